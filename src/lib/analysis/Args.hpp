@@ -202,6 +202,7 @@ public:
   std::string out_db_config;     // disable: "", stdout: "-"
 
   bool db_makeMetricDB;
+  bool db_metricDBColumnar; // cf. HPCMETRICDB_FMT_VersionColumnar
   bool db_addStructId;
 
   // -------------------------------------------------------
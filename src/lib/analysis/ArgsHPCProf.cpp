@@ -116,6 +116,12 @@ Options: General:\n\
   -V, --version        Print version information.\n\
   -h, --help           Print this help.\n\
   --debug [<n>]        Debug: use debug level <n>. {1}\n\
+  -j <num>, --threads <num>\n\
+                       hpcprof: read measurement files using <num> threads.\n\
+                       Profiles are still merged in command line order, so\n\
+                       the database is identical for any <num>. {1}\n\
+  --reduce-fanin <k>   hpcprof-mpi: merge profiles over a reduction tree in\n\
+                       which each rank receives from up to <k> others. {2}\n\
 \n\
 Options: Source Code and Static Structure:\n\
   --name <name>, --title <name>\n\
@@ -152,9 +158,11 @@ Options: Output:\n\
                        Specify Experiment database name <db-path>.\n\
                        {./" Analysis_DB_DIR "}\n\
                        Experiment format {" Analysis_OUT_DB_EXPERIMENT "}\n\
-  --metric-db <yes|no>\n\
+  --metric-db <yes|no|columnar>\n\
                        Control whether to generate a thread-level metric\n\
                        value database for hpcviewer scatter plots. {yes}\n\
+                       'columnar' (hpcprof-mpi) stores only nonzero values,\n\
+                       compressed and indexed by metric.\n\
   --remove-redundancy \n\
                        Eliminate procedure name redundancy in experiment.xml\n\
   --struct-id          Add 'str=nnn' field to profile data with the hpcstruct\n\
@@ -218,6 +226,10 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   {  0 , "debug",           CLP::ARG_OPT,  CLP::DUPOPT_CLOB, NULL,  // hidden
      CLP::isOptArg_long },
+  { 'j', "threads",         CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "reduce-fanin",    CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
   CmdLineParser_OptArgDesc_NULL_MACRO // SGI's compiler requires this version
 };
 
@@ -393,7 +405,9 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
 	parseArg_metric(metricVec[i], "--metric/-M option");
       }
     }
-    // N.B.: hpcprof checks for "force-metric": src/tool/hpcprof/Args.cpp
+    // N.B.: hpcprof checks for "force-metric" and "threads":
+    // src/tool/hpcprof/Args.cpp; hpcprof-mpi checks for "reduce-fanin":
+    // src/tool/hpcprof-mpi/Args.cpp
     
     // Check for other options: Output options
     bool isDbDirSet = false;
@@ -407,7 +421,13 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
     }
     if (parser.isOpt("metric-db")) {
       const string& arg = parser.getOptArg("metric-db");
-      db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
+      if (arg == "columnar") {
+	db_makeMetricDB = true;
+	db_metricDBColumnar = true;
+      }
+      else {
+	db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
+      }
     }
     if (parser.isOpt("struct-id")) {
       db_addStructId = true;
@@ -73,6 +73,13 @@ using std::string;
 
 #include <typeinfo>
 
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
 #include <sys/stat.h>
 
 //*************************** User Include Files ****************************
@@ -85,6 +92,7 @@ using std::string;
 #include "Util.hpp"
 
 #include <lib/prof/CCT-Tree.hpp>
+#include <lib/prof/CCT-TreeIterator.hpp>
 #include <lib/prof/Metric-Mgr.hpp>
 #include <lib/prof/Metric-ADesc.hpp>
 
@@ -138,15 +146,27 @@ namespace Analysis {
 namespace CallPath {
 
 
+static Prof::CallPath::Profile*
+readParallel(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
+	     int mergeTy, uint rFlags, uint mrgFlags, uint numThreads,
+	     ReadProgressFn progressFn, void* progressArg);
+
+
 Prof::CallPath::Profile*
 read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
-     int mergeTy, uint rFlags, uint mrgFlags)
+     int mergeTy, uint rFlags, uint mrgFlags, uint numThreads,
+     ReadProgressFn progressFn, void* progressArg)
 {
   // Special case
   if (profileFiles.empty()) {
     Prof::CallPath::Profile* prof = Prof::CallPath::Profile::make(rFlags);
     return prof;
   }
+
+  if (numThreads > 1 && profileFiles.size() > 1) {
+    return readParallel(profileFiles, groupMap, mergeTy, rFlags, mrgFlags,
+			numThreads, progressFn, progressArg);
+  }
   
   // General case
   uint groupId = (groupMap) ? (*groupMap)[0] : 0;
@@ -155,6 +175,10 @@ read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
   // add the directory into the set of directories
   prof->addDirectory(profileFiles[0]);
 
+  if (progressFn) {
+    progressFn(progressArg);
+  }
+
   for (uint i = 1; i < profileFiles.size(); ++i) {
     groupId = (groupMap) ? (*groupMap)[i] : 0;
     Prof::CallPath::Profile* p = read(profileFiles[i], groupId, rFlags);
@@ -165,6 +189,10 @@ read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
 
     // add the directory into the set of directories
     prof->addDirectory(profileFiles[i]);
+
+    if (progressFn) {
+      progressFn(progressArg);
+    }
   }
   prof->metricMgr()->mergePerfEventStatistics_finalize(profileFiles.size());
   
@@ -172,6 +200,222 @@ read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
 }
 
 
+//***************************************************************************
+// readParallel: Read 'profileFiles' using 'numThreads' threads.
+//
+// Parsing a profile is independent of all others, but merging is not:
+// the merge order determines the order of metrics and children and
+// the resolution of conflicting cpIds.  Therefore workers only parse,
+// and the calling thread merges the results in 'profileFiles' order,
+// exactly as the serial loop above does.  At most 'numThreads'
+// profiles are outstanding (read but not yet merged) at a time.
+//
+// Node ids: CCT::ANode ids come from a per-thread counter.  Each
+// worker records the range of ids it used for a profile; before
+// merging, those ids are shifted to where a serial read would have
+// placed them.  (Ids break ties when ordering nodes for the database,
+// so this keeps the output identical for any thread count.)
+//***************************************************************************
+
+namespace {
+
+class ReadSlot {
+public:
+  ReadSlot()
+    : prof(NULL), idBeg(0), idEnd(0), isDone(false)
+  { }
+
+  Prof::CallPath::Profile* prof;
+  uint idBeg, idEnd;        // node ids [idBeg, idEnd) used by 'prof'
+  std::exception_ptr error; // set if reading failed
+  bool isDone;
+};
+
+
+class ParallelReader {
+public:
+  ParallelReader(const Util::StringVec& profileFiles,
+		 const Util::UIntVec* groupMap, uint rFlags, uint window)
+    : m_profileFiles(profileFiles), m_groupMap(groupMap), m_rFlags(rFlags),
+      m_slots(profileFiles.size()), m_window(window),
+      m_nextRead(0), m_nextMerge(0)
+  { }
+
+  // worker: read profiles, in order, until none remain
+  void
+  work()
+  {
+    while (true) {
+      uint i;
+      {
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_canRead.wait(lock, [this] {
+	    return (m_nextRead >= m_slots.size()
+		    || m_nextRead < m_nextMerge + m_window); });
+	if (m_nextRead >= m_slots.size()) {
+	  return;
+	}
+	i = m_nextRead++;
+      }
+
+      ReadSlot& slot = m_slots[i];
+      slot.idBeg = Prof::CCT::ANode::nextUniqueId();
+      try {
+	uint groupId = (m_groupMap) ? (*m_groupMap)[i] : 0;
+	slot.prof = read(m_profileFiles[i], groupId, m_rFlags);
+      }
+      catch (...) {
+	slot.error = std::current_exception();
+      }
+      slot.idEnd = Prof::CCT::ANode::nextUniqueId();
+
+      {
+	std::lock_guard<std::mutex> lock(m_lock);
+	slot.isDone = true;
+      }
+      m_isRead.notify_all();
+    }
+  }
+
+  // merger: wait for the i-th profile and take ownership of it
+  ReadSlot&
+  take(uint i)
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_isRead.wait(lock, [this, i] { return m_slots[i].isDone; });
+    return m_slots[i];
+  }
+
+  // merger: the i-th profile has been consumed
+  void
+  release(uint i)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_slots[i].prof = NULL;
+      m_nextMerge = i + 1;
+    }
+    m_canRead.notify_all();
+  }
+
+  // merger: stop handing out work (e.g., after an error) and free
+  // whatever the workers have produced but not merged
+  void
+  cancel()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_nextRead = m_slots.size();
+    }
+    m_canRead.notify_all();
+  }
+
+  ~ParallelReader()
+  {
+    for (uint i = 0; i < m_slots.size(); ++i) {
+      delete m_slots[i].prof;
+    }
+  }
+
+private:
+  const Util::StringVec& m_profileFiles;
+  const Util::UIntVec* m_groupMap;
+  uint m_rFlags;
+
+  std::vector<ReadSlot> m_slots;
+  uint m_window;
+  uint m_nextRead;  // next profile to hand to a worker
+  uint m_nextMerge; // next profile to be merged
+
+  std::mutex m_lock;
+  std::condition_variable m_canRead;
+  std::condition_variable m_isRead;
+};
+
+} // namespace
+
+
+static void
+renumberNodeIds(Prof::CallPath::Profile* prof, uint idBeg, uint nextId)
+{
+  for (Prof::CCT::ANodeIterator it(prof->cct()->root()); it.Current(); ++it) {
+    Prof::CCT::ANode* n = it.current();
+    n->id(n->id() - idBeg + nextId);
+  }
+}
+
+
+static Prof::CallPath::Profile*
+readParallel(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
+	     int mergeTy, uint rFlags, uint mrgFlags, uint numThreads,
+	     ReadProgressFn progressFn, void* progressArg)
+{
+  uint nThreads = std::min<uint>(numThreads, profileFiles.size());
+  ParallelReader reader(profileFiles, groupMap, rFlags, nThreads);
+
+  std::vector<std::thread> workers;
+  for (uint t = 0; t < nThreads; ++t) {
+    workers.push_back(std::thread(&ParallelReader::work, &reader));
+  }
+
+  Prof::CallPath::Profile* prof = NULL;
+  uint nextId = Prof::CCT::ANode::nextUniqueId();
+  std::exception_ptr error;
+
+  for (uint i = 0; i < profileFiles.size(); ++i) {
+    ReadSlot& slot = reader.take(i);
+    if (slot.error) {
+      error = slot.error;
+      break;
+    }
+
+    Prof::CallPath::Profile* p = slot.prof;
+    renumberNodeIds(p, slot.idBeg, nextId);
+    nextId += slot.idEnd - slot.idBeg;
+
+    if (!prof) {
+      prof = p;
+    }
+    else {
+      try {
+	prof->merge(*p, mergeTy, mrgFlags);
+      }
+      catch (...) {
+	error = std::current_exception();
+	break;
+      }
+      prof->metricMgr()->mergePerfEventStatistics(p->metricMgr());
+      delete p;
+    }
+    reader.release(i);
+
+    // add the directory into the set of directories
+    prof->addDirectory(profileFiles[i]);
+
+    if (progressFn) {
+      progressFn(progressArg);
+    }
+  }
+
+  if (error) {
+    reader.cancel();
+  }
+  for (uint t = 0; t < workers.size(); ++t) {
+    workers[t].join();
+  }
+
+  if (error) {
+    delete prof;
+    std::rethrow_exception(error);
+  }
+
+  Prof::CCT::ANode::nextUniqueId(nextId);
+  prof->metricMgr()->mergePerfEventStatistics_finalize(profileFiles.size());
+
+  return prof;
+}
+
+
 Prof::CallPath::Profile*
 read(const char* prof_fnm, uint groupId, uint rFlags)
 {
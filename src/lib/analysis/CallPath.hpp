@@ -94,9 +94,16 @@ extern std::ostream* dbgOs; // for parallel debugging
 //
 // ---------------------------------------------------------
 
+typedef void (*ReadProgressFn)(void* arg);
+
+// read: Read and merge 'profileFiles' in order.  If 'numThreads' > 1,
+// the files are parsed concurrently; the result is the same.  If
+// given, 'progressFn(progressArg)' is called after each profile is
+// merged (e.g., to advance pending communication).
 Prof::CallPath::Profile*
 read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
-     int mergeTy, uint rFlags = 0, uint mrgFlags = 0);
+     int mergeTy, uint rFlags = 0, uint mrgFlags = 0, uint numThreads = 1,
+     ReadProgressFn progressFn = NULL, void* progressArg = NULL);
 
 Prof::CallPath::Profile*
 read(const char* prof_fnm, uint groupId, uint rFlags = 0);
@@ -405,7 +405,7 @@ Driver::write_txt_secSummary(std::ostream& os,
       const Metric::SampledDesc* mm =
 	dynamic_cast<const Metric::SampledDesc*>(m);
       if (mm) {
-	double smpl = rootStrct->metric(i) / (double)mm->period();
+	double smpl = rootStrct->metricVal(i) / (double)mm->period();
 	colFmt.genCol(i, smpl);
       }
       else {
@@ -416,7 +416,7 @@ Driver::write_txt_secSummary(std::ostream& os,
 
     // Program metric summary
     for (uint i = 0; i < m_mMgr.size(); ++i) {
-      colFmt.genCol(i, rootStrct->metric(i));
+      colFmt.genCol(i, rootStrct->metricVal(i));
     }
     os << std::endl;
   }
@@ -425,7 +425,7 @@ Driver::write_txt_secSummary(std::ostream& os,
     for (; it.current(); it++) {
       Struct::ANode* strct = it.current();
       for (uint i = 0; i < m_mMgr.size(); ++i) {
-	colFmt.genCol(i, strct->metric(i), rootStrct->metric(i));
+	colFmt.genCol(i, strct->metricVal(i), rootStrct->metricVal(i));
       }
       os << " " << strct->nameQual() << std::endl;
     }
@@ -487,7 +487,7 @@ Driver::write_txt_annotateFile(std::ostream& os,
     // Generate columns for ln_metric
     os << std::setw(linew) << std::setfill(' ') << ln_metric;
     for (uint i = 0; i < m_mMgr.size(); ++i) {
-      colFmt.genCol(i, strct->metric(i), rootStrct->metric(i));
+      colFmt.genCol(i, strct->metricVal(i), rootStrct->metricVal(i));
     }
 
     // Generate source file line for ln_metric, if necessary
@@ -825,7 +825,7 @@ Driver::correlateRaw(Prof::Metric::ADesc* metric,
     DIAG_DevMsg(6, "Metric associate: "
 		<< metric->name() << ":0x" << hex << vma_ur << dec
 		<< " --> +" << events << "="
-		<< strct->metric(metric->id()) << " :: " << strct->toXML());
+		<< strct->metricVal(metric->id()) << " :: " << strct->toXML());
   }
 }
 
@@ -61,6 +61,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 using std::string;
 
 #define __STDC_FORMAT_MACROS
@@ -144,6 +145,34 @@ Analysis::Raw::writeAsText_callpathMetricDB(const char* filenm)
 
     hpcmetricDB_fmt_hdr_fprint(&hdr, stdout);
 
+    if (hpcmetricDB_fmt_isColumnar(&hdr)) {
+      std::vector<hpcmetricDB_fmt_col_t> cols(hdr.numMetrics);
+      ret = hpcmetricDB_fmt_index_fread(cols.data(), hdr.numMetrics, fs);
+      if (ret != HPCFMT_OK) {
+	DIAG_Throw("error reading metric-db index '" << filenm << "'");
+      }
+
+      std::vector<unsigned char> buf(HPCMETRICDB_FMT_BlockBufSz);
+      for (uint mId = 0; mId < hdr.numMetrics; ++mId) {
+	const hpcmetricDB_fmt_col_t& col = cols[mId];
+	std::vector<uint32_t> nodeIds(col.numEntries);
+	std::vector<double> mvals(col.numEntries);
+	ret = hpcmetricDB_fmt_col_fread(nodeIds.data(), mvals.data(), &col,
+					buf.data(), fs);
+	if (ret != HPCFMT_OK) {
+	  DIAG_Throw("error reading metric-db file '" << filenm << "'");
+	}
+
+	fprintf(stdout, "(metric %u: %u values)\n", mId, col.numEntries);
+	for (uint i = 0; i < col.numEntries; ++i) {
+	  fprintf(stdout, "  (%6u: %12g)\n", nodeIds[i], mvals[i]);
+	}
+      }
+
+      hpcio_fclose(fs);
+      return;
+    }
+
     for (uint nodeId = 1; nodeId < hdr.numNodes + 1; ++nodeId) {
       fprintf(stdout, "(%6u: ", nodeId);
       for (uint mId = 0; mId < hdr.numMetrics; ++mId) {
@@ -187,9 +216,10 @@ Analysis::Raw::writeAsText_callpathTrace(const char* filenm)
     hpctrace_fmt_hdr_fprint(&hdr, stdout);
 
     // Read trace records and exit on EOF
+    hpctrace_fmt_block_t blk = hpctrace_fmt_block_NULL;
     while ( !feof(fs) ) {
       hpctrace_fmt_datum_t datum;
-      ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, fs);
+      ret = hpctrace_fmt_block_datum_fread(&datum, &blk, hdr.flags, fs);
       if (ret == HPCFMT_EOF) {
 	break;
       }
@@ -69,6 +69,11 @@
 // control at the end of the process, so there is no way to auto close
 // the buffers.
 //
+// With HPCIO_OUTBUF_ASYNC, the buffer is a ring of segments.  Full
+// segments are handed off and written by another thread that calls
+// hpcio_outbuf_drain(), so the client only calls write() itself when
+// the whole ring is full (a stall).
+//
 // Deserves further study: the best way to handle errors from write().
 //
 //***************************************************************************
@@ -91,10 +96,34 @@
 #include <include/min-max.h>
 
 #define HPCIO_OUTBUF_MAGIC  0x494F4246
+#define HPCIO_OUTBUF_ALIGN  4096
 
 
 //*************************** Private Functions *****************************
 
+// Start and capacity of the region the client is currently filling:
+// the whole buffer, or the current segment in async mode.
+//
+static inline char *
+outbuf_cur(hpcio_outbuf_t *outbuf)
+{
+  if (outbuf->flags & HPCIO_OUTBUF_ASYNC) {
+    unsigned long head =
+      atomic_load_explicit(&outbuf->seg_head, memory_order_relaxed);
+    return outbuf->buf_start + (head % HPCIO_OUTBUF_NSEG) * outbuf->seg_size;
+  }
+  return outbuf->buf_start;
+}
+
+
+static inline size_t
+outbuf_cap(hpcio_outbuf_t *outbuf)
+{
+  return (outbuf->flags & HPCIO_OUTBUF_ASYNC) ?
+    outbuf->seg_size : outbuf->buf_size;
+}
+
+
 // Try to write() the entire outbuf.
 //
 // Returns: HPCFMT_OK if the entire buffer was successfully written,
@@ -103,13 +132,13 @@
 static int
 outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
 {
+  char *cur = outbuf_cur(outbuf);
   ssize_t amt_done, ret;
 
   amt_done = 0;
   while (amt_done < outbuf->in_use) {
     errno = 0;
-    ret = write(outbuf->fd, outbuf->buf_start + amt_done,
-		outbuf->in_use - amt_done);
+    ret = write(outbuf->fd, cur + amt_done, outbuf->in_use - amt_done);
 
     // Check for short writes.  Note: EINTR is not failure.
     if (ret > 0 || (ret == 0 && errno == EINTR)) {
@@ -123,8 +152,7 @@ outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
       // and I want to rethink this case anyway.  So, this will do for
       // now. (krentel)
       if (amt_done > 0) {
-	memmove(outbuf->buf_start, outbuf->buf_start + amt_done,
-		outbuf->in_use - amt_done);
+	memmove(cur, cur + amt_done, outbuf->in_use - amt_done);
 	outbuf->in_use = amt_done;
       }
       return HPCFMT_ERR;
@@ -137,10 +165,125 @@ outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
 }
 
 
+// Async mode: write() up to 'max' full segments, oldest first.  The
+// caller must hold drain_lock.  On failure, drain_off remembers how
+// much of the oldest segment was written.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+static int
+outbuf_drain_segments(hpcio_outbuf_t *outbuf, int max)
+{
+  unsigned long tail =
+    atomic_load_explicit(&outbuf->seg_tail, memory_order_relaxed);
+  unsigned long head =
+    atomic_load_explicit(&outbuf->seg_head, memory_order_acquire);
+  ssize_t ret;
+  int n;
+
+  for (n = 0; n < max && tail != head; n++) {
+    int k = tail % HPCIO_OUTBUF_NSEG;
+    char *seg = outbuf->buf_start + k * outbuf->seg_size;
+    size_t len = outbuf->seg_len[k];
+
+    while (outbuf->drain_off < len) {
+      errno = 0;
+      ret = write(outbuf->fd, seg + outbuf->drain_off,
+		  len - outbuf->drain_off);
+      if (ret > 0 || (ret == 0 && errno == EINTR)) {
+	outbuf->drain_off += ret;
+      }
+      else {
+	return HPCFMT_ERR;
+      }
+    }
+
+    // segment is written, give it back to the client
+    outbuf->drain_off = 0;
+    tail++;
+    atomic_store_explicit(&outbuf->seg_tail, tail, memory_order_release);
+  }
+
+  return HPCFMT_OK;
+}
+
+
+// Async mode: hand off the current (full) segment and move to the
+// next one.  If every segment is still waiting to be written, this is
+// a stall and the client writes the oldest segment itself, so memory
+// stays bounded by the ring.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR (no free segment).
+//
+static int
+outbuf_next_segment(hpcio_outbuf_t *outbuf)
+{
+  unsigned long head =
+    atomic_load_explicit(&outbuf->seg_head, memory_order_relaxed);
+
+  if (head + 1 - atomic_load_explicit(&outbuf->seg_tail, memory_order_acquire)
+      == HPCIO_OUTBUF_NSEG) {
+    outbuf->num_stalls++;
+    spinlock_lock(&outbuf->drain_lock);
+    if (head + 1 - atomic_load_explicit(&outbuf->seg_tail, memory_order_relaxed)
+	== HPCIO_OUTBUF_NSEG) {
+      outbuf_drain_segments(outbuf, 1);
+    }
+    spinlock_unlock(&outbuf->drain_lock);
+
+    if (head + 1 - atomic_load_explicit(&outbuf->seg_tail, memory_order_acquire)
+	== HPCIO_OUTBUF_NSEG) {
+      return HPCFMT_ERR;
+    }
+  }
+
+  outbuf->seg_len[head % HPCIO_OUTBUF_NSEG] = outbuf->in_use;
+  atomic_store_explicit(&outbuf->seg_head, head + 1, memory_order_release);
+  outbuf->in_use = 0;
+
+  // wake the writer; write() is safe in a signal handler, and if it
+  // fails the segment is written at the next wakeup or stall
+  if (outbuf->notify_fd >= 0) {
+    uint64_t one = 1;
+    ssize_t ret = write(outbuf->notify_fd, &one, sizeof(one));
+    (void) ret;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+// Write everything in the outbuf: in async mode, the pending segments
+// in order and then the partial current segment.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+static int
+outbuf_flush_all(hpcio_outbuf_t *outbuf)
+{
+  int ret;
+
+  if (! (outbuf->flags & HPCIO_OUTBUF_ASYNC)) {
+    return outbuf_flush_buffer(outbuf);
+  }
+
+  spinlock_lock(&outbuf->drain_lock);
+  ret = outbuf_drain_segments(outbuf, HPCIO_OUTBUF_NSEG);
+  if (ret == HPCFMT_OK) {
+    ret = outbuf_flush_buffer(outbuf);
+  }
+  spinlock_unlock(&outbuf->drain_lock);
+
+  return ret;
+}
+
+
 //*************************** Interface Functions ***************************
 
 // Attach the file descriptor to the buffer, initialize and fill in
-// the outbuf struct.  The client supplies the buffer and fd.
+// the outbuf struct.  The client supplies the buffer and fd.  With
+// HPCIO_OUTBUF_ASYNC, the buffer is split into segments whose sizes
+// are a multiple of HPCIO_OUTBUF_ALIGN when the buffer is big enough.
 //
 // Returns: HPCFMT_OK on success, else HPCFMT_ERR.
 //
@@ -155,14 +298,32 @@ hpcio_outbuf_attach(hpcio_outbuf_t *outbuf /* out */, int fd,
   }
 
   outbuf->magic = HPCIO_OUTBUF_MAGIC;
-  outbuf->buf_start = buf_start;
+  outbuf->buf_start = (char *) buf_start;
   outbuf->buf_size = buf_size;
   outbuf->in_use = 0;
   outbuf->fd = fd;
   outbuf->flags = flags;
   outbuf->use_lock = (flags & HPCIO_OUTBUF_LOCKED);
+  outbuf->num_flushes = 0;
   spinlock_unlock(&outbuf->lock);
 
+  if (flags & HPCIO_OUTBUF_ASYNC) {
+    size_t seg_size = buf_size / HPCIO_OUTBUF_NSEG;
+    if (seg_size >= HPCIO_OUTBUF_ALIGN) {
+      seg_size -= seg_size % HPCIO_OUTBUF_ALIGN;
+    }
+    if (seg_size == 0) {
+      return HPCFMT_ERR;
+    }
+    outbuf->seg_size = seg_size;
+    outbuf->drain_off = 0;
+    outbuf->num_stalls = 0;
+    outbuf->notify_fd = -1;
+    atomic_init(&outbuf->seg_head, 0);
+    atomic_init(&outbuf->seg_tail, 0);
+    spinlock_unlock(&outbuf->drain_lock);
+  }
+
   return HPCFMT_OK;
 }
 
@@ -185,8 +346,19 @@ hpcio_outbuf_write(hpcio_outbuf_t *outbuf, const void *data, size_t size)
 
   amt_done = 0;
   while (amt_done < size) {
+    if (outbuf->flags & HPCIO_OUTBUF_ASYNC) {
+      // hand off only full segments, so writes stay aligned
+      if (outbuf->in_use == outbuf->seg_size) {
+	outbuf->num_flushes++;
+	if (outbuf_next_segment(outbuf) != HPCFMT_OK) {
+	  // ring is full and the oldest segment failed to write
+	  break;
+	}
+      }
+    }
     // flush if needed
-    if (size > outbuf->buf_size - outbuf->in_use) {
+    else if (size > outbuf->buf_size - outbuf->in_use) {
+      outbuf->num_flushes++;
       outbuf_flush_buffer(outbuf);
       if (outbuf->in_use == outbuf->buf_size) {
 	// flush failed, no space
@@ -195,8 +367,9 @@ hpcio_outbuf_write(hpcio_outbuf_t *outbuf, const void *data, size_t size)
     }
 
     // copy as much as possible
-    amt = MIN(size - amt_done, outbuf->buf_size - outbuf->in_use);
-    memcpy(outbuf->buf_start + outbuf->in_use, data + amt_done, amt);
+    amt = MIN(size - amt_done, outbuf_cap(outbuf) - outbuf->in_use);
+    memcpy(outbuf_cur(outbuf) + outbuf->in_use,
+	   (const char *)data + amt_done, amt);
     outbuf->in_use += amt;
     amt_done += amt;
   }
@@ -222,7 +395,7 @@ hpcio_outbuf_flush(hpcio_outbuf_t *outbuf)
     spinlock_lock(&outbuf->lock);
   }
 
-  int ret = outbuf_flush_buffer(outbuf);
+  int ret = outbuf_flush_all(outbuf);
 
   if (outbuf->use_lock) {
     spinlock_unlock(&outbuf->lock);
@@ -249,7 +422,7 @@ hpcio_outbuf_close(hpcio_outbuf_t *outbuf)
     spinlock_lock(&outbuf->lock);
   }
 
-  if (outbuf_flush_buffer(outbuf) == HPCFMT_OK
+  if (outbuf_flush_all(outbuf) == HPCFMT_OK
       && close(outbuf->fd) == 0) {
     // flush and close both succeed
     outbuf->magic = 0;
@@ -264,3 +437,221 @@ hpcio_outbuf_close(hpcio_outbuf_t *outbuf)
   }
   return ret;
 }
+
+
+// Write the segments that the client has handed off.  This is the
+// work of the background writer in async mode and may be called from
+// a thread other than the client's, but not after close.  A no-op for
+// synchronous outbufs.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_outbuf_drain(hpcio_outbuf_t *outbuf)
+{
+  int ret;
+
+  if (outbuf == NULL || outbuf->magic != HPCIO_OUTBUF_MAGIC) {
+    return HPCFMT_ERR;
+  }
+  if (! (outbuf->flags & HPCIO_OUTBUF_ASYNC)) {
+    return HPCFMT_OK;
+  }
+
+  spinlock_lock(&outbuf->drain_lock);
+  ret = outbuf_drain_segments(outbuf, HPCIO_OUTBUF_NSEG);
+  spinlock_unlock(&outbuf->drain_lock);
+
+  return ret;
+}
+
+
+// Returns: the number of times the client found every segment still
+// waiting to be written and had to write one itself.
+//
+unsigned long
+hpcio_outbuf_num_stalls(hpcio_outbuf_t *outbuf)
+{
+  if (outbuf == NULL || ! (outbuf->flags & HPCIO_OUTBUF_ASYNC)) {
+    return 0;
+  }
+  return outbuf->num_stalls;
+}
+
+
+// Returns: the number of times a write filled the buffer and flushed
+// it or, in async mode, handed off a segment.
+//
+unsigned long
+hpcio_outbuf_num_flushes(hpcio_outbuf_t *outbuf)
+{
+  if (outbuf == NULL || outbuf->magic != HPCIO_OUTBUF_MAGIC) {
+    return 0;
+  }
+  return outbuf->num_flushes;
+}
+
+
+// Async mode: after each segment is handed off, write an 8-byte count
+// of 1 to 'fd', e.g., an eventfd that the draining thread waits on.
+// -1 turns this off.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_outbuf_notify(hpcio_outbuf_t *outbuf, int fd)
+{
+  if (outbuf == NULL || outbuf->magic != HPCIO_OUTBUF_MAGIC
+      || ! (outbuf->flags & HPCIO_OUTBUF_ASYNC)) {
+    return HPCFMT_ERR;
+  }
+  outbuf->notify_fd = fd;
+  return HPCFMT_OK;
+}
+
+
+//***************************************************************************
+// unit test
+//***************************************************************************
+// #define UNIT_TEST_HPCIO_BUFFER
+
+#ifdef UNIT_TEST_HPCIO_BUFFER
+
+// Times every hpcio_outbuf_write() of 12-byte trace records, with the
+// sample path writing the file itself and with a writer thread that
+// waits on an eventfd, and prints the latency percentiles.  Checks
+// that both files have the same contents.
+//
+// usage: a.out [records] [ns between records] [buffer size] [dir]
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+static hpcio_outbuf_t bench_outbuf;
+static int bench_efd;
+static volatile int bench_done;
+
+static uint64_t
+bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void *
+bench_writer(void *arg)
+{
+  uint64_t count;
+  while (! bench_done) {
+    if (read(bench_efd, &count, sizeof(count)) == sizeof(count)) {
+      hpcio_outbuf_drain(&bench_outbuf);
+    }
+  }
+  return NULL;
+}
+
+static int
+bench_cmp(const void *x, const void *y)
+{
+  uint64_t a = *(const uint64_t *)x, b = *(const uint64_t *)y;
+  return (a > b) - (a < b);
+}
+
+static void
+bench_run(const char *fnm, int async, long nrec, long gap, size_t bufsz,
+	  uint64_t *lat)
+{
+  int fd = open(fnm, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  char *buf = malloc(bufsz);
+  pthread_t thread;
+
+  hpcio_outbuf_attach(&bench_outbuf, fd, buf, bufsz,
+		      HPCIO_OUTBUF_UNLOCKED | (async ? HPCIO_OUTBUF_ASYNC : 0));
+  if (async) {
+    bench_efd = eventfd(0, 0);
+    bench_done = 0;
+    hpcio_outbuf_notify(&bench_outbuf, bench_efd);
+    pthread_create(&thread, NULL, bench_writer, NULL);
+  }
+
+  srand(1);
+  for (long i = 0; i < nrec; i++) {
+    char rec[12];
+    uint64_t t = 1000 + 10 * i;
+    uint32_t id = rand() % 5000;
+    memcpy(rec, &t, 8);
+    memcpy(rec + 8, &id, 4);
+
+    uint64_t t0 = bench_now();
+    hpcio_outbuf_write(&bench_outbuf, rec, sizeof(rec));
+    uint64_t t1 = bench_now();
+    lat[i] = t1 - t0;
+    while (bench_now() - t1 < gap) { }
+  }
+
+  if (async) {
+    uint64_t one = 1;
+    bench_done = 1;
+    if (write(bench_efd, &one, sizeof(one)) == sizeof(one)) {
+      pthread_join(thread, NULL);
+    }
+    close(bench_efd);
+    printf("  stalls: %lu\n", hpcio_outbuf_num_stalls(&bench_outbuf));
+  }
+  hpcio_outbuf_close(&bench_outbuf);
+  free(buf);
+
+  qsort(lat, nrec, sizeof(*lat), bench_cmp);
+  printf("  latency (ns): p50 %lu  p99 %lu  p99.9 %lu  p99.99 %lu  max %lu\n",
+	 (unsigned long)lat[nrec / 2], (unsigned long)lat[nrec / 100 * 99],
+	 (unsigned long)lat[nrec / 1000 * 999],
+	 (unsigned long)lat[nrec / 10000 * 9999], (unsigned long)lat[nrec - 1]);
+}
+
+static int
+bench_same(const char *x, const char *y)
+{
+  FILE *fx = fopen(x, "r"), *fy = fopen(y, "r");
+  int cx, cy;
+  do {
+    cx = getc(fx);
+    cy = getc(fy);
+  } while (cx == cy && cx != EOF);
+  fclose(fx);
+  fclose(fy);
+  return (cx == cy);
+}
+
+int
+main(int argc, char **argv)
+{
+  long nrec = (argc > 1) ? atol(argv[1]) : 4000000;
+  long gap = (argc > 2) ? atol(argv[2]) : 200;
+  size_t bufsz = (argc > 3) ? atol(argv[3]) : HPCIO_RWBufferSz;
+  const char *dir = (argc > 4) ? argv[4] : "/tmp";
+  uint64_t *lat = malloc(nrec * sizeof(*lat));
+  char sync_fnm[4096], async_fnm[4096];
+
+  snprintf(sync_fnm, sizeof(sync_fnm), "%s/outbuf-sync.%d", dir, (int)getpid());
+  snprintf(async_fnm, sizeof(async_fnm), "%s/outbuf-async.%d", dir, (int)getpid());
+
+  printf("%ld records, %ld ns apart, %lu byte buffer\n", nrec, gap,
+	 (unsigned long)bufsz);
+  printf("synchronous:\n");
+  bench_run(sync_fnm, 0, nrec, gap, bufsz, lat);
+  printf("async (writer thread):\n");
+  bench_run(async_fnm, 1, nrec, gap, bufsz, lat);
+
+  int ok = bench_same(sync_fnm, async_fnm);
+  printf("%s\n", ok ? "same contents" : "CONTENTS DIFFER");
+  unlink(sync_fnm);
+  unlink(async_fnm);
+  free(lat);
+  return ok ? 0 : 1;
+}
+
+#endif
@@ -51,19 +51,41 @@
 #include <stdint.h>
 #include <stdio.h>
 #include "spinlock.h"
+#include "stdatomic.h"
 
 
+// Number of segments in the ring for HPCIO_OUTBUF_ASYNC.
+#define HPCIO_OUTBUF_NSEG  4
+
 // Clients should treat the outbuf struct as opaque.
+//
+// In async mode, the buffer is split into HPCIO_OUTBUF_NSEG segments.
+// The client fills the segment at seg_head and hands it off when
+// full, another thread writes segments [seg_tail, seg_head) via
+// hpcio_outbuf_drain().  in_use is relative to the current segment.
+// If notify_fd is set, each hand-off is signaled there so that the
+// draining thread can sleep until there is work.
 
 typedef struct hpcio_outbuf_s {
   uint32_t magic;
-  void  *buf_start;
+  char  *buf_start;
   size_t buf_size;
   size_t in_use;
   int  fd;
   int  flags;
   char use_lock;
   spinlock_t lock;
+  unsigned long num_flushes;
+
+  // async mode only
+  size_t seg_size;
+  size_t seg_len[HPCIO_OUTBUF_NSEG];
+  size_t drain_off;
+  atomic_ulong seg_head;
+  atomic_ulong seg_tail;
+  spinlock_t drain_lock;
+  unsigned long num_stalls;
+  int notify_fd;
 } hpcio_outbuf_t;
 
 
@@ -73,6 +95,7 @@ typedef struct hpcio_outbuf_s {
 
 #define HPCIO_OUTBUF_LOCKED    0x1
 #define HPCIO_OUTBUF_UNLOCKED  0x2
+#define HPCIO_OUTBUF_ASYNC     0x4
 
 #if defined(__cplusplus)
 extern "C" {
@@ -91,6 +114,18 @@ hpcio_outbuf_flush(hpcio_outbuf_t *outbuf);
 int
 hpcio_outbuf_close(hpcio_outbuf_t *outbuf);
 
+int
+hpcio_outbuf_drain(hpcio_outbuf_t *outbuf);
+
+unsigned long
+hpcio_outbuf_num_stalls(hpcio_outbuf_t *outbuf);
+
+unsigned long
+hpcio_outbuf_num_flushes(hpcio_outbuf_t *outbuf);
+
+int
+hpcio_outbuf_notify(hpcio_outbuf_t *outbuf, int fd);
+
 #if defined(__cplusplus)
 }
 #endif
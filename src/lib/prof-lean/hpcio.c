@@ -406,6 +406,20 @@ hpcio_beX_fwrite(uint8_t* val, size_t size, FILE* fs)
 }
 
 
+//***************************************************************************
+// In-memory big endian
+//***************************************************************************
+
+void
+hpcio_be8_mread_n(uint64_t* restrict val, const unsigned char* restrict buf,
+		  size_t n)
+{
+  for (size_t i = 0; i < n; ++i) {
+    val[i] = hpcio_be8_mread(buf + 8 * i);
+  }
+}
+
+
 //***************************************************************************
 //
 //***************************************************************************
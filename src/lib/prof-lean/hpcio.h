@@ -171,6 +171,58 @@ size_t
 hpcio_beX_fwrite(uint8_t* val, size_t size, FILE* fs);
 
 
+//***************************************************************************
+
+// hpcio_beX_mread: Decodes 'X' number of big-endian bytes beginning
+// at 'buf' (which need not be aligned), correctly ordering them for
+// the current architecture.  These are the in-memory analogues of
+// hpcio_beX_fread for use with mapped or bulk-read files.  The shift
+// forms are recognized by compilers as a load plus byte swap.
+
+static inline uint16_t
+hpcio_be2_mread(const unsigned char* buf)
+{
+  return (uint16_t)(((uint16_t)buf[0] << 8) | (uint16_t)buf[1]);
+}
+
+
+static inline uint32_t
+hpcio_be4_mread(const unsigned char* buf)
+{
+  return (((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16)
+	  | ((uint32_t)buf[2] << 8) | (uint32_t)buf[3]);
+}
+
+
+static inline uint64_t
+hpcio_be8_mread(const unsigned char* buf)
+{
+  return (((uint64_t)buf[0] << 56) | ((uint64_t)buf[1] << 48)
+	  | ((uint64_t)buf[2] << 40) | ((uint64_t)buf[3] << 32)
+	  | ((uint64_t)buf[4] << 24) | ((uint64_t)buf[5] << 16)
+	  | ((uint64_t)buf[6] << 8)  | (uint64_t)buf[7]);
+}
+
+
+// hpcio_be4_mwrite: Encodes 'val' as 4 big-endian bytes at 'buf'
+// (which need not be aligned).
+static inline void
+hpcio_be4_mwrite(unsigned char* buf, uint32_t val)
+{
+  buf[0] = (unsigned char)(val >> 24);
+  buf[1] = (unsigned char)(val >> 16);
+  buf[2] = (unsigned char)(val >> 8);
+  buf[3] = (unsigned char)val;
+}
+
+
+// hpcio_be8_mread_n: Decodes 'n' consecutive big-endian 8-byte values
+// beginning at 'buf' into 'val'.  The loop has no dependences so that
+// it vectorizes into a block byte swap.
+void
+hpcio_be8_mread_n(uint64_t* val, const unsigned char* buf, size_t n);
+
+
 //***************************************************************************
 
 #if defined(__cplusplus)
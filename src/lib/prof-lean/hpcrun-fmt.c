@@ -639,6 +639,37 @@ hpcrun_fmt_cct_node_fread(hpcrun_fmt_cct_node_t* x,
 }
 
 
+size_t
+hpcrun_fmt_cct_node_mread(hpcrun_fmt_cct_node_t* x,
+			  epoch_flags_t flags, const unsigned char* buf)
+{
+  const unsigned char* p = buf;
+
+  x->id = hpcio_be4_mread(p);         p += sizeof(uint32_t);
+  x->id_parent = hpcio_be4_mread(p);  p += sizeof(uint32_t);
+
+  x->as_info = lush_assoc_info_NULL;
+  if (flags.fields.isLogicalUnwind) {
+    x->as_info.bits = hpcio_be4_mread(p);  p += sizeof(uint32_t);
+  }
+
+  x->lm_id = hpcio_be2_mread(p);      p += sizeof(uint16_t);
+  x->lm_ip = hpcio_be8_mread(p);      p += sizeof(hpcfmt_vma_t);
+
+  lush_lip_init(&x->lip);
+  if (flags.fields.isLogicalUnwind) {
+    hpcio_be8_mread_n(x->lip.data8, p, LUSH_LIP_DATA8_SZ);
+    p += sizeof(lush_lip_t);
+  }
+
+  // N.B.: hpcrun_metricVal_t is a union over 8 bytes
+  hpcio_be8_mread_n((uint64_t*)x->metrics, p, x->num_metrics);
+  p += x->num_metrics * sizeof(uint64_t);
+
+  return (size_t)(p - buf);
+}
+
+
 int
 hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
 			   epoch_flags_t flags, FILE* fs)
@@ -966,6 +997,257 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 }
 
 
+//***************************************************************************
+// [hpctrace] delta-encoded trace records
+//***************************************************************************
+
+const hpctrace_fmt_block_t hpctrace_fmt_block_NULL = {
+  .time = 0,
+  .cpId = 0,
+  .pos  = 0
+};
+
+
+// padding for the end of a block
+static const unsigned char hpctrace_fmt_block_zeros[HPCTRACE_FMT_BlockSize];
+
+
+static inline uint64_t
+hpctrace_fmt_zigzag(int64_t v)
+{
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+
+static inline int64_t
+hpctrace_fmt_unzigzag(uint64_t u)
+{
+  return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+
+static int
+hpctrace_fmt_varint_put(unsigned char* buf, uint64_t val)
+{
+  int k = 0;
+  while (val >= 0x80) {
+    buf[k++] = (val & 0x7f) | 0x80;
+    val >>= 7;
+  }
+  buf[k++] = val;
+  return k;
+}
+
+
+// Encode the record 'x' relative to (time, cpId) into 'buf'.
+// Returns: the number of bytes, at most HPCTRACE_FMT_BlockRecMax.
+static int
+hpctrace_fmt_block_rec_encode(unsigned char* buf, hpctrace_fmt_datum_t* x,
+			      uint64_t time, uint32_t cpId,
+			      hpctrace_hdr_flags_t flags)
+{
+  int k = 0;
+
+  // +1 so that a record never begins with a zero byte
+  k += hpctrace_fmt_varint_put(buf + k,
+	 hpctrace_fmt_zigzag((int64_t)(x->time - time)) + 1);
+  k += hpctrace_fmt_varint_put(buf + k,
+	 hpctrace_fmt_zigzag((int32_t)(x->cpId - cpId)));
+  if (flags.fields.isDataCentric) {
+    k += hpctrace_fmt_varint_put(buf + k, x->metricId);
+  }
+  return k;
+}
+
+
+// Encode 'x' into 'buf', starting a new block if it does not fit in
+// the current one.  '*pad' is set to the number of zero bytes that
+// must be written before 'buf' to end the current block.
+// Returns: the number of bytes in 'buf'.
+static int
+hpctrace_fmt_block_encode(hpctrace_fmt_datum_t* x, hpctrace_fmt_block_t* blk,
+			  hpctrace_hdr_flags_t flags, unsigned char* buf,
+			  int* pad)
+{
+  int len;
+
+  *pad = 0;
+  if (blk->pos > 0) {
+    len = hpctrace_fmt_block_rec_encode(buf, x, blk->time, blk->cpId, flags);
+    if (blk->pos + len <= HPCTRACE_FMT_BlockSize) {
+      blk->pos += len;
+      blk->time = x->time;
+      blk->cpId = x->cpId;
+      return len;
+    }
+    *pad = HPCTRACE_FMT_BlockSize - blk->pos;
+  }
+
+  // new block: absolute start time, then the record
+  uint64_t time = x->time;
+  len = 0;
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    buf[len] = (time >> shift) & 0xff;
+    len++;
+  }
+  len += hpctrace_fmt_block_rec_encode(buf + len, x, x->time, 0, flags);
+
+  blk->pos = len;
+  blk->time = x->time;
+  blk->cpId = x->cpId;
+  return len;
+}
+
+
+static inline int
+hpctrace_fmt_block_getc(hpctrace_fmt_block_t* blk, FILE* fs)
+{
+  blk->pos++;
+  return fgetc(fs);
+}
+
+
+// Decode a varint whose first byte 'c' has already been read.
+static int
+hpctrace_fmt_varint_fread(uint64_t* val, int c, hpctrace_fmt_block_t* blk,
+			  FILE* fs)
+{
+  uint64_t v = 0;
+
+  for (int shift = 0; ; shift += 7) {
+    if (c == EOF || shift > 63) {
+      return HPCFMT_ERR;
+    }
+    v |= (uint64_t)(c & 0x7f) << shift;
+    if (! (c & 0x80)) {
+      break;
+    }
+    c = hpctrace_fmt_block_getc(blk, fs);
+  }
+
+  *val = v;
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_block_datum_fread(hpctrace_fmt_datum_t* x,
+			       hpctrace_fmt_block_t* blk,
+			       hpctrace_hdr_flags_t flags, FILE* fs)
+{
+  if (! flags.fields.isDeltaEncoded) {
+    return hpctrace_fmt_datum_fread(x, flags, fs);
+  }
+
+  int c;
+  for (;;) {
+    if (blk->pos == 0 || blk->pos >= HPCTRACE_FMT_BlockSize) {
+      int ret = hpcfmt_int8_fread(&(blk->time), fs);
+      if (ret != HPCFMT_OK) {
+	return ret; // can be HPCFMT_EOF
+      }
+      blk->cpId = 0;
+      blk->pos = HPCTRACE_FMT_BlockHdrLen;
+    }
+
+    c = hpctrace_fmt_block_getc(blk, fs);
+    if (c == EOF) {
+      return HPCFMT_EOF;
+    }
+    if (c != 0) {
+      break;
+    }
+
+    // end of block: skip the padding
+    if (fseek(fs, HPCTRACE_FMT_BlockSize - blk->pos, SEEK_CUR) != 0) {
+      return HPCFMT_ERR;
+    }
+    blk->pos = HPCTRACE_FMT_BlockSize;
+  }
+
+  uint64_t val;
+  HPCFMT_ThrowIfError(hpctrace_fmt_varint_fread(&val, c, blk, fs));
+  if (val == 0) {
+    return HPCFMT_ERR;
+  }
+  x->time = blk->time + hpctrace_fmt_unzigzag(val - 1);
+
+  c = hpctrace_fmt_block_getc(blk, fs);
+  HPCFMT_ThrowIfError(hpctrace_fmt_varint_fread(&val, c, blk, fs));
+  x->cpId = blk->cpId + (uint32_t)hpctrace_fmt_unzigzag(val);
+
+  if (flags.fields.isDataCentric) {
+    c = hpctrace_fmt_block_getc(blk, fs);
+    HPCFMT_ThrowIfError(hpctrace_fmt_varint_fread(&val, c, blk, fs));
+    x->metricId = (uint32_t)val;
+  }
+  else {
+    x->metricId = HPCRUN_FMT_MetricId_NULL;
+  }
+
+  if (blk->pos > HPCTRACE_FMT_BlockSize) {
+    return HPCFMT_ERR; // record crosses a block boundary
+  }
+
+  blk->time = x->time;
+  blk->cpId = x->cpId;
+  return HPCFMT_OK;
+}
+
+
+// Append the trace record to the outbuf.
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+int
+hpctrace_fmt_block_datum_outbuf(hpctrace_fmt_datum_t* x,
+				hpctrace_fmt_block_t* blk,
+				hpctrace_hdr_flags_t flags,
+				hpcio_outbuf_t* outbuf)
+{
+  if (! flags.fields.isDeltaEncoded) {
+    return hpctrace_fmt_datum_outbuf(x, flags, outbuf);
+  }
+
+  unsigned char buf[HPCTRACE_FMT_BlockHdrLen + HPCTRACE_FMT_BlockRecMax];
+  int pad;
+  int len = hpctrace_fmt_block_encode(x, blk, flags, buf, &pad);
+
+  if (pad > 0
+      && hpcio_outbuf_write(outbuf, hpctrace_fmt_block_zeros, pad) != pad) {
+    return HPCFMT_ERR;
+  }
+  if (hpcio_outbuf_write(outbuf, buf, len) != len) {
+    return HPCFMT_ERR;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_block_datum_fwrite(hpctrace_fmt_datum_t* x,
+				hpctrace_fmt_block_t* blk,
+				hpctrace_hdr_flags_t flags, FILE* outfs)
+{
+  if (! flags.fields.isDeltaEncoded) {
+    return hpctrace_fmt_datum_fwrite(x, flags, outfs);
+  }
+
+  unsigned char buf[HPCTRACE_FMT_BlockHdrLen + HPCTRACE_FMT_BlockRecMax];
+  int pad;
+  int len = hpctrace_fmt_block_encode(x, blk, flags, buf, &pad);
+
+  if (pad > 0
+      && fwrite(hpctrace_fmt_block_zeros, 1, pad, outfs) != (size_t)pad) {
+    return HPCFMT_ERR;
+  }
+  if (fwrite(buf, 1, len, outfs) != (size_t)len) {
+    return HPCFMT_ERR;
+  }
+
+  return HPCFMT_OK;
+}
+
+
 //***************************************************************************
 // hpcprof-metricdb (located here for now)
 //***************************************************************************
@@ -978,7 +1260,6 @@ int
 hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
 {
   char tag[HPCMETRICDB_FMT_MagicLen + 1];
-  char version[HPCMETRICDB_FMT_VersionLen + 1];
   char endian[HPCMETRICDB_FMT_EndianLen + 1];
 
   int nr = fread(tag, 1, HPCMETRICDB_FMT_MagicLen, infs);
@@ -991,8 +1272,8 @@ hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
     return HPCFMT_ERR;
   }
 
-  nr = fread(&version, 1, HPCMETRICDB_FMT_VersionLen, infs);
-  version[HPCMETRICDB_FMT_VersionLen] = '\0';
+  nr = fread(hdr->versionStr, 1, HPCMETRICDB_FMT_VersionLen, infs);
+  hdr->versionStr[HPCMETRICDB_FMT_VersionLen] = '\0';
   if (nr != HPCMETRICDB_FMT_VersionLen) {
     return HPCFMT_ERR;
   }
@@ -1018,7 +1299,7 @@ hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
   nw = fwrite(HPCMETRICDB_FMT_Magic,   1, HPCMETRICDB_FMT_MagicLen, outfs);
   if (nw != HPCTRACE_FMT_MagicLen) return HPCFMT_ERR;
 
-  nw = fwrite(HPCMETRICDB_FMT_Version, 1, HPCMETRICDB_FMT_VersionLen, outfs);
+  nw = fwrite(hdr->versionStr, 1, HPCMETRICDB_FMT_VersionLen, outfs);
   if (nw != HPCMETRICDB_FMT_VersionLen) return HPCFMT_ERR;
 
   nw = fwrite(HPCMETRICDB_FMT_Endian,  1, HPCMETRICDB_FMT_EndianLen, outfs);
@@ -1035,7 +1316,9 @@ int
 hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
 {
   fprintf(outfs, "%s\n", HPCMETRICDB_FMT_Magic);
-  fprintf(outfs, "[hdr:...]\n");
+  fprintf(outfs, "[hdr:\n");
+  fprintf(outfs, "  (version: %s)\n", hdr->versionStr);
+  fprintf(outfs, "]\n");
 
   fprintf(outfs, "(num-nodes:   %u)\n", hdr->numNodes);
   fprintf(outfs, "(num-metrics: %u)\n", hdr->numMetrics);
@@ -1043,3 +1326,216 @@ hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
   return HPCFMT_OK;
 }
 
+
+//***************************************************************************
+// [hpcprof-metricdb] columns
+//***************************************************************************
+
+static inline uint64_t
+metricDB_dblToBits(double x)
+{
+  union { double d; uint64_t u; } v;
+  v.d = x;
+  return v.u;
+}
+
+
+static inline double
+metricDB_bitsToDbl(uint64_t x)
+{
+  union { double d; uint64_t u; } v;
+  v.u = x;
+  return v.d;
+}
+
+
+static inline void
+metricDB_int4_mwrite(unsigned char* buf, uint32_t val)
+{
+  buf[0] = (unsigned char)(val >> 24);
+  buf[1] = (unsigned char)(val >> 16);
+  buf[2] = (unsigned char)(val >> 8);
+  buf[3] = (unsigned char)(val);
+}
+
+
+int
+hpcmetricDB_fmt_block_fwrite(const uint32_t* nodeIds, const double* vals,
+			     uint32_t n, hpcmetricDB_fmt_col_t* col,
+			     unsigned char* buf, FILE* outfs)
+{
+  if (n == 0 || n > HPCMETRICDB_FMT_BlockMaxEntries) {
+    return HPCFMT_ERR;
+  }
+
+  unsigned char* p = buf;
+  uint32_t prevId = 0;
+  uint64_t prevBits = 0;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    // node-id delta (LEB128)
+    uint32_t d = nodeIds[i] - prevId;
+    prevId = nodeIds[i];
+    while (d >= 0x80) {
+      *p++ = (unsigned char)(d | 0x80);
+      d >>= 7;
+    }
+    *p++ = (unsigned char)d;
+
+    // value: XOR with previous; drop leading and trailing zero bytes
+    uint64_t bits = metricDB_dblToBits(vals[i]);
+    uint64_t x = bits ^ prevBits;
+    prevBits = bits;
+
+    int lead = 8, trail = 0;
+    if (x != 0) {
+      lead = 0;
+      while (!(x & ((uint64_t)0xff << (56 - 8 * lead)))) { lead++; }
+      while (!(x & 0xff)) { x >>= 8; trail++; }
+    }
+    *p++ = (unsigned char)((lead << 4) | trail);
+    for (int j = 8 - lead - trail - 1; j >= 0; --j) {
+      *p++ = (unsigned char)(x >> (8 * j));
+    }
+  }
+
+  unsigned char blkHdr[8];
+  uint32_t len = (uint32_t)(p - buf);
+  metricDB_int4_mwrite(blkHdr, n);
+  metricDB_int4_mwrite(blkHdr + 4, len);
+
+  if (fwrite(blkHdr, 1, sizeof(blkHdr), outfs) != sizeof(blkHdr)) {
+    return HPCFMT_ERR;
+  }
+  if (fwrite(buf, 1, len, outfs) != len) {
+    return HPCFMT_ERR;
+  }
+
+  col->length += sizeof(blkHdr) + len;
+  col->numEntries += n;
+  col->numBlocks++;
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_index_fwrite(const hpcmetricDB_fmt_col_t* cols,
+			     uint32_t numMetrics, uint64_t offset,
+			     FILE* outfs)
+{
+  for (uint32_t i = 0; i < numMetrics; ++i) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(cols[i].offset, outfs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(cols[i].length, outfs));
+    HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(cols[i].numEntries, outfs));
+    HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(cols[i].numBlocks, outfs));
+  }
+
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(offset, outfs));
+
+  size_t nw = fwrite(HPCMETRICDB_FMT_FooterTag, 1,
+		     HPCMETRICDB_FMT_FooterTagLen, outfs);
+  if (nw != HPCMETRICDB_FMT_FooterTagLen) return HPCFMT_ERR;
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_index_fread(hpcmetricDB_fmt_col_t* cols,
+			    uint32_t numMetrics, FILE* infs)
+{
+  char tag[HPCMETRICDB_FMT_FooterTagLen + 1];
+  uint64_t offset = 0;
+
+  if (fseeko(infs, -(off_t)HPCMETRICDB_FMT_FooterLen, SEEK_END) != 0) {
+    return HPCFMT_ERR;
+  }
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&offset, infs));
+
+  size_t nr = fread(tag, 1, HPCMETRICDB_FMT_FooterTagLen, infs);
+  tag[HPCMETRICDB_FMT_FooterTagLen] = '\0';
+  if (nr != HPCMETRICDB_FMT_FooterTagLen
+      || strcmp(tag, HPCMETRICDB_FMT_FooterTag) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  if (fseeko(infs, (off_t)offset, SEEK_SET) != 0) {
+    return HPCFMT_ERR;
+  }
+  for (uint32_t i = 0; i < numMetrics; ++i) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&cols[i].offset, infs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&cols[i].length, infs));
+    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&cols[i].numEntries, infs));
+    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&cols[i].numBlocks, infs));
+  }
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_col_fread(uint32_t* nodeIds, double* vals,
+			  const hpcmetricDB_fmt_col_t* col,
+			  unsigned char* buf, FILE* infs)
+{
+  if (fseeko(infs, (off_t)col->offset, SEEK_SET) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  uint32_t k = 0; // entries decoded
+
+  for (uint32_t blk = 0; blk < col->numBlocks; ++blk) {
+    unsigned char blkHdr[8];
+    if (fread(blkHdr, 1, sizeof(blkHdr), infs) != sizeof(blkHdr)) {
+      return HPCFMT_ERR;
+    }
+    uint32_t n   = hpcio_be4_mread(blkHdr);
+    uint32_t len = hpcio_be4_mread(blkHdr + 4);
+    if (n > HPCMETRICDB_FMT_BlockMaxEntries || n > col->numEntries - k
+	|| len > HPCMETRICDB_FMT_BlockBufSz) {
+      return HPCFMT_ERR;
+    }
+    if (fread(buf, 1, len, infs) != len) {
+      return HPCFMT_ERR;
+    }
+
+    const unsigned char* p = buf;
+    const unsigned char* end = buf + len;
+    uint32_t prevId = 0;
+    uint64_t prevBits = 0;
+
+    for (uint32_t i = 0; i < n; ++i, ++k) {
+      uint32_t d = 0;
+      for (int shift = 0; ; shift += 7) {
+	if (p == end || shift > 28) return HPCFMT_ERR;
+	unsigned char c = *p++;
+	d |= (uint32_t)(c & 0x7f) << shift;
+	if (!(c & 0x80)) break;
+      }
+      prevId += d;
+
+      if (p == end) return HPCFMT_ERR;
+      int lead = *p >> 4, trail = *p & 0xf;
+      p++;
+      int nbytes = 8 - lead - trail;
+      if (nbytes < 0 || (lead == 8 && trail != 0) || end - p < nbytes) {
+	return HPCFMT_ERR;
+      }
+      uint64_t x = 0;
+      for (int j = 0; j < nbytes; ++j) {
+	x = (x << 8) | *p++;
+      }
+      if (nbytes > 0) {
+	x <<= 8 * trail;
+      }
+      prevBits ^= x;
+
+      nodeIds[k] = prevId;
+      vals[k] = metricDB_bitsToDbl(prevBits);
+    }
+  }
+
+  return (k == col->numEntries) ? HPCFMT_OK : HPCFMT_ERR;
+}
+
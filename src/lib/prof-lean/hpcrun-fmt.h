@@ -98,6 +98,9 @@ static const char HPCRUN_TraceFnmSfx[] = "hpctrace";
 // hpcrun log filename suffix
 static const char HPCRUN_LogFnmSfx[] = "log";
 
+// hpcrun sample overhead filename suffix
+static const char HPCRUN_OverheadFnmSfx[] = "hpcoverhead";
+
 // hpcprof metric db filename suffix
 static const char HPCPROF_MetricDBSfx[] = "metric-db";
 
@@ -559,6 +562,29 @@ extern int
 hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
 			   epoch_flags_t flags, FILE* fs);
 
+// hpcrun_fmt_cct_node_mlen: the (fixed) size in bytes of a formatted
+// node with 'num_metrics' metrics.
+static inline size_t
+hpcrun_fmt_cct_node_mlen(epoch_flags_t flags, hpcfmt_uint_t num_metrics)
+{
+  size_t sz = (sizeof(uint32_t) /*id*/ + sizeof(uint32_t) /*id_parent*/
+	       + sizeof(uint16_t) /*lm_id*/ + sizeof(hpcfmt_vma_t) /*lm_ip*/
+	       + num_metrics * sizeof(uint64_t));
+  if (flags.fields.isLogicalUnwind) {
+    sz += sizeof(uint32_t) /*as_info*/ + sizeof(lush_lip_t) /*lip*/;
+  }
+  return sz;
+}
+
+// hpcrun_fmt_cct_node_mread: in-memory analogue of
+// hpcrun_fmt_cct_node_fread.  Decodes one node from 'buf', which must
+// hold at least hpcrun_fmt_cct_node_mlen() bytes, and returns the
+// number of bytes consumed.
+// N.B.: assumes space for metrics has been allocated
+extern size_t
+hpcrun_fmt_cct_node_mread(hpcrun_fmt_cct_node_t* x,
+			  epoch_flags_t flags, const unsigned char* buf);
+
 extern int
 hpcrun_fmt_cct_node_fprint(hpcrun_fmt_cct_node_t* x, FILE* fs,
 			   epoch_flags_t flags, const metric_tbl_t* metricTbl,
@@ -597,8 +623,9 @@ static const char HPCTRACE_FMT_Endian[]  = "b";                  // 1 byte
 
 
 typedef struct hpctrace_hdr_flags_bitfield {
-  bool isDataCentric : 1;
-  uint64_t unused    : 63;
+  bool isDataCentric  : 1;
+  bool isDeltaEncoded : 1; // records are in blocks (see below)
+  uint64_t unused     : 62;
 } hpctrace_hdr_flags_bitfield;
 
 
@@ -684,6 +711,64 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 			  FILE* fs);
 
 
+//***************************************************************************
+// [hpctrace] delta-encoded trace records
+//***************************************************************************
+
+// With flags.isDeltaEncoded, the records following the header are
+// stored in blocks of HPCTRACE_FMT_BlockSize bytes.  Each block begins
+// with the absolute time (8 bytes, big-endian) of its first record,
+// followed by records of:
+//
+//   varint(zigzag(time - prev.time) + 1)
+//   varint(zigzag(cpId - prev.cpId))
+//   varint(metricId)                       [isDataCentric only]
+//
+// where varints are LEB128 and 'prev' is (block time, 0) at the start
+// of each block.  A zero byte where a record would begin ends the
+// block; the rest of the block is padding.  The last block may be
+// short.  Because blocks have a fixed size, block k begins at
+// HPCTRACE_FMT_HeaderLen + k * HPCTRACE_FMT_BlockSize, so readers may
+// binary search on block times without decoding the whole file.
+
+#define HPCTRACE_FMT_BlockSize    (4096)
+#define HPCTRACE_FMT_BlockHdrLen  (8)
+#define HPCTRACE_FMT_BlockRecMax  (10 + 5 + 5)
+
+
+// Encoder or decoder state for one trace file.  Initialize with
+// hpctrace_fmt_block_NULL.
+typedef struct hpctrace_fmt_block_t {
+  uint64_t time; // previous record in this block
+  uint32_t cpId;
+  uint32_t pos;  // bytes used in this block, 0 before the first block
+} hpctrace_fmt_block_t;
+
+extern const hpctrace_fmt_block_t hpctrace_fmt_block_NULL;
+
+
+// hpctrace_fmt_block_datum_X: Read or write the next trace record in
+// either encoding, according to 'flags'.  'blk' carries the state
+// between records of one file and is unused for fixed-size records.
+
+int
+hpctrace_fmt_block_datum_fread(hpctrace_fmt_datum_t* x,
+			       hpctrace_fmt_block_t* blk,
+			       hpctrace_hdr_flags_t flags, FILE* fs);
+
+int
+hpctrace_fmt_block_datum_outbuf(hpctrace_fmt_datum_t* x,
+				hpctrace_fmt_block_t* blk,
+				hpctrace_hdr_flags_t flags,
+				hpcio_outbuf_t* outbuf);
+
+// N.B.: not async safe
+int
+hpctrace_fmt_block_datum_fwrite(hpctrace_fmt_datum_t* x,
+				hpctrace_fmt_block_t* blk,
+				hpctrace_hdr_flags_t flags, FILE* outfs);
+
+
 //***************************************************************************
 // hpcprof-metricdb (located here for now)
 //***************************************************************************
@@ -696,6 +781,9 @@ static const char HPCMETRICDB_FMT_Magic[]   = "HPCPROF-metricdb__"; // 18 bytes
 static const char HPCMETRICDB_FMT_Version[] = "00.10";              // 5 bytes
 static const char HPCMETRICDB_FMT_Endian[]  = "b";                  // 1 byte
 
+// columnar format; cf. [hpcprof-metricdb] columns, below
+static const char HPCMETRICDB_FMT_VersionColumnar[] = "00.20";      // 5 bytes
+
 #define HPCMETRICDB_FMT_MagicLenX   (sizeof(HPCMETRICDB_FMT_Magic) - 1)
 #define HPCMETRICDB_FMT_VersionLenX (sizeof(HPCMETRICDB_FMT_Version) - 1)
 #define HPCMETRICDB_FMT_EndianLenX  (sizeof(HPCMETRICDB_FMT_Endian) - 1)
@@ -725,18 +813,113 @@ typedef struct hpcmetricDB_fmt_hdr_t {
 int
 hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs);
 
+// N.B.: writes 'hdr->versionStr', which should be one of
+// HPCMETRICDB_FMT_Version or HPCMETRICDB_FMT_VersionColumnar.
 int
 hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 
 int
 hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 
+
+static inline bool
+hpcmetricDB_fmt_isColumnar(hpcmetricDB_fmt_hdr_t* hdr)
+{
+  return (hdr->version >= 0.2);
+}
+
+
+//***************************************************************************
+// [hpcprof-metricdb] columns
+//***************************************************************************
+
+// In the dense format (HPCMETRICDB_FMT_Version), the header is
+// followed by a numNodes x numMetrics row-major matrix of real8
+// values, where the first row corresponds to node 1.
+//
+// In the columnar format (HPCMETRICDB_FMT_VersionColumnar), the header
+// is followed by each metric's column, in metric order, and then by
+// an index so that a reader may load any one column directly:
+//
+//   [hdr]
+//   [column 0] ... [column numMetrics-1]
+//   [index: numMetrics x (offset, length, num-entries, num-blocks)]
+//   [footer: index offset (int8), HPCMETRICDB_FMT_FooterTag]
+//
+// A column holds the metric's nonzero values as (node-id, value)
+// pairs in increasing node-id order, grouped into blocks of at most
+// HPCMETRICDB_FMT_BlockMaxEntries pairs.  A block is
+//   [num-entries (int4)] [payload length (int4)] [payload]
+// where the payload encodes each pair as
+//   - the node-id's difference from the previous node-id (LEB128)
+//   - the value's bits XOR the previous value's bits, as a control
+//     byte (high nibble: number of leading zero bytes; low nibble:
+//     number of trailing zero bytes) followed by the remaining bytes
+//     in big-endian order.
+// Each block starts from a previous node-id and value of 0 and can
+// therefore be decoded on its own.
+
+static const char HPCMETRICDB_FMT_FooterTag[] = "MDBindex"; // 8 bytes
+
+#define HPCMETRICDB_FMT_FooterTagLen (sizeof(HPCMETRICDB_FMT_FooterTag) - 1)
+#define HPCMETRICDB_FMT_FooterLen    (8 + HPCMETRICDB_FMT_FooterTagLen)
+
+#define HPCMETRICDB_FMT_BlockMaxEntries (4096)
+
+// upper bound on a block's payload: 5 bytes (node-id) + 9 bytes (value)
+#define HPCMETRICDB_FMT_BlockBufSz (HPCMETRICDB_FMT_BlockMaxEntries * 14)
+
+
+typedef struct hpcmetricDB_fmt_col_t {
+
+  uint64_t offset;     // file offset of the column's first block
+  uint64_t length;     // total size of the column's blocks (bytes)
+  uint32_t numEntries; // number of (node-id, value) pairs
+  uint32_t numBlocks;
+
+} hpcmetricDB_fmt_col_t;
+
+
+// hpcmetricDB_fmt_block_fwrite: Encodes the 'n' pairs ('nodeIds',
+// 'vals'), where 0 < n <= HPCMETRICDB_FMT_BlockMaxEntries and
+// 'nodeIds' is increasing, as one block of column 'col' and writes it
+// to 'outfs'.  'buf' is scratch space of HPCMETRICDB_FMT_BlockBufSz
+// bytes.  Before a column's first block, 'col' should be zeroed and
+// 'col->offset' set to the current file offset.
+int
+hpcmetricDB_fmt_block_fwrite(const uint32_t* nodeIds, const double* vals,
+			     uint32_t n, hpcmetricDB_fmt_col_t* col,
+			     unsigned char* buf, FILE* outfs);
+
+// hpcmetricDB_fmt_index_fwrite: Writes the index for the 'numMetrics'
+// columns 'cols' followed by the footer.  'offset' is the current file
+// offset (i.e., the end of the last column).
+int
+hpcmetricDB_fmt_index_fwrite(const hpcmetricDB_fmt_col_t* cols,
+			     uint32_t numMetrics, uint64_t offset,
+			     FILE* outfs);
+
+// hpcmetricDB_fmt_index_fread: Locates the index using the footer and
+// reads 'numMetrics' entries into 'cols'.
+int
+hpcmetricDB_fmt_index_fread(hpcmetricDB_fmt_col_t* cols,
+			    uint32_t numMetrics, FILE* infs);
+
+// hpcmetricDB_fmt_col_fread: Reads and decodes column 'col' into
+// 'nodeIds' and 'vals', each of which has room for 'col->numEntries'
+// elements.  'buf' is scratch space of HPCMETRICDB_FMT_BlockBufSz bytes.
+int
+hpcmetricDB_fmt_col_fread(uint32_t* nodeIds, double* vals,
+			  const hpcmetricDB_fmt_col_t* col,
+			  unsigned char* buf, FILE* infs);
+
 // --------------------------------------------------------------------------
 // additional sampling info
 // --------------------------------------------------------------------------
 
 typedef struct sampling_info_s {
-  uint64_t  sample_clock;
+  uint64_t  sample_clock;  // time of day of the sample in microseconds,
+                           // or 0 if it is being taken now
   void     *sample_data;
 } sampling_info_t;
 
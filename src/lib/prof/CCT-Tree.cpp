@@ -74,7 +74,11 @@ using std::vector;
 #include <set>
 using std::set;
 
+#include <unordered_map>
+
 #include <typeinfo>
+#include <algorithm>
+#include <limits>
 
 //*************************** User Include Files ****************************
 
@@ -95,8 +99,21 @@ using SrcFile::ln_NULL;
 
 #include <lib/support/dictionary.h>
 
+#ifdef ENABLE_OPENMP
+#include <omp.h>
+#endif
+
 //*************************** Forward Declarations ***************************
 
+// XML output: a buffer is flushed to the stream when it reaches
+// XMLBufferSz; when writing in parallel, the tree is split into about
+// XMLChunksPerThread subtrees per thread, but no smaller than
+// XMLGrainMin nodes, and XMLWindowPerThread subtrees per thread are
+// kept formatted in memory at a time.
+static const size_t XMLBufferSz = (4 * 1024 * 1024);
+static const size_t XMLChunksPerThread = 16;
+static const size_t XMLWindowPerThread = 2;
+static const size_t XMLGrainMin = 1024;
 
 //***************************************************************************
 
@@ -106,10 +123,10 @@ using SrcFile::ln_NULL;
 
 namespace Prof {
 
-extern std::map<uint, uint> m_mapFileIDs;      // map between file IDs
-extern std::map<uint, uint> m_mapProcIDs;      // map between proc IDs
+extern std::unordered_map<uint, uint> m_mapFileIDs;      // map between file IDs
+extern std::unordered_map<uint, uint> m_mapProcIDs;      // map between proc IDs
 
-extern std::map<uint, uint> m_pairFakeLoadModule;
+extern std::unordered_map<uint, uint> m_pairFakeLoadModule;
 
 // local function to convert from the original procedure ID into a 
 // a "compact" id to reduce redundancy if the procedure of the same
@@ -119,10 +136,12 @@ static uint
 getProcIdFromMap(uint proc_id)
 {
   uint id = proc_id;
-  if (Prof::m_mapProcIDs.find(proc_id) != Prof::m_mapProcIDs.end()) {
+  std::unordered_map<uint, uint>::const_iterator it =
+    Prof::m_mapProcIDs.find(proc_id);
+  if (it != Prof::m_mapProcIDs.end()) {
     // the file ID should redirected to another file ID which has 
     // exactly the same filename
-    id = Prof::m_mapProcIDs[proc_id];
+    id = it->second;
   }
   return id;
 }
@@ -133,7 +152,8 @@ static uint
 getLoadModuleFromMap(uint lm_id)
 {
   uint id = lm_id;
-  std::map<uint, uint>::iterator it = Prof::m_pairFakeLoadModule.find(lm_id);
+  std::unordered_map<uint, uint>::iterator it =
+    Prof::m_pairFakeLoadModule.find(lm_id);
 
   if (it != Prof::m_pairFakeLoadModule.end()) {
     id = it->second;
@@ -334,7 +354,7 @@ ANode::IntToANodeType(long i)
   return (ANodeTy)i;
 }
 
-uint ANode::s_nextUniqueId = 2;
+thread_local uint ANode::s_nextUniqueId = 2;
 
 
 //***************************************************************************
@@ -481,9 +501,14 @@ ANode::aggregateMetricsIncl(const VMAIntervalSet& ivalset)
 	const VMAInterval& ival = *it1;
 	uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
 
+	n->ensureMetricsSize(mEndId);
+	n_parent->ensureMetricsSize(mEndId);
+
 	for (uint mId = mBegId; mId < mEndId; ++mId) {
-	  double mVal = n->demandMetric(mId, mEndId/*size*/);
-	  n_parent->demandMetric(mId, mEndId/*size*/) += mVal;
+	  double mVal = n->metricVal(mId);
+	  if (mVal != 0.0) {
+	    n_parent->metric(mId) += mVal;
+	  }
 	}
       }
     }
@@ -579,11 +604,20 @@ ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
       const VMAInterval& ival = *it;
       uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
 
+      n->ensureMetricsSize(mEndId);
+      n_parent->ensureMetricsSize(mEndId);
+      if (frame) {
+        frame->ensureMetricsSize(mEndId);
+      }
+
       for (uint mId = mBegId; mId < mEndId; ++mId) {
-        double mVal = n->demandMetric(mId, mEndId/*size*/);
-        n_parent->demandMetric(mId, mEndId/*size*/) += mVal;
+        double mVal = n->metricVal(mId);
+        if (mVal == 0.0) {
+          continue;
+        }
+        n_parent->metric(mId) += mVal;
         if (frame && frame != n_parent) {
-          frame->demandMetric(mId, mEndId/*size*/) += mVal;
+          frame->metric(mId) += mVal;
         }
       }
     }
@@ -591,6 +625,41 @@ ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
 }
 
 
+// computeMetricsBatch: the batched analogue of computeMetricsMe() for
+// 'nodes' using each metric's compiled programs (NULL if the metric is
+// not derived).  Metrics are computed in id order for the whole batch,
+// which is equivalent because the metrics are point-wise.
+static void
+computeMetricsBatch(const vector<Metric::IData*>& nodes, uint numMetrics,
+		    uint mBegId, uint mEndId,
+		    const vector<Metric::AExprProg*>& progNF,
+		    const vector<Metric::AExprProg*>& progFinal)
+{
+  double val[Metric::AExprProg::BatchSz];
+  uint n = nodes.size();
+
+  for (uint mId = mBegId; mId < mEndId; ++mId) {
+    const Metric::AExprProg* nf = progNF[mId - mBegId];
+    if (!nf) {
+      continue;
+    }
+    nf->evalNF(nodes.data(), n);
+
+    const Metric::AExprProg* fin = progFinal[mId - mBegId];
+    if (fin) {
+      fin->eval(nodes.data(), n, val);
+      for (uint i = 0; i < n; ++i) {
+	Metric::IData* x = nodes[i];
+	x->ensureMetricsSize(numMetrics);
+	if (val[i] != 0.0 || x->hasMetric(mId)) {
+	  x->metric(mId) = val[i];
+	}
+      }
+    }
+  }
+}
+
+
 void
 ANode::computeMetrics(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
 		      bool doFinal)
@@ -602,9 +671,43 @@ ANode::computeMetrics(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
   // N.B. pre-order walk assumes point-wise metrics
   // Cf. Analysis::Flat::Driver::computeDerivedBatch().
 
+  // Compile each derived metric's expression once and evaluate the
+  // programs over batches of nodes (cf. computeMetricsMe()).
+  uint numProgs = mEndId - mBegId;
+  vector<Metric::AExprProg*> progNF(numProgs, NULL);
+  vector<Metric::AExprProg*> progFinal(numProgs, NULL);
+
+  for (uint mId = mBegId; mId < mEndId; ++mId) {
+    const Metric::ADesc* m = mMgr.metric(mId);
+    const Metric::DerivedDesc* mm = dynamic_cast<const Metric::DerivedDesc*>(m);
+    if (mm && mm->expr()) {
+      progNF[mId - mBegId] = new Metric::AExprProg(*mm->expr(), true);
+      if (doFinal) {
+	progFinal[mId - mBegId] = new Metric::AExprProg(*mm->expr(), false);
+      }
+    }
+  }
+
+  uint numMetrics = mMgr.size();
+  vector<Metric::IData*> nodes;
+  nodes.reserve(Metric::AExprProg::BatchSz);
+
   for (ANodeIterator it(this); it.Current(); ++it) {
-    ANode* n = it.current();
-    n->computeMetricsMe(mMgr, mBegId, mEndId, doFinal);
+    nodes.push_back(it.current());
+    if (nodes.size() == Metric::AExprProg::BatchSz) {
+      computeMetricsBatch(nodes, numMetrics, mBegId, mEndId,
+			  progNF, progFinal);
+      nodes.clear();
+    }
+  }
+  if (!nodes.empty()) {
+    computeMetricsBatch(nodes, numMetrics, mBegId, mEndId,
+			progNF, progFinal);
+  }
+
+  for (uint i = 0; i < numProgs; ++i) {
+    delete progNF[i];
+    delete progFinal[i];
   }
 }
 
@@ -623,7 +726,10 @@ ANode::computeMetricsMe(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
       expr->evalNF(*this);
       if (doFinal) {
 	double val = expr->eval(*this);
-	demandMetric(mId, numMetrics/*size*/) = val;
+	ensureMetricsSize(numMetrics);
+	if (val != 0.0 || hasMetric(mId)) {
+	  metric(mId) = val;
+	}
       }
     }
   }
@@ -705,9 +811,9 @@ ANode::pruneByMetrics(const Metric::Mgr& mMgr, const VMAIntervalSet& ivalset,
 	}
 	numIncl++;
 	
-	double total = root->metric(mId); // root->metric(m->partner()->id());
+	double total = root->metricVal(mId); // root->metric(m->partner()->id());
 	
-	double pct = x->metric(mId) * 100 / total;
+	double pct = x->metricVal(mId) * 100 / total;
 	if (pct >= thresholdPct) {
 	  isImportant = true;
 	  break;
@@ -810,6 +916,109 @@ ANode::deleteChaff(ANode* x, uint8_t* deletedNodes)
 // Merging
 //**********************************************************************
 
+namespace {
+
+// DynChildIndex: A hash index of the direct ADynNode descendents of a
+// node x (cf. ANode::findDynChild()), used by ANode::mergeDeep() so
+// that merging a wide node costs time proportional to the number of
+// children rather than (children of x) * (children of y).
+//
+// Nodes are keyed on the fields that ADynNode::isMergable() compares
+// for strict equality (leaf-ness, load module id and ip); each bucket
+// holds its candidates in findDynChild() order and is searched with
+// isMergable() itself, so find() returns exactly what findDynChild()
+// would.  The structure-based merge condition cannot be hashed; a node
+// with structure information falls back to findDynChild().
+//
+// The index is only valid while x's children are modified through
+// insert().
+class DynChildIndex {
+public:
+  // minimum number of children of x for which indexing pays off
+  static const uint MinChildCount = 8;
+
+  DynChildIndex(ANode* x)
+    : m_x(x)
+  {
+    build(x);
+  }
+
+  ADynNode*
+  find(const ADynNode& y_dyn) const
+  {
+    if (y_dyn.structure()) {
+      return m_x->findDynChild(y_dyn);
+    }
+
+    Map::const_iterator it = m_map.find(Key(y_dyn));
+    if (it != m_map.end()) {
+      const std::vector<ADynNode*>& bucket = it->second;
+      for (uint i = 0; i < bucket.size(); ++i) {
+	if (ADynNode::isMergable(*bucket[i], y_dyn)) {
+	  return bucket[i];
+	}
+      }
+    }
+    return NULL;
+  }
+
+  // insert: note that x_dyn has been linked as the last child of x
+  void
+  insert(ADynNode* x_dyn)
+  {
+    m_map[Key(*x_dyn)].push_back(x_dyn);
+  }
+
+private:
+  struct Key {
+    Key(const ADynNode& x)
+      : isLeaf(x.isLeaf()), lmId(x.lmId_real()), lmIP(x.lmIP_real())
+    { }
+
+    bool
+    operator==(const Key& y) const
+    { return (isLeaf == y.isLeaf && lmId == y.lmId && lmIP == y.lmIP); }
+
+    bool isLeaf;
+    LoadMap::LMId_t lmId;
+    VMA lmIP;
+  };
+
+  struct KeyHash {
+    size_t
+    operator()(const Key& x) const
+    {
+      uint64_t h = (uint64_t)x.lmIP * 0x9e3779b97f4a7c15ULL;
+      h ^= ((uint64_t)x.lmId << 1) | (uint64_t)x.isLeaf;
+      return (size_t)(h ^ (h >> 29));
+    }
+  };
+
+  typedef std::unordered_map<Key, std::vector<ADynNode*>, KeyHash> Map;
+
+  // build: visit direct ADynNode descendents in findDynChild() order
+  void
+  build(ANode* z)
+  {
+    for (ANodeChildIterator it(z); it.Current(); ++it) {
+      ANode* x = it.current();
+      ADynNode* x_dyn = dynamic_cast<ADynNode*>(x);
+      if (x_dyn) {
+	insert(x_dyn);
+      }
+      else {
+	build(x);
+      }
+    }
+  }
+
+  ANode* m_x;
+  Map m_map;
+};
+
+} // namespace
+
+
 MergeEffectList*
 ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 		 uint oFlag)
@@ -832,6 +1041,11 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
   //    recur.
   // ------------------------------------------------------------
   MergeEffectList* effctLst = new MergeEffectList;
+
+  DynChildIndex* x_index = NULL;
+  if (y->childCount() > 1 && x->childCount() >= DynChildIndex::MinChildCount) {
+    x_index = new DynChildIndex(x);
+  }
   
   for (ANodeChildIterator it(y); it.Current(); /* */) {
     ANode* y_child = it.current();
@@ -841,7 +1055,8 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 
     MergeEffectList* effctLst1 = NULL;
 
-    ADynNode* x_child_dyn = x->findDynChild(*y_child_dyn);
+    ADynNode* x_child_dyn = (x_index) ? x_index->find(*y_child_dyn)
+                                      : x->findDynChild(*y_child_dyn);
 
 #define MERGE_ACTION 0
 #define MERGE_ERROR 0
@@ -863,6 +1078,9 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 	effctLst1 = y_child->mergeDeep_fixInsert(x_newMetricBegIdx, mrgCtxt);
 
 	y_child->link(x);
+	if (x_index) {
+	  x_index->insert(y_child_dyn);
+	}
       }
     }
     else {
@@ -888,6 +1106,8 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
     delete effctLst1;
   }
 
+  delete x_index;
+
   return effctLst;
 }
 
@@ -927,7 +1147,11 @@ ANode::mergeMe(const ANode& y, MergeContext* GCC_ATTR_UNUSED mrgCtxt,
   }
 
   for (uint x_i = metricBegIdx, y_i = 0; x_i < x_end; ++x_i, ++y_i) {
-    x->metric(x_i) += y.metric(y_i);
+    double mVal = y.metric(y_i);
+    if (mVal == 0.0) {
+      continue;
+    }
+    x->metric(x_i) += mVal;
   }
   
   MergeEffect noopEffect;
@@ -1124,11 +1348,18 @@ string
 ANode::toStringMe(uint oFlags) const
 { 
   string self;
+  appendStringMe(self, oFlags);
+  return self;
+}
+
+
+void
+ANode::appendStringMe(string& self, uint oFlags) const
+{ 
   ANodeTy node_type = type();
-  self = ANodeTyToName(node_type);
+  self += ANodeTyToName(node_type);
 
   SrcFile::ln lnBeg = begLine();
-  string line = StrUtil::toStr(lnBeg);
   //SrcFile::ln lnEnd = endLine();
   //if (lnBeg != lnEnd) {
   //  line += "-" + StrUtil::toStr(lnEnd);
@@ -1139,13 +1370,12 @@ ANode::toStringMe(uint oFlags) const
     sId = getProcIdFromMap(sId);
   }
 
-  self += " i" + xml::MakeAttrNum(m_id);
-  self += " s" + xml::MakeAttrNum(sId) + " l" + xml::MakeAttrStr(line);
+  self += " i"; xml::AppendAttrNum(self, m_id);
+  self += " s"; xml::AppendAttrNum(self, sId);
+  self += " l"; xml::AppendAttrNum(self, lnBeg);
   if ((oFlags & Tree::OFlg_Debug) || (oFlags & Tree::OFlg_DebugAll)) {
     self += " strct" + xml::MakeAttrNum((uintptr_t)m_strct, 16);
   }
-
-  return self;
 }
 
 
@@ -1197,11 +1427,11 @@ ADynNode::writeDyn(std::ostream& o, uint GCC_ATTR_UNUSED oFlags,
 }
 
 
-string
-Root::toStringMe(uint oFlags) const
+void
+Root::appendStringMe(string& self, uint oFlags) const
 { 
-  string self = ANode::toStringMe(oFlags) + " n" + xml::MakeAttrStr(m_name);
-  return self;
+  ANode::appendStringMe(self, oFlags);
+  self += " n"; xml::AppendAttrStr(self, m_name);
 }
 
 
@@ -1219,38 +1449,45 @@ static uint
 getFileIdFromMap(uint file_id)
 {
   uint id = file_id;
-  if (Prof::m_mapFileIDs.find(file_id) != Prof::m_mapFileIDs.end()) {
+  std::unordered_map<uint, uint>::const_iterator it =
+    Prof::m_mapFileIDs.find(file_id);
+  if (it != Prof::m_mapFileIDs.end()) {
     // the file ID should redirected to another file ID which has 
     // exactly the same filename
-    id = Prof::m_mapFileIDs[file_id];
+    id = it->second;
   }
   return id;
 }
 
-string
-ProcFrm::toStringMe(uint oFlags) const
+void
+ProcFrm::appendStringMe(string& self, uint oFlags) const
 {
-  string self = ANode::toStringMe(oFlags);
+  ANode::appendStringMe(self, oFlags);
   
   if (m_strct) {
-    uint lm_id = getLoadModuleFromMap(lmId());
-    string lm_nm = xml::MakeAttrNum(lm_id);
-
-    uint file_id = getFileIdFromMap(fileId());
-    string fnm = xml::MakeAttrNum(file_id);
-
-    uint proc_id = getProcIdFromMap(procId());
-    string pnm = xml::MakeAttrNum(proc_id);
+    self += " lm";
+    if (oFlags & Tree::OFlg_DebugAll) {
+      xml::AppendAttrStr(self, lmName());
+    }
+    else {
+      xml::AppendAttrNum(self, getLoadModuleFromMap(lmId()));
+    }
 
+    self += " f";
     if (oFlags & Tree::OFlg_DebugAll) {
-      lm_nm = xml::MakeAttrStr(lmName());
-      fnm = xml::MakeAttrStr(fileName());
+      xml::AppendAttrStr(self, fileName());
     }
-    if ( (oFlags & Tree::OFlg_Debug) || (oFlags & Tree::OFlg_DebugAll) ) {
-      pnm = xml::MakeAttrStr(procNameDbg());
+    else {
+      xml::AppendAttrNum(self, getFileIdFromMap(fileId()));
     }
 
-    self += " lm" + lm_nm + " f" + fnm + " n" + pnm;
+    self += " n";
+    if ( (oFlags & Tree::OFlg_Debug) || (oFlags & Tree::OFlg_DebugAll) ) {
+      xml::AppendAttrStr(self, procNameDbg());
+    }
+    else {
+      xml::AppendAttrNum(self, getProcIdFromMap(procId()));
+    }
 
     // print the vma for debugging purpose
     int dbg_level = Diagnostics_GetDiagnosticFilterLevel();
@@ -1263,32 +1500,25 @@ ProcFrm::toStringMe(uint oFlags) const
       self += " str" + xml::MakeAttrNum(structure()->m_origId);
     }
   }
-
-  return self; 
 }
 
 
-string
-Proc::toStringMe(uint oFlags) const
+void
+Proc::appendStringMe(string& self, uint oFlags) const
 {
-  string self = ANode::toStringMe(oFlags);
+  ANode::appendStringMe(self, oFlags);
   
   if (m_strct) {
-    string lm_nm = xml::MakeAttrNum(lmId());
-
-    uint file_id = getFileIdFromMap(fileId());
-    string fnm = xml::MakeAttrNum(file_id);
-
-    uint proc_id = getProcIdFromMap(procId());
-    string pnm = xml::MakeAttrNum(proc_id);
-
     if (oFlags & Tree::OFlg_DebugAll) {
-      lm_nm = xml::MakeAttrStr(lmName());
-      fnm = xml::MakeAttrStr(fileName());
-      pnm = xml::MakeAttrStr(procName());
+      self += " lm"; xml::AppendAttrStr(self, lmName());
+      self += " f";  xml::AppendAttrStr(self, fileName());
+      self += " n";  xml::AppendAttrStr(self, procName());
+    }
+    else {
+      self += " lm"; xml::AppendAttrNum(self, lmId());
+      self += " f";  xml::AppendAttrNum(self, getFileIdFromMap(fileId()));
+      self += " n";  xml::AppendAttrNum(self, getProcIdFromMap(procId()));
     }
-
-    self += " lm" + lm_nm + " f" + fnm + " n" + pnm;
 
     int dbg_level = Diagnostics_GetDiagnosticFilterLevel();
     if (dbg_level > 2) {
@@ -1296,23 +1526,20 @@ Proc::toStringMe(uint oFlags) const
       self += " v=\"" + vma.toString() + "\"";
     }
     if (isAlien()) {
-      self = self + " a=\"1\"";
+      self += " a=\"1\"";
     }
     if ((oFlags & CCT::Tree::OFlg_StructId) && structure() != NULL) {
       self += " str" + xml::MakeAttrNum(structure()->m_origId);
     }
   }
-
-  return self; 
 }
 
 
-string 
-Loop::toStringMe(uint oFlags) const
+void
+Loop::appendStringMe(string& self, uint oFlags) const
 {
-  uint file_id = getFileIdFromMap(fileId());
-  string fnm = xml::MakeAttrNum(file_id);
-  string self = ANode::toStringMe(oFlags) + " f" + fnm;
+  ANode::appendStringMe(self, oFlags);
+  self += " f"; xml::AppendAttrNum(self, getFileIdFromMap(fileId()));
 
   int dbg_level = Diagnostics_GetDiagnosticFilterLevel();
   if (dbg_level > 2) {
@@ -1322,15 +1549,13 @@ Loop::toStringMe(uint oFlags) const
   if ((oFlags & CCT::Tree::OFlg_StructId) && structure() != NULL) {
     self += " str" + xml::MakeAttrNum(structure()->m_origId);
   }
-
-  return self;
 }
 
 
-string
-Call::toStringMe(uint oFlags) const
+void
+Call::appendStringMe(string& self, uint oFlags) const
 {
-  string self = ANode::toStringMe(oFlags);
+  ANode::appendStringMe(self, oFlags);
 
   if ((oFlags & Tree::OFlg_Debug) || (oFlags & Tree::OFlg_DebugAll)) {
     self += " n=\"" + nameDyn() + "\"";
@@ -1344,21 +1569,19 @@ Call::toStringMe(uint oFlags) const
   if ((oFlags & CCT::Tree::OFlg_StructId) && structure() != NULL) {
     self += " str" + xml::MakeAttrNum(structure()->m_origId);
   }
-
-  return self;
 }
 
 
-string
-Stmt::toStringMe(uint oFlags) const
+void
+Stmt::appendStringMe(string& self, uint oFlags) const
 {
-  string self = ANode::toStringMe(oFlags);
+  ANode::appendStringMe(self, oFlags);
 
   if ((oFlags & Tree::OFlg_Debug) || (oFlags & Tree::OFlg_DebugAll)) {
     self += " n=\"" + nameDyn() + "\"";
   }
   if (hpcrun_fmt_doRetainId(cpId())) {
-    self += " it" + xml::MakeAttrNum(cpId());
+    self += " it"; xml::AppendAttrNum(self, cpId());
   }
 
   int dbg_level = Diagnostics_GetDiagnosticFilterLevel();
@@ -1369,14 +1592,94 @@ Stmt::toStringMe(uint oFlags) const
   if ((oFlags & CCT::Tree::OFlg_StructId) && structure() != NULL) {
     self += " str" + xml::MakeAttrNum(structure()->m_origId);
   }
-
-  return self;
 }
 
 
+struct ANode::XMLChunk {
+  XMLChunk(const ANode* node_, const string& pfx_)
+    : node(node_), pfx(pfx_)
+  { }
+
+  const ANode* node; // subtree to format; NULL if 'text' is a literal
+  string pfx;
+  string text;
+};
+
+
+// writeXML: Nodes are formatted into large string buffers rather than
+// through the stream.  When there are several threads, the tree is
+// split (writeXML_split()) into a list of literal text and subtrees
+// of roughly equal size; the subtrees are formatted in parallel, a
+// window at a time, and all chunks are written in order.  The output
+// is identical to a serial traversal.
+//
+// N.B.: the parallel path needs lib/prof, and every tool that links
+// it, to be built with OPENMP_FLAG (ENABLE_OPENMP); otherwise the
+// whole tree is formatted serially.
 std::ostream&
 ANode::writeXML(ostream& os, uint metricBeg, uint metricEnd,
 		uint oFlags, const char* pfx) const
+{
+  if (oFlags & CCT::Tree::OFlg_Compressed) {
+    pfx = "";
+  }
+
+  int numThreads = 1;
+#ifdef ENABLE_OPENMP
+  numThreads = omp_get_max_threads();
+#endif
+
+  std::set<const ANode*> bigNodes;
+  size_t grain = 0;
+  if (numThreads > 1) {
+    // N.B.: the first pass only counts nodes
+    size_t numNodes = writeXML_size(std::numeric_limits<size_t>::max(),
+				    bigNodes);
+    grain = std::max(XMLGrainMin, numNodes / (XMLChunksPerThread * numThreads));
+    if (numNodes > grain) {
+      writeXML_size(grain, bigNodes);
+    }
+  }
+
+  if (bigNodes.empty()) {
+    string buf;
+    buf.reserve(XMLBufferSz + XMLBufferSz / 4);
+    writeXML_buf(buf, &os, metricBeg, metricEnd, oFlags, pfx);
+    os << buf;
+    return os;
+  }
+
+  std::vector<XMLChunk> chunks;
+  writeXML_split(chunks, bigNodes, metricBeg, metricEnd, oFlags, pfx);
+
+  // N.B.: the window bounds the memory held by formatted subtrees to
+  // about XMLWindowPerThread / XMLChunksPerThread of the output
+  const long window = XMLWindowPerThread * numThreads;
+  for (long beg = 0; beg < (long)chunks.size(); beg += window) {
+    long end = std::min(beg + window, (long)chunks.size());
+
+#pragma omp parallel for schedule(dynamic)
+    for (long i = beg; i < end; i++) {
+      XMLChunk& chunk = chunks[i];
+      if (chunk.node) {
+	chunk.node->writeXML_buf(chunk.text, NULL, metricBeg, metricEnd,
+				 oFlags, chunk.pfx.c_str());
+      }
+    }
+
+    for (long i = beg; i < end; i++) {
+      os << chunks[i].text;
+      string().swap(chunks[i].text);
+    }
+  }
+
+  return os;
+}
+
+
+void
+ANode::writeXML_buf(string& buf, ostream* os, uint metricBeg, uint metricEnd,
+		    uint oFlags, const char* pfx) const
 {
   string indent = "  ";
   if (oFlags & CCT::Tree::OFlg_Compressed) {
@@ -1384,17 +1687,74 @@ ANode::writeXML(ostream& os, uint metricBeg, uint metricEnd,
     indent = "";
   }
   
-  bool doPost = writeXML_pre(os, metricBeg, metricEnd, oFlags, pfx);
+  bool doPost = writeXML_pre(buf, metricBeg, metricEnd, oFlags, pfx);
+  if (os && buf.size() >= XMLBufferSz) {
+    *os << buf;
+    buf.clear();
+  }
+
   string prefix = pfx + indent;
   for (ANodeSortedChildIterator it(this, ANodeSortedIterator::cmpByStructureInfo);
        it.current(); it++) {
     ANode* n = it.current();
-    n->writeXML(os, metricBeg, metricEnd, oFlags, prefix.c_str());
+    n->writeXML_buf(buf, os, metricBeg, metricEnd, oFlags, prefix.c_str());
   }
   if (doPost) {
-    writeXML_post(os, oFlags, pfx);
+    writeXML_post(buf, oFlags, pfx);
+  }
+}
+
+
+// writeXML_size: returns the number of nodes in this subtree and
+// adds to 'bigNodes' each node whose subtree has more than 'grain'
+// nodes.
+size_t
+ANode::writeXML_size(size_t grain, std::set<const ANode*>& bigNodes) const
+{
+  size_t sz = 1;
+  for (ANodeChildIterator it(this); it.Current(); ++it) {
+    sz += it.current()->writeXML_size(grain, bigNodes);
+  }
+  if (sz > grain) {
+    bigNodes.insert(this);
+  }
+  return sz;
+}
+
+
+void
+ANode::writeXML_split(std::vector<XMLChunk>& chunks,
+		      const std::set<const ANode*>& bigNodes,
+		      uint metricBeg, uint metricEnd,
+		      uint oFlags, const string& pfx) const
+{
+  if (bigNodes.find(this) == bigNodes.end()) {
+    chunks.push_back(XMLChunk(this, pfx));
+    return;
+  }
+
+  string indent = (oFlags & CCT::Tree::OFlg_Compressed) ? "" : "  ";
+
+  // N.B.: consecutive text is merged into a single literal chunk
+  if (chunks.empty() || chunks.back().node) {
+    chunks.push_back(XMLChunk(NULL, ""));
+  }
+  bool doPost = writeXML_pre(chunks.back().text, metricBeg, metricEnd,
+			     oFlags, pfx.c_str());
+
+  string prefix = pfx + indent;
+  for (ANodeSortedChildIterator it(this, ANodeSortedIterator::cmpByStructureInfo);
+       it.current(); it++) {
+    ANode* n = it.current();
+    n->writeXML_split(chunks, bigNodes, metricBeg, metricEnd, oFlags, prefix);
+  }
+
+  if (doPost) {
+    if (chunks.back().node) {
+      chunks.push_back(XMLChunk(NULL, ""));
+    }
+    writeXML_post(chunks.back().text, oFlags, pfx.c_str());
   }
-  return os;
 }
 
 
@@ -1453,6 +1813,17 @@ ANode::ddumpMe() const
 bool
 ANode::writeXML_pre(ostream& os, uint metricBeg, uint metricEnd,
 		    uint oFlags, const char* pfx) const
+{
+  string buf;
+  bool doPost = writeXML_pre(buf, metricBeg, metricEnd, oFlags, pfx);
+  os << buf;
+  return doPost;
+}
+
+
+bool
+ANode::writeXML_pre(string& buf, uint metricBeg, uint metricEnd,
+		    uint oFlags, const char* pfx) const
 {
   bool doTag = (type() != TyRoot);
   bool doMetrics = ((oFlags & Tree::OFlg_LeafMetricsOnly)
@@ -1462,18 +1833,16 @@ ANode::writeXML_pre(ostream& os, uint metricBeg, uint metricEnd,
 
   // 1. Write element name
   if (doTag) {
-    if (isXMLLeaf) {
-      os << pfx << "<" << toStringMe(oFlags) << "/>\n";
-    }
-    else {
-      os << pfx << "<" << toStringMe(oFlags) << ">\n";
-    }
+    buf += pfx;
+    buf += '<';
+    appendStringMe(buf, oFlags);
+    buf += (isXMLLeaf) ? "/>\n" : ">\n";
   }
 
   // 2. Write associated metrics
   if (doMetrics) {
-    writeMetricsXML(os, metricBeg, metricEnd, oFlags, pfx);
-    os << "\n";
+    writeMetricsXML(buf, metricBeg, metricEnd, oFlags, pfx);
+    buf += '\n';
   }
 
   return !isXMLLeaf; // whether to execute writeXML_post()
@@ -1481,7 +1850,16 @@ ANode::writeXML_pre(ostream& os, uint metricBeg, uint metricEnd,
 
 
 void
-ANode::writeXML_post(ostream& os, uint GCC_ATTR_UNUSED oFlags,
+ANode::writeXML_post(ostream& os, uint oFlags, const char* pfx) const
+{
+  string buf;
+  writeXML_post(buf, oFlags, pfx);
+  os << buf;
+}
+
+
+void
+ANode::writeXML_post(string& buf, uint GCC_ATTR_UNUSED oFlags,
 		     const char* pfx) const
 {
   bool doTag = (type() != ANode::TyRoot);
@@ -1489,7 +1867,10 @@ ANode::writeXML_post(ostream& os, uint GCC_ATTR_UNUSED oFlags,
     return;
   }
   
-  os << pfx << "</" << ANodeTyToName(type()) << ">\n";
+  buf += pfx;
+  buf += "</";
+  buf += ANodeTyToName(type());
+  buf += ">\n";
 }
 
 
@@ -1524,3 +1905,232 @@ int ANodeLineComp(ANode* x, ANode* y)
 
 } // namespace Prof
 
+
+//***************************************************************************
+// unit test
+//***************************************************************************
+// #define UNIT_TEST_CCT_MERGE
+
+#ifdef UNIT_TEST_CCT_MERGE
+
+// Merges trees whose root has 'width' children (half of them shared
+// with the other tree, some duplicated) and checks the result against
+// the linear findDynChild() semantics: every child of y is merged into
+// the first matching child of x or appended.  Also times the merge for
+// increasing widths; the time should grow linearly.
+
+#include <map>
+#include <sys/time.h>
+
+using namespace Prof;
+
+static double
+seconds()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static CCT::Stmt*
+mkStmt(CCT::ANode* parent, LoadMap::LMId_t lmId, VMA ip, double val)
+{
+  lush_assoc_info_t as_info = lush_assoc_info_NULL;
+  Metric::IData metrics(1);
+  metrics.metric(0) = val;
+  return new CCT::Stmt(parent, HPCRUN_FMT_CCTNodeId_NULL, as_info,
+		       lmId, ip, 0, NULL, metrics);
+}
+
+typedef std::pair<LoadMap::LMId_t, VMA> Key;
+
+// builds a tree with 'width' leaves; leaf i has ip 'ipBeg + i*ipStride'
+// and every 'dupEvery'th leaf is followed by a duplicate of itself
+static CCT::Tree*
+mkTree(CallPath::Profile* prof, uint width, VMA ipBeg, VMA ipStride,
+       uint dupEvery, std::multimap<Key, double>& leaves)
+{
+  CCT::Tree* tree = new CCT::Tree(prof);
+  CCT::ANode* root = new CCT::Root("root");
+  tree->root(root);
+  for (uint i = 0; i < width; ++i) {
+    Key key(1 + (i % 3), ipBeg + i * ipStride);
+    mkStmt(root, key.first, key.second, 1.0 + i);
+    leaves.insert(std::make_pair(key, 1.0 + i));
+    if (dupEvery && i % dupEvery == 0) {
+      mkStmt(root, key.first, key.second, 0.5);
+      leaves.insert(std::make_pair(key, 0.5));
+    }
+  }
+  return tree;
+}
+
+static bool
+testMerge(CallPath::Profile* prof, uint width, double* time)
+{
+  std::multimap<Key, double> xLeaves, yLeaves;
+  CCT::Tree* x = mkTree(prof, width, 0x1000, 16, 7, xLeaves);
+  CCT::Tree* y = mkTree(prof, width, 0x1000 + 8 * width, 8, 5, yLeaves);
+
+  // expected: a y leaf adds into the first x leaf with its key (the
+  // y leaves already appended count as x leaves for later ones)
+  std::vector<std::pair<Key, double> > expect;
+  std::map<Key, uint> first;
+  for (CCT::ANodeChildIterator it(x->root()); it.Current(); ++it) {
+    CCT::ADynNode* n = dynamic_cast<CCT::ADynNode*>(it.current());
+    Key key(n->lmId_real(), n->lmIP_real());
+    if (first.find(key) == first.end()) {
+      first[key] = expect.size();
+    }
+    expect.push_back(std::make_pair(key, n->metric(0)));
+  }
+  for (CCT::ANodeChildIterator it(y->root()); it.Current(); ++it) {
+    CCT::ADynNode* n = dynamic_cast<CCT::ADynNode*>(it.current());
+    Key key(n->lmId_real(), n->lmIP_real());
+    if (first.find(key) == first.end()) {
+      first[key] = expect.size();
+      expect.push_back(std::make_pair(key, n->metric(0)));
+    }
+    else {
+      expect[first[key]].second += n->metric(0);
+    }
+  }
+
+  double t0 = seconds();
+  CCT::MergeEffectList* effects = x->merge(y, 0);
+  *time = seconds() - t0;
+  delete effects;
+
+  // N.B.: children are iterated in reverse order of linking
+  std::vector<std::pair<Key, double> > actual;
+  for (CCT::ANodeChildIterator it(x->root()); it.Current(); ++it) {
+    CCT::ADynNode* n = dynamic_cast<CCT::ADynNode*>(it.current());
+    actual.push_back(std::make_pair(Key(n->lmId_real(), n->lmIP_real()),
+				    n->metric(0)));
+  }
+  bool ok = (actual.size() == expect.size());
+  std::multiset<std::pair<Key, double> > a(actual.begin(), actual.end());
+  std::multiset<std::pair<Key, double> > e(expect.begin(), expect.end());
+  ok = ok && (a == e);
+
+  delete x;
+  delete y;
+  return ok;
+}
+
+int
+main(int argc, char** argv)
+{
+  CallPath::Profile* prof = CallPath::Profile::make(0);
+  bool ok = true;
+  for (uint width = 1; width <= 128000; width *= 2) {
+    double time = 0.0;
+    bool ok1 = testMerge(prof, width, &time);
+    if (width >= 1000) {
+      std::cout << "width " << width << ": " << (time * 1e3) << " ms"
+		<< std::endl;
+    }
+    if (!ok1) {
+      std::cout << "width " << width << ": MISMATCH" << std::endl;
+    }
+    ok = ok && ok1;
+  }
+  std::cout << (ok ? "ok" : "FAILED") << std::endl;
+  delete prof;
+  return ok ? 0 : 1;
+}
+
+#endif
+
+
+//***************************************************************************
+// unit test
+//***************************************************************************
+// #define UNIT_TEST_CCT_XML
+
+#ifdef UNIT_TEST_CCT_XML
+
+// Writes random trees with 1 thread and with several and checks that
+// the output is byte-identical; also times both.  Build with
+// -DENABLE_OPENMP -fopenmp.
+
+#include <sstream>
+#include <sys/time.h>
+
+using namespace Prof;
+
+static double
+seconds()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// adds about 'numNodes' statements below 'parent', with random
+// fan-out (some of it large) and metrics on some of them
+static void
+mkSubtree(CCT::ANode* parent, long numNodes, VMA& ip)
+{
+  long fanout = (rand() % 8 == 0) ? 1 + rand() % 200 : 1 + rand() % 4;
+  fanout = std::min(fanout, numNodes);
+  for (long i = 0; i < fanout; ++i) {
+    lush_assoc_info_t as_info = lush_assoc_info_NULL;
+    Metric::IData metrics(2);
+    if (rand() % 3 == 0) {
+      metrics.metric(rand() % 2) = (rand() % 1000) / 7.0;
+    }
+    ip += 1 + rand() % 64;
+    CCT::Stmt* n = new CCT::Stmt(parent, HPCRUN_FMT_CCTNodeId_NULL, as_info,
+				 1 + rand() % 3, ip, 0, NULL, metrics);
+    long below = (numNodes - fanout) / fanout;
+    if (below > 0) {
+      mkSubtree(n, below, ip);
+    }
+  }
+}
+
+static string
+writeTree(CCT::ANode* root, int numThreads, uint oFlags, double* time)
+{
+  omp_set_num_threads(numThreads);
+  std::ostringstream os;
+  double t0 = seconds();
+  root->writeXML(os, 0, 2, oFlags);
+  *time = seconds() - t0;
+  return os.str();
+}
+
+int
+main(int argc, char** argv)
+{
+  bool ok = true;
+  long sizes[] = { 10, 5000, 100000, 1000000 };
+  for (uint s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    srand(s + 1);
+    CCT::ANode* root = new CCT::Root("root");
+    VMA ip = 0x400000;
+    mkSubtree(root, sizes[s], ip);
+
+    for (uint oFlags = 0; oFlags <= CCT::Tree::OFlg_Compressed;
+	 oFlags += CCT::Tree::OFlg_Compressed) {
+      double t1 = 0.0;
+      string expect = writeTree(root, 1, oFlags, &t1);
+      for (int numThreads = 2; numThreads <= 8; numThreads *= 2) {
+	double tN = 0.0;
+	bool same = (writeTree(root, numThreads, oFlags, &tN) == expect);
+	std::cout << "nodes " << sizes[s] << (oFlags ? " compressed" : "")
+		  << ": " << numThreads << " threads "
+		  << (same ? "same" : "DIFFERENT") << ", "
+		  << (t1 * 1e3) << " / " << (tN * 1e3) << " ms, "
+		  << expect.size() << " bytes" << std::endl;
+	ok = ok && same;
+      }
+    }
+    delete root;
+  }
+  std::cout << (ok ? "ok" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
+
+#endif
@@ -381,6 +381,19 @@ public:
   id(uint id)
   { m_id = id; }
 
+
+  // nextUniqueId: the id that will be given to the next node created
+  //   by the calling thread.  The counter is per-thread so that
+  //   profiles may be read concurrently; cf. Analysis::CallPath::read()
+  //   for how ids are then made consistent with a serial read.
+  static uint
+  nextUniqueId()
+  { return s_nextUniqueId; }
+
+  static void
+  nextUniqueId(uint id)
+  { s_nextUniqueId = id; }
+
   
   // 'name()' is overridden by some derived classes
   virtual const std::string&
@@ -620,6 +633,10 @@ public:
   virtual std::string
   toStringMe(uint oFlags = 0) const;
 
+  // appendStringMe: appends toStringMe() to 'buf'
+  virtual void
+  appendStringMe(std::string& buf, uint oFlags = 0) const;
+
   std::ostream&
   writeXML(std::ostream& os,
 	   uint metricBeg = Metric::IData::npos,
@@ -659,6 +676,37 @@ protected:
   void
   writeXML_post(std::ostream& os, uint oFlags = 0, const char* pfx = "") const;
 
+  // writeXML_buf, writeXML_pre, writeXML_post: same as above, but
+  //   append to 'buf'.  writeXML_buf() flushes 'buf' to 'os' (if
+  //   non-NULL) whenever it grows beyond a threshold.
+  void
+  writeXML_buf(std::string& buf, std::ostream* os,
+	       uint metricBeg, uint metricEnd,
+	       uint oFlags, const char* pfx) const;
+
+  bool
+  writeXML_pre(std::string& buf, uint metricBeg, uint metricEnd,
+	       uint oFlags, const char* pfx) const;
+
+  void
+  writeXML_post(std::string& buf, uint oFlags, const char* pfx) const;
+
+  // writeXML_size: returns the size of this subtree, collecting the
+  //   nodes whose subtrees have more than 'grain' nodes.
+  // writeXML_split: partitions this subtree into an in-order list of
+  //   literal text and independent subtrees, expanding 'bigNodes'
+  //   (cf. writeXML())
+  struct XMLChunk;
+
+  size_t
+  writeXML_size(size_t grain, std::set<const ANode*>& bigNodes) const;
+
+  void
+  writeXML_split(std::vector<XMLChunk>& chunks,
+		 const std::set<const ANode*>& bigNodes,
+		 uint metricBeg, uint metricEnd,
+		 uint oFlags, const std::string& pfx) const;
+
   // --------------------------------------------------------
   // Makes room for new metrics. Also checks and resolves
   // any cpId conflicts between 2 trees.
@@ -669,7 +717,7 @@ protected:
 
 
 private:
-  static uint s_nextUniqueId;
+  static thread_local uint s_nextUniqueId;
   
 protected:
   ANodeTy m_type; // obsolete with typeid(), but hard to replace
@@ -1109,8 +1157,8 @@ public:
   name() const { return m_name; }
   
   // Dump contents for inspection
-  virtual std::string
-  toStringMe(uint oFlags = 0) const;
+  virtual void
+  appendStringMe(std::string& buf, uint oFlags = 0) const;
   
 protected:
 private:
@@ -1164,8 +1212,8 @@ public:
   //
   // -------------------------------------------------------
 
-  virtual std::string
-  toStringMe(uint oFlags = 0) const;
+  virtual void
+  appendStringMe(std::string& buf, uint oFlags = 0) const;
 
   virtual std::string
   codeName() const;
@@ -1204,8 +1252,8 @@ public:
   //
   // -------------------------------------------------------
 
-  virtual std::string
-  toStringMe(uint oFlags = 0) const;
+  virtual void
+  appendStringMe(std::string& buf, uint oFlags = 0) const;
 
 private:
 };
@@ -1238,8 +1286,8 @@ public:
   { }
 
   // Dump contents for inspection
-  virtual std::string
-  toStringMe(uint oFlags = 0) const;
+  virtual void
+  appendStringMe(std::string& buf, uint oFlags = 0) const;
   
 private:
 };
@@ -1289,8 +1337,8 @@ public:
   { return ADynNode::lmIP_real(); }
   
   // Dump contents for inspection
-  virtual std::string
-  toStringMe(uint oFlags = 0) const;
+  virtual void
+  appendStringMe(std::string& buf, uint oFlags = 0) const;
 
 };
 
@@ -1330,8 +1378,8 @@ class Stmt
   }
 
   // Dump contents for inspection
-  virtual std::string
-  toStringMe(uint oFlags = 0) const;
+  virtual void
+  appendStringMe(std::string& buf, uint oFlags = 0) const;
 };
 
 
@@ -71,6 +71,8 @@ using std::dec;
 using std::string;
 
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include <algorithm>
 #include <sstream>
 
@@ -87,6 +89,11 @@ using std::string;
 #include <alloca.h>
 #include <linux/limits.h>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
 
 
 //*************************** User Include Files ****************************
@@ -126,6 +133,18 @@ prof_abort
   int error_code
 );
 
+// Outcome of rewriting the records of a trace file through mappings.
+enum fixTrace_ret_t {
+  FixTrace_OK,
+  FixTrace_Fallback, // mappings not possible here; use stdio
+  FixTrace_ReadErr,
+  FixTrace_WriteErr
+};
+
+static fixTrace_ret_t
+fixTrace_remap(FILE* infs, FILE* outfs, const string& outFnm,
+	       hpctrace_hdr_flags_t flags, const std::vector<uint32_t>& cpIdMap);
+
 
 
 //***************************************************************************
@@ -149,12 +168,12 @@ namespace Prof {
 // and loop nodes.
 // this variable will be used by getFileIdFromMap in CCT-Tree.cpp
 // ---------------------------------------------------
-std::map<uint, uint> m_mapFileIDs;      // map between file IDs
-std::map<uint, uint> m_mapProcIDs;      // map between proc IDs
+std::unordered_map<uint, uint> m_mapFileIDs;      // map between file IDs
+std::unordered_map<uint, uint> m_mapProcIDs;      // map between proc IDs
 
 // all fake load modules will be merged into one single load module
 // whoever the first one arrive, will be the main fake load module
-std::map<uint, uint> m_pairFakeLoadModule;
+std::unordered_map<uint, uint> m_pairFakeLoadModule;
 
 namespace CallPath {
 
@@ -384,8 +403,6 @@ Profile::merge_fixCCT(const std::vector<LoadMap::MergeEffect>* mrgEffects)
 void
 Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
 {
-  typedef std::map<uint, uint> UIntToUIntMap;
-
   // early exit for trivial case
   if (m_traceFileName.empty()) {
     return;
@@ -396,13 +413,21 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
 
   // N.B.: We could build a map of old->new cpIds within
   // Profile::merge(), but the list of effects is more general and
-  // extensible.  There are no asymptotic problems with building the
-  // following map for local use.
-  UIntToUIntMap cpIdMap;
+  // extensible.  cpIds are dense, so the map is an array indexed by
+  // old cpId (ids beyond its end are unchanged).
+  uint cpIdMapSz = 0;
   for (CCT::MergeEffectList::const_iterator it = mrgEffects->begin();
        it != mrgEffects->end(); ++it) {
-    const CCT::MergeEffect& effct = *it;
-    cpIdMap.insert(std::make_pair(effct.old_cpId, effct.new_cpId));
+    cpIdMapSz = std::max(cpIdMapSz, it->old_cpId + 1);
+  }
+
+  std::vector<uint32_t> cpIdMap(cpIdMapSz);
+  for (uint i = 0; i < cpIdMapSz; ++i) {
+    cpIdMap[i] = i;
+  }
+  for (CCT::MergeEffectList::const_iterator it = mrgEffects->begin();
+       it != mrgEffects->end(); ++it) {
+    cpIdMap[it->old_cpId] = it->new_cpId;
   }
 
   // ------------------------------------------------------------
@@ -460,13 +485,37 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
   ret = setvbuf(outfs, outfsBuf, _IOFBF, HPCIO_RWBufferSz);
   DIAG_AssertWarn(ret == 0, outFnm << ": Profile::merge_fixTrace: setvbuf!");
 
+  // delta-encoded traces are rewritten with the same encoding
+  hpctrace_fmt_block_t inBlk = hpctrace_fmt_block_NULL;
+  hpctrace_fmt_block_t outBlk = hpctrace_fmt_block_NULL;
+
   ret = hpctrace_fmt_hdr_fwrite(hdr.flags, outfs);
   if (ret == HPCFMT_ERR) goto badwrite;
 
+  // fixed-size records are remapped in place in a mapping of the
+  // output; delta-encoded records change size and use stdio
+  if (!hdr.flags.fields.isDeltaEncoded) {
+    fixTrace_ret_t fret =
+      fixTrace_remap(infs, outfs, outFnm, hdr.flags, cpIdMap);
+    if (fret == FixTrace_ReadErr) {
+      DIAG_EMsg("failed reading a record from trace measurement file " << inFnm << "; skip this one.");
+      hpcio_fclose(infs);
+      hpcio_fclose(outfs);
+      unlink(outFnm.c_str()); // delete incomplete output file
+      return;
+    }
+    else if (fret == FixTrace_WriteErr) {
+      goto badwrite;
+    }
+    else if (fret == FixTrace_OK) {
+      goto done;
+    }
+  }
+
   while ( !feof(infs) ) {
     // 1. Read trace record (exit on EOF)
     hpctrace_fmt_datum_t datum;
-    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
+    ret = hpctrace_fmt_block_datum_fread(&datum, &inBlk, hdr.flags, infs);
     if (ret == HPCFMT_EOF) {
       break;
     } else if (ret == HPCFMT_ERR) {
@@ -478,20 +527,16 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
     }
     
     // 2. Translate cct id
-    uint cctId_old = datum.cpId;
-    uint cctId_new = datum.cpId;
-    UIntToUIntMap::iterator it = cpIdMap.find(cctId_old);
-    if (it != cpIdMap.end()) {
-      cctId_new = it->second;
-      DIAG_MsgIf(0, "  " << cctId_old << " -> " << cctId_new);
+    if (datum.cpId < cpIdMapSz) {
+      datum.cpId = cpIdMap[datum.cpId];
     }
-    datum.cpId = cctId_new;
 
     // 3. Write new trace record
-    ret = hpctrace_fmt_datum_fwrite(&datum, hdr.flags, outfs);
+    ret = hpctrace_fmt_block_datum_fwrite(&datum, &outBlk, hdr.flags, outfs);
     if (ret == HPCFMT_ERR) goto badwrite;
   }
 
+done:
   hpcio_fclose(infs);
   hpcio_fclose(outfs);
 
@@ -513,23 +558,14 @@ badwrite:
 
 
 
-// ---------------------------------------------------
-// String comparison used for hash map
-// ---------------------------------------------------
-class StringCompare {
-public:
-  bool operator()(const std::string n1,  const std::string n2) const {
-    return n1.compare(n2)<0;
-  } 
-};
-
 // ---------------------------------------------------
 // special variables to store mapping between filename and the ID
 // this hack is needed to avoid duplicate filenames
-// which occurs with alien nodes
+// which occurs with alien nodes.  The order of these maps is never
+// observed, so they are hashed.
 // ---------------------------------------------------
-static std::map<std::string, uint, StringCompare> m_mapFiles; // map the filenames and the ID
-static std::map<std::string, uint, StringCompare> m_mapProcs; // map the procedure names and the ID
+static std::unordered_map<std::string, uint> m_mapFiles; // map the filenames and the ID
+static std::unordered_map<std::string, uint> m_mapProcs; // map the procedure names and the ID
 
 // attempt to retrieve the filename of a node
 // if the node is an alien or a loop or a file, then we are guaranteed to
@@ -573,6 +609,7 @@ writeXML_help(std::ostream& os, const char* entry_nm,
     return;
   }
 
+  std::string entry;
   for (Struct::ANodeIterator it(root, filter); it.Current(); ++it) {
     Struct::ANode* strct = it.current();
 
@@ -604,19 +641,21 @@ writeXML_help(std::ostream& os, const char* entry_nm,
         // i.e.: vmlinux.aaaaa = vmlinux.bbbbbb = vmlinux.ccccc = vmlinux
         lm_name = lm->pretty_name();
       }
-      std::string key = lm_name + ":" + nm;
+      std::string key;
+      key.reserve(lm_name.size() + 1 + strlen(nm));
+      key.append(lm_name).append(1, ':').append(nm);
 
-      if (m_mapFiles.find(key) == m_mapFiles.end()) {
-        //  the filename is not in the list. Add it.
-        m_mapFiles[key] = id;
+      // N.B.: insert() adds the filename only if it is not in the list
+      std::pair<std::unordered_map<std::string, uint>::iterator, bool> ret =
+        m_mapFiles.insert(std::make_pair(key, id));
 
-      } else if ( nm != Prof::Struct::Tree::UnknownFileNm 
+      if (!ret.second && nm != Prof::Struct::Tree::UnknownFileNm 
           && nm[0] != '\0' )
       {
         // WARNING: We do not allow redundancy unless for some specific files
         // For "unknown-file" and empty file (alien case), we allow duplicates
         // Otherwise we remove duplicate filename, and use the existing one.
-        uint id_orig   = m_mapFiles[key];
+        uint id_orig   = ret.first->second;
 
         // remember that this ID needs redirection to the existing ID
         Prof::m_mapFileIDs[id] = id_orig;
@@ -685,15 +724,15 @@ writeXML_help(std::ostream& os, const char* entry_nm,
           lnm = strct->name().c_str();
         }
         completProcName.append(lnm);
-        if (m_mapProcs.find(completProcName) == m_mapProcs.end()) 
-        {
-          // the proc is not in dictionary. Add it into the map.
-          m_mapProcs[completProcName] = id;
-        } else 
+
+        // N.B.: insert() adds the proc only if it is not in dictionary
+        std::pair<std::unordered_map<std::string, uint>::iterator, bool> ret =
+          m_mapProcs.insert(std::make_pair(completProcName, id));
+        if (!ret.second)
         {
           // the same procedure name already exists, we need to reuse
           // the previous ID instead of the original one.
-          uint id_orig = m_mapProcs[completProcName];
+          uint id_orig = ret.first->second;
 
           // remember that this ID needs redirection to the existing ID
           Prof::m_mapProcIDs[id] = id_orig;
@@ -704,14 +743,21 @@ writeXML_help(std::ostream& os, const char* entry_nm,
       DIAG_Die(DIAG_UnexpectedInput);
     }
 
-    os << "    <" << entry_nm << " i" << MakeAttrNum(id)
-           << " n" << MakeAttrStr(nm);
+    entry.clear();
+    entry += "    <";
+    entry += entry_nm;
+    entry += " i";
+    AppendAttrNum(entry, id);
+    entry += " n";
+    AppendAttrStr(entry, nm);
 
     if (fake_procedure) {
-      os << " f" << MakeAttrNum(1);
+      entry += " f";
+      AppendAttrNum(entry, 1);
     } 
 
-    os << "/>\n";
+    entry += "/>\n";
+    os << entry;
   }
 }
 
@@ -928,6 +974,35 @@ fmt_cct_makeNode(hpcrun_fmt_cct_node_t& n_fmt, const Prof::CCT::ANode& n,
 		 epoch_flags_t flags);
 
 
+// fmt_fmap_t: a read-only mapping of a file stream from its current
+// position to the end of the file.  The mapping is released on
+// destruction if fmt_fmap_free() has not been called (e.g., when a
+// read error is thrown).
+struct fmt_fmap_t {
+  fmt_fmap_t()
+    : addr(NULL), len(0), beg(NULL), end(NULL)
+  { }
+
+  ~fmt_fmap_t()
+  {
+    if (addr) {
+      munmap(addr, len);
+    }
+  }
+
+  void*  addr;  // page-aligned mapping
+  size_t len;   // length of mapping
+  const unsigned char* beg; // file position of stream
+  const unsigned char* end; // end of file
+};
+
+static bool
+fmt_fmap_make(fmt_fmap_t& fmap, FILE* fs);
+
+static void
+fmt_fmap_free(fmt_fmap_t& fmap, FILE* fs, const unsigned char* cur);
+
+
 //***************************************************************************
 
 namespace Prof {
@@ -1468,15 +1543,32 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
     (hpcrun_metricVal_t*)alloca(numMetricsSrc * sizeof(hpcrun_metricVal_t))
     : NULL;
 
+  // When the stream is backed by a regular file, decode nodes directly
+  // from a mapping of the file rather than through per-field stdio
+  // calls.  Nodes are fixed-size records.  Memory streams (e.g.,
+  // profiles received by hpcprof-mpi) use the stdio path.
+  fmt_fmap_t fmap;
+  bool useFmap = (numNodes > 0) && fmt_fmap_make(fmap, infs);
+  const unsigned char* fmapCur = (useFmap) ? fmap.beg : NULL;
+  const size_t nodeLen = hpcrun_fmt_cct_node_mlen(prof.m_flags, numMetricsSrc);
+
   ExprEval eval;
 
   for (uint i = 0; i < numNodes; ++i) {
     // ----------------------------------------------------------
     // Read the node
     // ----------------------------------------------------------
-    ret = hpcrun_fmt_cct_node_fread(&nodeFmt, prof.m_flags, infs);
-    if (ret != HPCFMT_OK) {
-      DIAG_Throw("Error reading CCT node " << nodeFmt.id);
+    if (useFmap) {
+      if ((size_t)(fmap.end - fmapCur) < nodeLen) {
+	DIAG_Throw("Error reading CCT node " << nodeFmt.id);
+      }
+      fmapCur += hpcrun_fmt_cct_node_mread(&nodeFmt, prof.m_flags, fmapCur);
+    }
+    else {
+      ret = hpcrun_fmt_cct_node_fread(&nodeFmt, prof.m_flags, infs);
+      if (ret != HPCFMT_OK) {
+	DIAG_Throw("Error reading CCT node " << nodeFmt.id);
+      }
     }
     if (outfs) {
       hpcrun_fmt_cct_node_fprint(&nodeFmt, outfs, prof.m_flags,
@@ -1561,6 +1653,10 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
     cctNodeMap.insert(std::make_pair(nodeFmt.id, node));
   }
 
+  if (useFmap) {
+    fmt_fmap_free(fmap, infs, fmapCur);
+  }
+
   if (outfs) {
     fprintf(outfs, "]\n");
   }
@@ -1961,7 +2057,9 @@ cct_makeNode(Prof::CallPath::Profile& prof,
 	DIAG_Die(DIAG_UnexpectedInput);
     }
 
-    metricData.metric(i_dst) = mval * (double)mdesc->period();
+    if (mval != 0.0) {
+      metricData.metric(i_dst) = mval * (double)mdesc->period();
+    }
 
     if (!hpcrun_metricVal_isZero(m)) {
       hasMetrics = true;
@@ -2071,3 +2169,148 @@ fmt_cct_makeNode(hpcrun_fmt_cct_node_t& n_fmt, const Prof::CCT::ANode& n,
   }
 }
 
+
+//***************************************************************************
+
+static bool
+fmt_fmap_make(fmt_fmap_t& fmap, FILE* fs)
+{
+  int fd = fileno(fs);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    return false;
+  }
+
+  // N.B.: ftello accounts for data buffered by stdio
+  off_t pos = ftello(fs);
+  if (pos < 0 || pos >= st.st_size) {
+    return false;
+  }
+
+  off_t pgsz = (off_t)sysconf(_SC_PAGESIZE);
+  off_t mapBeg = (pos / pgsz) * pgsz;
+
+  fmap.len = (size_t)(st.st_size - mapBeg);
+  void* addr = mmap(NULL, fmap.len, PROT_READ, MAP_PRIVATE, fd, mapBeg);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  fmap.addr = addr;
+  madvise(fmap.addr, fmap.len, MADV_SEQUENTIAL);
+
+  fmap.beg = (const unsigned char*)fmap.addr + (pos - mapBeg);
+  fmap.end = (const unsigned char*)fmap.addr + fmap.len;
+  return true;
+}
+
+
+// fmt_fmap_free: Unmap 'fmap' and advance the stream 'fs' past the
+// data consumed from the mapping (up to 'cur').
+static void
+fmt_fmap_free(fmt_fmap_t& fmap, FILE* fs, const unsigned char* cur)
+{
+  off_t pos = ftello(fs) + (off_t)(cur - fmap.beg);
+  munmap(fmap.addr, fmap.len);
+  fmap.addr = NULL;
+  fseeko(fs, pos, SEEK_SET);
+}
+
+
+//***************************************************************************
+
+// fixTrace_remap: Rewrite the fixed-size trace records following the
+// header of 'infs' to the output file 'outFnm' (open as 'outfs'),
+// translating cpIds through 'cpIdMap'.  Both streams are positioned
+// just past their headers.  The output is preallocated and written
+// through a shared mapping, with blocks of records copied and
+// remapped in parallel.
+static fixTrace_ret_t
+fixTrace_remap(FILE* infs, FILE* outfs, const string& outFnm,
+	       hpctrace_hdr_flags_t flags, const std::vector<uint32_t>& cpIdMap)
+{
+  const size_t recSz = 8 + 4 + (flags.fields.isDataCentric ? 4 : 0);
+  const long blkRecs = 64 * 1024;
+
+  fmt_fmap_t inMap;
+  if (!fmt_fmap_make(inMap, infs)) {
+    return FixTrace_Fallback; // including an empty trace
+  }
+
+  size_t len = (size_t)(inMap.end - inMap.beg);
+  if (len % recSz != 0) {
+    return FixTrace_ReadErr;
+  }
+
+  if (fflush(outfs) != 0) {
+    return FixTrace_WriteErr;
+  }
+  off_t outPos = ftello(outfs);
+  if (outPos < 0) {
+    return FixTrace_Fallback;
+  }
+
+  // N.B.: 'outfs' is write-only, but a shared mapping needs a
+  // read-write descriptor.
+  int fd = open(outFnm.c_str(), O_RDWR);
+  if (fd < 0) {
+    return FixTrace_Fallback;
+  }
+
+  // preallocate so that running out of space is reported here rather
+  // than as SIGBUS while storing to the mapping
+  int ret = posix_fallocate(fd, outPos, (off_t)len);
+  if (ret == ENOSPC || ret == EDQUOT) {
+    close(fd);
+    errno = ret;
+    return FixTrace_WriteErr;
+  }
+  else if (ret != 0) {
+    close(fd);
+    return FixTrace_Fallback;
+  }
+
+  off_t pgsz = (off_t)sysconf(_SC_PAGESIZE);
+  off_t mapBeg = (outPos / pgsz) * pgsz;
+  size_t mapLen = (size_t)(outPos - mapBeg) + len;
+
+  void* addr = mmap(NULL, mapLen, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    fd, mapBeg);
+  if (addr == MAP_FAILED) {
+    ret = ftruncate(fd, outPos);
+    close(fd);
+    return (ret == 0) ? FixTrace_Fallback : FixTrace_WriteErr;
+  }
+  close(fd);
+
+  const unsigned char* in = inMap.beg;
+  unsigned char* out = (unsigned char*)addr + (outPos - mapBeg);
+
+  const uint32_t* map = &cpIdMap[0];
+  const uint32_t mapSz = cpIdMap.size();
+
+  const long nRecs = (long)(len / recSz);
+  const long nBlks = (nRecs + blkRecs - 1) / blkRecs;
+
+#pragma omp parallel for schedule(dynamic)
+  for (long b = 0; b < nBlks; ++b) {
+    long r_beg = b * blkRecs;
+    long r_end = std::min(r_beg + blkRecs, nRecs);
+
+    memcpy(out + r_beg * recSz, in + r_beg * recSz, (r_end - r_beg) * recSz);
+
+    for (long r = r_beg; r < r_end; ++r) {
+      unsigned char* cpIdBuf = out + r * recSz + 8;
+      uint32_t cpId = hpcio_be4_mread(cpIdBuf);
+      if (cpId < mapSz) {
+	hpcio_be4_mwrite(cpIdBuf, map[cpId]);
+      }
+    }
+  }
+
+  ret = munmap(addr, mapLen);
+  return (ret == 0) ? FixTrace_OK : FixTrace_WriteErr;
+}
@@ -118,8 +118,7 @@ LoadMap::lm_insert(LoadMap::LM* x)
 LoadMap::LMSet_nm::iterator
 LoadMap::lm_find(const std::string& nm) const
 {
-  static LoadMap::LM key;
-  key.name(nm);
+  LoadMap::LM key(nm); // N.B.: not static; profiles may be read concurrently
 
   LMSet_nm::iterator fnd = m_lm_byName.find(&key);
   return fnd;
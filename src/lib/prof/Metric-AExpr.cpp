@@ -113,6 +113,15 @@ AExpr::dump_opands(std::ostream& os, AExpr** opands, uint sz, const char* sep)
 }
 
 
+void
+AExpr::compile_opands(AExprProg& prog, AExpr** opands, uint sz)
+{
+  for (uint i = 0; i < sz; ++i) {
+    opands[i]->compile(prog);
+  }
+}
+
+
 // ----------------------------------------------------------------------
 // class Const
 // ----------------------------------------------------------------------
@@ -125,6 +134,13 @@ Const::dumpMe(std::ostream& os) const
 }
 
 
+void
+Const::compile(AExprProg& prog) const
+{
+  prog.emit(AExprProg::OpConst, 0, m_c);
+}
+
+
 // ----------------------------------------------------------------------
 // class Neg
 // ----------------------------------------------------------------------
@@ -149,6 +165,14 @@ Neg::dumpMe(std::ostream& os) const
 }
 
 
+void
+Neg::compile(AExprProg& prog) const
+{
+  m_expr->compile(prog);
+  prog.emit(AExprProg::OpNeg);
+}
+
+
 // ----------------------------------------------------------------------
 // class Var
 // ----------------------------------------------------------------------
@@ -161,6 +185,13 @@ Var::dumpMe(std::ostream& os) const
 }
 
 
+void
+Var::compile(AExprProg& prog) const
+{
+  prog.emit(AExprProg::OpVar, m_metricId);
+}
+
+
 // ----------------------------------------------------------------------
 // class Power
 // ----------------------------------------------------------------------
@@ -189,6 +220,15 @@ Power::dumpMe(std::ostream& os) const
 }
 
 
+void
+Power::compile(AExprProg& prog) const
+{
+  m_base->compile(prog);
+  m_exponent->compile(prog);
+  prog.emit(AExprProg::OpPower);
+}
+
+
 // ----------------------------------------------------------------------
 // class Divide
 // ----------------------------------------------------------------------
@@ -221,6 +261,15 @@ Divide::dumpMe(std::ostream& os) const
 }
 
 
+void
+Divide::compile(AExprProg& prog) const
+{
+  m_numerator->compile(prog);
+  m_denominator->compile(prog);
+  prog.emit(AExprProg::OpDivide);
+}
+
+
 // ----------------------------------------------------------------------
 // class Minus
 // ----------------------------------------------------------------------
@@ -248,6 +297,15 @@ Minus::dumpMe(std::ostream& os) const
 }
 
 
+void
+Minus::compile(AExprProg& prog) const
+{
+  m_minuend->compile(prog);
+  m_subtrahend->compile(prog);
+  prog.emit(AExprProg::OpMinus);
+}
+
+
 // ----------------------------------------------------------------------
 // class Plus
 // ----------------------------------------------------------------------
@@ -281,6 +339,14 @@ Plus::dumpMe(std::ostream& os) const
 }
 
 
+void
+Plus::compile(AExprProg& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emit(AExprProg::OpPlus, m_sz);
+}
+
+
 // ----------------------------------------------------------------------
 // class Times
 // ----------------------------------------------------------------------
@@ -318,6 +384,14 @@ Times::dumpMe(std::ostream& os) const
 }
 
 
+void
+Times::compile(AExprProg& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emit(AExprProg::OpTimes, m_sz);
+}
+
+
 // ----------------------------------------------------------------------
 // class Max
 // ----------------------------------------------------------------------
@@ -355,6 +429,14 @@ Max::dumpMe(std::ostream& os) const
 }
 
 
+void
+Max::compile(AExprProg& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emit(AExprProg::OpMax, m_sz);
+}
+
+
 // ----------------------------------------------------------------------
 // class Min
 // ----------------------------------------------------------------------
@@ -396,6 +478,14 @@ Min::dumpMe(std::ostream& os) const
 }
 
 
+void
+Min::compile(AExprProg& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emit(AExprProg::OpMin, m_sz);
+}
+
+
 // ----------------------------------------------------------------------
 // class Mean
 // ----------------------------------------------------------------------
@@ -429,6 +519,23 @@ Mean::dumpMe(std::ostream& os) const
 }
 
 
+void
+Mean::compile(AExprProg& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emit(AExprProg::OpMean, m_sz);
+}
+
+
+void
+Mean::compileNF(AExprProg& prog) const
+{
+  // cf. evalNF(): the sum
+  compile_opands(prog, m_opands, m_sz);
+  prog.emit(AExprProg::OpPlus, m_sz);
+}
+
+
 // ----------------------------------------------------------------------
 // class StdDev
 // ----------------------------------------------------------------------
@@ -463,6 +570,22 @@ StdDev::dumpMe(std::ostream& os) const
 }
 
 
+void
+StdDev::compile(AExprProg& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emit(AExprProg::OpStdDev, m_sz);
+}
+
+
+void
+StdDev::compileNF(AExprProg& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emit(AExprProg::OpSumSquares, m_sz);
+}
+
+
 // ----------------------------------------------------------------------
 // class CoefVar
 // ----------------------------------------------------------------------
@@ -502,6 +625,22 @@ CoefVar::dumpMe(std::ostream& os) const
 }
 
 
+void
+CoefVar::compile(AExprProg& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emit(AExprProg::OpCoefVar, m_sz);
+}
+
+
+void
+CoefVar::compileNF(AExprProg& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emit(AExprProg::OpSumSquares, m_sz);
+}
+
+
 // ----------------------------------------------------------------------
 // class RStdDev
 // ----------------------------------------------------------------------
@@ -541,6 +680,22 @@ RStdDev::dumpMe(std::ostream& os) const
 }
 
 
+void
+RStdDev::compile(AExprProg& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emit(AExprProg::OpRStdDev, m_sz);
+}
+
+
+void
+RStdDev::compileNF(AExprProg& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emit(AExprProg::OpSumSquares, m_sz);
+}
+
+
 // ----------------------------------------------------------------------
 // class NumSource
 // ----------------------------------------------------------------------
@@ -553,9 +708,536 @@ NumSource::dumpMe(std::ostream& os) const
 }
 
 
+void
+NumSource::compile(AExprProg& prog) const
+{
+  prog.emit(AExprProg::OpConst, 0, (double)m_numSrc);
+}
+
+
+// ----------------------------------------------------------------------
+// class AExprProg
+// ----------------------------------------------------------------------
+
+// N.B.: equivalent to AExpr::isok() but inlined so that loops using it
+// can be vectorized: x - x is 0 for finite x and NaN otherwise.
+static inline bool
+isok_inl(double x)
+{
+  return (x - x) == 0.0;
+}
+
+
+AExprProg::AExprProg(const AExpr& expr, bool isNF)
+  : m_depth(0), m_maxDepth(0)
+{
+  if (isNF) {
+    expr.compileNF(*this);
+  }
+  else {
+    expr.compile(*this);
+  }
+
+  DIAG_Assert(m_depth >= 1 && m_depth <= maxOut, DIAG_UnexpectedInput);
+  for (uint i = 0; i < maxOut; ++i) {
+    m_accumId[i] = expr.accumId(i);
+  }
+
+  // two extra columns for the n-ary operators' temporaries
+  m_stack.resize((m_maxDepth + 2) * BatchSz);
+}
+
+
+void
+AExprProg::emit(OpTy op, uint arg, double c)
+{
+  Insn insn = { op, arg, c };
+  m_insns.push_back(insn);
+
+  switch (op) {
+    case OpConst:
+    case OpVar:
+      m_depth += 1;
+      break;
+    case OpNeg:
+      break;
+    case OpPower:
+    case OpDivide:
+    case OpMinus:
+      DIAG_Assert(m_depth >= 2, DIAG_UnexpectedInput);
+      m_depth -= 1;
+      break;
+    case OpSumSquares:
+      DIAG_Assert(m_depth >= arg, DIAG_UnexpectedInput);
+      m_depth = m_depth - arg + 2;
+      break;
+    default: // n-ary
+      DIAG_Assert(m_depth >= arg, DIAG_UnexpectedInput);
+      m_depth = m_depth - arg + 1;
+      break;
+  }
+  m_maxDepth = std::max(m_maxDepth, m_depth);
+}
+
+
+void
+AExprProg::eval(const Metric::IData* const* mdata, uint n, double* z) const
+{
+  run(mdata, n);
+
+  const double* x = column(0);
+  for (uint i = 0; i < n; ++i) {
+    z[i] = x[i];
+  }
+}
+
+
+void
+AExprProg::evalNF(Metric::IData* const* mdata, uint n) const
+{
+  run(mdata, n);
+
+  // cf. AExpr::evalNF() and AExpr::evalStdDevNF()
+  for (uint k = 0; k < m_depth; ++k) {
+    const double* x = column(k);
+    for (uint i = 0; i < n; ++i) {
+      AExpr::var(*mdata[i], m_accumId[k]) = x[i];
+    }
+  }
+}
+
+
+// N.B.: Each case follows the corresponding eval() routine operation
+// by operation (including the order of n-ary sums and products) so
+// that results are bit-for-bit identical.
+void
+AExprProg::run(const Metric::IData* const* mdata, uint n) const
+{
+  DIAG_Assert(n <= BatchSz, DIAG_UnexpectedInput);
+
+  const double nan = c_FP_NAN_d;
+  uint sp = 0; // stack depth
+
+  for (uint pc = 0; pc < m_insns.size(); ++pc) {
+    const Insn& insn = m_insns[pc];
+    uint sz = insn.arg;
+
+    switch (insn.op) {
+      case OpConst: {
+	double* z = column(sp++);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = insn.c;
+	}
+	break;
+      }
+      case OpVar: {
+	double* z = column(sp++);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = mdata[i]->demandMetric(insn.arg);
+	}
+	break;
+      }
+      case OpNeg: {
+	double* z = column(sp - 1);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = -z[i];
+	}
+	break;
+      }
+      case OpPower: {
+	double* b = column(sp - 2);
+	const double* e = column(sp - 1);
+	for (uint i = 0; i < n; ++i) {
+	  b[i] = pow(b[i], e[i]);
+	}
+	sp -= 1;
+	break;
+      }
+      case OpDivide: {
+	double* x = column(sp - 2);
+	const double* d = column(sp - 1);
+	for (uint i = 0; i < n; ++i) {
+	  double q = x[i] / d[i];
+	  x[i] = (isok_inl(d[i]) && d[i] != 0.0) ? q : nan;
+	}
+	sp -= 1;
+	break;
+      }
+      case OpMinus: {
+	double* m = column(sp - 2);
+	const double* s = column(sp - 1);
+	for (uint i = 0; i < n; ++i) {
+	  m[i] = (m[i] - s[i]);
+	}
+	sp -= 1;
+	break;
+      }
+      case OpPlus:
+      case OpMean: {
+	uint base = sp - sz;
+	double* z = column(m_maxDepth);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = 0.0;
+	}
+	for (uint k = 0; k < sz; ++k) {
+	  const double* x = column(base + k);
+	  for (uint i = 0; i < n; ++i) {
+	    z[i] += x[i];
+	  }
+	}
+	double* out = column(base);
+	if (insn.op == OpMean) {
+	  for (uint i = 0; i < n; ++i) {
+	    out[i] = z[i] / (double) sz;
+	  }
+	}
+	else {
+	  for (uint i = 0; i < n; ++i) {
+	    out[i] = z[i];
+	  }
+	}
+	sp = base + 1;
+	break;
+      }
+      case OpTimes: {
+	uint base = sp - sz;
+	double* z = column(m_maxDepth);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = 1.0;
+	}
+	for (uint k = 0; k < sz; ++k) {
+	  const double* x = column(base + k);
+	  for (uint i = 0; i < n; ++i) {
+	    z[i] *= x[i];
+	  }
+	}
+	double* out = column(base);
+	for (uint i = 0; i < n; ++i) {
+	  out[i] = z[i];
+	}
+	sp = base + 1;
+	break;
+      }
+      case OpMin: {
+	uint base = sp - sz;
+	double* z = column(m_maxDepth);
+	for (uint i = 0; i < n; ++i) {
+	  z[i] = DBL_MAX;
+	}
+	for (uint k = 0; k < sz; ++k) {
+	  const double* x = column(base + k);
+	  for (uint i = 0; i < n; ++i) {
+	    z[i] = (x[i] != 0.0) ? std::min(z[i], x[i]) : z[i];
+	  }
+	}
+	double* out = column(base);
+	for (uint i = 0; i < n; ++i) {
+	  out[i] = (z[i] == DBL_MAX) ? DBL_MIN : z[i];
+	}
+	sp = base + 1;
+	break;
+      }
+      case OpMax: {
+	uint base = sp - sz;
+	double* z = column(base);
+	for (uint k = 1; k < sz; ++k) {
+	  const double* x = column(base + k);
+	  for (uint i = 0; i < n; ++i) {
+	    z[i] = std::max(z[i], x[i]);
+	  }
+	}
+	sp = base + 1;
+	break;
+      }
+      case OpStdDev:
+      case OpCoefVar:
+      case OpRStdDev: {
+	// cf. AExpr::evalVariance()
+	uint base = sp - sz;
+	double* x_mean = column(m_maxDepth);
+	double* x_var = column(m_maxDepth + 1);
+	for (uint i = 0; i < n; ++i) {
+	  x_mean[i] = 0.0;
+	  x_var[i] = 0.0;
+	}
+	for (uint k = 0; k < sz; ++k) {
+	  const double* t = column(base + k);
+	  for (uint i = 0; i < n; ++i) {
+	    double delta = t[i] - x_mean[i];
+	    x_mean[i] += delta / (k + 1);
+	    x_var[i] += delta * (t[i] - x_mean[i]);
+	  }
+	}
+	double* out = column(base);
+	for (uint i = 0; i < n; ++i) {
+	  double sdev = sqrt(x_var[i] / sz);
+	  double z = sdev;
+	  if (insn.op != OpStdDev) {
+	    z = 0.0;
+	    if (x_mean[i] > epsilon) {
+	      z = (insn.op == OpCoefVar) ? (sdev / x_mean[i])
+		: (sdev / x_mean[i]) * 100;
+	    }
+	  }
+	  out[i] = z;
+	}
+	sp = base + 1;
+	break;
+      }
+      case OpSumSquares: {
+	// cf. AExpr::evalSumSquares()
+	uint base = sp - sz;
+	double* z1 = column(m_maxDepth);
+	double* z2 = column(m_maxDepth + 1);
+	for (uint i = 0; i < n; ++i) {
+	  z1[i] = 0.0;
+	  z2[i] = 0.0;
+	}
+	for (uint k = 0; k < sz; ++k) {
+	  const double* x = column(base + k);
+	  for (uint i = 0; i < n; ++i) {
+	    z1[i] += x[i];
+	    z2[i] += (x[i] * x[i]);
+	  }
+	}
+	double* out1 = column(base);
+	double* out2 = column(base + 1);
+	for (uint i = 0; i < n; ++i) {
+	  out1[i] = z1[i];
+	  out2[i] = z2[i];
+	}
+	sp = base + 2;
+	break;
+      }
+      default:
+	DIAG_Die(DIAG_UnexpectedInput);
+    }
+  }
+}
+
+
+std::ostream&
+AExprProg::dump(std::ostream& os) const
+{
+  static const char* opNames[] = {
+    "const", "var", "neg", "power", "divide", "minus", "plus", "times",
+    "min", "max", "mean", "stddev", "coefvar", "r-stddev", "sum-squares"
+  };
+
+  for (uint pc = 0; pc < m_insns.size(); ++pc) {
+    const Insn& insn = m_insns[pc];
+    os << pc << ": " << opNames[insn.op];
+    if (insn.op == OpConst) {
+      os << " " << insn.c;
+    }
+    else if (insn.op != OpNeg && insn.op != OpPower
+	     && insn.op != OpDivide && insn.op != OpMinus) {
+      os << " " << insn.arg;
+    }
+    os << endl;
+  }
+  return os;
+}
+
+
 //****************************************************************************
 
 
 } // namespace Metric
 
 } // namespace Prof
+
+
+//***************************************************************************
+// unit test
+//***************************************************************************
+// #define UNIT_TEST_AEXPR_PROG
+
+#ifdef UNIT_TEST_AEXPR_PROG
+
+// Benchmark of AExprProg against AExpr::eval()/evalNF().  Random
+// expressions over 'numVars' metrics are first checked on batches of
+// IData that hold 0, -0, inf, NaN and other edge values: every value
+// and accumulator must be bit-identical (or both NaN).  Then each
+// expression is evaluated over 'numNodes' IData with the tree and
+// with the program, timing both and checking that they agree.
+//
+// usage: a.out [expressions] [nodes]
+
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <ctime>
+#include <vector>
+
+using namespace Prof::Metric;
+
+static const uint numVars = 6;
+
+static double
+benchNow()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static bool
+benchSame(double a, double b)
+{
+  return (memcmp(&a, &b, sizeof(double)) == 0) || (a != a && b != b);
+}
+
+static AExpr*
+benchGenExpr(int depth);
+
+static AExpr**
+benchGenOpands(int depth, uint& sz)
+{
+  sz = 1 + rand() % 4;
+  AExpr** opands = new AExpr*[sz];
+  for (uint i = 0; i < sz; ++i) {
+    opands[i] = benchGenExpr(depth + 1);
+  }
+  return opands;
+}
+
+static AExpr*
+benchGenExpr(int depth)
+{
+  static const double consts[] = { 0.0, -0.0, 1.5, 2.0, -3.0 };
+  uint sz;
+
+  switch ((depth > 3) ? rand() % 3 : rand() % 15) {
+  case 0:  return new Const(consts[rand() % 5]);
+  case 1:
+  case 2:  return new Var("v", rand() % numVars);
+  case 3:  return new Neg(benchGenExpr(depth + 1));
+  case 4:  return new Power(benchGenExpr(depth + 1), benchGenExpr(depth + 1));
+  case 5:  return new Divide(benchGenExpr(depth + 1), benchGenExpr(depth + 1));
+  case 6:  return new Minus(benchGenExpr(depth + 1), benchGenExpr(depth + 1));
+  case 7:  { AExpr** x = benchGenOpands(depth, sz); return new Plus(x, sz); }
+  case 8:  { AExpr** x = benchGenOpands(depth, sz); return new Times(x, sz); }
+  case 9:  { AExpr** x = benchGenOpands(depth, sz); return new Min(x, sz); }
+  case 10: { AExpr** x = benchGenOpands(depth, sz); return new Max(x, sz); }
+  case 11: { AExpr** x = benchGenOpands(depth, sz); return new Mean(x, sz); }
+  case 12: { AExpr** x = benchGenOpands(depth, sz); return new StdDev(x, sz); }
+  case 13: { AExpr** x = benchGenOpands(depth, sz); return new CoefVar(x, sz); }
+  default: { AExpr** x = benchGenOpands(depth, sz); return new RStdDev(x, sz); }
+  }
+}
+
+static AExpr*
+benchMakeExpr()
+{
+  AExpr* expr = benchGenExpr(0);
+  expr->accumId(0, numVars);
+  expr->accumId(1, numVars + 1);
+  return expr;
+}
+
+int
+main(int argc, char** argv)
+{
+  uint numExprs = (argc > 1) ? strtoul(argv[1], NULL, 10) : 3000;
+  uint numNodes = (argc > 2) ? strtoul(argv[2], NULL, 10) : 100000;
+
+  srand(7);
+
+  // edge values: every result must be bit-identical
+  static const double edgeVals[] = {
+    0.0, -0.0, 1.0, -1.0, 2.5, 1e300, -1e-300, INFINITY, NAN, 3.0, 7.0
+  };
+  const uint numEdgeVals = sizeof(edgeVals) / sizeof(edgeVals[0]);
+
+  ulong numChecked = 0;
+  for (uint e = 0; e < numExprs; ++e) {
+    AExpr* expr = benchMakeExpr();
+    uint n = 1 + rand() % AExprProg::BatchSz;
+
+    std::vector<IData*> treeData(n), progData(n);
+    for (uint i = 0; i < n; ++i) {
+      treeData[i] = new IData(numVars);
+      progData[i] = new IData(numVars);
+      for (uint v = 0; v < numVars; ++v) {
+	if (rand() % 2) {
+	  double x = edgeVals[rand() % numEdgeVals];
+	  treeData[i]->metric(v) = x;
+	  progData[i]->metric(v) = x;
+	}
+      }
+    }
+
+    AExprProg prog(*expr, false), progNF(*expr, true);
+    double z[AExprProg::BatchSz];
+    prog.eval(&progData[0], n, z);
+    progNF.evalNF(&progData[0], n);
+
+    for (uint i = 0; i < n; ++i) {
+      assert(benchSame(expr->eval(*treeData[i]), z[i]));
+      expr->evalNF(*treeData[i]);
+      assert(treeData[i]->numMetrics() == progData[i]->numMetrics());
+      for (uint k = 0; k < 2; ++k) {
+	assert(benchSame(treeData[i]->metricVal(numVars + k),
+			 progData[i]->metricVal(numVars + k)));
+      }
+      numChecked++;
+      delete treeData[i];
+      delete progData[i];
+    }
+    delete expr;
+  }
+
+  // throughput over many nodes
+  std::vector<IData*> data(numNodes);
+  for (uint i = 0; i < numNodes; ++i) {
+    data[i] = new IData(numVars);
+    for (uint v = 0; v < numVars; ++v) {
+      data[i]->metric(v) = 1.0 + rand() % 1000;
+    }
+  }
+
+  uint numTimed = numExprs / 10 + 1;
+  std::vector<double> treeZ(numNodes), progZ(numNodes);
+  double treeTime = 0.0, progTime = 0.0;
+  ulong progInsns = 0;
+  for (uint e = 0; e < numTimed; ++e) {
+    AExpr* expr = benchMakeExpr();
+
+    double t0 = benchNow();
+    for (uint i = 0; i < numNodes; ++i) {
+      treeZ[i] = expr->eval(*data[i]);
+    }
+    treeTime += benchNow() - t0;
+
+    t0 = benchNow();
+    AExprProg prog(*expr, false);
+    for (uint i = 0; i < numNodes; i += AExprProg::BatchSz) {
+      prog.eval(&data[i], std::min(AExprProg::BatchSz, numNodes - i),
+		&progZ[i]);
+    }
+    progTime += benchNow() - t0;
+    progInsns += prog.size();
+
+    for (uint i = 0; i < numNodes; ++i) {
+      assert(benchSame(treeZ[i], progZ[i]));
+    }
+    delete expr;
+  }
+
+  std::cout << numChecked << " edge-value evaluations bit-identical"
+	    << std::endl
+	    << numTimed << " expressions (" << progInsns / numTimed
+	    << " insns avg) over " << numNodes << " nodes:" << std::endl
+	    << "  AExpr::eval: " << 1e9 * treeTime / numTimed / numNodes
+	    << " ns/node" << std::endl
+	    << "  AExprProg:   " << 1e9 * progTime / numTimed / numNodes
+	    << " ns/node" << std::endl;
+
+  for (uint i = 0; i < numNodes; ++i) {
+    delete data[i];
+  }
+  return 0;
+}
+
+#endif
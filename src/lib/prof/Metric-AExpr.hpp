@@ -70,6 +70,9 @@
 //   CoefVar: coefficient of variance              : n-ary
 //   RStdDev: relative standard deviation          : n-ary
 //
+// An expression may also be compiled into an AExprProg, a flat program
+// that evaluates it over a batch of IData at a time.
+//
 //***************************************************************************
 
 #ifndef prof_Prof_Metric_AExpr_hpp
@@ -79,6 +82,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 #include <algorithm>
 
 //************************* User Include Files *******************************
@@ -103,6 +107,8 @@ namespace Prof {
 
 namespace Metric {
 
+class AExprProg;
+
 // ----------------------------------------------------------------------
 // class AExpr
 //   The base class for all concrete evaluation classes
@@ -153,6 +159,21 @@ public:
   { return !(c_isnan_d(x) || c_isinf_d(x)); }
 
 
+  // ------------------------------------------------------------
+  // AExprProg
+  // ------------------------------------------------------------
+
+  // compile: append the postfix program for eval() to 'prog'
+  virtual void
+  compile(AExprProg& prog) const = 0;
+
+  // compileNF: append the postfix program for evalNF(), leaving one
+  //   value per accumulator (cf. evalNF())
+  virtual void
+  compileNF(AExprProg& prog) const
+  { compile(prog); }
+
+
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
   // ------------------------------------------------------------
@@ -322,6 +343,9 @@ protected:
   static void
   dump_opands(std::ostream& os, AExpr** opands, uint sz,
 	      const char* sep = ", ");
+
+  static void
+  compile_opands(AExprProg& prog, AExpr** opands, uint sz);
   
 protected:
   uint m_accumId[maxAccums];    // used only for Metric::IDBExpr routines
@@ -349,6 +373,9 @@ public:
   eval(const Metric::IData& GCC_ATTR_UNUSED mdata) const
   { return m_c; }
 
+  virtual void
+  compile(AExprProg& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -390,6 +417,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProg& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -435,6 +465,9 @@ public:
   eval(const Metric::IData& mdata) const
   { return mdata.demandMetric(m_metricId); }
 
+  virtual void
+  compile(AExprProg& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -490,6 +523,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProg& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr:
@@ -540,6 +576,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProg& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -587,6 +626,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProg& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -631,6 +673,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProg& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -681,6 +726,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProg& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -727,6 +775,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProg& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -776,6 +827,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProg& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -825,6 +879,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProg& prog) const;
+
   virtual double
   evalNF(Metric::IData& mdata) const
   {
@@ -833,6 +890,9 @@ public:
     return z;
   }
 
+  virtual void
+  compileNF(AExprProg& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr:
@@ -886,10 +946,16 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProg& prog) const;
+
   virtual double
   evalNF(Metric::IData& mdata) const
   { return evalStdDevNF(mdata, m_opands, m_sz); }
 
+  virtual void
+  compileNF(AExprProg& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -952,10 +1018,16 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProg& prog) const;
+
   virtual double
   evalNF(Metric::IData& mdata) const
   { return evalStdDevNF(mdata, m_opands, m_sz); }
 
+  virtual void
+  compileNF(AExprProg& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -1018,10 +1090,16 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProg& prog) const;
+
   virtual double
   evalNF(Metric::IData& mdata) const
   { return evalStdDevNF(mdata, m_opands, m_sz); }
 
+  virtual void
+  compileNF(AExprProg& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -1086,6 +1164,9 @@ public:
   eval(const Metric::IData& GCC_ATTR_UNUSED mdata) const
   { return (double)m_numSrc; }
 
+  virtual void
+  compile(AExprProg& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -1117,6 +1198,98 @@ private:
 };
 
 
+// ----------------------------------------------------------------------
+// class AExprProg
+//   An AExpr compiled into a flat postfix program that evaluates the
+//   expression for a batch of IData at once.  Each instruction works
+//   on whole columns of values (one per IData) so that its loop can be
+//   vectorized, instead of one virtual eval() per tree node per IData.
+//   The per-value arithmetic is the same as the eval() routines above,
+//   including the NaN and divide-by-zero handling, so results match.
+//
+//   N.B.: not reentrant (evaluation uses a scratch stack)
+// ----------------------------------------------------------------------
+
+class AExprProg
+  : public Unique // disable copying, for now
+{
+public:
+  enum OpTy {
+    OpConst,      // push constant 'c'
+    OpVar,        // push metric 'arg'
+    OpNeg,
+    OpPower,
+    OpDivide,
+    OpMinus,
+    OpPlus,       // n-ary ops pop 'arg' operands and push the result
+    OpTimes,
+    OpMin,
+    OpMax,
+    OpMean,
+    OpStdDev,
+    OpCoefVar,
+    OpRStdDev,
+    OpSumSquares  // pushes <sum, sum of squares> (cf. evalStdDevNF())
+  };
+
+  // maximum number of IData per batch
+  static const uint BatchSz = 256;
+
+  // maximum number of values left by a program (cf. IDBExpr::maxAccums)
+  enum { maxOut = 2 };
+
+public:
+  // Compile 'expr' to compute eval() or, if 'isNF', evalNF()
+  AExprProg(const AExpr& expr, bool isNF);
+
+  ~AExprProg()
+  { }
+
+  // eval: store the finalized values for mdata[0, n) in z[0, n)
+  void
+  eval(const Metric::IData* const* mdata, uint n, double* z) const;
+
+  // evalNF: store the non-finalized values for mdata[0, n) in the
+  //   expression's accumulators
+  void
+  evalNF(Metric::IData* const* mdata, uint n) const;
+
+  // emit: append an instruction; 'arg' is the metric id for OpVar
+  //   and the number of operands for n-ary ops
+  void
+  emit(OpTy op, uint arg = 0, double c = 0.0);
+
+  uint
+  size() const
+  { return m_insns.size(); }
+
+  std::ostream&
+  dump(std::ostream& os = std::cout) const;
+
+private:
+  struct Insn {
+    OpTy op;
+    uint arg;
+    double c;
+  };
+
+  void
+  run(const Metric::IData* const* mdata, uint n) const;
+
+  double*
+  column(uint i) const
+  { return &m_stack[i * BatchSz]; }
+
+private:
+  std::vector<Insn> m_insns;
+  uint m_depth;    // stack depth after the last instruction
+  uint m_maxDepth;
+  uint m_accumId[maxOut];
+
+  mutable std::vector<double> m_stack;
+};
+
+
 //****************************************************************************
 
 } // namespace Metric
@@ -65,6 +65,7 @@
 using std::string;
 
 #include <typeinfo>
+#include <algorithm>
 
 //*************************** User Include Files ****************************
 
@@ -101,6 +102,17 @@ IData::toStringMetrics(int oFlags, const char* pfx) const
 
 std::ostream&
 IData::writeMetricsXML(std::ostream& os, uint mBegId, uint mEndId,
+		       int oFlags, const char* pfx) const
+{
+  std::string buf;
+  writeMetricsXML(buf, mBegId, mEndId, oFlags, pfx);
+  os << buf;
+  return os;
+}
+
+
+void
+IData::writeMetricsXML(std::string& buf, uint mBegId, uint mEndId,
 		       int GCC_ATTR_UNUSED oFlags, const char* pfx) const
 {
   bool wasMetricWritten = false;
@@ -110,17 +122,34 @@ IData::writeMetricsXML(std::ostream& os, uint mBegId, uint mEndId,
   }
   mEndId = std::min(numMetrics(), mEndId);
 
+  if (!m_isDense) {
+    for (SparseMetricVec::const_iterator it = sparseLowerBound(mBegId);
+	 it != m_sparse.end() && it->id < mEndId; ++it) {
+      if (it->val != 0.0) {
+	if (!wasMetricWritten) { buf += pfx; }
+	buf += "<M n";
+	xml::AppendAttrNum(buf, it->id);
+	buf += " v";
+	xml::AppendAttrNum(buf, it->val);
+	buf += "/>";
+	wasMetricWritten = true;
+      }
+    }
+    return;
+  }
+
   for (uint i = mBegId; i < mEndId; i++) {
     if (hasMetric(i)) {
       double m = metric(i);
-      os << ((!wasMetricWritten) ? pfx : "");
-      os << "<M " << "n" << xml::MakeAttrNum(i) 
-	 << " v" << xml::MakeAttrNum(m) << "/>";
+      if (!wasMetricWritten) { buf += pfx; }
+      buf += "<M n";
+      xml::AppendAttrNum(buf, i);
+      buf += " v";
+      xml::AppendAttrNum(buf, m);
+      buf += "/>";
       wasMetricWritten = true;
     }
   }
-
-  return os;
 }
 
 
@@ -139,8 +168,206 @@ IData::ddumpMetrics() const
 }
 
 
+void
+IData::insertMetricsBefore(size_t numMetrics)
+{
+  if (m_isDense) {
+    m_metrics.insert(m_metrics.begin(), numMetrics, 0.0);
+  }
+  else {
+    for (SparseMetricVec::iterator it = m_sparse.begin();
+	 it != m_sparse.end(); ++it) {
+      it->id += numMetrics;
+    }
+  }
+  m_size += numMetrics;
+}
+
+
+static bool
+isZeroEntry(const IData::SparseEntry& x)
+{
+  return (x.val == 0.0);
+}
+
+
+double&
+IData::sparseMetric(size_t mId)
+{
+  SparseMetricVec::iterator it = sparseLowerBound(mId);
+  if (it != m_sparse.end() && it->id == mId) {
+    return it->val;
+  }
+
+  if (mId >= m_size) {
+    m_size = mId + 1;
+  }
+
+  // Before growing the sparse vector, reclaim entries that were
+  // created as l-values but still hold zero.
+  if (m_sparse.size() == m_sparse.capacity()) {
+    m_sparse.erase(std::remove_if(m_sparse.begin(), m_sparse.end(),
+				  isZeroEntry), m_sparse.end());
+    it = sparseLowerBound(mId);
+  }
+
+  // Switch to dense storage once it is no larger than sparse storage
+  if ((m_sparse.size() + 1) * sizeof(SparseEntry) > m_size * sizeof(double)) {
+    makeDense();
+    return m_metrics[mId];
+  }
+
+  it = m_sparse.insert(it, SparseEntry(mId, 0.0));
+  return it->val;
+}
+
+
+void
+IData::growDense(size_t size) const
+{
+  // Switch back to sparse storage if it would use at most half the
+  // space of the grown dense vector (hysteresis avoids thrashing).
+  size_t numNonZero = m_metrics.size() - std::count(m_metrics.begin(),
+						    m_metrics.end(), 0.0);
+  if (2 * numNonZero * sizeof(SparseEntry) <= size * sizeof(double)) {
+    makeSparse();
+  }
+  else {
+    m_metrics.resize(size, 0.0 /*value*/); // inserts at end
+  }
+}
+
+
+void
+IData::makeDense() const
+{
+  m_metrics.assign(m_size, 0.0);
+  for (SparseMetricVec::const_iterator it = m_sparse.begin();
+       it != m_sparse.end(); ++it) {
+    m_metrics[it->id] = it->val;
+  }
+  SparseMetricVec().swap(m_sparse);
+  m_isDense = true;
+}
+
+
+void
+IData::makeSparse() const
+{
+  SparseMetricVec sparse;
+  for (uint i = 0; i < m_metrics.size(); ++i) {
+    if (m_metrics[i] != 0.0) {
+      sparse.push_back(SparseEntry(i, m_metrics[i]));
+    }
+  }
+  m_sparse.swap(sparse);
+  MetricVec().swap(m_metrics);
+  m_isDense = false;
+}
+
+
 //***************************************************************************
 
 } // namespace Metric
 } // namespace Prof
 
+
+//***************************************************************************
+// unit test
+//***************************************************************************
+// #define UNIT_TEST_IDATA
+
+#ifdef UNIT_TEST_IDATA
+
+// Memory benchmark: 'numNodes' objects with 'numMetrics' metrics, of
+// which 'numNonZero' are non-zero, as in a wide hpcprof-mpi database.
+// Compares the heap used by IData with a dense vector per node and
+// checks that both hold the same values.
+
+#include <malloc.h>
+#include <cstdlib>
+#include <cassert>
+
+static size_t
+heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  struct mallinfo2 mi = mallinfo2();
+  return mi.uordblks + mi.hblkhd; // N.B.: large blocks are mmap'd
+#else
+  struct mallinfo mi = mallinfo();
+  return (size_t)(unsigned)mi.uordblks + (size_t)(unsigned)mi.hblkhd;
+#endif
+}
+
+int
+main(int argc, char** argv)
+{
+  using Prof::Metric::IData;
+
+  size_t numNodes   = (argc > 1) ? strtoul(argv[1], NULL, 10) : 200000;
+  uint   numMetrics = (argc > 2) ? strtoul(argv[2], NULL, 10) : 128;
+  uint   numNonZero = (argc > 3) ? strtoul(argv[3], NULL, 10) : 4;
+
+  size_t heap0 = heapInUse();
+  std::vector<std::vector<double> >* dense =
+    new std::vector<std::vector<double> >(numNodes);
+  for (size_t i = 0; i < numNodes; ++i) {
+    (*dense)[i].resize(numMetrics, 0.0);
+  }
+  size_t denseBytes = heapInUse() - heap0;
+
+  heap0 = heapInUse();
+  std::vector<IData>* sparse = new std::vector<IData>(numNodes);
+  size_t sparseBytes0 = heapInUse() - heap0;
+
+  // metrics are added a few at a time, as hpcprof does per input file
+  srand(7);
+  for (uint mEnd = 8; mEnd <= numMetrics; mEnd += 8) {
+    for (size_t i = 0; i < numNodes; ++i) {
+      (*sparse)[i].ensureMetricsSize(mEnd);
+    }
+  }
+  for (size_t i = 0; i < numNodes; ++i) {
+    for (uint k = 0; k < numNonZero; ++k) {
+      uint mId = rand() % numMetrics;
+      double x = 1.0 + (rand() % 1000);
+      (*dense)[i][mId] += x;
+      (*sparse)[i].demandMetric(mId) += x;
+    }
+  }
+
+  // an unpack-style pass that stores only non-zeros must not densify
+  for (size_t i = 0; i < numNodes; ++i) {
+    for (uint mId = 0; mId < numMetrics; ++mId) {
+      double x = (*dense)[i][mId];
+      if (x != 0.0 || (*sparse)[i].metricVal(mId) != 0.0) {
+	(*sparse)[i].metric(mId) = x;
+      }
+    }
+  }
+  size_t sparseBytes = heapInUse() - heap0;
+
+  size_t numDense = 0;
+  for (size_t i = 0; i < numNodes; ++i) {
+    const IData& d = (*sparse)[i];
+    assert(d.numMetrics() == numMetrics);
+    for (uint mId = 0; mId < numMetrics; ++mId) {
+      assert(d.metricVal(mId) == (*dense)[i][mId]);
+    }
+    numDense += d.isMetricsDense();
+  }
+
+  std::cout << numNodes << " nodes, " << numMetrics << " metrics, "
+	    << numNonZero << " non-zero each" << std::endl
+	    << "  dense vectors: " << denseBytes << " bytes" << std::endl
+	    << "  IData:         " << sparseBytes << " bytes ("
+	    << sparseBytes0 << " for the objects, " << numDense
+	    << " dense)" << std::endl;
+
+  delete sparse;
+  delete dense;
+  return 0;
+}
+
+#endif
@@ -95,6 +95,20 @@ namespace Metric {
 // Optimized for the two expected common cases:
 //   1. no metrics (hpcstruct's using Prof::Struct::Tree)
 //   2. a known number of metrics (which may then be expanded)
+//
+// Metric values are kept in one of two representations:
+//   - sparse: a vector of (id, value) entries sorted by id, plus the
+//     logical number of metrics.  Absent entries have value 0.0.
+//   - dense: a vector of values indexed by metric id.
+// Objects begin sparse and switch to dense when the sparse entries
+// would no longer save space; a dense object switches back to sparse
+// when it grows and most of its values are zero.
+//
+// N.B.: In sparse mode, the l-value forms of metric() and
+// demandMetric() create an entry if one does not exist.  As with
+// resizing a std::vector, creating an entry (or changing the
+// representation) invalidates references returned by earlier calls
+// on the same object.  Use metricVal() for pure reads.
 //***************************************************************************
 
 class IData {
@@ -102,11 +116,23 @@ public:
   
   typedef std::vector<double> MetricVec;
 
+  struct SparseEntry {
+    SparseEntry(uint id_, double val_)
+      : id(id_), val(val_)
+    { }
+
+    uint   id;
+    double val;
+  };
+
+  typedef std::vector<SparseEntry> SparseMetricVec;
+
 public:
   // --------------------------------------------------------
   // Create/Destroy
   // --------------------------------------------------------
   IData(size_t size = 0)
+    : m_size(0), m_isDense(false)
   {
     ensureMetricsSize(size);
   }
@@ -116,7 +142,8 @@ public:
   }
   
   IData(const IData& x)
-    : m_metrics(x.m_metrics)
+    : m_metrics(x.m_metrics), m_sparse(x.m_sparse),
+      m_size(x.m_size), m_isDense(x.m_isDense)
   {
   }
   
@@ -124,6 +151,9 @@ public:
   operator=(const IData& x)
   {
     m_metrics = x.m_metrics;
+    m_sparse  = x.m_sparse;
+    m_size    = x.m_size;
+    m_isDense = x.m_isDense;
     return *this;
   }
 
@@ -142,6 +172,16 @@ public:
     }
     mEndId = std::min(numMetrics(), mEndId);
 
+    if (!m_isDense) {
+      for (SparseMetricVec::const_iterator it = sparseLowerBound(mBegId);
+	   it != m_sparse.end() && it->id < mEndId; ++it) {
+	if (it->val != 0.0) {
+	  return true;
+	}
+      }
+      return false;
+    }
+
     for (uint i = mBegId; i < mEndId; ++i) {
       if (hasMetric(i)) {
 	return true;
@@ -152,20 +192,37 @@ public:
 
   bool
   hasMetric(size_t mId) const
-  { return (m_metrics[mId] != 0.0); }
+  { return (metric(mId) != 0.0); }
 
   bool
   hasMetricSlow(size_t mId) const
-  { return (mId < m_metrics.size() && hasMetric(mId)); }
+  { return (mId < numMetrics() && hasMetric(mId)); }
 
 
   double
   metric(size_t mId) const
-  { return m_metrics[mId]; }
+  {
+    if (m_isDense) {
+      return m_metrics[mId];
+    }
+    SparseMetricVec::const_iterator it = sparseLowerBound(mId);
+    return (it != m_sparse.end() && it->id == mId) ? it->val : 0.0;
+  }
 
   double&
   metric(size_t mId)
-  { return m_metrics[mId]; }
+  {
+    if (m_isDense) {
+      return m_metrics[mId];
+    }
+    return sparseMetric(mId);
+  }
+
+  // metricVal: r-value of metric 'mId' that never creates storage
+  // (cf. the l-value form of metric()); 0.0 if 'mId' is out of range
+  double
+  metricVal(size_t mId) const
+  { return (mId < numMetrics()) ? metric(mId) : 0.0; }
 
 
   double
@@ -190,6 +247,10 @@ public:
   void
   zeroMetrics(uint mBegId, uint mEndId)
   {
+    if (!m_isDense) {
+      m_sparse.erase(sparseLowerBound(mBegId), sparseLowerBound(mEndId));
+      return;
+    }
     for (uint i = mBegId; i < mEndId; ++i) {
       metric(i) = 0.0;
     }
@@ -199,26 +260,36 @@ public:
   void
   clearMetrics()
   {
-    m_metrics.clear();;
+    m_metrics.clear();
+    m_sparse.clear();
+    m_size = 0;
+    m_isDense = false;
   }
 
-  // ensureMetricsSize: ensures a vector of the requested size exists
+  // ensureMetricsSize: ensures space for the requested number of
+  // metrics exists
   void
   ensureMetricsSize(size_t size) const
   {
-    if (size > m_metrics.size())
-      m_metrics.resize(size, 0.0 /*value*/); // inserts at end
+    if (size > m_size) {
+      if (m_isDense) {
+	growDense(size);
+      }
+      m_size = size;
+    }
   }
 
   void
-  insertMetricsBefore(size_t numMetrics) 
-  {
-    m_metrics.insert(m_metrics.begin(), numMetrics, 0.0);
-  }
+  insertMetricsBefore(size_t numMetrics);
   
   uint
   numMetrics() const
-  { return m_metrics.size(); }
+  { return m_size; }
+
+  // isMetricsDense: whether the dense representation is in use
+  bool
+  isMetricsDense() const
+  { return m_isDense; }
 
 
   // --------------------------------------------------------
@@ -236,6 +307,13 @@ public:
 		  uint mEndId = Metric::IData::npos,
 		  int oFlags = 0, const char* pfx = "") const;
 
+  // writeMetricsXML: same, but appends to 'buf'
+  void
+  writeMetricsXML(std::string& buf,
+		  uint mBegId = Metric::IData::npos,
+		  uint mEndId = Metric::IData::npos,
+		  int oFlags = 0, const char* pfx = "") const;
+
 
   std::ostream&
   dumpMetrics(std::ostream& os = std::cerr, int oFlags = 0,
@@ -244,9 +322,38 @@ public:
   void
   ddumpMetrics() const;
 
-  
+
+private:
+  static bool
+  sparseLt(const SparseEntry& x, size_t mId)
+  { return (x.id < mId); }
+
+  SparseMetricVec::const_iterator
+  sparseLowerBound(size_t mId) const
+  { return std::lower_bound(m_sparse.begin(), m_sparse.end(), mId, sparseLt); }
+
+  SparseMetricVec::iterator
+  sparseLowerBound(size_t mId)
+  { return std::lower_bound(m_sparse.begin(), m_sparse.end(), mId, sparseLt); }
+
+  double&
+  sparseMetric(size_t mId);
+
+  void
+  growDense(size_t size) const;
+
+  void
+  makeDense() const;
+
+  void
+  makeSparse() const;
+
 private:
+  // N.B.: exactly one of m_metrics (dense) and m_sparse is in use
   mutable MetricVec m_metrics;
+  mutable SparseMetricVec m_sparse;
+  mutable size_t m_size;
+  mutable bool m_isDense;
 };
 
 //***************************************************************************
@@ -701,9 +701,14 @@ ANode::aggregateMetrics(uint mBegId, uint mEndId)
   for (ANode* n = NULL; (n = it.current()); ++it) {
     ANode* n_parent = n->parent();
     if (n != root) {
+      n->ensureMetricsSize(mEndId);
+      n_parent->ensureMetricsSize(mEndId);
+
       for (uint mId = mBegId; mId < mEndId; ++mId) {
-	double mVal = n->demandMetric(mId, mEndId/*size*/);
-	n_parent->demandMetric(mId, mEndId/*size*/) += mVal;
+	double mVal = n->metricVal(mId);
+	if (mVal != 0.0) {
+	  n_parent->metric(mId) += mVal;
+	}
       }
     }
   }
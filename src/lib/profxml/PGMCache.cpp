@@ -0,0 +1,629 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Binary cache of a program structure file (PGM)
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************ System Include Files ******************************
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+using std::string;
+
+#include <vector>
+
+//************************* User Include Files *******************************
+
+#include "PGMCache.hpp"
+
+#include <lib/prof-lean/hpcio.h>
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/StrUtil.hpp>
+
+//************************ Forward Declarations ******************************
+
+static const char PGMCache_Magic[]   = "HPCPROF-structbin_"; // 18 bytes
+static const char PGMCache_Version[] = "01.01";              // 5 bytes
+static const char PGMCache_Endian[]  = "b";                  // 1 byte
+
+#define PGMCache_TagLen  (sizeof(PGMCache_Magic) - 1 \
+			  + sizeof(PGMCache_Version) - 1 \
+			  + sizeof(PGMCache_Endian) - 1)
+
+// tag, 7 x u4, then VMA intervals
+#define PGMCache_RecMin  (1 + 7 * 4)
+
+// seconds after which another process' temporary is taken as abandoned
+#define PGMCache_TmpStale  (600)
+
+#define PGMCache_EndTag  (0x80)
+#define PGMCache_IdStr   (0x80000000u)
+
+struct PGMCache_hdr_t {
+  uint64_t xmlSize;
+  uint64_t xmlMtimeSec;
+  uint64_t xmlMtimeNsec;
+  uint64_t recOff;
+  uint64_t recLen;
+  uint64_t strOff;
+  uint32_t numStr;
+  uint64_t sum;
+};
+
+#define PGMCache_HdrLen  (PGMCache_TagLen + 6 * 8 + 4 + 8)
+
+#define PGMCache_SumInit  (0xcbf29ce484222325ull)
+
+//****************************************************************************
+
+string
+PGMCache_fnm(const char* xmlFnm)
+{
+  return string(xmlFnm) + ".bin";
+}
+
+
+static bool
+xmlStat(const char* xmlFnm, PGMCache_hdr_t& hdr)
+{
+  struct stat st;
+  if (stat(xmlFnm, &st) != 0) {
+    return false;
+  }
+  hdr.xmlSize      = st.st_size;
+  hdr.xmlMtimeSec  = st.st_mtim.tv_sec;
+  hdr.xmlMtimeNsec = st.st_mtim.tv_nsec;
+  return true;
+}
+
+
+// Returns the value + 1 of 'x' if it is a plain decimal integer that
+// fits, else 0.
+static uint32_t
+idToNum(const string& x)
+{
+  size_t len = x.size();
+  if (len == 0 || len > 9 || (x[0] == '0' && len > 1)) {
+    return 0;
+  }
+  uint32_t val = 0;
+  for (size_t i = 0; i < len; ++i) {
+    if (x[i] < '0' || x[i] > '9') {
+      return 0;
+    }
+    val = val * 10 + (x[i] - '0');
+  }
+  return val + 1;
+}
+
+
+// PGMCache_sum: Continues the checksum 'sum' (FNV-1a) over 'len' bytes.
+static uint64_t
+PGMCache_sum(uint64_t sum, const unsigned char* x, size_t len)
+{
+  for (size_t i = 0; i < len; ++i) {
+    sum = (sum ^ x[i]) * 0x100000001b3ull;
+  }
+  return sum;
+}
+
+
+//****************************************************************************
+// PGMCacheWriter
+//****************************************************************************
+
+PGMCacheWriter::PGMCacheWriter(const char* xmlFnm)
+  : m_fs(NULL), m_tmpIno(0), m_recLen(0), m_sum(PGMCache_SumInit)
+{
+  static const string empty;
+  m_strs.push_back(&empty);
+
+  if (!xmlFnm) {
+    return;
+  }
+  m_xmlFnm = xmlFnm;
+
+  // N.B.: ranks of hpcprof-mpi may race to create the cache.  The
+  // temporary is created exclusively, so only the first writes it and
+  // the others just parse the XML.  A temporary left behind by a
+  // process that died is taken over once it is stale.
+  m_tmpFnm = PGMCache_fnm(xmlFnm) + ".tmp";
+  int fd = open(m_tmpFnm.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+  struct stat st;
+  if (fd < 0 && errno == EEXIST && stat(m_tmpFnm.c_str(), &st) == 0
+      && time(NULL) - st.st_mtime > PGMCache_TmpStale) {
+    unlink(m_tmpFnm.c_str());
+    fd = open(m_tmpFnm.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+  }
+  if (fd >= 0 && fstat(fd, &st) != 0) {
+    close(fd);
+    unlink(m_tmpFnm.c_str());
+    fd = -1;
+  }
+  if (fd < 0) {
+    DIAG_Msg(2, "Cannot create structure cache '" << m_tmpFnm << "'");
+    return;
+  }
+  m_tmpIno = st.st_ino;
+
+  m_fs = fdopen(fd, "w");
+  if (!m_fs) {
+    close(fd);
+    unlink(m_tmpFnm.c_str());
+    return;
+  }
+
+  // placeholder header, rewritten by finish()
+  char hdr[PGMCache_HdrLen];
+  memset(hdr, 0, sizeof(hdr));
+  if (fwrite(hdr, 1, sizeof(hdr), m_fs) != sizeof(hdr)) {
+    discard();
+  }
+}
+
+
+PGMCacheWriter::~PGMCacheWriter()
+{
+  discard();
+}
+
+
+void
+PGMCacheWriter::startElem(const PGMDocHandler::Elem& elem)
+{
+  if (!m_fs) {
+    return;
+  }
+
+  uint32_t id = idToNum(elem.id);
+  if (id == 0 && !elem.id.empty()) {
+    id = PGMCache_IdStr | intern(elem.id);
+  }
+
+  put1(elem.ty);
+  put4(intern(elem.name));
+  put4(intern(elem.lnName));
+  put4(intern(elem.file));
+  put4(id);
+  put4(elem.begLn);
+  put4(elem.endLn);
+  put4(elem.vma.size());
+  for (VMAIntervalSet::const_iterator it = elem.vma.begin();
+       it != elem.vma.end(); ++it) {
+    put8(it->beg());
+    put8(it->end());
+  }
+  m_recLen += PGMCache_RecMin + 16 * elem.vma.size();
+}
+
+
+void
+PGMCacheWriter::endElem(PGMDocHandler::Elem_t ty)
+{
+  if (!m_fs) {
+    return;
+  }
+  put1(PGMCache_EndTag | ty);
+  m_recLen += 1;
+}
+
+
+void
+PGMCacheWriter::finish()
+{
+  if (!m_fs) {
+    return;
+  }
+
+  PGMCache_hdr_t hdr;
+  if (!xmlStat(m_xmlFnm.c_str(), hdr)) {
+    discard();
+    return;
+  }
+  hdr.recOff = PGMCache_HdrLen;
+  hdr.recLen = m_recLen;
+  hdr.strOff = hdr.recOff + hdr.recLen;
+  hdr.numStr = m_strs.size();
+
+  for (uint32_t i = 0; i < m_strs.size(); ++i) {
+    const string& x = *m_strs[i];
+    put4(x.size());
+    putBytes(x.data(), x.size());
+  }
+
+  hdr.sum = m_sum;
+
+  rewind(m_fs);
+  fwrite(PGMCache_Magic, 1, sizeof(PGMCache_Magic) - 1, m_fs);
+  fwrite(PGMCache_Version, 1, sizeof(PGMCache_Version) - 1, m_fs);
+  fwrite(PGMCache_Endian, 1, sizeof(PGMCache_Endian) - 1, m_fs);
+  put8(hdr.xmlSize);
+  put8(hdr.xmlMtimeSec);
+  put8(hdr.xmlMtimeNsec);
+  put8(hdr.recOff);
+  put8(hdr.recLen);
+  put8(hdr.strOff);
+  put4(hdr.numStr);
+  put8(hdr.sum);
+
+  bool ok = !ferror(m_fs);
+  ok = (fclose(m_fs) == 0) && ok;
+  m_fs = NULL;
+
+  string fnm = PGMCache_fnm(m_xmlFnm.c_str());
+  if (!ok || !ownsTmp() || rename(m_tmpFnm.c_str(), fnm.c_str()) != 0) {
+    DIAG_Msg(2, "Cannot write structure cache '" << fnm << "'");
+    if (ownsTmp()) {
+      unlink(m_tmpFnm.c_str());
+    }
+  }
+}
+
+
+uint32_t
+PGMCacheWriter::intern(const string& x)
+{
+  if (x.empty()) {
+    return 0;
+  }
+  std::pair<std::unordered_map<string, uint32_t>::iterator, bool> ret =
+    m_strIdx.insert(std::make_pair(x, (uint32_t)m_strs.size()));
+  if (ret.second) {
+    m_strs.push_back(&ret.first->first);
+  }
+  return ret.first->second;
+}
+
+
+void
+PGMCacheWriter::put1(uint8_t x)
+{
+  putBytes(&x, 1);
+}
+
+
+void
+PGMCacheWriter::put4(uint32_t x)
+{
+  unsigned char buf[4];
+  hpcio_be4_mwrite(buf, x);
+  putBytes(buf, 4);
+}
+
+
+void
+PGMCacheWriter::put8(uint64_t x)
+{
+  put4((uint32_t)(x >> 32));
+  put4((uint32_t)x);
+}
+
+
+void
+PGMCacheWriter::putBytes(const void* x, size_t len)
+{
+  fwrite(x, 1, len, m_fs);
+  m_sum = PGMCache_sum(m_sum, (const unsigned char*)x, len);
+}
+
+
+void
+PGMCacheWriter::discard()
+{
+  if (m_fs) {
+    fclose(m_fs);
+    m_fs = NULL;
+    if (ownsTmp()) {
+      unlink(m_tmpFnm.c_str());
+    }
+  }
+}
+
+
+// ownsTmp: Returns true unless the temporary has been taken over by
+// another process (cf. PGMCache_TmpStale).
+bool
+PGMCacheWriter::ownsTmp()
+{
+  struct stat st;
+  return (stat(m_tmpFnm.c_str(), &st) == 0 && st.st_ino == m_tmpIno);
+}
+
+
+//****************************************************************************
+// PGMCache_read
+//****************************************************************************
+
+// decodeRec: Decodes the record at 'p' into 'elem' (unless NULL) and
+// advances 'p' past it.  Returns false if the record is malformed.
+static bool
+decodeRec(const unsigned char*& p, const unsigned char* recEnd,
+	  const std::vector<string>& strs, PGMDocHandler::Elem* elem,
+	  bool& isEnd)
+{
+  uint tag = *p;
+  isEnd = (tag & PGMCache_EndTag);
+  tag &= ~PGMCache_EndTag;
+  if (tag > PGMDocHandler::Elem_Group) {
+    return false;
+  }
+
+  if (isEnd) {
+    p += 1;
+    if (elem) {
+      elem->ty = (PGMDocHandler::Elem_t)tag;
+    }
+    return true;
+  }
+
+  if (recEnd - p < PGMCache_RecMin) {
+    return false;
+  }
+  p += 1;
+
+  uint32_t name   = hpcio_be4_mread(p);      p += 4;
+  uint32_t lnName = hpcio_be4_mread(p);      p += 4;
+  uint32_t file   = hpcio_be4_mread(p);      p += 4;
+  uint32_t id     = hpcio_be4_mread(p);      p += 4;
+  uint32_t begLn  = hpcio_be4_mread(p);      p += 4;
+  uint32_t endLn  = hpcio_be4_mread(p);      p += 4;
+  uint32_t numVMA = hpcio_be4_mread(p);      p += 4;
+
+  uint32_t idStr = (id & PGMCache_IdStr) ? (id & ~PGMCache_IdStr) : 0;
+  if (name >= strs.size() || lnName >= strs.size()
+      || file >= strs.size() || idStr >= strs.size()
+      || (size_t)(recEnd - p) / 16 < numVMA) {
+    return false;
+  }
+
+  if (!elem) {
+    p += 16 * (size_t)numVMA;
+    return true;
+  }
+
+  elem->clear();
+  elem->ty     = (PGMDocHandler::Elem_t)tag;
+  elem->name   = strs[name];
+  elem->lnName = strs[lnName];
+  elem->file   = strs[file];
+  elem->begLn  = begLn;
+  elem->endLn  = endLn;
+  if (id & PGMCache_IdStr) {
+    elem->id = strs[idStr];
+  }
+  else if (id != 0) {
+    elem->id = StrUtil::toStr((unsigned)(id - 1));
+  }
+
+  for (uint32_t i = 0; i < numVMA; ++i) {
+    VMA vbeg = hpcio_be8_mread(p);  p += 8;
+    VMA vend = hpcio_be8_mread(p);  p += 8;
+    elem->vma.insert(vbeg, vend);
+  }
+  return true;
+}
+
+
+// validRecs: Returns true if the records are well formed and every end
+// tag closes the innermost open element.
+static bool
+validRecs(const unsigned char* p, const unsigned char* recEnd,
+	  const std::vector<string>& strs)
+{
+  std::vector<uint> open;
+  while (p < recEnd) {
+    uint tag = *p;
+    bool isEnd;
+    if (!decodeRec(p, recEnd, strs, NULL, isEnd)) {
+      return false;
+    }
+    if (!isEnd) {
+      open.push_back(tag);
+    }
+    else if (open.empty() || (open.back() | PGMCache_EndTag) != tag) {
+      return false;
+    }
+    else {
+      open.pop_back();
+    }
+  }
+  return open.empty();
+}
+
+
+bool
+PGMCache_read(const char* xmlFnm, PGMDocHandler& handler)
+{
+  string fnm = PGMCache_fnm(xmlFnm);
+
+  PGMCache_hdr_t xml;
+  if (!xmlStat(xmlFnm, xml)) {
+    return false;
+  }
+
+  int fd = open(fnm.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < PGMCache_HdrLen) {
+    close(fd);
+    return false;
+  }
+  size_t len = st.st_size;
+
+  void* addr = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  madvise(addr, len, MADV_SEQUENTIAL);
+
+  const unsigned char* beg = (const unsigned char*)addr;
+  const unsigned char* end = beg + len;
+
+  // -------------------------------------------------------
+  // header: ignore the cache if it is stale or of another version
+  // -------------------------------------------------------
+  const unsigned char* p = beg;
+  bool ok = (memcmp(p, PGMCache_Magic, sizeof(PGMCache_Magic) - 1) == 0);
+  p += sizeof(PGMCache_Magic) - 1;
+  ok = ok && (memcmp(p, PGMCache_Version, sizeof(PGMCache_Version) - 1) == 0);
+  p += sizeof(PGMCache_Version) - 1;
+  ok = ok && (memcmp(p, PGMCache_Endian, sizeof(PGMCache_Endian) - 1) == 0);
+  p += sizeof(PGMCache_Endian) - 1;
+
+  PGMCache_hdr_t hdr;
+  hdr.xmlSize      = hpcio_be8_mread(p);  p += 8;
+  hdr.xmlMtimeSec  = hpcio_be8_mread(p);  p += 8;
+  hdr.xmlMtimeNsec = hpcio_be8_mread(p);  p += 8;
+  hdr.recOff       = hpcio_be8_mread(p);  p += 8;
+  hdr.recLen       = hpcio_be8_mread(p);  p += 8;
+  hdr.strOff       = hpcio_be8_mread(p);  p += 8;
+  hdr.numStr       = hpcio_be4_mread(p);  p += 4;
+  hdr.sum          = hpcio_be8_mread(p);  p += 8;
+
+  ok = ok && (hdr.xmlSize == xml.xmlSize
+	      && hdr.xmlMtimeSec == xml.xmlMtimeSec
+	      && hdr.xmlMtimeNsec == xml.xmlMtimeNsec);
+  ok = ok && (hdr.recOff == PGMCache_HdrLen
+	      && hdr.strOff == hdr.recOff + hdr.recLen
+	      && hdr.strOff <= len);
+  if (!ok) {
+    munmap(addr, len);
+    DIAG_Msg(2, "Ignoring stale structure cache '" << fnm << "'");
+    return false;
+  }
+
+  if (PGMCache_sum(PGMCache_SumInit, beg + hdr.recOff, len - hdr.recOff)
+      != hdr.sum) {
+    munmap(addr, len);
+    DIAG_Msg(2, "Ignoring corrupt structure cache '" << fnm << "'");
+    return false;
+  }
+
+  // -------------------------------------------------------
+  // strings (validated before anything is added to the tree)
+  // -------------------------------------------------------
+  std::vector<string> strs;
+  strs.reserve(hdr.numStr);
+  p = beg + hdr.strOff;
+  for (uint32_t i = 0; i < hdr.numStr; ++i) {
+    if (end - p < 4) {
+      break;
+    }
+    uint32_t slen = hpcio_be4_mread(p);
+    p += 4;
+    if ((size_t)(end - p) < slen) {
+      break;
+    }
+    strs.push_back(string((const char*)p, slen));
+    p += slen;
+  }
+  if (strs.size() != hdr.numStr || p != end || hdr.numStr == 0) {
+    munmap(addr, len);
+    DIAG_Msg(2, "Ignoring invalid structure cache '" << fnm << "'");
+    return false;
+  }
+
+  // -------------------------------------------------------
+  // records: the whole stream is checked before the first element
+  // reaches 'handler', so that a corrupt cache leaves the tree alone
+  // and the caller can fall back to the XML
+  // -------------------------------------------------------
+  const unsigned char* recEnd = beg + hdr.strOff;
+  if (!validRecs(beg + hdr.recOff, recEnd, strs)) {
+    munmap(addr, len);
+    DIAG_Msg(2, "Ignoring corrupt structure cache '" << fnm << "'");
+    return false;
+  }
+
+  DIAG_Msg(2, "Reading structure cache '" << fnm << "'");
+
+  PGMDocHandler::Elem elem;
+  p = beg + hdr.recOff;
+
+  try {
+    while (p < recEnd) {
+      bool isEnd;
+      decodeRec(p, recEnd, strs, &elem, isEnd);
+      if (isEnd) {
+	handler.endElem(elem.ty);
+      }
+      else {
+	handler.startElem(elem);
+      }
+    }
+  }
+  catch (...) {
+    munmap(addr, len);
+    throw;
+  }
+
+  munmap(addr, len);
+  return true;
+}
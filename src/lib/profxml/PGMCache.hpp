@@ -0,0 +1,172 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Binary cache of a program structure file (PGM)
+//
+// Description:
+//   A PGMCache file is a compact image of the element stream of a
+//   STRUCTURE file, kept next to it as '<file>.bin'.  Replaying the
+//   image through PGMDocHandler builds the same Struct::Tree as
+//   parsing the XML, without Xerces.
+//
+//   Layout (big-endian):
+//     header:  magic, version, endian (24 bytes)
+//              XML size, XML mtime (sec, nsec)
+//              offset/length of records, offset/count of strings
+//              u8 checksum (FNV-1a) of the records and strings
+//     records: u1 tag: element type, or 0x80 | type for an end tag
+//              start tags continue with
+//                u4 name, u4 lnName, u4 file  (string index; 0 = "")
+//                u4 id  (value + 1 if a plain integer; else
+//                        0x80000000 | string index; 0 = "")
+//                u4 begLn, u4 endLn
+//                u4 n, n x (u8 beg, u8 end)   (VMA intervals)
+//     strings: u4 length, bytes
+//
+//   The image is ignored unless the XML's size and mtime match, and
+//   it is checked in full before it is replayed, so that a corrupt
+//   image is ignored too.
+//
+//***************************************************************************
+
+#ifndef profxml_PGMCache_hpp
+#define profxml_PGMCache_hpp
+
+//************************ System Include Files ******************************
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//************************* User Include Files *******************************
+
+#include "PGMDocHandler.hpp"
+
+//************************ Forward Declarations ******************************
+
+//****************************************************************************
+
+// PGMCacheWriter: Records the elements of 'xmlFnm' as they are parsed
+// into a temporary file, which finish() completes and renames into
+// place.  If 'xmlFnm' is NULL or the cache cannot be created (e.g.,
+// the directory is not writable, or another process is writing it),
+// the writer quietly does nothing.
+class PGMCacheWriter {
+public:
+  PGMCacheWriter(const char* xmlFnm);
+  ~PGMCacheWriter();
+
+  bool
+  isOpen() const
+  { return (m_fs != NULL); }
+
+  void
+  startElem(const PGMDocHandler::Elem& elem);
+
+  void
+  endElem(PGMDocHandler::Elem_t ty);
+
+  // finish: Complete the cache after a successful parse.
+  void
+  finish();
+
+private:
+  uint32_t
+  intern(const std::string& x);
+
+  void
+  put1(uint8_t x);
+
+  void
+  put4(uint32_t x);
+
+  void
+  put8(uint64_t x);
+
+  void
+  putBytes(const void* x, size_t len);
+
+  void
+  discard();
+
+  bool
+  ownsTmp();
+
+private:
+  std::string m_xmlFnm;
+  std::string m_tmpFnm;
+  FILE* m_fs;
+  ino_t m_tmpIno;
+  uint64_t m_recLen;
+  uint64_t m_sum; // of what follows the header
+
+  std::unordered_map<std::string, uint32_t> m_strIdx;
+  std::vector<const std::string*> m_strs; // by index (0 is "")
+};
+
+
+// PGMCache_read: If 'xmlFnm' has a valid cache, replay it through
+// 'handler' and return true; otherwise (no cache, or a stale or
+// corrupt one) return false without touching 'handler'.
+bool
+PGMCache_read(const char* xmlFnm, PGMDocHandler& handler);
+
+std::string
+PGMCache_fnm(const char* xmlFnm);
+
+//****************************************************************************
+
+#endif // profxml_PGMCache_hpp
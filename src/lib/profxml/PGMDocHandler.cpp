@@ -83,6 +83,7 @@ using XERCES_CPP_NAMESPACE::XMLString;
 #include "XercesSAX2.hpp"
 #include "XercesUtil.hpp"
 #include "XercesErrorHandler.hpp"
+#include "PGMCache.hpp"
 
 #include <lib/prof/Struct-Tree.hpp>
 using namespace Prof;
@@ -207,6 +208,7 @@ PGMDocHandler::PGMDocHandler(Doc_t ty,
   : m_docty(ty),
     m_args(args),
     m_structure(structure),
+    m_cacheWriter(NULL),
 
     // element names
     elemStructure(XMLString::transcode("HPCToolkitStructure")),
@@ -268,12 +270,134 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
 			    const XMLCh* const GCC_ATTR_UNUSED qname,
 			    const XERCES_CPP_NAMESPACE::Attributes& attributes)
 {
-  Struct::ANode* curStrct = NULL;
+  Elem& elem = m_elem;
+  elem.clear();
 
   // Structure
   if (XMLString::equals(name, elemStructure)) {
-    string verStr = getAttr(attributes, attrVer);
-    double ver = StrUtil::toDbl(verStr);
+    elem.ty = Elem_Structure;
+    elem.name = getAttr(attributes, attrVer);
+  }
+
+  // Load Module
+  else if (XMLString::equals(name, elemLM)) {
+    elem.ty = Elem_LM;
+    elem.name = getAttr(attributes, attrName); // must exist
+  }
+
+  // File
+  else if (XMLString::equals(name, elemFile)) {
+    elem.ty = Elem_File;
+    elem.name = getAttr(attributes, attrName);
+  }
+
+  // Proc
+  else if (XMLString::equals(name, elemProc)) {
+    elem.ty = Elem_Proc;
+    elem.name   = getAttr(attributes, attrName);   // must exist
+    elem.lnName = getAttr(attributes, attrLnName); // optional
+    elem.id     = getAttr(attributes, attrId);     // ID: must exist
+    getLineAttr(elem.begLn, elem.endLn, attributes);
+    elem.vma.fromString(getAttr(attributes, attrVMA).c_str());
+  }
+
+  // Alien
+  else if (XMLString::equals(name, elemAlien)) {
+    int numAttr = attributes.getLength();
+    DIAG_Assert(0 <= numAttr && numAttr <= 6, DIAG_UnexpectedInput);
+
+    elem.ty = Elem_Alien;
+    elem.name   = getAttr(attributes, attrName);
+    elem.lnName = getAttr(attributes, attrLnName);
+    elem.file   = getAttr(attributes, attrFile);
+    elem.id     = getAttr(attributes, attrId);
+    getLineAttr(elem.begLn, elem.endLn, attributes);
+  }
+
+  // Loop
+  else if (XMLString::equals(name, elemLoop)) {
+    // both 'begin' and 'end' are implied (and can be in any order)
+    int numAttr = attributes.getLength();
+    DIAG_Assert(0 <= numAttr && numAttr <= 5, DIAG_UnexpectedInput);
+
+    elem.ty = Elem_Loop;
+    elem.file = getAttr(attributes, attrFile);
+    elem.id   = getAttr(attributes, attrId);
+    getLineAttr(elem.begLn, elem.endLn, attributes);
+  }
+
+  // Stmt
+  else if (XMLString::equals(name, elemStmt)) {
+    // 'begin' is required but 'end' is implied (and can be in any order)
+    int numAttr = attributes.getLength();
+    DIAG_Assert(1 <= numAttr && numAttr <= 4, DIAG_UnexpectedInput);
+
+    elem.ty = Elem_Stmt;
+    elem.id = getAttr(attributes, attrId);
+    getLineAttr(elem.begLn, elem.endLn, attributes);
+    elem.vma.fromString(getAttr(attributes, attrVMA).c_str());
+  }
+
+  // Group
+  else if (XMLString::equals(name, elemGroup)) {
+    elem.ty = Elem_Group;
+    elem.name = getAttr(attributes, attrName); // must exist
+  }
+
+  if (m_cacheWriter) {
+    m_cacheWriter->startElem(elem);
+  }
+  startElem(elem);
+}
+
+
+void
+PGMDocHandler::endElement(const XMLCh* const GCC_ATTR_UNUSED uri,
+			  const XMLCh* const name,
+			  const XMLCh* const GCC_ATTR_UNUSED qname)
+{
+  Elem_t ty = Elem_NULL;
+
+  if (XMLString::equals(name, elemStructure)) {
+    ty = Elem_Structure;
+  }
+  else if (XMLString::equals(name, elemLM)) {
+    ty = Elem_LM;
+  }
+  else if (XMLString::equals(name, elemFile)) {
+    ty = Elem_File;
+  }
+  else if (XMLString::equals(name, elemProc)) {
+    ty = Elem_Proc;
+  }
+  else if (XMLString::equals(name, elemAlien)) {
+    ty = Elem_Alien;
+  }
+  else if (XMLString::equals(name, elemLoop)) {
+    ty = Elem_Loop;
+  }
+  else if (XMLString::equals(name, elemStmt)) {
+    ty = Elem_Stmt;
+  }
+  else if (XMLString::equals(name, elemGroup)) {
+    ty = Elem_Group;
+  }
+
+  if (m_cacheWriter) {
+    m_cacheWriter->endElem(ty);
+  }
+  endElem(ty);
+}
+
+
+void
+PGMDocHandler::startElem(const Elem& elem)
+{
+  Struct::ANode* curStrct = NULL;
+
+  // Structure
+  if (elem.ty == Elem_Structure) {
+    double ver = StrUtil::toDbl(elem.name);
 
     m_version = ver;
     if (m_version < 4.5) {
@@ -287,11 +411,10 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
   }
 
   // Load Module
-  else if (XMLString::equals(name, elemLM)) {
-    string nm = getAttr(attributes, attrName); // must exist
+  else if (elem.ty == Elem_LM) {
     DIAG_Assert(m_curRoot && !m_curLM, "Parse error!");
 
-    nm = m_args.realpath(nm);
+    string nm = m_args.realpath(elem.name);
     m_curLM = Prof::Struct::LM::demand(m_curRoot, nm);
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << m_curLM->toStringMe());
 
@@ -302,11 +425,10 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
   }
 
   // File
-  else if (XMLString::equals(name, elemFile)) {
-    string nm = getAttr(attributes, attrName);
+  else if (elem.ty == Elem_File) {
     DIAG_Assert(m_curLM && !m_curFile, "Parse error!");
 
-    nm = m_args.realpath(nm);
+    string nm = m_args.realpath(elem.name);
     m_curFile = Struct::File::demand(m_curLM, nm);
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << m_curFile->toStringMe());
 
@@ -316,16 +438,8 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
   }
 
   // Proc
-  else if (XMLString::equals(name, elemProc)) {
-    string nm  = getAttr(attributes, attrName);   // must exist
-    string lnm = getAttr(attributes, attrLnName); // optional
-    string id  = getAttr(attributes, attrId); 	  // ID: must exist
-
-    SrcFile::ln begLn, endLn;
-    getLineAttr(begLn, endLn, attributes);
-
-    string vma = getAttr(attributes, attrVMA);
-    string node_id = getAttr(attributes, attrId);
+  else if (elem.ty == Elem_Proc) {
+    const string& nm = elem.name;
 
     DIAG_Assert(m_curLM && m_curFile && !m_curProc, "Parse error: Support for nested procedures is disabled (cf. buildLMSkeleton())!");
 
@@ -340,17 +454,18 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
       // STRUCTURE files usually have qualifying VMA information.
       // Assume that VMA information fully qualifies procedures.
       if (m_docty == Doc_STRUCT
-	  && !m_curProc->vmaSet().empty() && !vma.empty()) {
+	  && !m_curProc->vmaSet().empty() && !elem.vma.empty()) {
 	m_curProc = NULL;
       }
     }
 
     if (!m_curProc) {
-      m_curProc = new Struct::Proc(nm, m_curFile, lnm, false, begLn, endLn);
-      if (!vma.empty()) {
-	m_curProc->vmaSet().fromString(vma.c_str());
+      m_curProc = new Struct::Proc(nm, m_curFile, elem.lnName, false,
+				   elem.begLn, elem.endLn);
+      if (!elem.vma.empty()) {
+	m_curProc->vmaSet().merge(elem.vma);
       }
-      m_curProc->m_origId = atoi(node_id.c_str());
+      m_curProc->m_origId = atoi(elem.id.c_str());
     }
     else {
       if (m_docty == Doc_STRUCT) {
@@ -362,28 +477,19 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << m_curProc->toStringMe());
 
     curStrct = m_curProc;
-    PGMDocHandler::idToProcMap[id] = (Prof::Struct::Proc*) m_curProc;
+    PGMDocHandler::idToProcMap[elem.id] = (Prof::Struct::Proc*) m_curProc;
   }
 
   // Alien
-  else if (XMLString::equals(name, elemAlien)) {
-    int numAttr = attributes.getLength();
-    DIAG_Assert(0 <= numAttr && numAttr <= 6, DIAG_UnexpectedInput);
-
-    string nm  = getAttr(attributes, attrName);
-    string ln  = getAttr(attributes, attrLnName);
-    string fnm = getAttr(attributes, attrFile);
-    fnm = m_args.realpath(fnm);
-
-    SrcFile::ln begLn, endLn;
-    getLineAttr(begLn, endLn, attributes);
+  else if (elem.ty == Elem_Alien) {
+    string fnm = m_args.realpath(elem.file);
 
     Struct::ACodeNode* parent = dynamic_cast<Struct::ACodeNode*>(getCurrentScope());
-    Struct::Alien* alien = new Struct::Alien(parent, fnm, nm, nm, begLn, endLn);
-    alien->proc( idToProcMap[ln] );
+    Struct::Alien* alien = new Struct::Alien(parent, fnm, elem.name, elem.name,
+					     elem.begLn, elem.endLn);
+    alien->proc( idToProcMap[elem.lnName] );
 
-    string node_id = getAttr(attributes, attrId);
-    alien->m_origId = atoi(node_id.c_str());
+    alien->m_origId = atoi(elem.id.c_str());
 
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << alien->toStringMe());
 
@@ -391,25 +497,17 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
   }
 
   // Loop
-  else if (XMLString::equals(name, elemLoop)) {
+  else if (elem.ty == Elem_Loop) {
     DIAG_Assert(scopeStack.Depth() >= 3, ""); // at least has Proc, File, LM
 
-    // both 'begin' and 'end' are implied (and can be in any order)
-    int numAttr = attributes.getLength();
-    DIAG_Assert(0 <= numAttr && numAttr <= 5, DIAG_UnexpectedInput);
-
-    SrcFile::ln begLn, endLn;
-    getLineAttr(begLn, endLn, attributes);
-
-    string fnm = getAttr(attributes, attrFile);
-    fnm = m_args.realpath(fnm);
+    string fnm = m_args.realpath(elem.file);
 
     // by now the file and function names should have been found
     Struct::ACodeNode* parent = dynamic_cast<Struct::ACodeNode*>(getCurrentScope());
-    Struct::ACodeNode* loopNode = new Struct::Loop(parent, fnm, begLn, endLn);
+    Struct::ACodeNode* loopNode = new Struct::Loop(parent, fnm, elem.begLn,
+						   elem.endLn);
 
-    string node_id = getAttr(attributes, attrId);
-    loopNode->m_origId = atoi(node_id.c_str());
+    loopNode->m_origId = atoi(elem.id.c_str());
 
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << loopNode->toStringMe());
 
@@ -417,30 +515,19 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
   }
 
   // Stmt
-  else if (XMLString::equals(name, elemStmt)) {
-    int numAttr = attributes.getLength();
-
-    // 'begin' is required but 'end' is implied (and can be in any order)
-    DIAG_Assert(1 <= numAttr && numAttr <= 4, DIAG_UnexpectedInput);
-
-    SrcFile::ln begLn, endLn;
-    getLineAttr(begLn, endLn, attributes);
-
+  else if (elem.ty == Elem_Stmt) {
     // for now insist that line range include one line (since we don't nest S)
-    DIAG_Assert(begLn == endLn, "S line range [" << begLn << ", " << endLn << "]");
-
-    string vma = getAttr(attributes, attrVMA);
+    DIAG_Assert(elem.begLn == elem.endLn, "S line range [" << elem.begLn << ", " << elem.endLn << "]");
 
     // by now the file and function names should have been found
     Struct::ACodeNode* parent = dynamic_cast<Struct::ACodeNode*>(getCurrentScope());
     DIAG_Assert(m_curProc != NULL, "");
 
-    Struct::Stmt* stmtNode = new Struct::Stmt(parent, begLn, endLn);
-    if (!vma.empty()) {
-      stmtNode->vmaSet().fromString(vma.c_str());
+    Struct::Stmt* stmtNode = new Struct::Stmt(parent, elem.begLn, elem.endLn);
+    if (!elem.vma.empty()) {
+      stmtNode->vmaSet().merge(elem.vma);
     }
-    string node_id = getAttr(attributes, attrId);
-    stmtNode->m_origId = atoi(node_id.c_str());
+    stmtNode->m_origId = atoi(elem.id.c_str());
 
     DIAG_DevMsgIf(DBG, "PGMDocHandler: " << stmtNode->toStringMe());
 
@@ -448,8 +535,8 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
   }
 
   // Group
-  else if (XMLString::equals(name, elemGroup)) {
-    string grpnm = getAttr(attributes, attrName); // must exist
+  else if (elem.ty == Elem_Group) {
+    const string& grpnm = elem.name; // must exist
     DIAG_Assert(!grpnm.empty(), "");
 
     Struct::ANode* parent = getCurrentScope(); // enclosing scope
@@ -478,58 +565,56 @@ PGMDocHandler::startElement(const XMLCh* const GCC_ATTR_UNUSED uri,
 
 
 void
-PGMDocHandler::endElement(const XMLCh* const GCC_ATTR_UNUSED uri,
-			  const XMLCh* const name,
-			  const XMLCh* const GCC_ATTR_UNUSED qname)
+PGMDocHandler::endElem(Elem_t ty)
 {
 
   // Structure
-  if (XMLString::equals(name, elemStructure)) {
+  if (ty == Elem_Structure) {
     m_curRoot = NULL;
   }
 
   // Load Module
-  else if (XMLString::equals(name, elemLM)) {
+  else if (ty == Elem_LM) {
     DIAG_Assert(scopeStack.Depth() >= 1, "");
     if (m_docty == Doc_GROUP) { processGroupDocEndTag(); }
     m_curLM = NULL;
   }
 
   // File
-  else if (XMLString::equals(name, elemFile)) {
+  else if (ty == Elem_File) {
     DIAG_Assert(scopeStack.Depth() >= 2, ""); // at least has LM
     if (m_docty == Doc_GROUP) { processGroupDocEndTag(); }
     m_curFile = NULL;
   }
 
   // Proc
-  else if (XMLString::equals(name, elemProc)) {
+  else if (ty == Elem_Proc) {
     DIAG_Assert(scopeStack.Depth() >= 3, ""); // at least has File, LM
     if (m_docty == Doc_GROUP) { processGroupDocEndTag(); }
     m_curProc = NULL;
   }
 
   // Alien
-  else if (XMLString::equals(name, elemAlien)) {
+  else if (ty == Elem_Alien) {
     // stack depth should be at least 4
     DIAG_Assert(scopeStack.Depth() >= 4, "");
     if (m_docty == Doc_GROUP) { processGroupDocEndTag(); }
   }
 
   // Loop
-  else if (XMLString::equals(name, elemLoop)) {
+  else if (ty == Elem_Loop) {
     // stack depth should be at least 4
     DIAG_Assert(scopeStack.Depth() >= 4, "");
     if (m_docty == Doc_GROUP) { processGroupDocEndTag(); }
   }
 
   // Stmt
-  else if (XMLString::equals(name, elemStmt)) {
+  else if (ty == Elem_Stmt) {
     if (m_docty == Doc_GROUP) { processGroupDocEndTag(); }
   }
 
   // Group
-  else if (XMLString::equals(name, elemGroup)) {
+  else if (ty == Elem_Group) {
     DIAG_Assert(scopeStack.Depth() >= 1, "");
     DIAG_Assert(groupNestingLvl >= 1, "");
     if (m_docty == Doc_GROUP) { processGroupDocEndTag(); }
@@ -72,10 +72,15 @@
 
 #include <lib/prof/Struct-Tree.hpp>
 
+#include <lib/binutils/VMAInterval.hpp>
+
 #include <lib/support/PointerStack.hpp>
+#include <lib/support/SrcFile.hpp>
 
 //************************ Forward Declarations ******************************
 
+class PGMCacheWriter;
+
 //****************************************************************************
 
 class PGMDocHandler : public XERCES_CPP_NAMESPACE::DefaultHandler {
@@ -83,6 +88,40 @@ public:
   enum Doc_t { Doc_NULL, Doc_STRUCT, Doc_GROUP };
   static const char* ToString(Doc_t docty);
 
+  enum Elem_t {
+    Elem_NULL = 0,
+    Elem_Structure, Elem_LM, Elem_File, Elem_Proc, Elem_Alien,
+    Elem_Loop, Elem_Stmt, Elem_Group
+  };
+
+  // Elem: a PGM element with its attributes decoded, as delivered
+  // either by the SAX parser or by a replay of a PGMCache file.
+  // Unused attributes are empty.
+  class Elem {
+  public:
+    Elem()
+      : ty(Elem_NULL), begLn(SrcFile::ln_NULL), endLn(SrcFile::ln_NULL)
+    { }
+
+    void
+    clear()
+    {
+      ty = Elem_NULL;
+      name.clear(); lnName.clear(); file.clear(); id.clear();
+      begLn = endLn = SrcFile::ln_NULL;
+      vma.clear();
+    }
+
+    Elem_t ty;
+    std::string name;     // 'n' (or 'version' for Elem_Structure)
+    std::string lnName;   // 'ln'
+    std::string file;     // 'f'
+    std::string id;       // 'i'
+    SrcFile::ln begLn;    // 'l'
+    SrcFile::ln endLn;
+    VMAIntervalSet vma;   // 'v'
+  };
+
 private:
     std::map<std::string, Prof::Struct::Proc*> idToProcMap;
 
@@ -105,6 +144,20 @@ public:
   getLineAttr(SrcFile::ln& begLn, SrcFile::ln& endLn,
 	      const XERCES_CPP_NAMESPACE::Attributes& attributes);
 
+  // startElem, endElem: build the structure tree from a decoded
+  // element; the SAX callbacks above decode and forward to these.
+  void
+  startElem(const Elem& elem);
+
+  void
+  endElem(Elem_t ty);
+
+  // If set, every element is also recorded by 'writer' (used to
+  // create a PGMCache file while parsing the XML).
+  void
+  cacheWriter(PGMCacheWriter* writer)
+  { m_cacheWriter = writer; }
+
   //--------------------------------------
   // SAX2 error handler interface
   //--------------------------------------
@@ -222,6 +275,9 @@ private:
   Doc_t m_docty;
   DocHandlerArgs& m_args;
   Prof::Struct::Tree* m_structure;
+  PGMCacheWriter* m_cacheWriter;
+
+  Elem m_elem; // scratch space for decoding SAX elements
   
   // variables for constant values during file processing
   double m_version;     // initialized to a negative
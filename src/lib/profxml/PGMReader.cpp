@@ -76,6 +76,7 @@ using std::string;
 //************************* User Include Files *******************************
 
 #include "PGMReader.hpp"
+#include "PGMCache.hpp"
 #include "XercesUtil.hpp"
 
 //*********************** Xerces Include Files *******************************
@@ -163,8 +164,27 @@ read_PGM(Struct::Tree& structure,
 
   xmlSanityCheck(filenm, docType);
 
+  // STRUCTURE files are replayed from their binary cache if it is
+  // current; otherwise the cache is created while parsing.
+  if (docty == PGMDocHandler::Doc_STRUCT) {
+    PGMDocHandler handler(docty, &structure, docHandlerArgs);
+    try {
+      if (PGMCache_read(filenm, handler)) {
+	return;
+      }
+    }
+    catch (const PGMException& x) {
+      DIAG_Throw("reading '" << PGMCache_fnm(filenm) << "'" << x.message());
+    }
+  }
+
   if (!fpath.empty()) {
     try {
+      // N.B.: an incomplete cache is removed when the writer is
+      // destroyed, e.g., by a parse error.
+      PGMCacheWriter cacheWriter((docty == PGMDocHandler::Doc_STRUCT)
+				 ? filenm : NULL);
+
       SAX2XMLReader* parser = XMLReaderFactory::createXMLReader();
       
       parser->setFeature(XMLUni::fgSAX2CoreValidation, true);
@@ -173,6 +193,9 @@ read_PGM(Struct::Tree& structure,
       
       PGMDocHandler* handler = new PGMDocHandler(docty, &structure, 
 						 docHandlerArgs);
+      if (cacheWriter.isOpen()) {
+	handler->cacheWriter(&cacheWriter);
+      }
       parser->setContentHandler(handler);
       parser->setErrorHandler(handler);
 	  
@@ -181,6 +204,7 @@ read_PGM(Struct::Tree& structure,
       if (parser->getErrorCount() > 0) {
 	DIAG_Throw("ignoring " << fpath << " because of previously reported parse errors.");
       }
+      cacheWriter.finish();
       delete handler;
       delete parser;
     }
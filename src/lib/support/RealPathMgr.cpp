@@ -62,6 +62,8 @@
 #include <string>
 using std::string;
 
+#include <mutex>
+
 
 //*************************** User Include Files ****************************
 
@@ -86,6 +88,10 @@ using std::string;
 
 static RealPathMgr s_singleton;
 
+// Serializes realpath() so that profiles may be read concurrently (the
+// cache, PathFindMgr and PathReplacementMgr are not thread safe).
+static std::mutex s_realpathLock;
+
 
 // Constructor with static singleton objects for PathFindMgr and
 // PathReplacementMgr.
@@ -132,6 +138,8 @@ RealPathMgr::realpath(string& pathNm) const
   
   // INVARIANT: 'pathNm' is not empty
 
+  std::lock_guard<std::mutex> guard(s_realpathLock);
+
   // INVARIANT: all entries in the map are non-empty
   MyMap::iterator it = m_cache.find(pathNm);
 
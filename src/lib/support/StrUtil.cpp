@@ -237,11 +237,10 @@ toDbl(const char* str, unsigned* endidx)
 //
 // --------------------------------------------------------------------------
 
-static char buf[32];
-
 string
 toStr(const int x, int base)
 {
+  char buf[32]; // N.B.: local so that conversions are thread safe
   const char* format = NULL;
 
   switch (base) {
@@ -261,6 +260,7 @@ toStr(const int x, int base)
 string
 toStr(const unsigned x, int base)
 {
+  char buf[32];
   const char* format = NULL;
 
   switch (base) {
@@ -288,6 +288,7 @@ toStr(const unsigned x, int base)
 string
 toStr(const int64_t x, int base)
 {
+  char buf[32];
   const char* format = NULL;
   
   switch (base) {
@@ -311,6 +312,7 @@ toStr(const int64_t x, int base)
 string
 toStr(const uint64_t x, int base)
 {
+  char buf[32];
   const char* format = NULL;
   
   switch (base) {
@@ -334,6 +336,7 @@ toStr(const uint64_t x, int base)
 string
 toStr(const void* x, int GCC_ATTR_UNUSED base)
 {
+  char buf[32];
   sprintf(buf, "%p", x);
   return string(buf);
 }
@@ -342,6 +345,7 @@ toStr(const void* x, int GCC_ATTR_UNUSED base)
 string
 toStr(const double x, const char* format)
 {
+  char buf[32];
   //static char buf[19]; // 0xhhhhhhhhhhhhhhhh format
   sprintf(buf, format, x);
   return string(buf);
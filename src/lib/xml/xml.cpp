@@ -117,6 +117,36 @@ xml::WriteAttrStr(std::ostream& os, const char* s, int flags)
 }
 
 
+// Appends attribute value, beginning with 'attB' and ending with 'attE'.
+void
+xml::AppendAttrStr(string& buf, const char* x, int flags)
+{
+  buf += attB;
+  if (!(flags & ESC_TRUE)) {
+    buf += x;
+  }
+  else {
+    // N.B.: equivalent to EscapeStr() for the single-character patterns
+    const char* run = x;
+    for (const char* p = x; *p != '\0'; ++p) {
+      const char* esc = NULL;
+      switch (*p) {
+	case '<':  esc = "&lt;";   break;
+	case '>':  esc = "&gt;";   break;
+	case '&':  esc = "&amp;";  break;
+	case '"':  esc = "&quot;"; break;
+	default:   continue;
+      }
+      buf.append(run, p - run);
+      buf += esc;
+      run = p + 1;
+    }
+    buf += run;
+  }
+  buf += attE;
+}
+
+
 //****************************************************************************
 //
 //****************************************************************************
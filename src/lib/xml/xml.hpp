@@ -67,6 +67,7 @@
 #include <iostream>
 #include <string>
 
+#include <cstdio>
 #include <inttypes.h>
 
 //*************************** User Include Files ****************************
@@ -249,6 +250,86 @@ namespace xml {
     return (attB + StrUtil::toStr(x, format) + attE);
   }
 
+
+  // -------------------------------------------------------
+  // Appends an attribute string, beginning with 'attB' and ending
+  // with 'attE', to 'buf'.  The output is identical to the MakeAttr*
+  // routines, but no temporary strings are created and (unlike
+  // EscapeStr) the routines are thread safe.
+  // -------------------------------------------------------
+
+  void
+  AppendAttrStr(std::string& buf, const char* x, int flags = ESC_TRUE);
+
+  inline void
+  AppendAttrStr(std::string& buf, const std::string& x, int flags = ESC_TRUE)
+  {
+    AppendAttrStr(buf, x.c_str(), flags);
+  }
+
+
+  // AppendNum: appends the decimal digits of 'x' to 'buf'
+  inline void
+  AppendNum(std::string& buf, uint64_t x)
+  {
+    char str[24];
+    char* p = str + sizeof(str);
+    do {
+      *--p = (char)('0' + (x % 10));
+      x /= 10;
+    } while (x != 0);
+    buf.append(p, (str + sizeof(str)) - p);
+  }
+
+  inline void
+  AppendNum(std::string& buf, int64_t x)
+  {
+    if (x < 0) {
+      buf += '-';
+      AppendNum(buf, (uint64_t)0 - (uint64_t)x);
+    }
+    else {
+      AppendNum(buf, (uint64_t)x);
+    }
+  }
+
+
+  inline void
+  AppendAttrNum(std::string& buf, int x) {
+    buf += attB; AppendNum(buf, (int64_t)x); buf += attE;
+  }
+
+  inline void
+  AppendAttrNum(std::string& buf, unsigned int x, int base = 10) {
+    if (base != 10) { buf += MakeAttrNum(x, base); return; }
+    buf += attB; AppendNum(buf, (uint64_t)x); buf += attE;
+  }
+
+  inline void
+  AppendAttrNum(std::string& buf, int64_t x) {
+    buf += attB; AppendNum(buf, x); buf += attE;
+  }
+
+  inline void
+  AppendAttrNum(std::string& buf, uint64_t x, int base = 10) {
+    if (base != 10) { buf += MakeAttrNum(x, base); return; }
+    buf += attB; AppendNum(buf, x); buf += attE;
+  }
+
+  inline void
+  AppendAttrNum(std::string& buf, double x, const char* format = "%g") {
+    char str[32];
+    int len = snprintf(str, sizeof(str), format, x);
+    buf += attB;
+    if (len >= (int)sizeof(str)) {
+      buf += StrUtil::toStr(x, format); // very long formats
+    }
+    else if (len > 0) {
+      buf.append(str, len);
+    }
+    buf += attE;
+  }
+
 }
 
 #endif /* xml_xml_hpp */
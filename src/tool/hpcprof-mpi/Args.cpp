@@ -88,6 +88,7 @@ using std::string;
 
 Args::Args()
 {
+  hpcprofmpi_reduceFanIn = 2;
 }
 
 
@@ -96,6 +97,22 @@ Args::~Args()
 }
 
 
+void
+Args::parse(int argc, const char* const argv[])
+{
+  ArgsHPCProf::parse(argc, argv);
+
+  if (parser.isOpt("reduce-fanin")) {
+    const string& arg = parser.getOptArg("reduce-fanin");
+    long k = CmdLineParser::toLong(arg);
+    if (k < 2) {
+      ARG_ERROR("--reduce-fanin expects a number >= 2: " << arg);
+    }
+    hpcprofmpi_reduceFanIn = (int)k;
+  }
+}
+
+
 const std::string
 Args::getCmd() const
 {
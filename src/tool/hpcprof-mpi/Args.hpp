@@ -82,10 +82,18 @@ public:
   Args();
   virtual ~Args();
 
+  // Parse the command line
+  virtual void
+  parse(int argc, const char* const argv[]);
+
 public:
   // Parsed Data: Command
   virtual const std::string
   getCmd() const;
+
+public:
+  // Parsed Data
+  int hpcprofmpi_reduceFanIn; // cf. ParallelAnalysis::ProfileReducer
 }; 
 
 #endif // Args_hpp 
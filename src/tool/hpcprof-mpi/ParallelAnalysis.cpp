@@ -69,6 +69,7 @@
 using std::string;
 
 #include <algorithm>
+#include <sstream>
 
 #include <stdint.h>
 
@@ -190,56 +191,6 @@ broadcast
 }
 
 
-void
-packSend(Prof::CallPath::Profile* profile,
-	 int dest, int myRank, MPI_Comm comm)
-{
-  uint8_t* profileBuf = NULL;
-  size_t profileBufSz = 0;
-  packProfile(*profile, &profileBuf, &profileBufSz);
-  MPI_Send(profileBuf, (int)profileBufSz, MPI_BYTE, dest, myRank, comm);
-  free(profileBuf);
-}
-
-void
-recvMerge(Prof::CallPath::Profile* profile,
-	  int src, int myRank, MPI_Comm comm)
-{
-  // probe src
-  MPI_Status mpistat;
-  MPI_Probe(src, src, comm, &mpistat);
-  int profileBufSz;
-  MPI_Get_count(&mpistat, MPI_BYTE, &profileBufSz);
-
-  // receive profile from src
-  uint8_t *profileBuf = new uint8_t[profileBufSz];
-  MPI_Recv(profileBuf, profileBufSz, MPI_BYTE, src, src, comm, &mpistat);
-  Prof::CallPath::Profile* new_profile =
-    unpackProfile(profileBuf, (size_t)profileBufSz);
-  delete[] profileBuf;
-
-  if (DBG_CCT_MERGE) {
-    string pfx0 = "[" + StrUtil::toStr(myRank) + "]";
-    string pfx1 = "[" + StrUtil::toStr(src) + "]";
-    DIAG_DevMsgIf(1, profile->metricMgr()->toString(pfx0.c_str()));
-    DIAG_DevMsgIf(1, new_profile->metricMgr()->toString(pfx1.c_str()));
-  }
-    
-  int mergeTy = Prof::CallPath::Profile::Merge_MergeMetricByName;
-  profile->merge(*new_profile, mergeTy);
-
-  // merging the perf event statistics
-  profile->metricMgr()->mergePerfEventStatistics(new_profile->metricMgr());
-
-  if (DBG_CCT_MERGE) {
-    string pfx = ("[" + StrUtil::toStr(src)
-		  + " => " + StrUtil::toStr(myRank) + "]");
-    DIAG_DevMsgIf(1, profile->metricMgr()->toString(pfx.c_str()));
-  }
-
-  delete new_profile;
-}
-
 void
 packSend(std::pair<Prof::CallPath::Profile*,
 	                ParallelAnalysis::PackedMetrics*> data,
@@ -302,6 +253,267 @@ recvMerge(StringSet *stringSet,
 }
 
 
+//***************************************************************************
+// ProfileReducer
+//***************************************************************************
+
+const size_t ProfileReducer::ChunkSz;
+
+
+ProfileReducer::ProfileReducer(int myRank, int numRanks, int fanIn,
+			       MPI_Comm comm)
+  : m_myRank(myRank), m_nextChild(0), m_childProfile(NULL)
+{
+  DIAG_Assert(fanIn >= 2, "ProfileReducer: fan-in must be at least 2");
+
+  MPI_Comm_dup(comm, &m_comm);
+
+  m_parent = (myRank > 0) ? (myRank - 1) / fanIn : -1;
+
+  for (int i = 1; i <= fanIn; ++i) {
+    int rank = fanIn * myRank + i;
+    if (rank >= numRanks) {
+      break;
+    }
+    m_children.push_back(Child());
+    Child& child = m_children.back();
+    child.rank = rank;
+    child.size = 0;
+    child.isPosted = false;
+    child.buf = NULL;
+  }
+
+  // N.B.: post after m_children stops growing (requests hold addresses)
+  for (uint i = 0; i < m_children.size(); ++i) {
+    Child& child = m_children[i];
+    MPI_Irecv(&child.size, 1, MPI_UNSIGNED_LONG_LONG, child.rank, TagSize,
+	      m_comm, &child.sizeReq);
+  }
+}
+
+
+ProfileReducer::~ProfileReducer()
+{
+  for (uint i = 0; i < m_children.size(); ++i) {
+    delete[] m_children[i].buf;
+  }
+  delete m_childProfile;
+  for (uint i = 0; i < m_heldProfiles.size(); ++i) {
+    delete m_heldProfiles[i];
+  }
+
+  // N.B.: reduce() frees the communicator.  Otherwise (e.g., an error
+  // unwound past reduce()) it is only freed while MPI is still usable.
+  int isFinalized = 1;
+  MPI_Finalized(&isFinalized);
+  if (m_comm != MPI_COMM_NULL && !isFinalized) {
+    MPI_Comm_free(&m_comm);
+  }
+}
+
+
+void
+ProfileReducer::progress()
+{
+  for (uint i = m_nextChild; i < m_children.size(); ++i) {
+    Child& child = m_children[i];
+    if (!child.isPosted) {
+      int isDone = 0;
+      MPI_Test(&child.sizeReq, &isDone, MPI_STATUS_IGNORE);
+      if (isDone) {
+	postChunks(child);
+      }
+    }
+    else {
+      testChunks(child);
+    }
+  }
+
+  // merge the children that have arrived, in rank order
+  while (m_nextChild < m_children.size()) {
+    Child& child = m_children[m_nextChild];
+    if (!(child.isPosted && testChunks(child))) {
+      break;
+    }
+    mergeNextChild();
+  }
+}
+
+
+void
+ProfileReducer::reduce(Prof::CallPath::Profile* profile)
+{
+  // -------------------------------------------------------
+  // wait for (and merge) the remaining children
+  // -------------------------------------------------------
+  double tm = MPI_Wtime();
+  double tmWork = m_timers.unpack + m_timers.merge;
+  while (m_nextChild < m_children.size()) {
+    progress();
+  }
+  m_timers.wait += ((MPI_Wtime() - tm)
+		    - (m_timers.unpack + m_timers.merge - tmWork));
+
+  // -------------------------------------------------------
+  // merge the children's profiles into the local one
+  // -------------------------------------------------------
+  if (m_childProfile) {
+    m_heldProfiles.insert(m_heldProfiles.begin(), m_childProfile);
+    m_childProfile = NULL;
+  }
+
+  for (uint i = 0; i < m_heldProfiles.size(); ++i) {
+    Prof::CallPath::Profile* childProfile = m_heldProfiles[i];
+    if (DBG_CCT_MERGE) {
+      string pfx0 = "[" + StrUtil::toStr(m_myRank) + "]";
+      string pfx1 = "[" + StrUtil::toStr(m_myRank) + " children]";
+      DIAG_DevMsgIf(1, profile->metricMgr()->toString(pfx0.c_str()));
+      DIAG_DevMsgIf(1, childProfile->metricMgr()->toString(pfx1.c_str()));
+    }
+
+    tm = MPI_Wtime();
+    int mergeTy = Prof::CallPath::Profile::Merge_MergeMetricByName;
+    profile->merge(*childProfile, mergeTy);
+
+    // merging the perf event statistics
+    profile->metricMgr()->
+      mergePerfEventStatistics(childProfile->metricMgr());
+    m_timers.merge += MPI_Wtime() - tm;
+
+    delete childProfile;
+  }
+  m_heldProfiles.clear();
+
+  // -------------------------------------------------------
+  // stream result to parent
+  // -------------------------------------------------------
+  if (m_parent >= 0) {
+    tm = MPI_Wtime();
+    uint8_t* buf = NULL;
+    size_t bufSz = 0;
+    packProfile(*profile, &buf, &bufSz);
+    m_timers.pack += MPI_Wtime() - tm;
+
+    tm = MPI_Wtime();
+    unsigned long long size = bufSz;
+    MPI_Send(&size, 1, MPI_UNSIGNED_LONG_LONG, m_parent, TagSize, m_comm);
+
+    std::vector<MPI_Request> reqs;
+    for (size_t off = 0; off < bufSz; off += ChunkSz) {
+      int len = (int)std::min(ChunkSz, bufSz - off);
+      reqs.push_back(MPI_REQUEST_NULL);
+      MPI_Isend(buf + off, len, MPI_BYTE, m_parent, TagChunk, m_comm,
+		&reqs.back());
+    }
+    MPI_Waitall((int)reqs.size(), reqs.data(), MPI_STATUSES_IGNORE);
+    free(buf);
+    m_timers.send += MPI_Wtime() - tm;
+  }
+
+  MPI_Comm_free(&m_comm); // sets MPI_COMM_NULL
+}
+
+
+std::string
+ProfileReducer::toStringTimers() const
+{
+  std::ostringstream os;
+  os << "[" << m_myRank << "] reduce times (s):"
+     << " read " << m_timers.read
+     << ", wait " << m_timers.wait
+     << ", unpack " << m_timers.unpack
+     << ", merge " << m_timers.merge
+     << ", pack " << m_timers.pack
+     << ", send " << m_timers.send;
+  return os.str();
+}
+
+
+void
+ProfileReducer::postChunks(Child& child)
+{
+  child.buf = new uint8_t[child.size];
+  for (size_t off = 0; off < child.size; off += ChunkSz) {
+    int len = (int)std::min(ChunkSz, (size_t)child.size - off);
+    child.chunkReqs.push_back(MPI_REQUEST_NULL);
+    MPI_Irecv(child.buf + off, len, MPI_BYTE, child.rank, TagChunk, m_comm,
+	      &child.chunkReqs.back());
+  }
+  child.isPosted = true;
+}
+
+
+// hasSameMetrics: returns true if 'x' and 'y' have the same metric
+// names in the same order
+static bool
+hasSameMetrics(const Prof::CallPath::Profile& x,
+	       const Prof::CallPath::Profile& y)
+{
+  const Prof::Metric::Mgr* xMgr = x.metricMgr();
+  const Prof::Metric::Mgr* yMgr = y.metricMgr();
+  if (xMgr->size() != yMgr->size()) {
+    return false;
+  }
+  for (uint i = 0; i < xMgr->size(); ++i) {
+    if (xMgr->metric(i)->name() != yMgr->metric(i)->name()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+void
+ProfileReducer::mergeNextChild()
+{
+  Child& child = m_children[m_nextChild++];
+
+  double tm = MPI_Wtime();
+  Prof::CallPath::Profile* new_profile =
+    unpackProfile(child.buf, (size_t)child.size);
+  delete[] child.buf;
+  child.buf = NULL;
+  m_timers.unpack += MPI_Wtime() - tm;
+
+  if (!m_childProfile) {
+    m_childProfile = new_profile;
+    return;
+  }
+
+  // Merging metrics by group is not associative.  Merging children
+  // with the same metrics first gives the same metrics as merging them
+  // one by one into the local profile, unless that has only some of
+  // them (without the group, each child would get its own copy).
+  if (!m_heldProfiles.empty()
+      || !hasSameMetrics(*m_childProfile, *new_profile)) {
+    m_heldProfiles.push_back(new_profile);
+    return;
+  }
+
+  tm = MPI_Wtime();
+  int mergeTy = Prof::CallPath::Profile::Merge_MergeMetricByName;
+  m_childProfile->merge(*new_profile, mergeTy);
+  m_childProfile->metricMgr()->
+    mergePerfEventStatistics(new_profile->metricMgr());
+  m_timers.merge += MPI_Wtime() - tm;
+
+  delete new_profile;
+}
+
+
+// testChunks: returns true if all of 'child's chunks have arrived
+bool
+ProfileReducer::testChunks(Child& child)
+{
+  int isDone = 1;
+  if (!child.chunkReqs.empty()) {
+    MPI_Testall((int)child.chunkReqs.size(), child.chunkReqs.data(), &isDone,
+		MPI_STATUSES_IGNORE);
+  }
+  return isDone;
+}
+
+
 //***************************************************************************
 
 void
@@ -384,7 +596,7 @@ packMetrics(const Prof::CallPath::Profile& profile,
   for (Prof::CCT::ANodeIterator it(cct.root()); it.Current(); ++it) {
     Prof::CCT::ANode* n = it.current();
     for (uint mId1 = 0, mId2 = mDrvdBeg; mId2 < mDrvdEnd; ++mId1, ++mId2) {
-      packedMetrics.idx(n->id(), mId1) = n->metric(mId2);
+      packedMetrics.idx(n->id(), mId1) = n->metricVal(mId2);
     }
   }
 }
@@ -404,9 +616,14 @@ unpackMetrics(Prof::CallPath::Profile& profile,
   DIAG_Assert(packedMetrics.numMetrics() == mEndId - mBegId, "");
 
   for (uint nodeId = 1; nodeId < packedMetrics.numNodes(); ++nodeId) {
+    Prof::CCT::ANode* n = cct.findNode(nodeId);
+    n->ensureMetricsSize(mEndId);
     for (uint mId1 = 0, mId2 = mBegId; mId2 < mEndId; ++mId1, ++mId2) {
-      Prof::CCT::ANode* n = cct.findNode(nodeId);
-      n->demandMetric(mId2) = packedMetrics.idx(nodeId, mId1);
+      // N.B.: only store non-zeros so that sparse nodes stay sparse
+      double x = packedMetrics.idx(nodeId, mId1);
+      if (x != 0.0 || n->metricVal(mId2) != 0.0) {
+	n->metric(mId2) = x;
+      }
     }
   }
 
@@ -423,3 +640,171 @@ unpackMetrics(Prof::CallPath::Profile& profile,
 //***************************************************************************
 
 } // namespace ParallelAnalysis
+
+
+//***************************************************************************
+// unit test
+//***************************************************************************
+// #define UNIT_TEST_PROFILE_REDUCER
+
+#ifdef UNIT_TEST_PROFILE_REDUCER
+
+// mpirun -np <n> <test> [fan-in [metric names [description length]]]
+//
+// Reduces a synthetic profile from every rank with ProfileReducer and
+// checks, on rank 0, that the result is the same as merging the
+// profiles one at a time in the old order: each rank merges its
+// children, in rank order, into its local profile.  Rank r measures
+// metric 'm<r % metric names>': with one name, children are merged as
+// they arrive.  (Some mixes, e.g. 12 ranks with 2 names and a fan-in of
+// 2, cannot be merged by name in either order.)  A long metric
+// description makes the packed profiles span several chunks.
+
+#include <lib/prof/Metric-ADesc.hpp>
+#include <lib/prof/Metric-Mgr.hpp>
+#include <lib/prof/LoadMap.hpp>
+#include <lib/prof/CCT-TreeIterator.hpp>
+
+#include <cstdlib>
+#include <cstdio>
+
+static Prof::CallPath::Profile*
+makeTestProfile(int rank, int numNames, uint descSz)
+{
+  using namespace Prof;
+
+  CallPath::Profile* prof =
+    CallPath::Profile::make(CallPath::Profile::RFlg_VirtualMetrics);
+
+  // metrics shared by some ranks are merged by name
+  string nm = "m" + StrUtil::toStr(rank % numNames);
+  string desc(descSz, 'x');
+  prof->metricMgr()->insert(new Metric::SampledDesc(nm, desc, 1, true,
+						    "", "", "", true));
+
+  prof->loadmap()->lm_insert(new LoadMap::LM("/lib/libA.so"));
+  prof->loadmap()->lm_insert(new LoadMap::LM((rank % 2) ? "/lib/libB.so"
+					     : "/lib/libC.so"));
+
+  lush_assoc_info_t as_info = lush_assoc_info_NULL;
+  CCT::ANode* root = prof->cct()->root();
+  for (int i = 0; i < 40 + rank; ++i) {
+    Metric::IData metrics(1);
+    metrics.metric(0) = rank * 100 + i;
+
+    LoadMap::LMId_t lmId = 1 + (i % 2);
+    VMA ip = 0x1000 + 16 * ((rank * 7 + i * 3) % 97);
+    CCT::Call* call = new CCT::Call(root, HPCRUN_FMT_CCTNodeId_NULL, as_info,
+				    lmId, ip, 0, NULL, metrics);
+    new CCT::Stmt(call, HPCRUN_FMT_CCTNodeId_NULL, as_info,
+		  lmId, ip + 4 * (rank % 5), 0, NULL, metrics);
+  }
+  return prof;
+}
+
+
+// writeTestCCT: write 'node's subtree with children in a canonical
+// order (cf. ANodeSortedIterator::cmpByDynInfo), since sibling order
+// (and node ids) depend on the order of merging
+static void
+writeTestCCT(std::ostream& os, const Prof::CCT::ANode* node,
+	     uint numMetrics)
+{
+  os << "(" << Prof::CCT::ANode::ANodeTyToName(node->type());
+  const Prof::CCT::ADynNode* dyn =
+    dynamic_cast<const Prof::CCT::ADynNode*>(node);
+  if (dyn) {
+    os << " " << dyn->lmId() << " " << dyn->lmIP();
+  }
+  for (uint mId = 0; mId < numMetrics; ++mId) {
+    os << " " << node->metricVal(mId);
+  }
+  for (Prof::CCT::ANodeSortedChildIterator
+	 it(node, Prof::CCT::ANodeSortedIterator::cmpByDynInfo);
+       it.current(); it++) {
+    writeTestCCT(os, it.current(), numMetrics);
+  }
+  os << ")";
+}
+
+
+static string
+toTestString(const Prof::CallPath::Profile& prof)
+{
+  std::ostringstream os;
+  prof.metricMgr()->dump(os);
+  prof.loadmap()->dump(os);
+  writeTestCCT(os, prof.cct()->root(), prof.metricMgr()->size());
+  return os.str();
+}
+
+
+// the old order: merge each child's (reduced) profile into 'rank's, one
+// at a time
+static Prof::CallPath::Profile*
+makeExpected(int rank, int numRanks, int fanIn, int numNames, uint descSz)
+{
+  Prof::CallPath::Profile* prof = makeTestProfile(rank, numNames, descSz);
+  for (int i = 1; i <= fanIn && fanIn * rank + i < numRanks; ++i) {
+    Prof::CallPath::Profile* reduced =
+      makeExpected(fanIn * rank + i, numRanks, fanIn, numNames, descSz);
+
+    // as sent by the child rank
+    uint8_t* buf = NULL;
+    size_t bufSz = 0;
+    ParallelAnalysis::packProfile(*reduced, &buf, &bufSz);
+    delete reduced;
+    Prof::CallPath::Profile* child = ParallelAnalysis::unpackProfile(buf, bufSz);
+    free(buf);
+
+    prof->merge(*child, Prof::CallPath::Profile::Merge_MergeMetricByName);
+    prof->metricMgr()->mergePerfEventStatistics(child->metricMgr());
+    delete child;
+  }
+  return prof;
+}
+
+
+int
+main(int argc, char** argv)
+{
+  MPI_Init(&argc, &argv);
+  int myRank, numRanks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myRank);
+  MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+  int fanIn = (argc > 1) ? atoi(argv[1]) : 2;
+  int numNames = (argc > 2) ? atoi(argv[2]) : 3;
+  uint descSz = (argc > 3) ? atoi(argv[3]) : 16;
+
+  int ret = 0;
+  {
+    ParallelAnalysis::ProfileReducer reducer(myRank, numRanks, fanIn);
+
+    // as if reading local files, with children arriving meanwhile
+    Prof::CallPath::Profile* prof = makeTestProfile(myRank, numNames, descSz);
+    for (int i = 0; i < 10; ++i) {
+      reducer.progress();
+    }
+    reducer.reduce(prof);
+
+    if (myRank == 0) {
+      Prof::CallPath::Profile* expected =
+	makeExpected(0, numRanks, fanIn, numNames, descSz);
+
+      string str1 = toTestString(*prof);
+      string str2 = toTestString(*expected);
+      bool ok = (str1 == str2);
+      printf("%d ranks, fan-in %d: %s\n", numRanks, fanIn,
+	     ok ? "ok" : "MISMATCH");
+      ret = ok ? 0 : 1;
+      delete expected;
+    }
+    delete prof;
+  }
+
+  MPI_Finalize();
+  return ret;
+}
+
+#endif
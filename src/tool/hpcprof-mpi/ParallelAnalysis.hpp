@@ -200,16 +200,9 @@ private:
 namespace ParallelAnalysis {
 
 // ------------------------------------------------------------------------
-// recvMerge: merge profile on rank_y into profile on rank_x
+// recvMerge: merge object on rank_y into object on rank_x
 // ------------------------------------------------------------------------
 
-void
-packSend(Prof::CallPath::Profile* profile,
-	 int dest, int myRank, MPI_Comm comm = MPI_COMM_WORLD);
-void
-recvMerge(Prof::CallPath::Profile* profile,
-	  int src, int myRank, MPI_Comm comm = MPI_COMM_WORLD);
-
 void
 packSend(std::pair<Prof::CallPath::Profile*,
 	                ParallelAnalysis::PackedMetrics*> data,
@@ -231,8 +224,10 @@ recvMerge(StringSet *stringSet,
 // rank into a canonical profile at the tree's root, rank 0.  Assumes
 // 0-based ranks.
 // 
-// T: Prof::CallPath::Profile*
 // T: std::pair<Prof::CallPath::Profile*, ParallelAnalysis::PackedMetrics*>
+// T: StringSet*
+//
+// (Profiles are reduced with ProfileReducer.)
 // ------------------------------------------------------------------------
 
 template<typename T>
@@ -254,6 +249,115 @@ reduce(T object, int myRank, int numRanks, MPI_Comm comm = MPI_COMM_WORLD)
 }
 
 
+// ------------------------------------------------------------------------
+// ProfileReducer: A pipelined tree reduction of profiles with
+// configurable fan-in, where the children of rank r are ranks
+// [fanIn*r + 1, fanIn*r + fanIn].
+//
+// Each rank posts non-blocking receives for its children's profiles
+// up front.  A child's (packed) profile arrives as a size message
+// followed by chunks of at most ChunkSz bytes.  Calling progress()
+// while reading local profiles (cf. Analysis::CallPath::read()) lets
+// those transfers complete in the background and unpacks each child
+// (in rank order) as soon as it has arrived.  Children with the same
+// metrics as the ones before them are merged right away into a partial
+// result; because metrics are merged by group (cf.
+// Prof::Metric::Mgr::findGroup()), any others are kept and merged
+// later, in order.  reduce() waits for the remaining children, merges
+// them into the local profile and sends that to the parent in chunks.
+// The merged CCT, metric order and load map are those of merging the
+// local profile and then each child in rank order; only the order of
+// CCT siblings (and thus node ids before makeDensePreorderIds()) may
+// differ.
+// ------------------------------------------------------------------------
+
+class ProfileReducer
+  : public Unique // prevent copying
+{
+public:
+  ProfileReducer(int myRank, int numRanks, int fanIn,
+		 MPI_Comm comm = MPI_COMM_WORLD);
+
+  ~ProfileReducer();
+
+  // progress: advance outstanding receives and unpack (and possibly
+  // merge) the children that have arrived; does not wait for
+  // communication
+  void
+  progress();
+
+  static void
+  progressFn(void* reducer)
+  { static_cast<ProfileReducer*>(reducer)->progress(); }
+
+  // reduce: merge children's profiles into 'profile' and send the
+  // result to the parent (if any).  Call once.
+  void
+  reduce(Prof::CallPath::Profile* profile);
+
+
+  // per-phase timing counters (seconds)
+  struct Timers {
+    Timers()
+      : read(0.0), wait(0.0), unpack(0.0), merge(0.0), pack(0.0), send(0.0)
+    { }
+
+    double read;   // reading local profiles, including progress() (set by caller)
+    double wait;   // waiting for children's profiles
+    double unpack; // unpacking children's profiles
+    double merge;  // merging children's profiles
+    double pack;   // packing the reduced profile
+    double send;   // sending the reduced profile to the parent
+  };
+
+  Timers&
+  timers()
+  { return m_timers; }
+
+  std::string
+  toStringTimers() const;
+
+  static const size_t ChunkSz = (64 * 1024 * 1024);
+
+private:
+  struct Child {
+    int rank;
+    unsigned long long size;   // size of packed profile
+    MPI_Request sizeReq;
+    bool isPosted;             // are chunk receives posted?
+    uint8_t* buf;
+    std::vector<MPI_Request> chunkReqs;
+  };
+
+  void
+  postChunks(Child& child);
+
+  bool
+  testChunks(Child& child);
+
+  // mergeNextChild: unpack m_children[m_nextChild], which has arrived,
+  // and merge it into m_childProfile or add it to m_heldProfiles
+  void
+  mergeNextChild();
+
+  static const int TagSize  = 1;
+  static const int TagChunk = 2;
+
+  int m_myRank;
+  int m_parent; // -1 for the root
+  MPI_Comm m_comm; // private duplicate of the given communicator
+  std::vector<Child> m_children;
+  uint m_nextChild; // next child (in rank order) to be unpacked
+
+  // m_children[0, m_nextChild): the merge of a prefix with the same
+  // metrics followed by the others, unmerged
+  Prof::CallPath::Profile* m_childProfile;
+  std::vector<Prof::CallPath::Profile*> m_heldProfiles;
+
+  Timers m_timers;
+};
+
+
 // ------------------------------------------------------------------------
 // broadcast: Broadcast the profile at the tree's root (rank 0) to every
 // other rank.  Assumes 0-based ranks.
@@ -155,7 +155,7 @@ makeDBFileName(const string& dbDir, uint groupId, const string& profileFile);
 
 static void
 writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
-	       const string& metricDBFnm);
+	       const string& metricDBFnm, bool isColumnar);
 
 
 static void
@@ -308,7 +308,15 @@ realmain(int argc, char* const* argv)
   Analysis::Util::UIntVec* groupMap =
     (nArgs.groupMax > 1) ? nArgs.groupMap : NULL;
 
-  profLcl = Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags);
+  // N.B.: children's profiles are received while local ones are read
+  ParallelAnalysis::ProfileReducer reducer(myRank, numRanks,
+					   args.hpcprofmpi_reduceFanIn);
+
+  double tmRead = MPI_Wtime();
+  profLcl = Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags,
+				     0, 1, ParallelAnalysis::ProfileReducer::
+				     progressFn, &reducer);
+  reducer.timers().read = MPI_Wtime() - tmRead;
 
   // -------------------------------------------------------
   // 1b. Create canonical CCT (metrics merged by <group>.<name>.*)
@@ -316,8 +324,9 @@ realmain(int argc, char* const* argv)
   Prof::CallPath::Profile* profGbl = NULL;
 
   // Post-INVARIANT: rank 0's 'profLcl' is the canonical CCT.  Metrics
-  // are merged (and sorted by always merging left-child before right)
-  ParallelAnalysis::reduce(profLcl, myRank, numRanks);
+  // are merged (and sorted by always merging children in rank order)
+  reducer.reduce(profLcl);
+  DIAG_Msg(2, reducer.toStringTimers());
 
   ParallelAnalysis::reduce(&profLcl->directorySet(), myRank, numRanks);
 
@@ -944,7 +953,7 @@ makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
     // -------------------------------------------------------
 
     string dbFnm = makeDBFileName(args.db_dir, groupId, profileFile);
-    writeMetricsDB(profGbl, mBeg, mEnd, dbFnm);
+    writeMetricsDB(profGbl, mBeg, mEnd, dbFnm, args.db_metricDBColumnar);
 
     // -------------------------------------------------------
     // reinitialize metric values for next time
@@ -975,7 +984,7 @@ makeDBFileName(const string& dbDir, uint groupId, const string& profileFile)
 // [mBegId, mEndId)
 static void
 writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
-	       const string& metricDBFnm)
+	       const string& metricDBFnm, bool isColumnar)
 {
   const Prof::CCT::Tree& cct = *(profGbl.cct());
 
@@ -1009,6 +1018,8 @@ writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
 
   // 1. header
   hpcmetricDB_fmt_hdr_t hdr;
+  strcpy(hdr.versionStr, (isColumnar) ? HPCMETRICDB_FMT_VersionColumnar
+	                              : HPCMETRICDB_FMT_Version);
   hdr.numNodes = numNodes;
   hdr.numMetrics = mEndId - mBegId; // [mBegId mEndId)
 
@@ -1016,17 +1027,59 @@ writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
   ret = hpcmetricDB_fmt_hdr_fwrite(&hdr, fs);
   if (ret == HPCFMT_ERR) goto badwrite;
 
-  // 2. metric values
-  //    - first row corresponds to node 1.
-  //    - first column corresponds to first sampled metric.
-  // cf. ParallelAnalysis::unpackMetrics: 
-
-  for (uint nodeId = 1; nodeId < numNodes + 1; ++nodeId) {
-    for (uint mId1 = 0, mId2 = mBegId; mId2 < mEndId; ++mId1, ++mId2) {
-      double mval = packedMetrics.idx(nodeId, mId1);
-      DIAG_MsgIf(0,  "  " << nodeId << " -> " << mval);
-      ret = hpcfmt_real8_fwrite(mval, fs);
-      if (ret == HPCFMT_ERR) goto badwrite;
+  if (isColumnar) {
+    // 2. metric columns: nonzero values only, one column per metric;
+    //    followed by the column index.
+    // cf. [hpcprof-metricdb] columns in hpcrun-fmt.h
+
+    std::vector<hpcmetricDB_fmt_col_t> cols(hdr.numMetrics);
+    std::vector<uint32_t> nodeIds(HPCMETRICDB_FMT_BlockMaxEntries);
+    std::vector<double> mvals(HPCMETRICDB_FMT_BlockMaxEntries);
+    std::vector<unsigned char> buf(HPCMETRICDB_FMT_BlockBufSz);
+
+    uint64_t offset = ftello(fs);
+
+    for (uint mId1 = 0; mId1 < hdr.numMetrics; ++mId1) {
+      hpcmetricDB_fmt_col_t& col = cols[mId1];
+      memset(&col, 0, sizeof(col));
+      col.offset = offset;
+
+      uint n = 0;
+      for (uint nodeId = 1; nodeId < numNodes + 1; ++nodeId) {
+	double mval = packedMetrics.idx(nodeId, mId1);
+	if (mval != 0.0) {
+	  nodeIds[n] = nodeId;
+	  mvals[n] = mval;
+	  n++;
+	}
+	if (n > 0 && (n == HPCMETRICDB_FMT_BlockMaxEntries
+		      || nodeId == numNodes)) {
+	  ret = hpcmetricDB_fmt_block_fwrite(nodeIds.data(), mvals.data(), n,
+					     &col, buf.data(), fs);
+	  if (ret == HPCFMT_ERR) goto badwrite;
+	  n = 0;
+	}
+      }
+      offset += col.length;
+    }
+
+    ret = hpcmetricDB_fmt_index_fwrite(cols.data(), hdr.numMetrics, offset,
+				       fs);
+    if (ret == HPCFMT_ERR) goto badwrite;
+  }
+  else {
+    // 2. metric values
+    //    - first row corresponds to node 1.
+    //    - first column corresponds to first sampled metric.
+    // cf. ParallelAnalysis::unpackMetrics: 
+
+    for (uint nodeId = 1; nodeId < numNodes + 1; ++nodeId) {
+      for (uint mId1 = 0, mId2 = mBegId; mId2 < mEndId; ++mId1, ++mId2) {
+	double mval = packedMetrics.idx(nodeId, mId1);
+	DIAG_MsgIf(0,  "  " << nodeId << " -> " << mval);
+	ret = hpcfmt_real8_fwrite(mval, fs);
+	if (ret == HPCFMT_ERR) goto badwrite;
+      }
     }
   }
 
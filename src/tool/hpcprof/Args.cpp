@@ -90,6 +90,7 @@ Args::Args()
 {
   hpcprof_isMetricArg = false;
   hpcprof_forceMetrics = false;
+  hpcprof_numThreads = 1;
 }
 
 
@@ -111,6 +112,15 @@ Args::parse(int argc, const char* const argv[])
     hpcprof_forceMetrics = true;
   }
 
+  if (parser.isOpt("threads")) {
+    const string& arg = parser.getOptArg("threads");
+    long n = CmdLineParser::toLong(arg);
+    if (n < 1) {
+      ARG_ERROR("--threads expects a positive number: " << arg);
+    }
+    hpcprof_numThreads = (uint)n;
+  }
+
   // Currently, hpcprof does not generate thread-level metric db
   db_makeMetricDB = false;
 }
@@ -178,7 +178,8 @@ realmain(int argc, char* const* argv)
   uint mrgFlags = (Prof::CCT::MrgFlg_NormalizeTraceFileY);
 
   Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags, mrgFlags);
+    Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags, mrgFlags,
+			     args.hpcprof_numThreads);
 
   prof->disable_redundancy(args.remove_redundancy);
 
@@ -109,6 +109,9 @@ struct cct_node_t {
   // tree structure
   // ---------------------------------------------------------
 
+  // metrics associated with this node, if any (cf. cct2metrics.h)
+  metric_set_t* metrics;
+
   // parent node and the beginning of the child list
   struct cct_node_t* parent;
   struct cct_node_t* children;
@@ -116,8 +119,36 @@ struct cct_node_t {
   // left and right pointers for splay tree of siblings
   struct cct_node_t* left;
   struct cct_node_t* right;
+
+  // alternative to 'children': an array of children (cf. array
+  // children section).  at most one of 'children' and 'child_set'
+  // is non-null; the representation is chosen when the first child
+  // is inserted.
+  struct cct_child_set_t* child_set;
 };
 
+//
+// array children: the set of children is a small array, searched
+// linearly, that becomes an open-addressed hash table (keyed by
+// normalized ip) at high fan-out.  unlike splaying, a lookup does not
+// write to the child nodes.
+//
+typedef struct cct_child_set_t {
+  uint32_t n;    // number of children
+  uint32_t cap;  // number of slots; hashed iff cap > CCT_LINEAR_MAX
+  cct_node_t* slot[];
+} cct_child_set_t;
+
+#define CCT_LINEAR_INIT 2
+#define CCT_LINEAR_MAX  8
+#define CCT_HASH_INIT   32
+
+//
+// use array children for nodes that do not yet have children?
+// (cf. hpcrun_cct_set_array_children)
+//
+static bool cct_array_children = false;
+
 //
 // cache of info from most recent splay
 //
@@ -142,20 +173,24 @@ new_persistent_id()
   return atomic_fetch_add_explicit(&global_persistent_id, 2, memory_order_relaxed);
 }
 
-static cct_node_t*
-cct_node_create(cct_addr_t* addr, cct_node_t* parent)
+static void*
+cct_malloc(size_t sz)
 {
-  size_t sz = sizeof(cct_node_t);
-  cct_node_t *node;
-
   // FIXME: when multiple epochs really work, this will always be freeable.
   // WARN ME (krentel) if/when we really use freeable memory.
   if (ENABLED(FREEABLE)) {
-    node = hpcrun_malloc_freeable(sz);
+    return hpcrun_malloc_freeable(sz);
   }
   else {
-    node = hpcrun_malloc(sz);
+    return hpcrun_malloc(sz);
   }
+}
+
+static cct_node_t*
+cct_node_create(cct_addr_t* addr, cct_node_t* parent)
+{
+  size_t sz = sizeof(cct_node_t);
+  cct_node_t *node = cct_malloc(sz);
 
   memset(node, 0, sz);
 
@@ -165,16 +200,162 @@ cct_node_create(cct_addr_t* addr, cct_node_t* parent)
 
   node->persistent_id = new_persistent_id();
 
+  node->metrics = NULL;
   node->parent = parent;
   node->children = NULL;
   node->left = NULL;
   node->right = NULL;
+  node->child_set = NULL;
 
   node->is_leaf = false;
 
   return node;
 }
 
+static inline bool
+cct_has_children(cct_node_t* node)
+{
+  return node->children || node->child_set;
+}
+
+//
+// does (or will) 'node' keep its children in an array?
+//
+static inline bool
+cct_uses_array(cct_node_t* node)
+{
+  return node->child_set || (! node->children && cct_array_children);
+}
+
+//
+// ******* ARRAY CHILDREN section ********
+//
+
+static inline uint32_t
+child_set_hash(cct_addr_t* addr)
+{
+  uint64_t h = (((uint64_t) addr->ip_norm.lm_id) << 48)
+    ^ ((uint64_t) addr->ip_norm.lm_ip);
+  h *= 0x9e3779b97f4a7c15ULL;
+  return (uint32_t) (h >> 32);
+}
+
+static cct_child_set_t*
+child_set_new(uint32_t cap)
+{
+  size_t sz = sizeof(cct_child_set_t) + cap * sizeof(cct_node_t*);
+  cct_child_set_t* set = cct_malloc(sz);
+  memset(set, 0, sz);
+  set->cap = cap;
+  return set;
+}
+
+static cct_node_t*
+child_set_find(cct_child_set_t* set, cct_addr_t* addr)
+{
+  if (! set) return NULL;
+
+  if (set->cap <= CCT_LINEAR_MAX) {
+    for (uint32_t i = 0; i < set->n; i++) {
+      if (cct_addr_eq(addr, &(set->slot[i]->addr))) {
+        return set->slot[i];
+      }
+    }
+    return NULL;
+  }
+
+  uint32_t mask = set->cap - 1;
+  for (uint32_t i = child_set_hash(addr) & mask; set->slot[i];
+       i = (i + 1) & mask) {
+    if (cct_addr_eq(addr, &(set->slot[i]->addr))) {
+      return set->slot[i];
+    }
+  }
+  return NULL;
+}
+
+//
+// add 'child' (assumed not present) without growing
+//
+static void
+child_set_put(cct_child_set_t* set, cct_node_t* child)
+{
+  if (set->cap <= CCT_LINEAR_MAX) {
+    set->slot[set->n++] = child;
+    return;
+  }
+
+  uint32_t mask = set->cap - 1;
+  uint32_t i = child_set_hash(&(child->addr)) & mask;
+  while (set->slot[i]) {
+    i = (i + 1) & mask;
+  }
+  set->slot[i] = child;
+  set->n++;
+}
+
+//
+// add 'child' (assumed not present) to the children of 'parent',
+// growing the set as needed.  N.B.: an outgrown set is not freed;
+// the memory is reclaimed with the rest of the thread's cct.
+//
+static void
+child_set_add(cct_node_t* parent, cct_node_t* child)
+{
+  cct_child_set_t* set = parent->child_set;
+
+  bool is_full;
+  if (! set) {
+    is_full = true;
+  }
+  else if (set->cap <= CCT_LINEAR_MAX) {
+    is_full = (set->n == set->cap);
+  }
+  else {
+    is_full = (2 * (set->n + 1) > set->cap); // load factor <= 1/2
+  }
+
+  if (is_full) {
+    uint32_t cap;
+    if (! set) {
+      cap = CCT_LINEAR_INIT;
+    }
+    else if (set->cap < CCT_LINEAR_MAX) {
+      cap = 2 * set->cap;
+    }
+    else if (set->cap == CCT_LINEAR_MAX) {
+      cap = CCT_HASH_INIT;
+    }
+    else {
+      cap = 2 * set->cap;
+    }
+
+    cct_child_set_t* new_set = child_set_new(cap);
+    if (set) {
+      for (uint32_t i = 0; i < set->cap; i++) {
+        if (set->slot[i]) child_set_put(new_set, set->slot[i]);
+      }
+    }
+    parent->child_set = set = new_set;
+  }
+
+  child->left = NULL;
+  child->right = NULL;
+  child_set_put(set, child);
+}
+
+static void
+child_set_walk(cct_child_set_t* set, cct_op_t op, cct_op_arg_t arg,
+               size_t level,
+               void (*wf)(cct_node_t* n, cct_op_t o, cct_op_arg_t a, size_t l))
+{
+  if (! set) return;
+
+  for (uint32_t i = 0; i < set->cap; i++) {
+    if (set->slot[i]) wf(set->slot[i], op, arg, level);
+  }
+}
+
 //
 // ******* SPLAY TREE section ********
 // [ Thanks to Mark Krentel ]
@@ -355,10 +536,16 @@ hpcrun_cct_addr(cct_node_t* node)
   return node ? &(node->addr) : NULL;
 }
 
+metric_set_t*
+hpcrun_cct_metrics(cct_node_t* node)
+{
+  return node ? node->metrics : NULL;
+}
+
 bool
 hpcrun_cct_is_leaf(cct_node_t* node)
 {
-  return node ? (node->is_leaf) || (!(node->children)) : false;
+  return node ? (node->is_leaf) || (! cct_has_children(node)) : false;
 }
 
 //
@@ -369,7 +556,7 @@ hpcrun_cct_is_leaf(cct_node_t* node)
 bool
 hpcrun_cct_no_children(cct_node_t* node)
 {
-  return node ? ! node->children : false;
+  return node ? ! cct_has_children(node) : false;
 }
 
 bool
@@ -383,6 +570,13 @@ hpcrun_cct_is_root(cct_node_t* node)
 // ********** Mutator functions: modify a given cct
 //
 
+void
+hpcrun_cct_set_metrics(cct_node_t* node, metric_set_t* metrics)
+{
+  node->metrics = metrics;
+}
+
+
 //
 // Fundamental mutation operation: insert a given addr into the
 // set of children of a given cct node. Return the cct_node corresponding
@@ -396,6 +590,16 @@ hpcrun_cct_insert_addr(cct_node_t* node, cct_addr_t* frm)
   if ( ! node)
     return NULL;
 
+  if (cct_uses_array(node)) {
+    cct_node_t* found = child_set_find(node->child_set, frm);
+    if (found) {
+      return found;
+    }
+    cct_node_t* new = cct_node_create(frm, node);
+    child_set_add(node, new);
+    return new;
+  }
+
   cct_node_t* found    = splay(node->children, frm);
     //
     // !! SPECIAL CASE for cct splay !!
@@ -454,6 +658,11 @@ hpcrun_cct_insert_node(cct_node_t* target, cct_node_t* src)
 {
   src->parent = target;
 
+  if (cct_uses_array(target)) {
+    child_set_add(target, src);
+    return src;
+  }
+
   cct_node_t* found = splay(target->children, &(src->addr));
   target->children = src;
   if (! found) {
@@ -517,6 +726,8 @@ hpcrun_cct_walk_child_1st_w_level(cct_node_t* cct, cct_op_t op, cct_op_arg_t arg
   if (!cct) return;
   walk_child_lrs(cct->children, op, arg, level+1,
 		 hpcrun_cct_walk_child_1st_w_level);
+  child_set_walk(cct->child_set, op, arg, level+1,
+		 hpcrun_cct_walk_child_1st_w_level);
   op(cct, arg, level);
 }
 
@@ -530,6 +741,8 @@ hpcrun_cct_walk_node_1st_w_level(cct_node_t* cct, cct_op_t op, cct_op_arg_t arg,
   op(cct, arg, level);
   walk_child_lrs(cct->children, op, arg, level+1,
 		 hpcrun_cct_walk_node_1st_w_level);
+  child_set_walk(cct->child_set, op, arg, level+1,
+		 hpcrun_cct_walk_node_1st_w_level);
 }
 
 //
@@ -581,6 +794,18 @@ hpcrun_cct_insert_path(cct_node_t ** root, cct_node_t* path)
 }
 
 
+//
+// Representation of children for nodes created from now on (more
+// precisely, for nodes that acquire their first child from now on).
+//
+void
+hpcrun_cct_set_array_children(bool mode)
+{
+  TMSG(CCT, "array children set to %s", mode ? "true" : "false");
+  cct_array_children = mode;
+}
+
+
 //
 // Writing operation
 //
@@ -637,6 +862,10 @@ hpcrun_cct_find_addr(cct_node_t* cct, cct_addr_t* addr)
   if ( ! cct)
     return NULL;
 
+  if (cct->child_set) {
+    return child_set_find(cct->child_set, addr);
+  }
+
   cct_node_t* found    = splay(cct->children, addr);
     //
     // !! SPECIAL CASE for cct splay !!
@@ -688,11 +917,23 @@ hpcrun_cct_merge(cct_node_t* cct_a, cct_node_t* cct_b,
   if (hpcrun_cct_is_leaf (cct_a) && hpcrun_cct_is_leaf(cct_b)) {
     merge(cct_a, cct_b, arg);
   }
-  if (! cct_b->children)
+  if (! cct_has_children(cct_b)) {
     cct_b->children = cct_a->children;
+    cct_b->child_set = cct_a->child_set;
+  }
   else {
     mjarg_t local = (mjarg_t) {.targ = cct_a, .fn = merge, .arg = arg};
-    hpcrun_cct_walkset(cct_b->children, merge_or_join, (cct_op_arg_t) &local);
+    if (cct_b->child_set) {
+      // N.B.: merge_or_join does not modify cct_b's set; copy it
+      // anyway so that the walk does not depend on that.
+      cct_child_set_t* set = cct_b->child_set;
+      for (uint32_t i = 0; i < set->cap; i++) {
+        if (set->slot[i]) merge_or_join(set->slot[i], &local, 0);
+      }
+    }
+    else {
+      hpcrun_cct_walkset(cct_b->children, merge_or_join, (cct_op_arg_t) &local);
+    }
   }
 }
 
@@ -704,6 +945,17 @@ merge_or_join(cct_node_t* n, cct_op_arg_t a, size_t l)
 {
   mjarg_t* the_arg = (mjarg_t*) a;
   cct_node_t* targ = the_arg->targ;
+  if (cct_uses_array(targ)) {
+    cct_node_t* found = child_set_find(targ->child_set, hpcrun_cct_addr(n));
+    if (found) {
+      hpcrun_cct_merge(found, n, the_arg->fn, the_arg->arg);
+    }
+    else {
+      n->parent = targ;
+      child_set_add(targ, n);
+    }
+    return;
+  }
   if (cct_child_find_cache(targ, hpcrun_cct_addr(n)))
     hpcrun_cct_merge(splay_cache.node, n, the_arg->fn, the_arg->arg);
   else
@@ -771,3 +1023,123 @@ cct_disjoint_union_cached(cct_node_t* target, cct_node_t* src)
   }
   target->children = src;
 }
+
+//***************************************************************************
+// unit test
+//***************************************************************************
+// #define UNIT_TEST_CCT_CHILDREN
+
+#ifdef UNIT_TEST_CCT_CHILDREN
+
+//
+// Sampling-overhead benchmark for the two child-set representations:
+// inserts the call paths of a deep recursive workload (as
+// hpcrun_cct_insert_backtrace does, from the outermost frame in) with
+// splay trees and with array/hash children, reports the time per
+// sample, and checks that both give the same set of paths.  Link with
+// hpcrun's memory and messages objects (or stand-ins for them).
+//
+//   cct-children [samples [max depth [call sites]]]
+//
+
+#include <time.h>
+
+static uint64_t path_sum;
+
+static uint64_t
+bench_hash(uint64_t h, uint64_t x)
+{
+  h ^= x + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+  return h;
+}
+
+// sum over all nodes of a hash of the node's path: independent of
+// the order of siblings
+static void
+bench_path_sum(cct_node_t* node, cct_op_arg_t arg, size_t level)
+{
+  uint64_t h = 0;
+  for (cct_node_t* n = node; n; n = hpcrun_cct_parent(n)) {
+    cct_addr_t* addr = hpcrun_cct_addr(n);
+    h = bench_hash(h, ((uint64_t)addr->ip_norm.lm_id << 48)
+		   ^ addr->ip_norm.lm_ip);
+  }
+  path_sum += h;
+}
+
+static double
+bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static void
+bench_insert(cct_node_t* root, int nsamples, int max_depth, int nsites,
+	     double* secs)
+{
+  cct_addr_t path[max_depth + 3];
+  memset(path, 0, sizeof(path));
+  srand(1);
+
+  double t0 = bench_now();
+  for (int s = 0; s < nsamples; s++) {
+    // main -> driver -> one of 'nsites' callers -> recursion (through
+    // a second call site only near the bottom) -> one of 32 statements
+    int n = 0;
+    path[n].ip_norm.lm_id = 1;
+    path[n++].ip_norm.lm_ip = 0x400000;
+    path[n].ip_norm.lm_id = 1;
+    path[n++].ip_norm.lm_ip = 0x401000 + 16 * (rand() % nsites);
+    int depth = 1 + rand() % max_depth;
+    for (int d = 0; d < depth; d++) {
+      path[n].ip_norm.lm_id = 2;
+      path[n++].ip_norm.lm_ip = 0x1000 + ((depth - d <= 3) ? 8 * (rand() % 2) : 0);
+    }
+    path[n].ip_norm.lm_id = 2;
+    path[n++].ip_norm.lm_ip = 0x2000 + 4 * (rand() % 32);
+
+    cct_node_t* node = root;
+    for (int i = 0; i < n; i++) {
+      node = hpcrun_cct_insert_addr(node, &path[i]);
+    }
+  }
+  *secs = bench_now() - t0;
+}
+
+int
+main(int argc, char* argv[])
+{
+  int nsamples  = (argc > 1) ? atoi(argv[1]) : 200000;
+  int max_depth = (argc > 2) ? atoi(argv[2]) : 12;
+  int nsites    = (argc > 3) ? atoi(argv[3]) : 1000;
+
+  uint64_t sums[2];
+  size_t nodes[2];
+  for (int mode = 0; mode < 2; mode++) {
+    hpcrun_cct_set_array_children(mode == 1);
+    // the second pass repeats the samples: the steady state, in which
+    // sample mostly finds existing nodes
+    double secs[2];
+    cct_node_t* root = hpcrun_cct_new();
+    bench_insert(root, nsamples, max_depth, nsites, &secs[0]);
+    bench_insert(root, nsamples, max_depth, nsites, &secs[1]);
+
+    path_sum = 0;
+    hpcrun_cct_walk_node_1st(root, bench_path_sum, NULL);
+    sums[mode] = path_sum;
+    nodes[mode] = hpcrun_cct_num_nodes(root);
+
+    double nframes = nsamples * (3.0 + (max_depth + 1) / 2.0);
+    printf("%-6s children: %zu nodes, ns/frame: %.1f (first pass), "
+	   "%.1f (second pass)\n", (mode == 1) ? "array" : "splay",
+	   nodes[mode], 1e9 * secs[0] / nframes, 1e9 * secs[1] / nframes);
+  }
+
+  bool ok = (sums[0] == sums[1] && nodes[0] == nodes[1]);
+  printf("%s\n", ok ? "same paths" : "MISMATCH");
+  return ok ? 0 : 1;
+}
+
+#endif
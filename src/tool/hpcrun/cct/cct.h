@@ -130,6 +130,8 @@ extern cct_node_t* hpcrun_cct_top_new(uint16_t lmid, uintptr_t lmip);
 extern cct_node_t* hpcrun_cct_parent(cct_node_t* node);
 extern int32_t hpcrun_cct_persistent_id(cct_node_t* node);
 extern cct_addr_t* hpcrun_cct_addr(cct_node_t* node);
+// metric set of a node, NULL if none (cf. cct2metrics.h)
+extern metric_set_t* hpcrun_cct_metrics(cct_node_t* node);
 extern bool hpcrun_cct_is_leaf(cct_node_t* node);
 //
 // NOTE: having no children is not exactly the same as being a leaf
@@ -143,6 +145,11 @@ extern bool hpcrun_cct_is_root(cct_node_t* node);
 // Mutator functions: modify a given cct
 //
 
+//
+// attach a metric set to a node (cf. cct2metrics_assoc)
+//
+extern void hpcrun_cct_set_metrics(cct_node_t* node, metric_set_t* metrics);
+
 //
 // Fundamental mutation operation: insert a given addr into the
 // set of children of a given cct node. Return the cct_node corresponding
@@ -241,6 +248,13 @@ extern void hpcrun_walk_path(cct_node_t* node, cct_op_t op, cct_op_arg_t arg);
 //
 extern void hpcrun_cct_walkset(cct_node_t* cct, cct_op_t fn, cct_op_arg_t arg);
 //
+// Representation of the children of a node: a splay tree (default)
+// or, if 'mode' is true, an array that becomes a hash table at high
+// fan-out.  Applies to nodes that acquire their first child after the
+// call; the two representations may coexist in one cct.
+//
+extern void hpcrun_cct_set_array_children(bool mode);
+//
 // Writing operation
 //
 // cct2metrics_t is defined in cct2metrics.h but we cannot include this header
@@ -13,6 +13,8 @@
 //
 // ******** Typedef ********
 //
+// N.B.: metric sets are held by the cct nodes themselves; a map
+// is always NULL and is retained for interfaces that pass one.
 //
 typedef struct cct2metrics_t cct2metrics_t;
 //
@@ -62,11 +64,8 @@ cct_metric_data_update(int metric_id,
 			  cct_node_t* x, update_metric_t type,
 			  cct_metric_data_t incr)
 {
-  if (! hpcrun_has_metric_set(x)) {
-    cct2metrics_assoc(x, hpcrun_metric_set_new());
-  }
-  metric_set_t* set = hpcrun_get_metric_set(x);
-  
+  metric_set_t* set = hpcrun_reify_metric_set(x);
+
   if (type == SET)
     hpcrun_metric_std_set(metric_id, set, incr);
   else if (type == INCR)
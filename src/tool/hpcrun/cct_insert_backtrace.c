@@ -181,12 +181,19 @@ hpcrun_cct_insert_backtrace_w_metric(cct_node_t* treenode,
 				     frame_t* path_beg, frame_t* path_end,
 				     cct_metric_data_t datum, void *data_aux)
 {
+  hpcrun_overhead_t* overhead =
+    &(hpcrun_get_thread_data()->core_profile_trace_data.overhead);
+  uint64_t overhead_start = hpcrun_overhead_ticks();
+
   cct_node_t* path = hpcrun_cct_insert_backtrace(treenode, path_beg, path_end);
 
   if (hpcrun_kernel_callpath) {
     path = hpcrun_kernel_callpath(path, data_aux);
   }
 
+  hpcrun_overhead_add(overhead, HPCRUN_OVERHEAD_CCT_INSERT, overhead_start);
+  overhead_start = hpcrun_overhead_ticks();
+
   metric_set_t* mset = hpcrun_reify_metric_set(path);
 
   metric_upd_proc_t* upd_proc = hpcrun_get_metric_proc(metric_id);
@@ -194,6 +201,8 @@ hpcrun_cct_insert_backtrace_w_metric(cct_node_t* treenode,
     upd_proc(metric_id, mset, datum);
   }
 
+  hpcrun_overhead_add(overhead, HPCRUN_OVERHEAD_METRIC, overhead_start);
+
   // POST-INVARIANT: metric set has been allocated for 'path'
 
   return path;
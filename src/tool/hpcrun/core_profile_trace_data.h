@@ -5,9 +5,11 @@
 #include <stdio.h>
 #include <lib/prof-lean/hpcio-buffer.h>
 #include <lib/prof-lean/hpcfmt.h> // for metric_aux_info_t
+#include <lib/prof-lean/hpcrun-fmt.h>
 
 #include "epoch.h"
 #include "cct2metrics.h"
+#include "sample_overhead.h"
 
 enum perf_ksym_e {PERF_UNDEFINED, PERF_AVAILABLE, PERF_UNAVAILABLE} ;
 
@@ -35,6 +37,10 @@ typedef struct core_profile_trace_data_t {
   FILE* hpcrun_file;
   void* trace_buffer;
   hpcio_outbuf_t trace_outbuf;
+  hpctrace_hdr_flags_t trace_flags;
+  hpctrace_fmt_block_t trace_block;
+  // next thread whose trace outbuf the background writer drains
+  struct core_profile_trace_data_t* trace_writer_next;
 
   // ----------------------------------------
   // Perf support
@@ -42,6 +48,11 @@ typedef struct core_profile_trace_data_t {
 
   metric_aux_info_t *perf_event_info;
 
+  // ----------------------------------------
+  // time spent handling samples
+  // ----------------------------------------
+  hpcrun_overhead_t overhead;
+
 } core_profile_trace_data_t;
 
 
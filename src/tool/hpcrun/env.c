@@ -49,9 +49,17 @@ const char* HPCRUN_OPT_LUSH_AGENTS = "HPCRUN_OPT_LUSH_AGENTS";
 
 const char* HPCRUN_OUT_PATH        = "HPCRUN_OUT_PATH";
 const char* HPCRUN_TRACE           = "HPCRUN_TRACE";
+const char* HPCRUN_TRACE_ASYNC     = "HPCRUN_TRACE_ASYNC";
+const char* HPCRUN_TRACE_DELTA     = "HPCRUN_TRACE_DELTA";
 
 const char* PAPI_EVENT_LIST        = "PAPI_EVENT_LIST";
 
 const char* HPCRUN_EVENT_LIST      = "HPCRUN_EVENT_LIST";
 const char* HPCRUN_MEMSIZE         = "HPCRUN_MEMSIZE";
 const char* HPCRUN_LOW_MEMSIZE     = "HPCRUN_LOW_MEMSIZE";
+const char* HPCRUN_MEMSTORE_HUGE   = "HPCRUN_MEMSTORE_HUGE";
+const char* HPCRUN_MEMSTORE_NUMA   = "HPCRUN_MEMSTORE_NUMA";
+
+const char* HPCRUN_FNBOUNDS_CACHE  = "HPCRUN_FNBOUNDS_CACHE";
+
+const char* HPCRUN_SAMPLE_OVERHEAD = "HPCRUN_SAMPLE_OVERHEAD";
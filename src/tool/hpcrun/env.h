@@ -84,9 +84,17 @@ extern const char* HPCRUN_OPT_LUSH_AGENTS;
 extern const char* HPCRUN_OUT_PATH;
 
 extern const char* HPCRUN_TRACE;
+extern const char* HPCRUN_TRACE_ASYNC;
+extern const char* HPCRUN_TRACE_DELTA;
 
 extern const char* HPCRUN_EVENT_LIST;
 extern const char* HPCRUN_MEMSIZE;
 extern const char* HPCRUN_LOW_MEMSIZE;
+extern const char* HPCRUN_MEMSTORE_HUGE;
+extern const char* HPCRUN_MEMSTORE_NUMA;
+
+extern const char* HPCRUN_FNBOUNDS_CACHE;
+
+extern const char* HPCRUN_SAMPLE_OVERHEAD;
 
 #endif /* hpcrun_env_h */
@@ -480,6 +480,21 @@ hpcrun_open_profile_file(int rank, int thread)
 }
 
 
+// Returns: file descriptor for sample overhead (hpcoverhead) file.
+int
+hpcrun_open_overhead_file(int rank, int thread)
+{
+  int ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  ret = hpcrun_open_file(rank, thread, HPCRUN_OverheadFnmSfx, FILES_LATE);
+  spinlock_unlock(&files_lock);
+
+  return ret;
+}
+
+
 // Note: we use the log file as the lock for the file names, so we
 // need to rename the log file as the first late action.  Since this
 // is out of sequence, we save the return value and return it when the
@@ -0,0 +1,414 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+// A persistent, on-disk cache of the fnbounds tables computed by the
+// hpcfnbounds server.  Every process in a large job otherwise asks
+// the server to re-parse the same set of load modules at startup.
+// When HPCRUN_FNBOUNDS_CACHE names a directory, each answer from the
+// server is saved there and later processes (and ranks, if the
+// directory is shared) mmap the saved table instead.
+//
+// Each module has one cache file, named by a hash of its path:
+//
+//   <dir>/<hash>.fnb:  header, module path, table of addresses
+//
+// Notes:
+// 1. An entry is valid only if the module's path, size and mtime
+// match the header and the checksum over the table matches.  Anything
+// else (stale entry, hash collision, truncated or corrupt file, other
+// architecture) is treated as a miss, and the fresh answer from the
+// server replaces the entry.
+//
+// 2. Entries are written to a temporary file and renamed into place,
+// so concurrent readers see either the old or the new file, never a
+// partial one.  Concurrent writers of the same entry are harmless.
+//
+// 3. The module is stat'ed before the server query and again before
+// storing, so a module that changes during the query is not saved.
+//
+// 4. The cache file is mapped private and read-write, the same as
+// the anonymous region from the server, and, like that region, stays
+// mapped for the life of the process.
+//
+// 5. Calls to fnbounds_cache_query() hold the FNBOUNDS_LOCK, the same
+// as hpcrun_syserv_query(), so the counters need no locking.
+
+//***************************************************************************
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "client.h"
+#include "env.h"
+#include "fnbounds_cache.h"
+#include "fnbounds_file_header.h"
+#include "messages.h"
+
+#define FNB_CACHE_MAGIC   "HPCFNB01"
+#define FNB_CACHE_ORDER   0x01020304
+#define FNB_CACHE_SUFFIX  ".fnb"
+
+// All fields are fixed width.  'order' and 'ptr_size' reject entries
+// written by a machine with a different byte order or address size.
+struct fnb_cache_header {
+  char      magic[8];
+  uint32_t  order;
+  uint32_t  ptr_size;
+  uint32_t  path_len;        // including the trailing \0
+  int32_t   is_relocatable;
+  uint64_t  mod_size;
+  uint64_t  mod_mtime_sec;
+  uint64_t  mod_mtime_nsec;
+  uint64_t  num_entries;
+  uint64_t  reference_offset;
+  uint64_t  table_offset;    // from start of file
+  uint64_t  checksum;        // over the table
+};
+
+static char cache_dir[PATH_MAX];
+static int  cache_enabled = 0;
+
+static long num_hits = 0;
+static long num_misses = 0;
+static long num_stale = 0;
+static long num_stores = 0;
+
+
+//*****************************************************************
+// Helper Functions
+//*****************************************************************
+
+// 64-bit FNV-1a, used for both the file name and the table checksum.
+#define FNV_OFFSET  14695981039346656037UL
+#define FNV_PRIME   1099511628211UL
+
+static uint64_t
+fnv_hash(const void *buf, size_t len)
+{
+  const unsigned char *p = (const unsigned char *) buf;
+  uint64_t hash = FNV_OFFSET;
+  size_t k;
+
+  for (k = 0; k < len; k++) {
+    hash = (hash ^ p[k]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+
+// Hash the table a word at a time, since it can be several Meg.
+static uint64_t
+table_checksum(void **table, uint64_t num_entries)
+{
+  uint64_t hash = FNV_OFFSET;
+  uint64_t k;
+
+  for (k = 0; k < num_entries; k++) {
+    hash = (hash ^ (uint64_t) (uintptr_t) table[k]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+
+// Returns: 0 on success, else -1 if the name does not fit.
+static int
+cache_file_name(char *buf, size_t size, const char *fname)
+{
+  int len = snprintf(buf, size, "%s/%016lx%s", cache_dir,
+		     (unsigned long) fnv_hash(fname, strlen(fname)),
+		     FNB_CACHE_SUFFIX);
+
+  return (len > 0 && len < size) ? 0 : -1;
+}
+
+
+static int
+write_all(int fd, const void *buf, size_t count)
+{
+  const char *p = (const char *) buf;
+  ssize_t ret;
+
+  while (count > 0) {
+    ret = write(fd, p, count);
+    if (ret < 0) {
+      if (errno == EINTR) {
+	continue;
+      }
+      return -1;
+    }
+    p += ret;
+    count -= ret;
+  }
+  return 0;
+}
+
+
+static int
+same_module(const struct stat *a, const struct stat *b)
+{
+  return a->st_size == b->st_size
+    && a->st_mtim.tv_sec == b->st_mtim.tv_sec
+    && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+
+//*****************************************************************
+// Lookup and Store
+//*****************************************************************
+
+// Returns: the mapped table for 'fname' and fills in 'fh', or else
+// NULL if there is no valid entry.
+static void *
+cache_lookup(const char *fname, const struct stat *st,
+	     struct fnbounds_file_header *fh)
+{
+  char path[PATH_MAX];
+  struct stat cst;
+  struct fnb_cache_header *hdr;
+  size_t path_len = strlen(fname) + 1;
+  void *addr;
+  int fd;
+
+  if (cache_file_name(path, sizeof(path), fname) != 0) {
+    return NULL;
+  }
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    num_misses++;
+    return NULL;
+  }
+  if (fstat(fd, &cst) != 0 || cst.st_size < sizeof(*hdr)) {
+    close(fd);
+    num_stale++;
+    return NULL;
+  }
+  addr = mmap(NULL, cst.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    num_misses++;
+    return NULL;
+  }
+
+  // Check the header against the module before trusting any offsets,
+  // and then check that the table lies within the file.
+  hdr = (struct fnb_cache_header *) addr;
+  if (memcmp(hdr->magic, FNB_CACHE_MAGIC, sizeof(hdr->magic)) != 0
+      || hdr->order != FNB_CACHE_ORDER
+      || hdr->ptr_size != sizeof(void *)
+      || hdr->path_len != path_len
+      || hdr->mod_size != (uint64_t) st->st_size
+      || hdr->mod_mtime_sec != (uint64_t) st->st_mtim.tv_sec
+      || hdr->mod_mtime_nsec != (uint64_t) st->st_mtim.tv_nsec
+      || hdr->table_offset < sizeof(*hdr) + path_len
+      || hdr->table_offset % sizeof(void *) != 0
+      || hdr->table_offset > cst.st_size
+      || hdr->num_entries > (cst.st_size - hdr->table_offset) / sizeof(void *)
+      || memcmp((char *) addr + sizeof(*hdr), fname, path_len) != 0) {
+    goto stale;
+  }
+
+  void **table = (void **) ((char *) addr + hdr->table_offset);
+  if (table_checksum(table, hdr->num_entries) != hdr->checksum) {
+    goto stale;
+  }
+
+  fh->num_entries = hdr->num_entries;
+  fh->reference_offset = hdr->reference_offset;
+  fh->is_relocatable = hdr->is_relocatable;
+  fh->mmap_size = cst.st_size;
+  num_hits++;
+
+  TMSG(DSO, "fnbounds cache hit: %s, symbols: %ld", fname,
+       (long) fh->num_entries);
+
+  return table;
+
+stale:
+  munmap(addr, cst.st_size);
+  num_stale++;
+  TMSG(DSO, "fnbounds cache stale entry: %s", fname);
+  return NULL;
+}
+
+
+static void
+cache_store(const char *fname, const struct stat *st, void **table,
+	    struct fnbounds_file_header *fh)
+{
+  char path[PATH_MAX];
+  char tmp_path[PATH_MAX];
+  struct fnb_cache_header hdr;
+  size_t path_len = strlen(fname) + 1;
+  size_t table_offset, pad;
+  char zeros[sizeof(void *)];
+  int fd, len;
+
+  if (cache_file_name(path, sizeof(path), fname) != 0) {
+    return;
+  }
+  len = snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int) getpid());
+  if (len < 0 || len >= sizeof(tmp_path)) {
+    return;
+  }
+
+  table_offset = sizeof(hdr) + path_len;
+  pad = (sizeof(void *) - table_offset % sizeof(void *)) % sizeof(void *);
+  table_offset += pad;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, FNB_CACHE_MAGIC, sizeof(hdr.magic));
+  hdr.order = FNB_CACHE_ORDER;
+  hdr.ptr_size = sizeof(void *);
+  hdr.path_len = path_len;
+  hdr.is_relocatable = fh->is_relocatable;
+  hdr.mod_size = st->st_size;
+  hdr.mod_mtime_sec = st->st_mtim.tv_sec;
+  hdr.mod_mtime_nsec = st->st_mtim.tv_nsec;
+  hdr.num_entries = fh->num_entries;
+  hdr.reference_offset = fh->reference_offset;
+  hdr.table_offset = table_offset;
+  hdr.checksum = table_checksum(table, fh->num_entries);
+  memset(zeros, 0, sizeof(zeros));
+
+  fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    return;
+  }
+  if (write_all(fd, &hdr, sizeof(hdr)) != 0
+      || write_all(fd, fname, path_len) != 0
+      || write_all(fd, zeros, pad) != 0
+      || write_all(fd, table, fh->num_entries * sizeof(void *)) != 0
+      || close(fd) != 0) {
+    TMSG(DSO, "fnbounds cache: unable to write %s", tmp_path);
+    unlink(tmp_path);
+    return;
+  }
+  if (rename(tmp_path, path) != 0) {
+    unlink(tmp_path);
+    return;
+  }
+  num_stores++;
+}
+
+
+//*****************************************************************
+// Interface Functions
+//*****************************************************************
+
+void
+fnbounds_cache_init(void)
+{
+  char *dir = getenv(HPCRUN_FNBOUNDS_CACHE);
+  size_t len;
+
+  cache_enabled = 0;
+  if (dir == NULL || dir[0] == 0) {
+    return;
+  }
+  len = strlen(dir);
+  while (len > 1 && dir[len - 1] == '/') {
+    len--;
+  }
+  if (len >= sizeof(cache_dir) - 32) {
+    EMSG("fnbounds cache: directory name too long: %s", dir);
+    return;
+  }
+  memcpy(cache_dir, dir, len);
+  cache_dir[len] = 0;
+
+  if (mkdir(cache_dir, 0755) != 0 && errno != EEXIST) {
+    EMSG("fnbounds cache: unable to create directory %s: %s",
+	 cache_dir, strerror(errno));
+    return;
+  }
+  cache_enabled = 1;
+
+  TMSG(DSO, "fnbounds cache: %s", cache_dir);
+}
+
+
+void
+fnbounds_cache_fini(void)
+{
+  if (cache_enabled) {
+    TMSG(DSO, "fnbounds cache: hits: %ld, misses: %ld, stale: %ld, stores: %ld",
+	 num_hits, num_misses, num_stale, num_stores);
+  }
+}
+
+
+void *
+fnbounds_cache_query(const char *fname, struct fnbounds_file_header *fh)
+{
+  struct stat st, st2;
+  void **table;
+
+  if (! cache_enabled || stat(fname, &st) != 0) {
+    return hpcrun_syserv_query(fname, fh);
+  }
+
+  table = (void **) cache_lookup(fname, &st, fh);
+  if (table != NULL) {
+    return table;
+  }
+
+  table = (void **) hpcrun_syserv_query(fname, fh);
+  if (table != NULL && fh->num_entries > 0
+      && stat(fname, &st2) == 0 && same_module(&st, &st2)) {
+    cache_store(fname, &st, table, fh);
+  }
+
+  return table;
+}
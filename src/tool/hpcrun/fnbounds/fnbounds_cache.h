@@ -0,0 +1,19 @@
+#ifndef _FNBOUNDS_CACHE_H_
+#define _FNBOUNDS_CACHE_H_
+
+#include "fnbounds_file_header.h"
+
+// Persistent on-disk cache of fnbounds tables, enabled by setting
+// HPCRUN_FNBOUNDS_CACHE to a directory (local or shared).  Entries
+// are keyed by the module's path, size and mtime.
+
+void fnbounds_cache_init(void);
+
+void fnbounds_cache_fini(void);
+
+// Same interface as hpcrun_syserv_query(): returns the table of
+// addresses and fills in 'fh', using the cache if possible and
+// otherwise asking the server and saving the answer in the cache.
+void *fnbounds_cache_query(const char *fname, struct fnbounds_file_header *fh);
+
+#endif  // _FNBOUNDS_CACHE_H_
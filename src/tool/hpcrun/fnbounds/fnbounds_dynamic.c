@@ -93,6 +93,7 @@
 #include "fnbounds_interface.h"
 #include "fnbounds_file_header.h"
 #include "client.h"
+#include "fnbounds_cache.h"
 #include "dylib.h"
 
 #include <hpcrun/main.h>
@@ -178,6 +179,7 @@ fnbounds_init()
   if (hpcrun_get_disabled()) return 0;
 
   hpcrun_syserv_init();
+  fnbounds_cache_init();
   fnbounds_map_executable();
   fnbounds_map_open_dsos();
 
@@ -288,7 +290,7 @@ fnbounds_dso_exec(void)
 
   TMSG(MAP_EXEC, "Entry");
   realpath("/proc/self/exe", filename);
-  void** nm_table = (void**) hpcrun_syserv_query(filename, &fh);
+  void** nm_table = (void**) fnbounds_cache_query(filename, &fh);
   if (! nm_table) {
     EMSG("No nm_table for executable %s", filename);
     return hpcrun_dso_make(filename, NULL, NULL, NULL, NULL, 0);
@@ -391,6 +393,7 @@ fnbounds_fini()
 {
   if (hpcrun_get_disabled()) return;
 
+  fnbounds_cache_fini();
   hpcrun_syserv_fini();
 }
 
@@ -446,7 +449,7 @@ fnbounds_compute(const char* incoming_filename, void* start, void* end)
 
   realpath(incoming_filename, filename);
 
-  nm_table = (void**) hpcrun_syserv_query(filename, &fh);
+  nm_table = (void**) fnbounds_cache_query(filename, &fh);
   if (nm_table == NULL) {
     return hpcrun_dso_make(filename, NULL, NULL, start, end, 0);
   }
@@ -79,6 +79,12 @@ static atomic_long trolled = ATOMIC_VAR_INIT(0);
 static atomic_long frames_total = ATOMIC_VAR_INIT(0);
 static atomic_long trolled_frames = ATOMIC_VAR_INIT(0);
 
+static atomic_long num_trace_stalls = ATOMIC_VAR_INIT(0);
+
+static atomic_long num_perf_drains = ATOMIC_VAR_INIT(0);
+static atomic_long num_perf_records = ATOMIC_VAR_INIT(0);
+static atomic_long num_perf_records_lost = ATOMIC_VAR_INIT(0);
+
 //***************************************************************************
 // interface operations
 //***************************************************************************
@@ -97,6 +103,10 @@ hpcrun_stats_reinit(void)
   atomic_store_explicit(&trolled, 0, memory_order_relaxed);
   atomic_store_explicit(&frames_total, 0, memory_order_relaxed);
   atomic_store_explicit(&trolled_frames, 0, memory_order_relaxed);
+  atomic_store_explicit(&num_trace_stalls, 0, memory_order_relaxed);
+  atomic_store_explicit(&num_perf_drains, 0, memory_order_relaxed);
+  atomic_store_explicit(&num_perf_records, 0, memory_order_relaxed);
+  atomic_store_explicit(&num_perf_records_lost, 0, memory_order_relaxed);
 }
 
 
@@ -331,6 +341,70 @@ hpcrun_stats_num_samples_yielded(void)
   return atomic_load_explicit(&num_samples_yielded, memory_order_relaxed);
 }
 
+//----------------------------
+// samples that found the async trace buffer ring full
+//----------------------------
+
+void
+hpcrun_stats_num_trace_stalls_inc(long amt)
+{
+  atomic_fetch_add_explicit(&num_trace_stalls, amt, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_num_trace_stalls(void)
+{
+  return atomic_load_explicit(&num_trace_stalls, memory_order_relaxed);
+}
+
+//----------------------------
+// perf buffer drains
+//----------------------------
+
+void
+hpcrun_stats_num_perf_drains_inc(void)
+{
+  atomic_fetch_add_explicit(&num_perf_drains, 1L, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_num_perf_drains(void)
+{
+  return atomic_load_explicit(&num_perf_drains, memory_order_relaxed);
+}
+
+//----------------------------
+// sample records read from perf buffers
+//----------------------------
+
+void
+hpcrun_stats_num_perf_records_inc(long amt)
+{
+  atomic_fetch_add_explicit(&num_perf_records, amt, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_num_perf_records(void)
+{
+  return atomic_load_explicit(&num_perf_records, memory_order_relaxed);
+}
+
+//----------------------------
+// records lost by the kernel (full perf buffer or throttling)
+//----------------------------
+
+void
+hpcrun_stats_num_perf_records_lost_inc(long amt)
+{
+  atomic_fetch_add_explicit(&num_perf_records_lost, amt, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_num_perf_records_lost(void)
+{
+  return atomic_load_explicit(&num_perf_records_lost, memory_order_relaxed);
+}
+
 //-----------------------------
 // print summary
 //-----------------------------
@@ -362,6 +436,20 @@ hpcrun_stats_print_summary(void)
        frames_total, trolled_frames,
        num_unwind_intervals_total,  num_unwind_intervals_suspicious);
 
+  long trace_stalls = atomic_load_explicit(&num_trace_stalls, memory_order_relaxed);
+  if (trace_stalls > 0) {
+    AMSG("TRACE: stalls: %ld (full async trace buffers written by the sampling thread)",
+	 trace_stalls);
+  }
+
+  long perf_drains = atomic_load_explicit(&num_perf_drains, memory_order_relaxed);
+  if (perf_drains > 0) {
+    long perf_records = atomic_load_explicit(&num_perf_records, memory_order_relaxed);
+    AMSG("PERF: drains: %ld, records: %ld (%.1f per drain), lost: %ld",
+	 perf_drains, perf_records, (double) perf_records / perf_drains,
+	 atomic_load_explicit(&num_perf_records_lost, memory_order_relaxed));
+  }
+
   if (hpcrun_get_disabled()) {
     AMSG("SAMPLING HAS BEEN DISABLED");
   }
@@ -158,6 +158,26 @@ long hpcrun_stats_frames_total(void);
 void hpcrun_stats_trolled_frames_inc(long amt);
 long hpcrun_stats_trolled_frames(void);
 
+//----------------------------
+// samples that found the async trace buffer ring full
+//----------------------------
+
+void hpcrun_stats_num_trace_stalls_inc(long amt);
+long hpcrun_stats_num_trace_stalls(void);
+
+//----------------------------
+// perf buffer drains, records drained, and records lost by the kernel
+//----------------------------
+
+void hpcrun_stats_num_perf_drains_inc(void);
+long hpcrun_stats_num_perf_drains(void);
+
+void hpcrun_stats_num_perf_records_inc(long amt);
+long hpcrun_stats_num_perf_records(void);
+
+void hpcrun_stats_num_perf_records_lost_inc(long amt);
+long hpcrun_stats_num_perf_records_lost(void);
+
 //-----------------------------
 // print summary
 //-----------------------------
@@ -57,11 +57,15 @@
 
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/stdatomic.h>
 
 #define LOADMAP_DEBUG 0
 
 #define UW_RECIPE_MAP_DEBUG 0
 
+#define LM_INDEX_INIT_SIZE  64
+#define LM_INDEX_MAX_TRIES  4
+
 static hpcrun_loadmap_t  s_loadmap;
 static hpcrun_loadmap_t* s_loadmap_ptr = NULL;
 
@@ -103,6 +107,185 @@ hpcrun_loadmap_notify_unmap(void *start, void *end)
 }
 
 
+//***************************************************************************
+// address index
+//***************************************************************************
+
+// A sorted array of the address ranges of the mapped load modules, so
+// that hpcrun_loadmap_findByAddr() is a binary search instead of a
+// walk of the lm_head list (processes may map thousands of modules).
+//
+// Writers (map and unmap) are serialized by the fnbounds lock, but
+// readers run in sample handlers without a lock, so the index is
+// protected by a sequence count.  A writer makes the count odd while
+// it edits the array and a reader retries if the count changed during
+// its search.  A reader that finds the count odd (eg, a sample that
+// interrupts a writer in the same thread) walks the list instead.
+//
+// The array grows by doubling and old arrays are never freed, so a
+// reader with a stale array pointer always reads valid memory.
+
+typedef struct lm_index_entry_t {
+  uintptr_t start;
+  uintptr_t end;
+  uintptr_t max_end;  // max of 'end' over entries [0, i]
+  load_module_t* lm;
+} lm_index_entry_t;
+
+static lm_index_entry_t* lm_index = NULL;
+static long lm_index_size = 0;
+static long lm_index_cap = 0;
+static int  lm_index_valid = 1;
+
+static atomic_ulong lm_index_seq = ATOMIC_VAR_INIT(0);
+
+
+static void
+lm_index_write_begin(void)
+{
+  atomic_fetch_add_explicit(&lm_index_seq, 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+
+static void
+lm_index_write_end(void)
+{
+  atomic_fetch_add_explicit(&lm_index_seq, 1, memory_order_release);
+}
+
+
+// Recompute the prefix max of the end addresses starting at 'i'.
+// Modules' ranges normally don't overlap, but the prefix max lets
+// the search step back over ranges that end before 'end'.
+static void
+lm_index_fix_max(long i)
+{
+  uintptr_t max_end = (i > 0) ? lm_index[i - 1].max_end : 0;
+
+  for (; i < lm_index_size; i++) {
+    if (lm_index[i].end > max_end) {
+      max_end = lm_index[i].end;
+    }
+    lm_index[i].max_end = max_end;
+  }
+}
+
+
+static void
+lm_index_remove(load_module_t* lm)
+{
+  for (long i = 0; i < lm_index_size; i++) {
+    if (lm_index[i].lm == lm) {
+      lm_index_write_begin();
+      memmove(&lm_index[i], &lm_index[i + 1],
+	      (lm_index_size - i - 1) * sizeof(lm_index_entry_t));
+      lm_index_size--;
+      lm_index_fix_max(i);
+      lm_index_write_end();
+      return;
+    }
+  }
+}
+
+
+static void
+lm_index_insert(load_module_t* lm)
+{
+  uintptr_t start = (uintptr_t) lm->dso_info->start_addr;
+  uintptr_t end = (uintptr_t) lm->dso_info->end_addr;
+  lm_index_entry_t* index = lm_index;
+  long cap = lm_index_cap;
+
+  lm_index_remove(lm);
+
+  if (lm_index_size == lm_index_cap) {
+    cap = (lm_index_cap > 0) ? 2 * lm_index_cap : LM_INDEX_INIT_SIZE;
+    index = (lm_index_entry_t*) hpcrun_malloc(cap * sizeof(lm_index_entry_t));
+    if (index == NULL) {
+      lm_index_valid = 0;
+      return;
+    }
+    if (lm_index_size > 0) {
+      memcpy(index, lm_index, lm_index_size * sizeof(lm_index_entry_t));
+    }
+  }
+
+  // insert after any entries with the same start
+  long lo = 0, hi = lm_index_size;
+  while (lo < hi) {
+    long mid = (lo + hi) / 2;
+    if (index[mid].start <= start) { lo = mid + 1; } else { hi = mid; }
+  }
+
+  lm_index_write_begin();
+  lm_index = index;
+  lm_index_cap = cap;
+  memmove(&lm_index[lo + 1], &lm_index[lo],
+	  (lm_index_size - lo) * sizeof(lm_index_entry_t));
+  lm_index[lo].start = start;
+  lm_index[lo].end = end;
+  lm_index[lo].lm = lm;
+  lm_index_size++;
+  lm_index_fix_max(lo);
+  lm_index_write_end();
+}
+
+
+// Returns: 1 and sets 'lm' (possibly to NULL) if the search
+// completed, else 0 if the index is in flux and the caller should
+// walk the list.
+static int
+lm_index_find(uintptr_t begin, uintptr_t end, load_module_t** lm)
+{
+  if (! lm_index_valid) {
+    return 0;
+  }
+
+  for (int tries = 0; tries < LM_INDEX_MAX_TRIES; tries++) {
+    unsigned long seq = atomic_load_explicit(&lm_index_seq, memory_order_acquire);
+    if (seq & 1) {
+      return 0;
+    }
+
+    lm_index_entry_t* index = lm_index;
+    long size = lm_index_size;
+    load_module_t* ans = NULL;
+
+    // find the last entry with start <= begin, then step back while
+    // an earlier range could still contain [begin, end]
+    long lo = 0, hi = size;
+    while (lo < hi) {
+      long mid = (lo + hi) / 2;
+      if (index[mid].start <= begin) { lo = mid + 1; } else { hi = mid; }
+    }
+    for (long i = lo - 1; i >= 0 && index[i].max_end >= end; i--) {
+      if (end <= index[i].end) {
+	ans = index[i].lm;
+	break;
+      }
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&lm_index_seq, memory_order_relaxed) == seq) {
+      *lm = ans;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+static void
+lm_index_reset(void)
+{
+  lm_index_size = 0;
+  lm_index_valid = 1;
+  atomic_store_explicit(&lm_index_seq, 0, memory_order_relaxed);
+}
+
+
 //***************************************************************************
 // 
 //***************************************************************************
@@ -288,6 +471,13 @@ load_module_t*
 hpcrun_loadmap_findByAddr(void* begin, void* end)
 {
   TMSG(LOADMAP, "find by address %p -- %p", begin, end);
+
+  load_module_t* lm = NULL;
+  if (lm_index_find((uintptr_t) begin, (uintptr_t) end, &lm)) {
+    TMSG(LOADMAP, "       --->%s", (lm) ? lm->name : "(NOT FOUND)");
+    return lm;
+  }
+
   for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
     TMSG(LOADMAP, "\tload module %s", x->name);
     if (x->dso_info) {
@@ -447,6 +637,8 @@ hpcrun_loadmap_map(dso_info_t* dso)
 
   }
 
+  lm_index_insert(lm);
+
   hpcrun_loadmap_notify_map(lm->dso_info->start_addr, 
 			    lm->dso_info->end_addr);
 
@@ -469,6 +661,7 @@ hpcrun_loadmap_unmap(load_module_t* lm)
   void *start_addr = old_dso->start_addr;
   void *end_addr = old_dso->end_addr;
 
+  lm_index_remove(lm);
   lm->dso_info = NULL;
 
   // tallent: For now, do not move the loadmap to the back of the
@@ -522,6 +715,7 @@ hpcrun_initLoadmap()
   hpcrun_loadmap_init(s_loadmap_ptr);
 
   s_dso_free_list = NULL;
+  lm_index_reset();
 }
 
 
@@ -530,3 +724,167 @@ hpcrun_getLoadmap()
 {
   return s_loadmap_ptr;
 }
+
+
+//***************************************************************************
+// unit test
+//***************************************************************************
+// #define UNIT_TEST_LOADMAP_INDEX
+
+#ifdef UNIT_TEST_LOADMAP_INDEX
+
+// Benchmark of hpcrun_loadmap_findByAddr() with the address index
+// against the walk of the lm_head list.  Maps made-up modules in a
+// random order, times lookups of random addresses (in modules and in
+// the gaps between them) both ways and checks every answer.  Then a
+// reader thread looks up the modules that stay mapped while this
+// thread unmaps and maps the others.  Link with stand-ins for
+// hpcrun_malloc and messages.
+//
+// usage: a.out [modules] [lookups]
+
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+
+#define BENCH_LM_BASE  0x10000000UL
+#define BENCH_LM_SPAN  0x100000UL   // module i starts at BASE + i * SPAN
+#define BENCH_LM_SIZE  0x80000UL    // and the rest of the span is a gap
+
+static long bench_nlms;
+static load_module_t** bench_lm;
+static volatile int bench_done;
+
+static double
+bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static uint64_t
+bench_random(uint64_t *x)
+{
+  *x ^= *x << 13;
+  *x ^= *x >> 7;
+  *x ^= *x << 17;
+  return *x;
+}
+
+// the module that contains 'addr' if every module were mapped
+static load_module_t*
+bench_expect(uintptr_t addr)
+{
+  uintptr_t i = (addr - BENCH_LM_BASE) / BENCH_LM_SPAN;
+  uintptr_t off = (addr - BENCH_LM_BASE) % BENCH_LM_SPAN;
+  return (off <= BENCH_LM_SIZE) ? bench_lm[i] : NULL;
+}
+
+static double
+bench_lookups(uintptr_t *addr, long n)
+{
+  double t0 = bench_now();
+  for (long i = 0; i < n; i++) {
+    void *a = (void *) addr[i];
+    load_module_t *lm = hpcrun_loadmap_findByAddr(a, a);
+    assert(lm == bench_expect(addr[i]));
+  }
+  return (bench_now() - t0) / n;
+}
+
+// look up the odd modules, which stay mapped
+static void *
+bench_reader(void *arg)
+{
+  uint64_t x = 88172645463325252ULL;
+  long *n = arg;
+
+  while (! bench_done) {
+    uintptr_t i = 2 * (bench_random(&x) % (bench_nlms / 2)) + 1;
+    void *a = (void *) (BENCH_LM_BASE + i * BENCH_LM_SPAN
+			+ (x >> 32) % BENCH_LM_SIZE);
+    load_module_t *lm = hpcrun_loadmap_findByAddr(a, a);
+    assert(lm == bench_lm[i]);
+    (*n)++;
+  }
+  return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+  bench_nlms   = (argc > 1) ? atol(argv[1]) : 4096;
+  long lookups = (argc > 2) ? atol(argv[2]) : 1000000;
+  long list_lookups = lookups / 100 + 1;
+  uint64_t x = 2463534242ULL;
+  assert(bench_nlms >= 2);
+
+  bench_lm = malloc(bench_nlms * sizeof(*bench_lm));
+  long *perm = malloc(bench_nlms * sizeof(*perm));
+  uintptr_t *addr = malloc(lookups * sizeof(*addr));
+
+  hpcrun_initLoadmap();
+
+  for (long i = 0; i < bench_nlms; i++) {
+    perm[i] = i;
+  }
+  for (long i = bench_nlms - 1; i > 0; i--) {
+    long j = bench_random(&x) % (i + 1);
+    long tmp = perm[i]; perm[i] = perm[j]; perm[j] = tmp;
+  }
+
+  double t0 = bench_now();
+  for (long k = 0; k < bench_nlms; k++) {
+    long i = perm[k];
+    char name[32];
+    void *start = (void *) (BENCH_LM_BASE + i * BENCH_LM_SPAN);
+    snprintf(name, sizeof(name), "/bench/lib%ld.so", i);
+    dso_info_t *dso = hpcrun_dso_make(name, NULL, NULL, start,
+				      start + BENCH_LM_SIZE, BENCH_LM_SIZE);
+    bench_lm[i] = hpcrun_loadmap_map(dso);
+  }
+  double t_map = bench_now() - t0;
+
+  for (long i = 0; i < lookups; i++) {
+    addr[i] = BENCH_LM_BASE + bench_random(&x) % (bench_nlms * BENCH_LM_SPAN);
+  }
+
+  double t_index = bench_lookups(addr, lookups);
+  lm_index_valid = 0;
+  double t_list = bench_lookups(addr, list_lookups);
+  lm_index_valid = 1;
+
+  // below and above every module
+  assert(hpcrun_loadmap_findByAddr((void *) 1, (void *) 1) == NULL);
+  void *top = (void *) (BENCH_LM_BASE + bench_nlms * BENCH_LM_SPAN);
+  assert(hpcrun_loadmap_findByAddr(top, top) == NULL);
+
+  // unmap and map the even modules under a reader
+  pthread_t reader;
+  long nread = 0;
+  pthread_create(&reader, NULL, bench_reader, &nread);
+  long remaps = 0;
+  t0 = bench_now();
+  while (bench_now() - t0 < 1.0) {
+    long i = 2 * (bench_random(&x) % (bench_nlms / 2));
+    dso_info_t *dso = bench_lm[i]->dso_info;
+    hpcrun_loadmap_unmap(bench_lm[i]);
+    void *a = dso->start_addr;
+    assert(hpcrun_loadmap_findByAddr(a, a) == NULL);
+    dso = hpcrun_dso_make(bench_lm[i]->name, NULL, NULL, a,
+			  a + BENCH_LM_SIZE, BENCH_LM_SIZE);
+    assert(hpcrun_loadmap_map(dso) == bench_lm[i]);
+    remaps++;
+  }
+  bench_done = 1;
+  pthread_join(reader, NULL);
+  assert(bench_lookups(addr, lookups) >= 0);
+
+  printf("modules: %ld, map: %.1f us each\n", bench_nlms, 1e6 * t_map / bench_nlms);
+  printf("lookup: index %.1f ns, list %.1f ns\n", 1e9 * t_index, 1e9 * t_list);
+  printf("remaps: %ld with %ld concurrent lookups\n", remaps, nread);
+  return 0;
+}
+
+#endif
@@ -126,6 +126,7 @@
 
 #include <unwind/common/backtrace.h>
 #include <unwind/common/unwind.h>
+#include <unwind/common/uw_recipe_map.h>
 
 #include <utilities/arch/context-pc.h>
 
@@ -417,6 +418,9 @@ hpcrun_init_internal(bool is_child)
   // first instance of recursive call
   hpcrun_set_retain_recursion_mode(getenv("HPCRUN_RETAIN_RECURSION") != NULL);
 
+  // Decide whether cct nodes keep their children in splay trees or arrays
+  hpcrun_cct_set_array_children(getenv("HPCRUN_CCT_ARRAY") != NULL);
+
   // Initialize logical unwinding agents (LUSH)
   if (opts.lush_agent_paths[0] != '\0') {
     epoch_t* epoch = TD_GET(core_profile_trace_data.epoch);
@@ -731,6 +735,7 @@ hpcrun_thread_fini(epoch_t *epoch)
     SAMPLE_SOURCES(stop);
     SAMPLE_SOURCES(thread_fini_action);
     lushPthr_thread_fini(&TD_GET(pthr_metrics));
+    uw_recipe_map_thread_fini();
 
     if (hpcrun_get_disabled()) {
       return;
@@ -51,9 +51,15 @@
 // When memory gets low, we write out an epoch and reclaim the CCT
 // nodes.
 //
+// Optionally, memstores are backed by huge pages to cut TLB misses in
+// the sample handler (HPCRUN_MEMSTORE_HUGE=thp or explicit), and
+// placed on the owning thread's NUMA node (HPCRUN_MEMSTORE_NUMA).
+// Both fall back to plain pages if the system doesn't cooperate.
+//
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 
 #include <errno.h>
@@ -78,11 +84,24 @@
 #define DEFAULT_MEMSIZE   (4 * 1024 * 1024)
 #define MIN_LOW_MEMSIZE  (80 * 1024)
 #define DEFAULT_PAGESIZE  4096
+#define HUGE_PAGESIZE    (2 * 1024 * 1024)
+
+// from <numaif.h>, without requiring libnuma
+#define HPCRUN_MPOL_PREFERRED  1
+#define NUMA_MASK_WORDS  16
+
+enum {
+  HUGE_NONE = 0,
+  HUGE_THP,       // transparent huge pages via madvise
+  HUGE_EXPLICIT   // hugetlbfs pages via MAP_HUGETLB, else THP
+};
 
 static size_t memsize = DEFAULT_MEMSIZE;
 static size_t low_memsize = MIN_LOW_MEMSIZE;
 static size_t pagesize = DEFAULT_PAGESIZE;
 static int allow_extra_mmap = 1;
+static int huge_mode = HUGE_NONE;
+static int numa_local = 0;
 
 static long num_segments = 0;
 static long total_allocation = 0;
@@ -90,6 +109,11 @@ static long num_reclaims = 0;
 static long num_failures = 0;
 static long total_freeable = 0;
 static long total_non_freeable = 0;
+static long num_huge_segments = 0;
+static long num_thp_segments = 0;
+static long num_huge_fallbacks = 0;
+static long num_numa_local = 0;
+static long num_numa_failures = 0;
 
 static int out_of_mem_mesg = 0;
 
@@ -140,9 +164,17 @@ hpcrun_mem_init(void)
       low_memsize = MIN_LOW_MEMSIZE;
   }
 
+  str = getenv(HPCRUN_MEMSTORE_HUGE);
+  if (str != NULL) {
+    huge_mode = (strcmp(str, "explicit") == 0) ? HUGE_EXPLICIT : HUGE_THP;
+    memsize = ((memsize + HUGE_PAGESIZE - 1)/HUGE_PAGESIZE) * HUGE_PAGESIZE;
+  }
+  numa_local = (getenv(HPCRUN_MEMSTORE_NUMA) != NULL);
+
   TMSG(MALLOC, "%s: pagesize = %ld, memsize = %ld, "
-       "low memsize = %ld, extra mmap = %d",
-       __func__, pagesize, memsize, low_memsize, allow_extra_mmap);
+       "low memsize = %ld, extra mmap = %d, huge = %d, numa = %d",
+       __func__, pagesize, memsize, low_memsize, allow_extra_mmap,
+       huge_mode, numa_local);
   init_done = 1;
 }
 
@@ -192,6 +224,103 @@ hpcrun_mmap_anon(size_t size)
   return addr;
 }
 
+//
+// Map a memstore with huge pages: MAP_HUGETLB first if explicit,
+// else (or if that fails) an aligned region advised for THP.
+//
+// Returns: address of mmap-ed region, else NULL on failure.
+//
+static void *
+hpcrun_mmap_huge(size_t size)
+{
+  void *addr;
+
+  size = ((size + HUGE_PAGESIZE - 1)/HUGE_PAGESIZE) * HUGE_PAGESIZE;
+
+#if defined(MAP_HUGETLB) && defined(MAP_ANONYMOUS)
+  if (huge_mode == HUGE_EXPLICIT) {
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (addr != MAP_FAILED) {
+      num_segments++;
+      num_huge_segments++;
+      total_allocation += size;
+      TMSG(MALLOC, "%s: hugetlb size = %ld, addr = %p", __func__, size, addr);
+      return addr;
+    }
+    // no hugetlbfs pages reserved, try THP
+    num_huge_fallbacks++;
+  }
+#endif
+
+  // THP needs a huge page aligned region, so over-map and trim.
+  char *start = hpcrun_mmap_anon(size + HUGE_PAGESIZE);
+  if (start == NULL) {
+    return NULL;
+  }
+  char *aligned = (char *)
+    (((uintptr_t) start + HUGE_PAGESIZE - 1) & ~((uintptr_t) HUGE_PAGESIZE - 1));
+  if (aligned > start) {
+    munmap(start, aligned - start);
+  }
+  if (start + HUGE_PAGESIZE > aligned) {
+    munmap(aligned + size, start + HUGE_PAGESIZE - aligned);
+  }
+  total_allocation -= HUGE_PAGESIZE;
+
+#if defined(MADV_HUGEPAGE)
+  if (madvise(aligned, size, MADV_HUGEPAGE) == 0) {
+    num_thp_segments++;
+  } else {
+    num_huge_fallbacks++;
+  }
+#else
+  num_huge_fallbacks++;
+#endif
+
+  TMSG(MALLOC, "%s: thp size = %ld, addr = %p", __func__, size, aligned);
+  return aligned;
+}
+
+//
+// Prefer the NUMA node of the calling (owning) thread for the
+// memstore, even if the thread later migrates, and first-touch it
+// here so that the sample handler doesn't take the page faults.
+//
+static void
+hpcrun_mem_bind_local(void *addr, size_t size)
+{
+#if defined(SYS_getcpu) && defined(SYS_mbind)
+  unsigned long mask[NUMA_MASK_WORDS];
+  unsigned int cpu, node;
+  int nbits = 8 * sizeof(unsigned long);
+
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0
+      || node >= NUMA_MASK_WORDS * nbits) {
+    num_numa_failures++;
+    return;
+  }
+  memset(mask, 0, sizeof(mask));
+  mask[node / nbits] = 1UL << (node % nbits);
+
+  // maxnode is one more than the number of bits in the mask
+  if (syscall(SYS_mbind, addr, size, HPCRUN_MPOL_PREFERRED, mask,
+	      NUMA_MASK_WORDS * nbits + 1, 0) != 0) {
+    num_numa_failures++;
+  } else {
+    num_numa_local++;
+  }
+  TMSG(MALLOC, "%s: addr = %p, node = %u", __func__, addr, node);
+#else
+  num_numa_failures++;
+#endif
+
+  size_t step = (huge_mode != HUGE_NONE) ? HUGE_PAGESIZE : pagesize;
+  for (size_t off = 0; off < size; off += step) {
+    ((volatile char *) addr)[off] = 0;
+  }
+}
+
 //------------------------------------------------------------------
 // External functions
 //------------------------------------------------------------------
@@ -237,7 +366,14 @@ hpcrun_make_memstore(hpcrun_meminfo_t *mi, int is_child)
     return;
   }
 
-  addr = hpcrun_mmap_anon(memsize);
+  if (huge_mode != HUGE_NONE) {
+    addr = hpcrun_mmap_huge(memsize);
+  } else {
+    addr = hpcrun_mmap_anon(memsize);
+  }
+  if (addr != NULL && numa_local) {
+    hpcrun_mem_bind_local(addr, memsize);
+  }
   if (addr == NULL) {
     if (! out_of_mem_mesg) {
       EMSG("%s: out of memory, shutting down sampling", __func__);
@@ -395,4 +531,126 @@ hpcrun_memory_summary(void)
   AMSG("MEMORY: total freeable: %.1f meg, total non-freeable: %.1f meg, "
        "malloc failures: %ld",
        total_freeable/meg, total_non_freeable/meg, num_failures);
+
+  if (huge_mode != HUGE_NONE || numa_local) {
+    AMSG("MEMORY: hugetlb segments: %ld, thp segments: %ld, "
+	 "huge page fallbacks: %ld, numa local: %ld, numa failures: %ld",
+	 num_huge_segments, num_thp_segments, num_huge_fallbacks,
+	 num_numa_local, num_numa_failures);
+  }
+}
+
+//***************************************************************************
+// unit test
+//***************************************************************************
+// #define UNIT_TEST_MEMSTORE
+
+#ifdef UNIT_TEST_MEMSTORE
+
+// Memstore benchmark for the page modes.  For plain pages, THP and
+// explicit huge pages, each with and without NUMA placement, allocates
+// cct-node sized objects with hpcrun_malloc, as the sample handler
+// does, links them in a random cycle and chases it, which is
+// dominated by TLB misses on a large enough cct.  Reports the time
+// per allocation and per step, and checks that every object lies in
+// its memstore, that THP memstores are huge page aligned, and that
+// every mode walks the same cycle.  Link with env.o and with stand-ins
+// for the thread data (hpcrun_get_thread_data) and messages.
+//
+// usage: a.out [objects] [steps per object]
+
+#include <assert.h>
+#include <time.h>
+
+bool private_hpcrun_sampling_disabled = false;
+
+typedef struct bench_node_s {
+  struct bench_node_s *next;
+  uint64_t val;
+  char pad[48];
+} bench_node_t;
+
+static double
+bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
 }
+
+int
+main(int argc, char **argv)
+{
+  long n     = (argc > 1) ? atol(argv[1]) : 1000000;
+  long steps = (argc > 2) ? atol(argv[2]) : 8;
+  static const char *huge_name[] = { "plain", "thp", "explicit" };
+
+  bench_node_t **node = malloc(n * sizeof(*node));
+  long *perm = malloc(n * sizeof(*perm));
+  assert(node != NULL && perm != NULL);
+
+  hpcrun_mem_init();
+
+  printf("%-9s %5s %12s %12s %9s %7s %5s %9s %5s\n", "pages", "numa",
+	 "alloc ns", "step ns", "segments", "hugetlb", "thp", "fallbacks",
+	 "local");
+
+  for (int mode = HUGE_NONE; mode <= HUGE_EXPLICIT; mode++) {
+    for (int numa = 0; numa <= 1; numa++) {
+      hpcrun_meminfo_t *mi = &TD_GET(memstore);
+      long segments = num_segments, hugetlb = num_huge_segments;
+      long thp = num_thp_segments, fallbacks = num_huge_fallbacks;
+      long local = num_numa_local;
+
+      huge_mode = mode;
+      numa_local = numa;
+      mi->mi_start = NULL;
+
+      double t0 = bench_now();
+      for (long i = 0; i < n; i++) {
+	node[i] = hpcrun_malloc(sizeof(bench_node_t));
+	assert(node[i] != NULL);
+	assert(mi->mi_start <= (void *) node[i]
+	       && (void *) (node[i] + 1) <= mi->mi_start + mi->mi_size);
+	if (num_thp_segments > thp) {
+	  assert(((uintptr_t) mi->mi_start & (HUGE_PAGESIZE - 1)) == 0);
+	}
+	node[i]->val = i;
+      }
+      double t_alloc = bench_now() - t0;
+
+      // the same random cycle in every mode
+      srandom(1);
+      for (long i = 0; i < n; i++) {
+	perm[i] = i;
+      }
+      for (long i = n - 1; i > 0; i--) {
+	long j = random() % (i + 1);
+	long tmp = perm[i]; perm[i] = perm[j]; perm[j] = tmp;
+      }
+      for (long i = 0; i < n; i++) {
+	node[perm[i]]->next = node[perm[(i + 1) % n]];
+      }
+
+      t0 = bench_now();
+      bench_node_t *p = node[0];
+      uint64_t sum = 0;
+      for (long i = 0; i < steps * n; i++) {
+	sum += p->val;
+	p = p->next;
+      }
+      double t_step = bench_now() - t0;
+      assert(p == node[0]);
+      assert(sum == (uint64_t) steps * n * (n - 1) / 2);
+
+      printf("%-9s %5d %12.1f %12.1f %9ld %7ld %5ld %9ld %5ld\n",
+	     huge_name[mode], numa, 1e9 * t_alloc / n,
+	     1e9 * t_step / (steps * n), num_segments - segments,
+	     num_huge_segments - hugetlb, num_thp_segments - thp,
+	     num_huge_fallbacks - fallbacks, num_numa_local - local);
+    }
+  }
+  return 0;
+}
+
+#endif
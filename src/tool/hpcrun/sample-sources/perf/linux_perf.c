@@ -73,6 +73,15 @@
 #include <linux/perf_event.h>
 #include <linux/version.h>
 
+#if defined(HOST_CPU_x86_64) && LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
+#define PERF_USER_STACK_SUPPORTED 1
+#include <asm/perf_regs.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0)
+// clock of the sample times in user stack mode
+#define PERF_USER_STACK_CLOCK CLOCK_MONOTONIC
+#endif
+#endif
+
 
 /******************************************************************************
  * libmonitor
@@ -100,6 +109,7 @@
 #include <hpcrun/sample_event.h>
 #include <hpcrun/sample_sources_registered.h>
 #include <hpcrun/sample-sources/blame-shift/blame-shift.h>
+#include <hpcrun/unwind/common/unwind.h>
 #include <hpcrun/utilities/tokenize.h>
 #include <hpcrun/utilities/arch/context-pc.h>
 
@@ -164,6 +174,31 @@
 
 #define PERF_FD_FINALIZED (-2)
 
+// user stack mode: if HPCRUN_PERF_USER_STACK is set to a number of
+// bytes, the kernel copies the user registers and the top of the user
+// stack into the buffer at each sample.  the records are then unwound
+// from these copies in batches, once half of the buffer is used or,
+// if HPCRUN_PERF_BATCH is set, once about that many records are pending.
+// either way, samples are traced at the time the kernel took them, and
+// a partial batch is unwound when sampling stops or the thread exits.
+#define HPCRUN_OPTION_PERF_USER_STACK "HPCRUN_PERF_USER_STACK"
+#define HPCRUN_OPTION_PERF_BATCH      "HPCRUN_PERF_BATCH"
+
+#define PERF_USER_STACK_MAX        65528  // largest copy allowed by the kernel
+#define PERF_USER_STACK_DEFAULT    8192   // copy size if only batching is asked
+#define PERF_USER_STACK_DATA_PAGES 32     // buffer pages in user stack mode
+
+// lower bound of the size of a record besides the stack copy
+#define PERF_USER_STACK_RECORD_MIN 64
+
+#ifdef PERF_USER_STACK_SUPPORTED
+// the kernel writes the registers in increasing order of PERF_REG_X86_*
+#define PERF_USER_REGS_MASK  ((1ULL << PERF_REG_X86_BP) | \
+                              (1ULL << PERF_REG_X86_SP) | \
+                              (1ULL << PERF_REG_X86_IP))
+enum { USER_REG_BP, USER_REG_SP, USER_REG_IP, USER_REG_NUM };
+#endif
+
 
 //******************************************************************************
 // type declarations
@@ -186,6 +221,9 @@ perf_thread_init(event_info_t *event, event_thread_t *et);
 static void 
 perf_thread_fini(int nevents, event_thread_t *event_thread);
 
+static void
+perf_user_stack_drain_all(int nevents, event_thread_t *event_thread);
+
 static int 
 perf_event_handler( int sig, siginfo_t* siginfo, void* context);
 
@@ -209,6 +247,21 @@ static event_info_t  *event_desc = NULL;
 
 static struct event_threshold_s default_threshold = {DEFAULT_THRESHOLD, FREQUENCY};
 
+// bytes of user stack copied per sample, or 0 if user stack mode is off
+static u64 user_stack_size = 0;
+
+// pending bytes in the buffer needed to unwind a batch in user stack mode
+static size_t batch_bytes = 0;
+
+// per thread buffer receiving the stack copy of a record
+static __thread char *user_stack_buf = NULL;
+
+// microseconds from PERF_USER_STACK_CLOCK to the time of day
+static int64_t user_stack_clock_offset = 0;
+
+// true while this thread reads records from a buffer
+static __thread bool perf_draining = false;
+
 
 
 /******************************************************************************
@@ -456,6 +509,9 @@ perf_thread_fini(int nevents, event_thread_t *event_thread)
   sigaddset(&perf_sigset, PERF_SIGNAL);
   monitor_real_pthread_sigmask(SIG_BLOCK, &perf_sigset, NULL);
 
+  // the counters are stopped: attribute what is left in the buffers
+  perf_user_stack_drain_all(nevents, event_thread);
+
   for(int i=0; i<nevents; i++) {
     if (!event_thread) {
        continue; // in some situations, it is possible a shutdown signal is delivered
@@ -498,6 +554,159 @@ get_fd_index(int nevents, int fd, event_thread_t *event_thread)
 }
 
 
+//----------------------------------------------------------
+// user stack mode
+//----------------------------------------------------------
+
+/***
+ * read HPCRUN_PERF_USER_STACK and HPCRUN_PERF_BATCH, and size the
+ * buffers accordingly.  batching needs the records to carry their own
+ * registers and stack, so HPCRUN_PERF_BATCH alone turns on user stack
+ * mode with a default copy size.
+ * needs to be called before perf_mmap_init.
+ */
+static void
+perf_user_stack_init()
+{
+  const char *stack_str = getenv(HPCRUN_OPTION_PERF_USER_STACK);
+  const char *batch_str = getenv(HPCRUN_OPTION_PERF_BATCH);
+  if (stack_str == NULL && batch_str == NULL)
+    return;
+
+  TMSG(LINUX_PERF, "%s = %s, %s = %s",
+       HPCRUN_OPTION_PERF_USER_STACK, stack_str ? stack_str : "(unset)",
+       HPCRUN_OPTION_PERF_BATCH, batch_str ? batch_str : "(unset)");
+
+#ifdef PERF_USER_STACK_SUPPORTED
+  long size = PERF_USER_STACK_DEFAULT;
+  if (stack_str != NULL)
+    size = strtol(stack_str, NULL, 10);
+  if (size > PERF_USER_STACK_MAX)
+    size = PERF_USER_STACK_MAX;
+
+  // the kernel requires a multiple of 8 bytes
+  size &= ~7L;
+  if (size <= 0)
+    return;
+
+  user_stack_size = size;
+
+#ifdef PERF_USER_STACK_CLOCK
+  struct timespec mono, real;
+  clock_gettime(PERF_USER_STACK_CLOCK, &mono);
+  clock_gettime(CLOCK_REALTIME, &real);
+  user_stack_clock_offset = (int64_t) (real.tv_sec - mono.tv_sec) * 1000000
+    + (real.tv_nsec - mono.tv_nsec) / 1000;
+#endif
+
+  // never wait for more than half of the buffer, to leave room for
+  // the samples taken until the signal is handled
+  batch_bytes = PERF_USER_STACK_DATA_PAGES * sysconf(_SC_PAGESIZE) / 2;
+  if (batch_str != NULL) {
+    long nrecords = strtol(batch_str, NULL, 10);
+    if (nrecords > 0) {
+      size_t bytes = nrecords * (user_stack_size + PERF_USER_STACK_RECORD_MIN);
+      if (bytes < batch_bytes)
+        batch_bytes = bytes;
+    }
+  }
+  perf_mmap_set_data_pages(PERF_USER_STACK_DATA_PAGES);
+#else
+  EMSG("WARNING: %s and %s are not supported on this platform and are ignored.",
+       HPCRUN_OPTION_PERF_USER_STACK, HPCRUN_OPTION_PERF_BATCH);
+#endif
+}
+
+
+/***
+ * ask the kernel to copy the user registers and stack at each sample
+ */
+static void
+perf_user_stack_attr_init(struct perf_event_attr *attr)
+{
+#ifdef PERF_USER_STACK_SUPPORTED
+  if (user_stack_size == 0)
+    return;
+
+  attr->sample_type      |= PERF_SAMPLE_REGS_USER | PERF_SAMPLE_STACK_USER;
+  attr->sample_regs_user  = PERF_USER_REGS_MASK;
+  attr->sample_stack_user = user_stack_size;
+
+#ifdef PERF_USER_STACK_CLOCK
+  // a batch is traced long after its samples were taken: time them
+  // with a clock that converts to the time of day
+  attr->use_clockid = 1;
+  attr->clockid     = PERF_USER_STACK_CLOCK;
+#endif
+#endif
+}
+
+
+/***
+ * return true if the samples in the buffer of the event that raised
+ * the signal can wait for a later signal, i.e., if we are in user stack
+ * mode and the buffer does not hold a batch yet.
+ */
+static bool
+perf_user_stack_defer(int nevents, event_thread_t *event_thread,
+    siginfo_t *siginfo)
+{
+  if (user_stack_size == 0 || siginfo->si_code < 0)
+    return false;
+
+  event_thread_t *current = get_fd_index(nevents, siginfo->si_fd, event_thread);
+  if (current == NULL || current->mmap == NULL)
+    return false;
+
+  return perf_mmap_bytes_pending(current->mmap) < batch_bytes;
+}
+
+
+#ifdef PERF_USER_STACK_SUPPORTED
+/***
+ * build the context and the stack snapshot of a record in user
+ * stack mode.  returns false if the record has no copy of the stack
+ * (e.g., a sample in a kernel thread or user stack mode is off).
+ */
+static bool
+perf_user_stack_context(perf_mmap_data_t *mmap_data, ucontext_t *uc,
+    hpcrun_unw_stack_snapshot_t *snapshot)
+{
+  if (mmap_data->regs == NULL || mmap_data->stack_data == NULL ||
+      mmap_data->abi == PERF_SAMPLE_REGS_ABI_NONE ||
+      mmap_data->stack_dyn_size == 0)
+    return false;
+
+  memset(uc, 0, sizeof(ucontext_t));
+  mcontext_t *mc = GET_MCONTEXT(uc);
+  LV_MCONTEXT_PC(mc) = mmap_data->regs[USER_REG_IP];
+  LV_MCONTEXT_SP(mc) = mmap_data->regs[USER_REG_SP];
+  LV_MCONTEXT_BP(mc) = mmap_data->regs[USER_REG_BP];
+
+  snapshot->sp   = (void *) mmap_data->regs[USER_REG_SP];
+  snapshot->size = mmap_data->stack_dyn_size;
+  snapshot->data = mmap_data->stack_data;
+
+  return true;
+}
+
+
+/***
+ * time of day of a record in user stack mode, in microseconds, or 0
+ * if the kernel cannot time it with PERF_USER_STACK_CLOCK
+ */
+static uint64_t
+perf_user_stack_time(perf_mmap_data_t *mmap_data)
+{
+#ifdef PERF_USER_STACK_CLOCK
+  if (mmap_data->time > 0)
+    return mmap_data->time / 1000 + user_stack_clock_offset;
+#endif
+  return 0;
+}
+#endif
+
+
 static sample_val_t*
 record_sample(event_thread_t *current, perf_mmap_data_t *mmap_data,
     void* context, sample_val_t* sv)
@@ -558,10 +767,31 @@ record_sample(event_thread_t *current, perf_mmap_data_t *mmap_data,
   // ----------------------------------------------------------------------------
   sampling_info_t info = {.sample_clock = 0, .sample_data = mmap_data};
 
+#ifdef PERF_USER_STACK_SUPPORTED
+  // in user stack mode, unwind from the registers and the copy of the
+  // stack taken by the kernel rather than from the signal context
+  ucontext_t uc;
+  hpcrun_unw_stack_snapshot_t snapshot;
+
+  if (perf_user_stack_context(mmap_data, &uc, &snapshot)) {
+    context = &uc;
+    info.sample_clock = perf_user_stack_time(mmap_data);
+    hpcrun_unw_set_stack_snapshot(&snapshot);
+  }
+#endif
+
+  // no signal context to attribute a record without a stack copy to
+  if (context == NULL)
+    return NULL;
+
   *sv = hpcrun_sample_callpath(context, current->event->metric,
         (hpcrun_metricVal_t) {.r=counter},
         0/*skipInner*/, 0/*isSync*/, &info);
 
+#ifdef PERF_USER_STACK_SUPPORTED
+  hpcrun_unw_set_stack_snapshot(NULL);
+#endif
+
   blame_shift_apply(current->event->metric, sv->sample_node, 
                     counter /*metricIncr*/);
 
@@ -727,6 +957,7 @@ METHOD_FN(stop)
   int nevents  = (self->evl).nevents;
 
   perf_stop_all(nevents, event_thread);
+  perf_user_stack_drain_all(nevents, event_thread);
 
   thread_data_t* td = hpcrun_get_thread_data();
   td->ss_state[self->sel_idx] = STOP;
@@ -825,6 +1056,8 @@ METHOD_FN(process_event_list, int lush_metrics)
 
   set_default_threshold();
 
+  perf_user_stack_init();
+
   // ----------------------------------------------------------------------
   // for each perf's event, create the metric descriptor which will be used later
   // during thread initialization for perf event creation
@@ -869,6 +1102,7 @@ METHOD_FN(process_event_list, int lush_metrics)
     // all threads and file descriptor will reuse the same attributes.
     // ------------------------------------------------------------
     perf_util_attr_init(event, event_attr, is_period, threshold, 0);
+    perf_user_stack_attr_init(event_attr);
 
     // ------------------------------------------------------------
     // initialize the property of the metric
@@ -944,6 +1178,19 @@ METHOD_FN(gen_event_set, int lush_metrics)
   td->core_profile_trace_data.perf_event_info = aux_info;
   td->ss_info[self->sel_idx].ptr = event_thread;
 
+  // the trampoline would be placed in the stack of a sample that may
+  // have returned by the time its batch is unwound
+  if (user_stack_size > 0 && ENABLED(USE_TRAMP)) {
+    EEMSG("%s and %s cannot be used with the %s event.",
+          HPCRUN_OPTION_PERF_USER_STACK, HPCRUN_OPTION_PERF_BATCH,
+          HPCRUN_METRIC_RetCnt);
+    exit(1);
+  }
+
+  if (user_stack_size > 0 && user_stack_buf == NULL) {
+    user_stack_buf = (char *) hpcrun_malloc(user_stack_size);
+  }
+
   // setup all requested events
   // if an event cannot be initialized, we still keep it in our list
   //  but there will be no samples
@@ -1008,6 +1255,85 @@ read_fd(int fd)
 
 #include "sample-sources/ss_obj.h"
 
+// ---------------------------------------------
+// reading the buffers
+// ---------------------------------------------
+
+/***
+ * read all the records in the buffer of an event and attribute its
+ * samples.  context is the signal context, for samples without a copy
+ * of the user stack, or NULL to drop them.
+ */
+static void
+perf_drain_buffer(event_thread_t *current, void *context)
+{
+  int more_data = 0;
+  long nsamples  = 0;
+
+  perf_draining = true;
+  do {
+    perf_mmap_data_t mmap_data;
+    memset(&mmap_data, 0, sizeof(perf_mmap_data_t));
+
+#ifdef PERF_USER_STACK_SUPPORTED
+    u64 user_regs[USER_REG_NUM];
+    if (user_stack_buf != NULL) {
+      mmap_data.regs       = user_regs;
+      mmap_data.stack_data = user_stack_buf;
+      mmap_data.stack_size = user_stack_size;
+    }
+#endif
+
+    // reading info from mmapped buffer
+    more_data = read_perf_buffer(current, &mmap_data);
+
+    sample_val_t sv;
+    memset(&sv, 0, sizeof(sample_val_t));
+
+    if (mmap_data.header_type == PERF_RECORD_SAMPLE) {
+      record_sample(current, &mmap_data, context, &sv);
+      nsamples++;
+    }
+    if (mmap_data.lost > 0)
+      hpcrun_stats_num_perf_records_lost_inc(mmap_data.lost);
+
+    kernel_block_handler(current, sv, &mmap_data);
+
+  } while (more_data);
+  perf_draining = false;
+
+  hpcrun_stats_num_perf_drains_inc();
+  hpcrun_stats_num_perf_records_inc(nsamples);
+}
+
+
+/***
+ * in user stack mode, attribute the samples still waiting for a
+ * batch, once the counters are disabled for good or for a while.
+ * does nothing if called while a buffer is read, e.g., when sampling
+ * is disabled in the middle of a batch.
+ */
+static void
+perf_user_stack_drain_all(int nevents, event_thread_t *event_thread)
+{
+  if (user_stack_size == 0 || event_thread == NULL || perf_draining)
+    return;
+
+  // stop and thread fini are usually called from inside hpcrun already
+  int safe = hpcrun_safe_enter();
+
+  for (int i = 0; i < nevents; i++) {
+    event_thread_t *current = &event_thread[i];
+    if (current->fd >= 0 && current->mmap != NULL &&
+        perf_mmap_bytes_pending(current->mmap) > 0) {
+      perf_drain_buffer(current, NULL);
+    }
+  }
+
+  if (safe) hpcrun_safe_exit();
+}
+
+
 // ---------------------------------------------
 // signal handler
 // ---------------------------------------------
@@ -1053,6 +1379,16 @@ perf_event_handler(
     return 0; // tell monitor that the signal has been handled
   }
 
+  // in user stack mode each record has its own registers and stack,
+  // so there is no need to unwind them until a batch is pending
+  if (perf_user_stack_defer(nevents, event_thread, siginfo)) {
+    hpcrun_safe_exit();
+
+    HPCTOOLKIT_APPLICATION_ERRNO_RESTORE();
+
+    return 0; // tell monitor that the signal has been handled
+  }
+
   perf_stop_all(nevents, event_thread);
 
   // ----------------------------------------------------------------------------
@@ -1126,23 +1462,7 @@ perf_event_handler(
   // parse the buffer until it finishes reading all buffers
   // ----------------------------------------------------------------------------
 
-  int more_data = 0;
-  do {
-    perf_mmap_data_t mmap_data;
-    memset(&mmap_data, 0, sizeof(perf_mmap_data_t));
-
-    // reading info from mmapped buffer
-    more_data = read_perf_buffer(current, &mmap_data);
-
-    sample_val_t sv;
-    memset(&sv, 0, sizeof(sample_val_t));
-
-    if (mmap_data.header_type == PERF_RECORD_SAMPLE)
-      record_sample(current, &mmap_data, context, &sv);
-
-    kernel_block_handler(current, sv, &mmap_data);
-
-  } while (more_data);
+  perf_drain_buffer(current, context);
 
   perf_start_all(nevents, event_thread);
 
@@ -87,10 +87,11 @@ typedef struct perf_mmap_data_s {
   
                      /* if PERF_SAMPLE_BRANCH_STACK */
   u64    abi;        /* if PERF_SAMPLE_REGS_USER */
-  u64    *regs;
+  u64    *regs;      /* if PERF_SAMPLE_REGS_USER, buffer set by the caller */
                      /* if PERF_SAMPLE_REGS_USER */
   u64    stack_size;             /* if PERF_SAMPLE_STACK_USER */
-  char   *stack_data; /* if PERF_SAMPLE_STACK_USER */
+  char   *stack_data; /* if PERF_SAMPLE_STACK_USER, buffer of stack_size
+                         bytes set by the caller */
   u64    stack_dyn_size;         /* if PERF_SAMPLE_STACK_USER &&
                                      size != 0 */
   u64    weight;     /* if PERF_SAMPLE_WEIGHT */
@@ -107,6 +108,9 @@ typedef struct perf_mmap_data_s {
   // only for PERF_RECORD_SWITCH
   u64 	context_switch_time;
 
+  // only for PERF_RECORD_LOST and PERF_RECORD_LOST_SAMPLES
+  u64   lost;
+
 } perf_mmap_data_t;
 
 
@@ -51,6 +51,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <sys/mman.h>
 #include <string.h>
 #include <unistd.h>
@@ -86,8 +87,8 @@
 #define PERF_DATA_PAGE_EXP        1      // use 2^PERF_DATA_PAGE_EXP pages
 #define PERF_DATA_PAGES           (1 << PERF_DATA_PAGE_EXP)
 
-#define PERF_MMAP_SIZE(pagesz)    ((pagesz) * (PERF_DATA_PAGES + 1))
-#define PERF_TAIL_MASK(pagesz)    (((pagesz) * PERF_DATA_PAGES) - 1)
+#define PERF_MMAP_SIZE(pagesz)    ((pagesz) * (data_pages + 1))
+#define PERF_TAIL_MASK(pagesz)    (((pagesz) * data_pages) - 1)
 
 
 
@@ -107,6 +108,7 @@ __attribute__ ((unused));
 
 static int pagesize      = 0;
 static size_t tail_mask  = 0;
+static int data_pages    = PERF_DATA_PAGES;
 
 
 /******************************************************************************
@@ -321,6 +323,70 @@ skip_perf_data(pe_mmap_t *current_perf_mmap, size_t sz)
   hdr->data_tail += sz;
 }
 
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
+//----------------------------------------------------------
+// read the user registers of PERF_SAMPLE_REGS_USER.
+// the kernel writes one u64 per bit set in the mask, in
+//  increasing order of bit.
+// the registers are copied into mmap_data->regs if the caller
+//  provides it, otherwise they are skipped.
+//----------------------------------------------------------
+static void
+perf_sample_regs_user(pe_mmap_t *current_perf_mmap, u64 regs_mask,
+    perf_mmap_data_t* mmap_data)
+{
+  perf_read_u64(current_perf_mmap, &mmap_data->abi);
+
+  // no registers if the sample was taken in a kernel thread
+  if (mmap_data->abi == PERF_SAMPLE_REGS_ABI_NONE)
+    return;
+
+  size_t nregs = __builtin_popcountll(regs_mask);
+  if (mmap_data->regs != NULL) {
+    perf_read(current_perf_mmap, mmap_data->regs, nregs * sizeof(u64));
+  } else {
+    skip_perf_data(current_perf_mmap, nregs * sizeof(u64));
+  }
+}
+
+
+//----------------------------------------------------------
+// read the copy of the user stack of PERF_SAMPLE_STACK_USER.
+// the record has the requested size, but only the first
+//  dyn_size bytes hold the stack; the rest is padding.
+// the stack is copied into mmap_data->stack_data if the caller
+//  provides it (of at least sample_stack_user bytes), otherwise
+//  it is skipped.
+//----------------------------------------------------------
+static void
+perf_sample_stack_user(pe_mmap_t *current_perf_mmap,
+    perf_mmap_data_t* mmap_data)
+{
+  u64 size = 0;
+  perf_read_u64(current_perf_mmap, &size);
+
+  if (size == 0) {
+    // nothing is copied if the sample was taken in a kernel thread
+    mmap_data->stack_size = 0;
+    mmap_data->stack_dyn_size = 0;
+    return;
+  }
+
+  if (mmap_data->stack_data != NULL && size <= mmap_data->stack_size) {
+    perf_read(current_perf_mmap, mmap_data->stack_data, size);
+  } else {
+    mmap_data->stack_data = NULL;
+    skip_perf_data(current_perf_mmap, size);
+  }
+  mmap_data->stack_size = size;
+
+  perf_read_u64(current_perf_mmap, &mmap_data->stack_dyn_size);
+  if (mmap_data->stack_dyn_size > size)
+    mmap_data->stack_dyn_size = size;
+}
+#endif
+
 /**
  * parse mmapped buffer and copy the values into perf_mmap_data_t mmap_info.
  * we assume mmap_info is already initialized.
@@ -396,9 +462,12 @@ parse_buffer(int sample_type, event_thread_t *current, perf_mmap_data_t *mmap_in
 	}
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
 	if (sample_type & PERF_SAMPLE_REGS_USER) {
+	  perf_sample_regs_user(current_perf_mmap,
+	      current->event->attr.sample_regs_user, mmap_info);
 	  data_read++;
 	}
 	if (sample_type & PERF_SAMPLE_STACK_USER) {
+	  perf_sample_stack_user(current_perf_mmap, mmap_info);
 	  data_read++;
 	}
 #endif
@@ -451,6 +520,9 @@ read_perf_buffer(event_thread_t *current, perf_mmap_data_t *mmap_info)
   mmap_info->header_type = hdr.type;
   mmap_info->header_misc = hdr.misc;
 
+  // end of the record, to skip the fields that are not parsed
+  u64 record_end = current_perf_mmap->data_tail + hdr.size - sizeof(pe_header_t);
+
   if (hdr.type == PERF_RECORD_SAMPLE) {
       if (hdr.size <= 0) {
         return 0;
@@ -478,27 +550,40 @@ read_perf_buffer(event_thread_t *current, perf_mmap_data_t *mmap_info)
       if (type & PERF_SAMPLE_CPU) {
         perf_read( current_perf_mmap, &cpu, sizeof(cpu) ) ;
       }
-#elif LINUX_VERSION_CODE >= KERNEL_VERSION(4,2,0)
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,2,0)
   } else if (hdr.type == PERF_RECORD_LOST_SAMPLES) {
-     u64 lost_samples;
-     perf_read_u64(current_perf_mmap, &lost_samples);
-     TMSG(LINUX_PERF, "[%d] lost samples %d",
-    		 current->fd, lost_samples);
-     skip_perf_data(current_perf_mmap, hdr.size-sizeof(lost_samples))
+     // samples dropped by the kernel before reaching the buffer
+     perf_read_u64(current_perf_mmap, &mmap_info->lost);
+     TMSG(LINUX_PERF, "[%d] lost samples %"PRIu64,
+    		 current->fd, (uint64_t) mmap_info->lost);
 #endif
 
+  } else if (hdr.type == PERF_RECORD_LOST) {
+     // records dropped because the buffer was full
+     u64 id;
+     perf_read_u64(current_perf_mmap, &id);
+     perf_read_u64(current_perf_mmap, &mmap_info->lost);
+     TMSG(LINUX_PERF, "[%d] lost records %"PRIu64,
+    		 current->fd, (uint64_t) mmap_info->lost);
+
   } else {
       // not a PERF_RECORD_SAMPLE nor PERF_RECORD_SWITCH
       // skip it
       if (hdr.size <= 0) {
         return 0;
       }
-      //skip_perf_data(current_perf_mmap, hdr.size);
       TMSG(LINUX_PERF, "[%d] skip header %d  %d : %d bytes",
     		  current->fd,
     		  hdr.type, hdr.misc, hdr.size);
   }
 
+  // skip what is left of the record so that the next read starts
+  // at a header
+  if ((int64_t) (record_end - current_perf_mmap->data_tail) > 0) {
+    skip_perf_data(current_perf_mmap, record_end - current_perf_mmap->data_tail);
+  }
+
   return (has_more_perf_data(current_perf_mmap));
 }
 
@@ -540,6 +625,25 @@ perf_unmmap(pe_mmap_t *mmap)
   munmap(mmap, PERF_MMAP_SIZE(pagesize));
 }
 
+/***
+ * number of bytes written by the kernel and not read yet
+ */
+size_t
+perf_mmap_bytes_pending(pe_mmap_t *mmap)
+{
+  return num_of_more_perf_data(mmap);
+}
+
+/**
+ * set the number of data pages of the buffers (a power of 2).
+ * the caller needs to call this before perf_mmap_init.
+ */
+void
+perf_mmap_set_data_pages(int npages)
+{
+  data_pages = npages;
+}
+
 /**
  * initialize perf_mmap.
  * caller needs to call this in the beginning before calling any API.
@@ -77,6 +77,7 @@ typedef struct perf_event_header pe_header_t;
  *  interfaces
  *****************************************************************************/
 
+void perf_mmap_set_data_pages(int npages);
 void perf_mmap_init();
 
 pe_mmap_t* set_mmap(int perf_fd);
@@ -84,5 +85,7 @@ void perf_unmmap(pe_mmap_t *mmap);
 
 int read_perf_buffer(event_thread_t *current, perf_mmap_data_t *mmap_info);
 
+size_t perf_mmap_bytes_pending(pe_mmap_t *mmap);
+
 
 #endif
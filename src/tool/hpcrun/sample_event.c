@@ -177,9 +177,14 @@ hpcrun_sample_callpath(void* context, int metricId,
 
   hpcrun_stats_num_samples_total_inc();
 
+  uint64_t overhead_start = hpcrun_overhead_ticks();
+  thread_data_t* td = hpcrun_get_thread_data();
+  hpcrun_overhead_t* overhead = &td->core_profile_trace_data.overhead;
+
   if (hpcrun_is_sampling_disabled()) {
     TMSG(SAMPLE,"global suspension");
     hpcrun_all_sources_stop();
+    hpcrun_overhead_add(overhead, HPCRUN_OVERHEAD_SAMPLE, overhead_start);
     monitor_unblock_shootdown();
     return ret;
   }
@@ -194,6 +199,7 @@ hpcrun_sample_callpath(void* context, int metricId,
   else if (! hpcrun_dlopen_read_lock()) {
     TMSG(SAMPLE_CALLPATH, "skipping sample for dlopen lock");
     hpcrun_stats_num_samples_blocked_dlopen_inc();
+    hpcrun_overhead_add(overhead, HPCRUN_OVERHEAD_SAMPLE, overhead_start);
     monitor_unblock_shootdown();
     return ret;
   }
@@ -202,7 +208,6 @@ hpcrun_sample_callpath(void* context, int metricId,
   TMSG(SAMPLE_CALLPATH, "attempting sample");
   hpcrun_stats_num_samples_attempted_inc();
 
-  thread_data_t* td   = hpcrun_get_thread_data();
   sigjmp_buf_t* it    = &(td->bad_unwind);
   sigjmp_buf_t* old   = td->current_jmp_buf;
   td->current_jmp_buf = it;
@@ -241,6 +246,13 @@ hpcrun_sample_callpath(void* context, int metricId,
     }
   }
   else {
+    // a dropped unwind longjmps here from the middle of its step loop
+    if (overhead->unwind_start != 0) {
+      hpcrun_overhead_add(overhead, HPCRUN_OVERHEAD_UNWIND,
+			  overhead->unwind_start);
+      overhead->unwind_start = 0;
+    }
+
     cct_bundle_t* cct = &(td->core_profile_trace_data.epoch->csdata);
     node = record_partial_unwind(cct, td->btbuf_beg, td->btbuf_cur - 1,
         metricId, metricIncr, skipInner, NULL);
@@ -297,7 +309,22 @@ hpcrun_sample_callpath(void* context, int metricId,
 
     TMSG(TRACE, "Changed persistent id to indicate mutation of func_proxy node");
 
-    hpcrun_trace_append(&td->core_profile_trace_data, func_proxy, metricId);
+    core_profile_trace_data_t *cptd = &td->core_profile_trace_data;
+    if (data != NULL && data->sample_clock != 0) {
+      // the sample was taken before now, e.g., a perf record read in a
+      // batch: trace it at its own time, but after the records that
+      // are already in the trace
+      uint64_t microtime = data->sample_clock;
+      if (microtime < cptd->trace_max_time_us)
+        microtime = cptd->trace_max_time_us;
+
+      hpcrun_cct_retain(func_proxy);
+      hpcrun_trace_append_with_time(cptd, hpcrun_cct_persistent_id(func_proxy),
+                                    metricId, microtime);
+    }
+    else {
+      hpcrun_trace_append(cptd, func_proxy, metricId);
+    }
     TMSG(TRACE, "Appended func_proxy node to trace");
   }
 
@@ -310,6 +337,8 @@ hpcrun_sample_callpath(void* context, int metricId,
   hpcrun_dlopen_read_unlock();
 #endif
 
+  hpcrun_overhead_add(overhead, HPCRUN_OVERHEAD_SAMPLE, overhead_start);
+
   TMSG(SAMPLE_CALLPATH,"done w sample, return %p", ret.sample_node);
   monitor_unblock_shootdown();
 
@@ -0,0 +1,142 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//***************************************************************************
+// system include files
+//***************************************************************************
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+//***************************************************************************
+// local include files
+//***************************************************************************
+
+#include "env.h"
+#include "files.h"
+#include "sample_overhead.h"
+#include "sample_prob.h"
+
+#include <messages/messages.h>
+#include <lib/prof-lean/hpcio.h>
+
+
+//***************************************************************************
+// local data
+//***************************************************************************
+
+static const char *overhead_kind_name[HPCRUN_OVERHEAD_NUM] = {
+  [HPCRUN_OVERHEAD_SAMPLE]     = "sample",
+  [HPCRUN_OVERHEAD_UNWIND]     = "unwind",
+  [HPCRUN_OVERHEAD_CCT_INSERT] = "cct-insert",
+  [HPCRUN_OVERHEAD_METRIC]     = "metric",
+  [HPCRUN_OVERHEAD_TRACE]      = "trace",
+  [HPCRUN_OVERHEAD_FLUSH]      = "flush",
+};
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__powerpc__)
+#define OVERHEAD_TICKS "cycles"
+#else
+#define OVERHEAD_TICKS "ns"
+#endif
+
+
+//***************************************************************************
+// interface operations
+//***************************************************************************
+
+void
+hpcrun_overhead_init(hpcrun_overhead_t *oh)
+{
+  memset(oh, 0, sizeof(*oh));
+}
+
+
+// one line per phase:
+//   <phase> <count> <total> <max> <bucket 0> ... <last non-empty bucket>
+// where bucket i counts the events that took [2^(i-1), 2^i) ticks.
+void
+hpcrun_overhead_write(hpcrun_overhead_t *oh, int rank, int id)
+{
+  if (getenv(HPCRUN_SAMPLE_OVERHEAD) == NULL || ! hpcrun_sample_prob_active()) {
+    return;
+  }
+  if (oh->hist[HPCRUN_OVERHEAD_SAMPLE].count == 0) {
+    return;
+  }
+
+  int fd = hpcrun_open_overhead_file(rank < 0 ? 0 : rank, id);
+  FILE *fs = fdopen(fd, "w");
+  if (fs == NULL) {
+    EMSG("unable to open sample overhead file");
+    close(fd);
+    return;
+  }
+
+  fprintf(fs, "# hpcrun sample overhead (ticks: %s)\n", OVERHEAD_TICKS);
+  fprintf(fs, "# phase count total max buckets (i: [2^(i-1), 2^i) ticks)\n");
+
+  for (int k = 0; k < HPCRUN_OVERHEAD_NUM; k++) {
+    hpcrun_overhead_hist_t *h = &oh->hist[k];
+
+    int last = HPCRUN_OVERHEAD_BUCKETS - 1;
+    while (last > 0 && h->bucket[last] == 0) last--;
+
+    fprintf(fs, "%s %"PRIu64" %"PRIu64" %"PRIu64, overhead_kind_name[k],
+	    h->count, h->total, h->max);
+    for (int i = 0; i <= last; i++) {
+      fprintf(fs, " %"PRIu64, h->bucket[i]);
+    }
+    fprintf(fs, "\n");
+  }
+
+  hpcio_fclose(fs);
+}
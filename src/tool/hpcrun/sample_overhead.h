@@ -0,0 +1,165 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//***************************************************************************
+//
+// File:
+//   sample_overhead.h
+//
+// Purpose:
+//   per-thread histograms of the time spent in the phases of handling
+//   a sample: the whole sample, the unwind, the insertion of the call
+//   path in the cct, the metric update, and the trace append.  trace
+//   appends that fill the trace buffer and flush it (or, with
+//   HPCRUN_TRACE_ASYNC, hand a segment off to the writer thread) are
+//   also counted on their own.
+//
+//   the counters are always maintained; they are written to a
+//   sidecar file (.hpcoverhead) next to each profile if
+//   HPCRUN_SAMPLE_OVERHEAD is set.
+//
+//***************************************************************************
+
+#ifndef SAMPLE_OVERHEAD_H
+#define SAMPLE_OVERHEAD_H
+
+//***************************************************************************
+// system include files
+//***************************************************************************
+
+#include <stdint.h>
+#include <time.h>
+
+
+//***************************************************************************
+// local include files
+//***************************************************************************
+
+#include <lib/support-lean/timer.h>
+
+
+//***************************************************************************
+// types
+//***************************************************************************
+
+typedef enum {
+  HPCRUN_OVERHEAD_SAMPLE,      // hpcrun_sample_callpath
+  HPCRUN_OVERHEAD_UNWIND,      // unwinder step loop
+  HPCRUN_OVERHEAD_CCT_INSERT,  // hpcrun_cct_insert_backtrace
+  HPCRUN_OVERHEAD_METRIC,      // metric update of the sampled node
+  HPCRUN_OVERHEAD_TRACE,       // hpcrun_trace_append
+  HPCRUN_OVERHEAD_FLUSH,       // trace append that flushes the buffer
+  HPCRUN_OVERHEAD_NUM
+} hpcrun_overhead_kind_t;
+
+// bucket i counts the events that took [2^(i-1), 2^i) ticks
+#define HPCRUN_OVERHEAD_BUCKETS 48
+
+typedef struct hpcrun_overhead_hist_t {
+  uint64_t count;
+  uint64_t total;
+  uint64_t max;
+  uint64_t bucket[HPCRUN_OVERHEAD_BUCKETS];
+} hpcrun_overhead_hist_t;
+
+typedef struct hpcrun_overhead_t {
+  hpcrun_overhead_hist_t hist[HPCRUN_OVERHEAD_NUM];
+
+  // start of the unwind in progress, 0 if none.  an unwind that drops
+  // the sample leaves by siglongjmp, so the sample handler records it.
+  uint64_t unwind_start;
+} hpcrun_overhead_t;
+
+
+//***************************************************************************
+// interface operations
+//***************************************************************************
+
+// hpcrun_overhead_ticks: a cheap time stamp: the cycle counter where
+// there is one, else nanoseconds.
+static inline uint64_t
+hpcrun_overhead_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(__powerpc__)
+  return time_getTSC();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+
+// hpcrun_overhead_add: record an event of 'kind' that started at
+// time stamp 'start' (from hpcrun_overhead_ticks) and ends now.
+static inline void
+hpcrun_overhead_add(hpcrun_overhead_t *oh, hpcrun_overhead_kind_t kind,
+		    uint64_t start)
+{
+  uint64_t ticks = hpcrun_overhead_ticks() - start;
+  hpcrun_overhead_hist_t *h = &oh->hist[kind];
+
+  int i = (ticks == 0) ? 0 : 64 - __builtin_clzll(ticks);
+  if (i >= HPCRUN_OVERHEAD_BUCKETS) i = HPCRUN_OVERHEAD_BUCKETS - 1;
+
+  h->count++;
+  h->total += ticks;
+  if (ticks > h->max) h->max = ticks;
+  h->bucket[i]++;
+}
+
+
+void
+hpcrun_overhead_init(hpcrun_overhead_t *oh);
+
+
+// hpcrun_overhead_write: write the histograms to the sidecar file of
+// profile 'id' if HPCRUN_SAMPLE_OVERHEAD is set.
+void
+hpcrun_overhead_write(hpcrun_overhead_t *oh, int rank, int id);
+
+#endif // SAMPLE_OVERHEAD_H
@@ -243,11 +243,18 @@ core_profile_trace_data_init(core_profile_trace_data_t * cptd, int id, cct_ctxt_
   // ----------------------------------------
   cptd->hpcrun_file  = NULL;
   cptd->trace_buffer = NULL;
+  cptd->trace_flags  = hpctrace_hdr_flags_NULL;
+  cptd->trace_block  = hpctrace_fmt_block_NULL;
 
   // ----------------------------------------
   // perf event support
   // ----------------------------------------
   cptd->perf_event_info   = NULL;
+
+  // ----------------------------------------
+  // sample overhead
+  // ----------------------------------------
+  hpcrun_overhead_init(&cptd->overhead);
 }
 
 
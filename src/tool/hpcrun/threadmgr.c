@@ -68,6 +68,8 @@
 #include "thread_data.h"
 #include "write_data.h"
 #include "trace.h"
+#include "rank.h"
+#include "sample_overhead.h"
 #include "sample_sources_all.h"
 
 #include <lib/prof-lean/stdatomic.h>
@@ -173,6 +175,11 @@ finalize_thread_data(core_profile_trace_data_t *current_data)
 {
   hpcrun_write_profile_data( current_data );
   hpcrun_trace_close( current_data );
+
+  // the overhead sidecar is written once, when the thread is done
+  // sampling, not with each flush of the profile
+  hpcrun_overhead_write(&current_data->overhead, hpcrun_get_rank(),
+			current_data->id);
 }
 
 
@@ -318,8 +325,7 @@ hpcrun_threadMgr_data_put( epoch_t *epoch, thread_data_t *data )
 
   if (hpcrun_threadMgr_compact_thread() == OPTION_NO_COMPACT_THREAD) {
 
-    hpcrun_write_profile_data( &data->core_profile_trace_data );
-    hpcrun_trace_close( &data->core_profile_trace_data );
+    finalize_thread_data( &data->core_profile_trace_data );
 
     return;
   }
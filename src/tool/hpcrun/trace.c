@@ -52,6 +52,10 @@
 #include <sys/time.h>
 #include <assert.h>
 #include <limits.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
 
 //*********************************************************************
@@ -63,6 +67,7 @@
 #include "disabled.h"
 #include "env.h"
 #include "files.h"
+#include "hpcrun_stats.h"
 #include "monitor.h"
 #include "rank.h"
 #include "string.h"
@@ -79,18 +84,14 @@
 #include <lib/prof-lean/hpcio-buffer.h>
 
 
-//*********************************************************************
-// type declarations
-//*********************************************************************
-
-
-
 //*********************************************************************
 // forward declarations 
 //*********************************************************************
 
 static void hpcrun_trace_file_validate(int valid, char *op);
 static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, uint metric_id, uint64_t microtime);
+static int trace_writer_add(core_profile_trace_data_t *cptd);
+static void trace_writer_remove(core_profile_trace_data_t *cptd);
 
 
 //*********************************************************************
@@ -99,6 +100,20 @@ static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t
 
 static int tracing = 0;
 
+// With HPCRUN_TRACE_DELTA, trace records are delta encoded in blocks.
+static int trace_delta = 0;
+
+// With HPCRUN_TRACE_ASYNC, full trace buffer segments are written by
+// one background thread per process instead of in the sample path.
+// The thread sleeps on an eventfd that the outbufs signal when they
+// hand off a segment; the threads whose outbufs it drains are linked
+// through cptd->trace_writer_next.
+static int trace_async = 0;
+static int trace_writer_started = 0;
+static int trace_writer_efd = -1;
+static pthread_mutex_t trace_writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static core_profile_trace_data_t *trace_writer_active = NULL;
+
 //*********************************************************************
 // interface operations
 //*********************************************************************
@@ -117,6 +132,18 @@ hpcrun_trace_init()
       tracing = 1;
       TMSG(TRACE, "Tracing is ON");
   }
+
+  // this also runs in a forked child, where the writer thread does
+  // not exist and its lock may have been held at the fork
+  trace_delta = (getenv(HPCRUN_TRACE_DELTA) != NULL);
+  trace_async = (getenv(HPCRUN_TRACE_ASYNC) != NULL);
+  trace_writer_started = 0;
+  trace_writer_active = NULL;
+  if (trace_writer_efd >= 0) {
+    close(trace_writer_efd);
+    trace_writer_efd = -1;
+  }
+  pthread_mutex_init(&trace_writer_lock, NULL);
 }
 
 
@@ -142,16 +169,29 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd)
     fd = hpcrun_open_trace_file(cptd->id);
     hpcrun_trace_file_validate(fd >= 0, "open");
     cptd->trace_buffer = hpcrun_malloc(HPCRUN_TraceBufferSz);
+    int outbuf_flags = HPCIO_OUTBUF_UNLOCKED;
+    if (trace_async) {
+      outbuf_flags |= HPCIO_OUTBUF_ASYNC;
+    }
     ret = hpcio_outbuf_attach(&cptd->trace_outbuf, fd, cptd->trace_buffer,
-			      HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED);
+			      HPCRUN_TraceBufferSz, outbuf_flags);
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "open");
 
+    // if the writer thread is not available, the outbuf still works,
+    // the client just writes every segment itself
+    if (trace_async && trace_writer_add(cptd) != 0) {
+      EMSG("unable to start trace writer thread, writing traces synchronously");
+    }
+
     hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
 #ifdef DATACENTRIC_TRACE
     flags.fields.isDataCentric = true;
 #else
     flags.fields.isDataCentric = false;
 #endif
+    flags.fields.isDeltaEncoded = trace_delta;
+    cptd->trace_flags = flags;
+    cptd->trace_block = hpctrace_fmt_block_NULL;
 
     ret = hpctrace_fmt_hdr_outbuf(flags, &cptd->trace_outbuf);
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "write header to");
@@ -173,6 +213,8 @@ void
 hpcrun_trace_append(core_profile_trace_data_t *cptd, cct_node_t* node, uint metric_id)
 {
   if (tracing && hpcrun_sample_prob_active()) {
+    uint64_t overhead_start = hpcrun_overhead_ticks();
+
     struct timeval tv;
     int ret = gettimeofday(&tv, NULL);
     assert(ret == 0 && "in trace_append: gettimeofday failed!");
@@ -186,6 +228,8 @@ hpcrun_trace_append(core_profile_trace_data_t *cptd, cct_node_t* node, uint metr
     int32_t call_path_id = hpcrun_cct_persistent_id(node);
 
     hpcrun_trace_append_with_time_real(cptd, call_path_id, metric_id, microtime);
+
+    hpcrun_overhead_add(&cptd->overhead, HPCRUN_OVERHEAD_TRACE, overhead_start);
   }
 }
 
@@ -198,6 +242,13 @@ hpcrun_trace_close(core_profile_trace_data_t * cptd)
   if (tracing && hpcrun_sample_prob_active()) {
 
     TMSG(TRACE, "Trace active close code");
+    if (trace_async) {
+      trace_writer_remove(cptd);
+      long stalls = hpcio_outbuf_num_stalls(&cptd->trace_outbuf);
+      hpcrun_stats_num_trace_stalls_inc(stalls);
+      TMSG(TRACE, "trace buffer stalls: %ld", stalls);
+    }
+
     int ret = hpcio_outbuf_close(&cptd->trace_outbuf);
     if (ret != HPCFMT_OK) {
       EMSG("unable to flush and close trace file");
@@ -215,6 +266,98 @@ hpcrun_trace_close(core_profile_trace_data_t * cptd)
 // private operations
 //*********************************************************************
 
+// The background writer: wait until some outbuf hands off a segment,
+// then drain every registered trace outbuf.  Samples never wait for
+// this thread, except when a client fills its whole ring and takes the
+// drain lock itself.
+static void*
+trace_writer_loop(void* arg)
+{
+  for (;;) {
+    uint64_t count;
+    if (read(trace_writer_efd, &count, sizeof(count)) != sizeof(count)
+	&& errno != EINTR) {
+      // the clients write their segments themselves at stalls
+      EMSG("trace writer thread cannot wait for work, exiting");
+      return NULL;
+    }
+
+    pthread_mutex_lock(&trace_writer_lock);
+    for (core_profile_trace_data_t *cptd = trace_writer_active; cptd != NULL;
+	 cptd = cptd->trace_writer_next) {
+      hpcio_outbuf_drain(&cptd->trace_outbuf);
+    }
+    pthread_mutex_unlock(&trace_writer_lock);
+  }
+
+  return NULL;
+}
+
+
+// Register the async outbuf of 'cptd' with the writer thread,
+// starting the thread on first use.  Returns 0 on success.
+static int
+trace_writer_add(core_profile_trace_data_t *cptd)
+{
+  int ret = 0;
+
+  pthread_mutex_lock(&trace_writer_lock);
+
+  if (! trace_writer_started) {
+    pthread_t thread;
+    pthread_attr_t attr;
+
+    if (trace_writer_efd < 0) {
+      trace_writer_efd = eventfd(0, EFD_CLOEXEC);
+    }
+    ret = (trace_writer_efd < 0) ? -1 : 0;
+
+    if (ret == 0) {
+      pthread_attr_init(&attr);
+      pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+      // the writer is ours, don't profile it
+      monitor_disable_new_threads();
+      ret = pthread_create(&thread, &attr, trace_writer_loop, NULL);
+      monitor_enable_new_threads();
+
+      pthread_attr_destroy(&attr);
+    }
+    trace_writer_started = (ret == 0);
+  }
+
+  if (ret == 0) {
+    hpcio_outbuf_notify(&cptd->trace_outbuf, trace_writer_efd);
+    cptd->trace_writer_next = trace_writer_active;
+    trace_writer_active = cptd;
+  }
+
+  pthread_mutex_unlock(&trace_writer_lock);
+  return ret;
+}
+
+
+// Unregister the outbuf of 'cptd' before it is closed.  After this
+// returns, the writer thread no longer touches it.
+static void
+trace_writer_remove(core_profile_trace_data_t *cptd)
+{
+  pthread_mutex_lock(&trace_writer_lock);
+
+  for (core_profile_trace_data_t **p = &trace_writer_active; *p != NULL;
+       p = &(*p)->trace_writer_next) {
+    if (*p == cptd) {
+      *p = cptd->trace_writer_next;
+      cptd->trace_writer_next = NULL;
+      break;
+    }
+  }
+  hpcio_outbuf_notify(&cptd->trace_outbuf, -1);
+
+  pthread_mutex_unlock(&trace_writer_lock);
+}
+
+
 static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, uint metric_id, uint64_t microtime)
 {
     if (cptd->trace_min_time_us == 0) {
@@ -232,15 +375,17 @@ static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t
     //TODO: was not in GPU version
     trace_datum.metricId = (uint32_t)metric_id;
     
-    hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
-#ifdef DATACENTRIC_TRACE
-    flags.fields.isDataCentric = true;
-#else
-    flags.fields.isDataCentric = false;
-#endif
-    
-    int ret = hpctrace_fmt_datum_outbuf(&trace_datum, flags, &cptd->trace_outbuf);
+    // time the appends that flush the buffer or hand off a segment
+    unsigned long flushes = hpcio_outbuf_num_flushes(&cptd->trace_outbuf);
+    uint64_t overhead_start = hpcrun_overhead_ticks();
+
+    int ret = hpctrace_fmt_block_datum_outbuf(&trace_datum, &cptd->trace_block,
+					      cptd->trace_flags, &cptd->trace_outbuf);
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "append");
+
+    if (hpcio_outbuf_num_flushes(&cptd->trace_outbuf) != flushes) {
+      hpcrun_overhead_add(&cptd->overhead, HPCRUN_OVERHEAD_FLUSH, overhead_start);
+    }
 }
 
 
@@ -199,6 +199,9 @@ hpcrun_generate_backtrace_no_trampoline(backtrace_info_t* bt,
   td->btbuf_cur   = td->btbuf_beg; // innermost
   td->btbuf_sav   = td->btbuf_end;
 
+  hpcrun_overhead_t* overhead = &td->core_profile_trace_data.overhead;
+  overhead->unwind_start = hpcrun_overhead_ticks();
+
   hpcrun_unw_cursor_t cursor;
   hpcrun_unw_init_cursor(&cursor, context);
 
@@ -264,6 +267,10 @@ hpcrun_generate_backtrace_no_trampoline(backtrace_info_t* bt,
     }
   } while (ret != STEP_ERROR && ret != STEP_STOP);
 
+  hpcrun_overhead_add(overhead, HPCRUN_OVERHEAD_UNWIND,
+		      overhead->unwind_start);
+  overhead->unwind_start = 0;
+
   TMSG(FENCE, "backtrace generation detects fence = %s", fence_enum_name(bt->fence));
 
   frame_t* bt_beg  = td->btbuf_beg;      // innermost, inclusive
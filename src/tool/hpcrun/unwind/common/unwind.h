@@ -60,6 +60,7 @@
 // system include files
 //***************************************************************************
 
+#include <stddef.h>
 #include <ucontext.h>
 
 
@@ -144,6 +145,26 @@ hpcrun_unw_step(hpcrun_unw_cursor_t* c);
 //
 //***************************************************************************
 
+// ----------------------------------------------------------
+// hpcrun_unw_set_stack_snapshot:
+//   Make the unwinder of this thread read the stack from a copy
+//   of its top (e.g., one taken by the kernel for
+//   PERF_SAMPLE_STACK_USER) rather than from memory.  Frames
+//   that are not in the copy end the unwind with an error.
+//   Pass NULL to unwind from memory again.  Only provided by
+//   the x86 unwinder.
+// ----------------------------------------------------------
+
+typedef struct hpcrun_unw_stack_snapshot_t {
+  void       *sp;    // stack address of data[0]
+  size_t      size;  // number of valid bytes in data
+  const char *data;
+} hpcrun_unw_stack_snapshot_t;
+
+void
+hpcrun_unw_set_stack_snapshot(const hpcrun_unw_stack_snapshot_t* snapshot);
+
+
 // ----------------------------------------------------------
 // hpcrun_unw_troll_stack
 // ----------------------------------------------------------
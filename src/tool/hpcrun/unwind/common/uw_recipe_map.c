@@ -110,6 +110,13 @@
 
 #define NUM_NODES 10
 
+// a thread's free list spills NUM_NODES pairs to the global free list
+// when it grows past this
+#define MAX_LOCAL_FREE_NODES (4 * NUM_NODES)
+
+// entries per unwinder in a thread's lookup cache, a power of 2
+#define LOOKUP_CACHE_SIZE 32
+
 //******************************************************************************
 // type
 //******************************************************************************
@@ -152,6 +159,7 @@ ilmstat_btuwi_pair_inrange(void *itp, void *address)
 static ilmstat_btuwi_pair_t *GF_ilmstat_btuwi = NULL; // global free list of ilmstat_btuwi_pair_t*
 static mcs_lock_t GFL_lock;  // lock for GF_ilmstat_btuwi
 static __thread  ilmstat_btuwi_pair_t *_lf_ilmstat_btuwi = NULL;  // thread local free list of ilmstat_btuwi_pair_t*
+static __thread  int _lf_num_ilmstat_btuwi = 0;  // length of _lf_ilmstat_btuwi
 
 
 //******************************************************************************
@@ -222,6 +230,7 @@ ilmstat_btuwi_pair_malloc(
 	  push_free_pair(&_lf_ilmstat_btuwi, head);
 	  n++;
 	}
+	_lf_num_ilmstat_btuwi += n;
       }
       mcs_unlock(&GFL_lock, &me);
     }
@@ -231,6 +240,7 @@ ilmstat_btuwi_pair_malloc(
 	ilmstat_btuwi_pair_t *node = m_alloc(sizeof(*node));
 	push_free_pair(&_lf_ilmstat_btuwi, node);
       }
+      _lf_num_ilmstat_btuwi += NUM_NODES;
     }
   }
 
@@ -244,6 +254,7 @@ ilmstat_btuwi_pair_malloc(
  * return the head node.
  */
   ilmstat_btuwi_pair_t *ans = pop_free_pair(&_lf_ilmstat_btuwi);
+  _lf_num_ilmstat_btuwi--;
   return ilmstat__btuwi_pair_init(ans, treestat, lm, start, end);
 }
 
@@ -257,11 +268,21 @@ ilmstat_btuwi_pair_free(ilmstat_btuwi_pair_t* pair, unwinder_t uw)
   if (!pair) return;
   bitree_uwi_free(uw, pair->btuwi);
 
-  // add pair to the front of the  global free list of ilmstat_btuwi_pair_t*:
-  mcs_node_t me;
-  mcs_lock(&GFL_lock, &me);
-  push_free_pair(&GF_ilmstat_btuwi, pair);
-  mcs_unlock(&GFL_lock, &me);
+  // add pair to the front of the thread local free list, and only
+  // take the global lock to hand a batch back when that list is long.
+  push_free_pair(&_lf_ilmstat_btuwi, pair);
+  _lf_num_ilmstat_btuwi++;
+
+  if (_lf_num_ilmstat_btuwi > MAX_LOCAL_FREE_NODES) {
+    mcs_node_t me;
+    mcs_lock(&GFL_lock, &me);
+    for (int i = 0; i < NUM_NODES; i++) {
+      ilmstat_btuwi_pair_t *head = pop_free_pair(&_lf_ilmstat_btuwi);
+      push_free_pair(&GF_ilmstat_btuwi, head);
+    }
+    mcs_unlock(&GFL_lock, &me);
+    _lf_num_ilmstat_btuwi -= NUM_NODES;
+  }
 }
 
 //---------------------------------------------------------------------
@@ -275,6 +296,19 @@ static cskiplist_t *addr2recipe_map[NUM_UNWINDERS];
 // and inserting entries into addr2recipe_map:
 static mem_alloc my_alloc = hpcrun_malloc;
 
+// Each thread caches the READY pairs it found, indexed by address, so
+// that repeated lookups of hot code don't search the shared map.  Pairs
+// are freed and reused when modules are mapped or unmapped, so those
+// events bump the generation once they have freed and reused pairs, and
+// a thread drops its cache when it sees a new one.
+typedef struct lookup_cache_s {
+  long generation;
+  ilmstat_btuwi_pair_t *pair[NUM_UNWINDERS][LOOKUP_CACHE_SIZE];
+} lookup_cache_t;
+
+static atomic_long lookup_cache_generation = ATOMIC_VAR_INIT(1);
+static __thread lookup_cache_t lookup_cache;
+
 //******************************************************************************
 // String output
 //******************************************************************************
@@ -442,6 +476,26 @@ uw_recipe_map_report_and_dump(const char *op, void *start, void *end)
 #define uw_recipe_map_report_and_dump(op, start, end)
 #endif
 
+static inline ilmstat_btuwi_pair_t **
+lookup_cache_slot(void *addr, unwinder_t uw)
+{
+  long gen = atomic_load_explicit(&lookup_cache_generation, memory_order_acquire);
+  if (lookup_cache.generation != gen) {
+    memset(lookup_cache.pair, 0, sizeof(lookup_cache.pair));
+    lookup_cache.generation = gen;
+  }
+
+  uintptr_t key = (uintptr_t)addr;
+  key = (key >> 4) ^ (key >> 12);
+  return &lookup_cache.pair[uw][key & (LOOKUP_CACHE_SIZE - 1)];
+}
+
+static inline void
+lookup_cache_invalidate(void)
+{
+  atomic_fetch_add_explicit(&lookup_cache_generation, 1, memory_order_release);
+}
+
 static void
 uw_recipe_map_poison(uintptr_t start, uintptr_t end, unwinder_t uw)
 {
@@ -562,6 +616,8 @@ uw_recipe_map_notify_map(void *start, void *end)
   for (uw = 0; uw < NUM_UNWINDERS; uw++)
     uw_recipe_map_unpoison((uintptr_t)start, (uintptr_t)end, uw);
 
+  lookup_cache_invalidate();
+
   uw_recipe_map_report_and_dump("*** map: after unpoisoning", start, end);
 }
 
@@ -581,6 +637,8 @@ uw_recipe_map_notify_unmap(void *start, void *end)
   for (uw = 0; uw < NUM_UNWINDERS; uw++)
     uw_recipe_map_repoison((uintptr_t)start, (uintptr_t)end, uw);
 
+  lookup_cache_invalidate();
+
   uw_recipe_map_report_and_dump("*** unmap: after poisoning", start, end);
 }
 
@@ -634,6 +692,28 @@ uw_recipe_map_init(void)
 }
 
 
+/*
+ * hand the free pairs of an exiting thread to the global free list
+ */
+void
+uw_recipe_map_thread_fini(void)
+{
+  ilmstat_btuwi_pair_t *tail = _lf_ilmstat_btuwi;
+  if (!tail) return;
+  while (tail->btuwi)
+    tail = (ilmstat_btuwi_pair_t *)tail->btuwi;
+
+  mcs_node_t me;
+  mcs_lock(&GFL_lock, &me);
+  push_free_pair(&GF_ilmstat_btuwi, tail);
+  GF_ilmstat_btuwi = _lf_ilmstat_btuwi;
+  mcs_unlock(&GFL_lock, &me);
+
+  _lf_ilmstat_btuwi = NULL;
+  _lf_num_ilmstat_btuwi = 0;
+}
+
+
 /*
  *
  */
@@ -655,9 +735,22 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
   unwr_info->interval.start = 0;
   unwr_info->interval.end   = 0;
 
+  // check this thread's cache first
+  ilmstat_btuwi_pair_t **slot = lookup_cache_slot(addr, uw);
+  ilmstat_btuwi_pair_t* ilm_btui = *slot;
+  if (ilm_btui
+      && READY == atomic_load_explicit(&ilm_btui->stat, memory_order_acquire)
+      && interval_t_inrange(&ilm_btui->interval, addr) == 0) {
+    TMSG(UW_RECIPE_MAP_LOOKUP, "found in lookup cache: addr %p", addr);
+    unwr_info->btuwi    = bitree_uwi_inrange(ilm_btui->btuwi, (uintptr_t)addr);
+    unwr_info->treestat = READY;
+    unwr_info->lm       = ilm_btui->lm;
+    unwr_info->interval = ilm_btui->interval;
+    return (unwr_info->btuwi != NULL);
+  }
+
   // check if addr is already in the range of an interval key in the map
-  ilmstat_btuwi_pair_t* ilm_btui =
-    uw_recipe_map_inrange_find((uintptr_t)addr, uw);
+  ilm_btui = uw_recipe_map_inrange_find((uintptr_t)addr, uw);
 
   if (!ilm_btui) {
 	load_module_t *lm;
@@ -737,6 +830,7 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
   }
 
   TMSG(UW_RECIPE_MAP_LOOKUP, "found in unwind tree: addr %p", addr);
+  *slot = ilm_btui;
 
   bitree_uwi_t *btuwi = ilm_btui->btuwi;
   unwr_info->btuwi    = bitree_uwi_inrange(btuwi, (uintptr_t)addr);
@@ -746,3 +840,161 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
 
   return (unwr_info->btuwi != NULL);
 }
+
+
+//***************************************************************************
+// unit test
+//***************************************************************************
+// #define UNIT_TEST_UW_RECIPE_MAP
+
+#ifdef UNIT_TEST_UW_RECIPE_MAP
+
+// Lookup throughput as the number of threads grows.  For each thread
+// count the code is mapped again, as after a phase change, so that the
+// threads race to build the intervals of every function, and then each
+// thread looks up addresses, most of them in a few hot functions.
+// Checks every lookup against the function bounds, that lookups in
+// unmapped code fail, and that an exiting thread keeps no free pairs.
+// The functions and their intervals are made up here; link with the
+// skip list, lock and binary tree objects and with stand-ins for
+// hpcrun_malloc, the thread data, the loadmap and messages.
+//
+// usage: a.out [max threads] [lookups per thread] [functions]
+
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+
+#define BENCH_CODE_START 0x10000000
+#define BENCH_FCN_SIZE   256
+#define BENCH_HOT_FCNS   64
+
+static uintptr_t bench_fcns;
+
+bool
+fnbounds_enclosing_addr(void *ip, void **start, void **end, load_module_t **lm)
+{
+  uintptr_t addr = (uintptr_t)ip;
+  if (addr < BENCH_CODE_START
+      || addr >= BENCH_CODE_START + bench_fcns * BENCH_FCN_SIZE)
+    return false;
+
+  *start = (void *)(addr - addr % BENCH_FCN_SIZE);
+  *end = (void *)((uintptr_t)*start + BENCH_FCN_SIZE);
+  *lm = NULL;
+  return true;
+}
+
+// four intervals per function, linked through their right subtrees
+btuwi_status_t
+build_intervals(char *ins, unsigned int len, unwinder_t uw)
+{
+  btuwi_status_t stat = { NULL, NULL, 4, 0 };
+  bitree_uwi_t *prev = NULL;
+  for (int i = 0; i < 4; i++) {
+    bitree_uwi_t *u = bitree_uwi_malloc(uw, 16);
+    bitree_uwi_interval(u)->start = (uintptr_t)ins + i * len / 4;
+    bitree_uwi_interval(u)->end = (uintptr_t)ins + (i + 1) * len / 4;
+    if (prev)
+      bitree_uwi_set_rightsubtree(prev, u);
+    else
+      stat.first = u;
+    prev = u;
+  }
+  return stat;
+}
+
+static bool
+bench_lookup_ok(uintptr_t addr, unwinder_t uw)
+{
+  unwindr_info_t info;
+  if (!uw_recipe_map_lookup((void *)addr, uw, &info))
+    return false;
+
+  uintptr_t start = addr - addr % BENCH_FCN_SIZE;
+  interval_t *uwi = bitree_uwi_interval(info.btuwi);
+  return info.treestat == READY
+    && info.interval.start == start
+    && info.interval.end == start + BENCH_FCN_SIZE
+    && uwi->start <= addr && addr < uwi->end;
+}
+
+typedef struct bench_arg_s {
+  pthread_t thread;
+  uint64_t seed;
+  long lookups;
+} bench_arg_t;
+
+static void *
+bench_worker(void *varg)
+{
+  bench_arg_t *arg = varg;
+  uint64_t x = arg->seed;
+
+  for (long i = 0; i < arg->lookups; i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    uintptr_t fcn = (x % 10) ? (x >> 8) % BENCH_HOT_FCNS : (x >> 8) % bench_fcns;
+    uintptr_t addr = BENCH_CODE_START + fcn * BENCH_FCN_SIZE
+      + (x >> 40) % BENCH_FCN_SIZE;
+    bool ok = bench_lookup_ok(addr, i & 1 ? NATIVE_UNWINDER : DWARF_UNWINDER);
+    assert(ok);
+  }
+
+  uw_recipe_map_thread_fini();
+  assert(_lf_ilmstat_btuwi == NULL && _lf_num_ilmstat_btuwi == 0);
+  return NULL;
+}
+
+static double
+bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+int
+main(int argc, char **argv)
+{
+  int max_threads = (argc > 1) ? atoi(argv[1]) : 16;
+  long lookups    = (argc > 2) ? atol(argv[2]) : 1000000;
+  bench_fcns      = (argc > 3) ? atol(argv[3]) : 4096;
+  assert(bench_fcns >= BENCH_HOT_FCNS);
+
+  void *start = (void *)BENCH_CODE_START;
+  void *end   = (void *)(BENCH_CODE_START + bench_fcns * BENCH_FCN_SIZE);
+
+  uw_recipe_map_init();
+
+  // fill this thread's lookup cache, then unmap the code under it
+  uw_recipe_map_notify_map(start, end);
+  for (uintptr_t f = 0; f < bench_fcns; f++)
+    assert(bench_lookup_ok(BENCH_CODE_START + f * BENCH_FCN_SIZE, NATIVE_UNWINDER));
+  uw_recipe_map_notify_unmap(start, end);
+  for (uintptr_t f = 0; f < bench_fcns; f++)
+    assert(!bench_lookup_ok(BENCH_CODE_START + f * BENCH_FCN_SIZE, NATIVE_UNWINDER));
+
+  printf("%8s %10s %14s\n", "threads", "seconds", "lookups/s");
+  for (int n = 1; n <= max_threads; n *= 2) {
+    bench_arg_t arg[n];
+    uw_recipe_map_notify_map(start, end);
+
+    double t0 = bench_now();
+    for (int i = 0; i < n; i++) {
+      arg[i].seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+      arg[i].lookups = lookups;
+      pthread_create(&arg[i].thread, NULL, bench_worker, &arg[i]);
+    }
+    for (int i = 0; i < n; i++)
+      pthread_join(arg[i].thread, NULL);
+    double t = bench_now() - t0;
+
+    uw_recipe_map_notify_unmap(start, end);
+    printf("%8d %10.3f %14.0f\n", n, t, n * lookups / t);
+  }
+  return 0;
+}
+
+#endif
@@ -59,6 +59,14 @@ void
 uw_recipe_map_init(void);
 
 
+/*
+ * return the calling thread's free map entries to the shared free list;
+ * called when the thread exits
+ */
+void
+uw_recipe_map_thread_fini(void);
+
+
 /*
  * if addr is found in range in the map, return true and
  *   *unwr_info is the ilmstat_btuwi_pair_t ( ([start, end), ldmod, status), btuwi ),
@@ -57,6 +57,8 @@
 #include <stdio.h>
 #include <setjmp.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include <assert.h>
 
 #include <sys/types.h>
@@ -120,6 +122,9 @@ static int DEBUG_WAIT_BEFORE_TROLLING = 1;
 
 static int DEBUG_NO_LONGJMP = 0;
 
+// copy of the stack to unwind from, instead of memory
+static __thread const hpcrun_unw_stack_snapshot_t *stack_snapshot = NULL;
+
 
 
 //****************************************************************************
@@ -141,6 +146,9 @@ unw_step_bp(hpcrun_unw_cursor_t* cursor);
 static step_state
 unw_step_std(hpcrun_unw_cursor_t* cursor);
 
+static bool
+unw_read_stack(void **addr, void **value);
+
 static step_state
 t1_dbg_unw_step(hpcrun_unw_cursor_t* cursor);
 
@@ -233,15 +241,33 @@ hpcrun_unw_get_ip_unnorm_reg(hpcrun_unw_cursor_t* c, void** reg_value)
   return hpcrun_unw_get_unnorm_reg(c, UNW_REG_IP, reg_value);
 }
 
+void
+hpcrun_unw_set_stack_snapshot(const hpcrun_unw_stack_snapshot_t* snapshot)
+{
+  stack_snapshot = snapshot;
+}
+
 void 
 hpcrun_unw_init_cursor(hpcrun_unw_cursor_t* cursor, void* context)
 {
-  libunw_unw_init_cursor(cursor, context);
-
   void *pc, **bp, **sp;
-  unw_get_reg(&cursor->uc, UNW_REG_IP, (unw_word_t *)&pc);
-  unw_get_reg(&cursor->uc, UNW_REG_SP, (unw_word_t *)&sp);
-  unw_get_reg(&cursor->uc, UNW_TDEP_BP, (unw_word_t *)&bp);
+
+  if (stack_snapshot) {
+    // libunwind would read the stack from memory: use only the
+    // native unwinder on a copy of the stack
+    mcontext_t *mc = GET_MCONTEXT(context);
+    pc = MCONTEXT_PC(mc);
+    sp = MCONTEXT_SP(mc);
+    bp = MCONTEXT_BP(mc);
+    cursor->libunw_status = LIBUNW_UNAVAIL;
+  }
+  else {
+    libunw_unw_init_cursor(cursor, context);
+
+    unw_get_reg(&cursor->uc, UNW_REG_IP, (unw_word_t *)&pc);
+    unw_get_reg(&cursor->uc, UNW_REG_SP, (unw_word_t *)&sp);
+    unw_get_reg(&cursor->uc, UNW_TDEP_BP, (unw_word_t *)&bp);
+  }
   save_registers(cursor, pc, bp, sp, NULL);
 
   if (cursor->libunw_status == LIBUNW_READY)
@@ -309,6 +335,12 @@ hpcrun_unw_step_real(hpcrun_unw_cursor_t* cursor)
   void*  sp = cursor->sp;
   unwind_interval* uw = cursor->unwr_info.btuwi;
 
+  if (!uw && stack_snapshot) {
+    // the copy of the stack cannot be trolled
+    TMSG(UNW, "unw_step: STEP_ERROR, invalid unw interval for cursor");
+    return STEP_ERROR;
+  }
+
   if (!uw) {
     TMSG(UNW, "unw_step: invalid unw interval for cursor, trolling ...");
     TMSG(TROLL, "Troll due to Invalid interval for pc %p", pc);
@@ -337,7 +369,7 @@ hpcrun_unw_step_real(hpcrun_unw_cursor_t* cursor)
   }
   if (unw_res == STEP_STOP_WEAK) unw_res = STEP_STOP; 
 
-  if (unw_res != STEP_ERROR) {
+  if (unw_res != STEP_ERROR || stack_snapshot) {
     return unw_res;
   }
   
@@ -394,6 +426,8 @@ static bool
 hpcrun_retry_libunw_find_step(hpcrun_unw_cursor_t *cursor,
 			      void *pc, void **sp, void **bp)
 {
+  if (stack_snapshot) return false;
+
   ucontext_t uc;
   memcpy(&uc, &cursor->uc, sizeof(uc));
   LV_MCONTEXT_PC(&uc.uc_mcontext) = (intptr_t)pc;
@@ -485,16 +519,25 @@ unw_step_sp(hpcrun_unw_cursor_t* cursor)
   TMSG(UNW,"step_sp: cursor { bp=%p, sp=%p, pc=%p }", bp, sp, pc);
   if (MYDBG) { dump_ui(uw, 0); }
 
-  void** next_bp = xr->reg.bp_status == BP_UNCHANGED ? bp :
+  void** next_bp = bp;
+  if (xr->reg.bp_status != BP_UNCHANGED) {
     //-----------------------------------------------------------
     // reload the candidate value for the caller's BP from the 
     // save area in the activation frame according to the unwind 
     // information produced by binary analysis
     //-----------------------------------------------------------
-    *(void **)(sp + xr->reg.sp_bp_pos);
+    if (!unw_read_stack((void **)(sp + xr->reg.sp_bp_pos), (void **)&next_bp)) {
+      TMSG(UNW,"  step_sp: STEP_ERROR, bp save area not in stack copy");
+      return STEP_ERROR;
+    }
+  }
   void** next_sp = (void **)(sp + xr->reg.sp_ra_pos);
   void*  ra_loc  = (void*) next_sp;
-  void*  next_pc  = *next_sp++;
+  void*  next_pc;
+  if (!unw_read_stack(next_sp++, &next_pc)) {
+    TMSG(UNW,"  step_sp: STEP_ERROR, return address not in stack copy");
+    return STEP_ERROR;
+  }
 
   if ((RA_BP_FRAME == xr->ra_status) ||
       (RA_STD_FRAME == xr->ra_status)) { // Makes sense to sanity check BP, do it
@@ -585,10 +628,15 @@ unw_step_bp(hpcrun_unw_cursor_t* cursor)
     }
   }
   // bp relative
-  void **next_bp  = *(void **)((void *)bp + xr->reg.bp_bp_pos);
+  void **next_bp;
   void **next_sp  = (void **)((void *)bp + xr->reg.bp_ra_pos);
   void* ra_loc = (void*) next_sp;
-  void *next_pc  = *next_sp++;
+  void *next_pc;
+  if (!unw_read_stack((void **)((void *)bp + xr->reg.bp_bp_pos), (void **)&next_bp) ||
+      !unw_read_stack(next_sp++, &next_pc)) {
+    TMSG(UNW,"  step_bp: STEP_ERROR, frame not in stack copy");
+    return STEP_ERROR;
+  }
 
   
   if (hpcrun_retry_libunw_find_step(cursor, next_pc, next_sp, next_bp))
@@ -690,6 +738,29 @@ t2_dbg_unw_step(hpcrun_unw_cursor_t* cursor)
 // private operations
 //****************************************************************************
 
+// read a word of the stack, either from memory or from the copy
+// set with hpcrun_unw_set_stack_snapshot.  returns false if the
+// word is not in the copy.
+static bool
+unw_read_stack(void **addr, void **value)
+{
+  const hpcrun_unw_stack_snapshot_t *snapshot = stack_snapshot;
+
+  if (snapshot == NULL) {
+    *value = *addr;
+    return true;
+  }
+
+  uintptr_t offset = (uintptr_t) addr - (uintptr_t) snapshot->sp;
+  if ((uintptr_t) addr < (uintptr_t) snapshot->sp ||
+      offset + sizeof(void *) > snapshot->size) {
+    return false;
+  }
+  memcpy(value, snapshot->data + offset, sizeof(void *));
+  return true;
+}
+
+
 static void
 update_cursor_with_troll(hpcrun_unw_cursor_t* cursor, int offset)
 {
@@ -120,6 +120,18 @@ Options: General\n\
                            indicates that the port will be auto-negotiated with\n\
                            the client. Specifying 1 indicates that the xml will\n\
                            be transferred on the main data port.\n\
+  -i, --trace-index    Enables or disables the trace index (on by default).\n\
+                           The index is kept in experiment.mt.idx next to the\n\
+                           merged trace file and is rebuilt when out of date.\n\
+                           Allowed values: on off \n\
+  -P, --trace-pyramid  Enables or disables the trace pyramid (off by default).\n\
+                           Zoomed-out views then show the dominant call path\n\
+                           of each pixel, read from experiment.mt.pyr next to\n\
+                           the merged trace file, which is built on first use.\n\
+                           Allowed values: on off \n\
+  -j, --threads <n>    Use <n> threads to read and compress the timelines of a\n\
+                           request (default is 1). Only for the single-process\n\
+                           hpcserver; hpcserver-mpi uses its MPI ranks instead.\n\
 \n\
 ";
 
@@ -149,6 +161,12 @@ CmdLineParser::OptArgDesc Args::optArgs[] = {
      CLP::isOptArg_long },
   {  'x' , "xmlport",       CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
      CLP::isOptArg_long },
+  {  'i' , "trace-index",       CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     CLP::isOptArg_long },
+  {  'P' , "trace-pyramid",       CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     CLP::isOptArg_long },
+  {  'j' , "threads",       CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     CLP::isOptArg_long },
   CmdLineParser_OptArgDesc_NULL_MACRO // SGI's compiler requires this version
 };
 
@@ -176,6 +194,9 @@ void
 Args::Ctor()
 {
   compression = true;
+  traceIndex = true;
+  tracePyramid = false;
+  numThreads = 1;
   mainPort = DEFAULT_PORT;//21590
   xmlPort = 0;
 }
@@ -258,6 +279,20 @@ Args::parse(int argc, const char* const argv[])
       const string& arg = parser.getOptArg("compression");
       compression = CmdLineParser::parseArg_bool(arg, "--compression option");
     }
+    if (parser.isOpt("trace-index")) {
+      const string& arg = parser.getOptArg("trace-index");
+      traceIndex = CmdLineParser::parseArg_bool(arg, "--trace-index option");
+    }
+    if (parser.isOpt("trace-pyramid")) {
+      const string& arg = parser.getOptArg("trace-pyramid");
+      tracePyramid = CmdLineParser::parseArg_bool(arg, "--trace-pyramid option");
+    }
+    if (parser.isOpt("threads")) {
+      const string& arg = parser.getOptArg("threads");
+      numThreads = (int) CmdLineParser::toLong(arg);
+      if (numThreads < 1)
+         	  ARG_ERROR("The number of threads must be at least 1.")
+    }
     if (parser.isOpt("port")) {
       const string& arg = parser.getOptArg("port");
       mainPort = (int) CmdLineParser::toLong(arg);
@@ -113,6 +113,9 @@ public:
   int mainPort;       // default: 21590
   int xmlPort;        // default: 0
   bool compression;   // default: true
+  bool traceIndex;    // default: true
+  bool tracePyramid;  // default: false
+  int numThreads;     // default: 1
 
 private:
   void
@@ -65,11 +65,13 @@
 #include "DebugUtils.hpp"
 #include "Server.hpp"
 #include "Slave.hpp"
+#include "TimelineSummary.hpp"
 
 #include <mpi.h>
 
 #include <iostream> //For cerr, cout
 #include <algorithm> //For copy
+#include <vector>
 
 using namespace std;
 using namespace MPI;
@@ -168,6 +170,48 @@ void Communication::sendEndGetData(DataSocketStream* stream, ProgressBar* prog,
 	}
 	LOGTIMESTAMPEDMSG("All data done.")
 }
+void Communication::sendStartGetSummary(SpaceTimeDataController* contr, int processStart, int processEnd,
+			Time timeStart, Time timeEnd, int verticalResolution, int horizontalResolution)
+{
+	MPICommunication::CommandMessage toBcast;
+	toBcast.command = SUMM;
+	toBcast.gdata.processStart = processStart;
+	toBcast.gdata.processEnd = processEnd;
+	toBcast.gdata.timeStart = timeStart;
+	toBcast.gdata.timeEnd = timeEnd;
+	toBcast.gdata.verticalResolution = verticalResolution;
+	toBcast.gdata.horizontalResolution = horizontalResolution;
+	COMM_WORLD.Bcast(&toBcast, sizeof(toBcast), MPI_PACKED,
+		MPICommunication::SOCKET_SERVER);
+	contr->attributes->numPixelsH = horizontalResolution;
+}
+//Every slave sends the packed summary of its timelines
+void Communication::sendEndGetSummary(DataSocketStream* stream, SpaceTimeDataController* controller)
+{
+	int size = COMM_WORLD.Get_size();
+	TimelineSummary summary(controller->attributes->numPixelsH);
+
+	int ranksDone = 1;//1 for the MPI rank that deals with the sockets
+	while (ranksDone < size)
+	{
+		MPICommunication::ResultMessage msg;
+		COMM_WORLD.Recv(&msg, sizeof(msg), MPI_PACKED, MPI_ANY_SOURCE, MPI_ANY_TAG);
+		if (msg.tag != SLAVE_SUMMARY)
+		{
+			cerr << "Unexpected message while waiting for summaries: " << msg.tag << endl;
+			continue;
+		}
+
+		vector<int> packed(msg.data.entries);
+		COMM_WORLD.Recv(packed.data(), msg.data.entries, MPI_INT, msg.data.rankID,
+				MPI_ANY_TAG);
+		summary.unpack(packed.data(), packed.size());
+		ranksDone++;
+	}
+	LOGTIMESTAMPEDMSG("All summaries received.")
+
+	summary.send(stream);
+}
 void Communication::sendStartFilter(int count, bool excludeMatches)
 {
 	MPICommunication::CommandMessage toBcast;
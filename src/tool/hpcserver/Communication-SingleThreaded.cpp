@@ -58,8 +58,15 @@
 //***************************************************************************
 
 #include <stdint.h>                     // for uint64_t
+#include <algorithm>                    // for min
+#include <atomic>                       // for atomic
+#include <condition_variable>           // for condition_variable
+#include <exception>                    // for exception_ptr, rethrow_exception
 #include <iostream>                     // for operator<<, basic_ostream, etc
+#include <memory>                       // for unique_ptr
+#include <mutex>                        // for mutex, lock_guard, unique_lock
 #include <string>                       // for string
+#include <thread>                       // for thread
 #include <vector>                       // for vector, vector<>::iterator
 
 #include "Communication.hpp"            // for Communication
@@ -73,6 +80,7 @@
 #include "Server.hpp"                   // for Server
 #include "SpaceTimeDataController.hpp"  // for SpaceTimeDataController
 #include "TimeCPID.hpp"                 // for TimeCPID, Time
+#include "TimelineSummary.hpp"          // for TimelineSummary
 #include "TraceDataByRank.hpp"          // for TraceDataByRank
 
 
@@ -101,47 +109,238 @@ void Communication::sendStartGetData(SpaceTimeDataController* contr, int process
 
 
 }
+static void readTimelineData(ProcessTimeline* timeline)
+{
+	timeline->readInData();
+}
+
+void (*Communication::readTimeline)(ProcessTimeline* timeline) = readTimelineData;
+
+// Compresses the samples of a timeline as (time delta, cpid) pairs
+static void compressTimeline(ProcessTimeline* timeline, DataCompressionLayer* comprStr)
+{
+	vector<TimeCPID>& data = *timeline->data->listCPID;
+
+	vector<TimeCPID>::iterator it;
+	DEBUGCOUT(2) << "Sending process timeline with " << data.size() << " entries" << endl;
+
+
+	Time currentTime = data[0].timestamp;
+	for (it = data.begin(); it != data.end(); ++it)
+	{
+		comprStr->writeInt( (int)(it->timestamp - currentTime));
+		comprStr->writeInt( it->cpid);
+		currentTime = it->timestamp;
+	}
+	comprStr->flush();
+}
+
+static void sendTimeline(DataSocketStream* stream, ProcessTimeline* timeline,
+		DataCompressionLayer* comprStr)
+{
+	vector<TimeCPID>& data = *timeline->data->listCPID;
+
+	stream->writeInt( timeline->line());
+	stream->writeInt( data.size());
+	// Begin time
+	stream->writeLong( data[0].timestamp);
+	//End time
+	stream->writeLong( data[data.size() - 1].timestamp);
+
+	int outputBufferLen = comprStr->getOutputLength();
+	char* outputBuffer = (char*)comprStr->getOutputBuffer();
+
+	stream->writeInt(outputBufferLen);
+
+	stream->writeRawData(outputBuffer, outputBufferLen);
+}
+
+// Reads and compresses the timelines with numThreads threads. The
+// timelines are sent in order, each as soon as it and all the ones
+// before it are ready, so the stream is the same as with one thread.
+static void sendTimelinesThreaded(DataSocketStream* stream, ProgressBar* prog,
+		SpaceTimeDataController* controller)
+{
+	controller->createTraces();
+	int numTraces = controller->tracesLength;
+
+	vector<DataCompressionLayer*> compressed(numTraces, (DataCompressionLayer*)NULL);
+	std::mutex compressedLock;
+	std::condition_variable compressedReady;
+	std::atomic<int> nextTrace(0);
+	// the first exception thrown by a worker (e.g., std::bad_alloc),
+	// rethrown on this thread
+	std::exception_ptr workerError;
+
+	auto work = [&]() {
+		try
+		{
+			for (int i = nextTrace++; i < numTraces; i = nextTrace++)
+			{
+				ProcessTimeline* timeline = controller->traces[i];
+				Communication::readTimeline(timeline);
+				std::unique_ptr<DataCompressionLayer> comprStr(new DataCompressionLayer());
+				compressTimeline(timeline, comprStr.get());
+				{
+					std::lock_guard<std::mutex> guard(compressedLock);
+					compressed[i] = comprStr.release();
+				}
+				compressedReady.notify_all();
+			}
+		}
+		catch (...)
+		{
+			nextTrace = numTraces;
+			{
+				std::lock_guard<std::mutex> guard(compressedLock);
+				if (!workerError)
+					workerError = std::current_exception();
+			}
+			compressedReady.notify_all();
+		}
+	};
+
+	vector<std::thread> workers;
+	try
+	{
+		for (int t = 0; t < min(numThreads, numTraces); t++)
+			workers.push_back(std::thread(work));
+
+		for (int i = 0; i < numTraces; i++)
+		{
+			DataCompressionLayer* comprStr;
+			{
+				std::unique_lock<std::mutex> guard(compressedLock);
+				compressedReady.wait(guard, [&]() {
+					return compressed[i] != NULL || workerError;
+				});
+				if (workerError)
+					std::rethrow_exception(workerError);
+				comprStr = compressed[i];
+			}
+			sendTimeline(stream, controller->traces[i], comprStr);
+			delete comprStr;
+			compressed[i] = NULL;
+			prog->incrementProgress();
+		}
+	}
+	catch (...)
+	{
+		// e.g., the client closed the connection or a worker failed: stop
+		// and clean up
+		nextTrace = numTraces;
+		for (size_t t = 0; t < workers.size(); t++)
+			workers[t].join();
+		for (int i = 0; i < numTraces; i++)
+			delete compressed[i];
+		throw;
+	}
+
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+	stream->flush();
+}
+
 void Communication::sendEndGetData(DataSocketStream* stream, ProgressBar* prog, SpaceTimeDataController* controller)
 {
 	// TODO: Make this so that the Lines get sent as soon as they are
 	// filled.
 
+	if (numThreads > 1)
+	{
+		sendTimelinesThreaded(stream, prog, controller);
+		return;
+	}
+
 	controller->fillTraces();
 	for (int i = 0; i < controller->tracesLength; i++)
 	{
 
 		ProcessTimeline* timeline = controller->traces[i];
-		stream->writeInt( timeline->line());
-		vector<TimeCPID> data = *timeline->data->listCPID;
-		stream->writeInt( data.size());
-		// Begin time
-		stream->writeLong( data[0].timestamp);
-		//End time
-		stream->writeLong( data[data.size() - 1].timestamp);
 
 		DataCompressionLayer comprStr;
+		compressTimeline(timeline, &comprStr);
+		sendTimeline(stream, timeline, &comprStr);
+
+		prog->incrementProgress();
+	}
+	stream->flush();
+}
+
+void Communication::sendStartGetSummary(SpaceTimeDataController* contr, int processStart, int processEnd,
+			Time timeStart, Time timeEnd, int verticalResolution, int horizontalResolution)
+{
+	sendStartGetData(contr, processStart, processEnd, timeStart, timeEnd,
+			verticalResolution, horizontalResolution);
+}
+
+// Reads the timelines with numThreads threads, each adding the ones it
+// reads to its own summary, and sends the merged summary.
+void Communication::sendEndGetSummary(DataSocketStream* stream, SpaceTimeDataController* controller)
+{
+	controller->createTraces();
+	int numTraces = controller->tracesLength;
+	int numColumns = controller->attributes->numPixelsH;
 
-		vector<TimeCPID>::iterator it;
-		DEBUGCOUT(2) << "Sending process timeline with " << data.size() << " entries" << endl;
+	int numWorkers = max(1, min(numThreads, numTraces));
+	vector<TimelineSummary*> partial(numWorkers, (TimelineSummary*)NULL);
+	std::atomic<int> nextTrace(0);
+	// the first exception thrown by a worker (cf. sendTimelinesThreaded)
+	std::exception_ptr workerError;
+	std::mutex workerErrorLock;
 
+	auto fail = [&]() {
+		nextTrace = numTraces;
+		std::lock_guard<std::mutex> guard(workerErrorLock);
+		if (!workerError)
+			workerError = std::current_exception();
+	};
 
-		Time currentTime = data[0].timestamp;
-		for (it = data.begin(); it != data.end(); ++it)
+	auto work = [&](int w) {
+		try
 		{
-			comprStr.writeInt( (int)(it->timestamp - currentTime));
-			comprStr.writeInt( it->cpid);
-			currentTime = it->timestamp;
+			partial[w] = new TimelineSummary(numColumns);
+			for (int i = nextTrace++; i < numTraces; i = nextTrace++)
+			{
+				ProcessTimeline* timeline = controller->traces[i];
+				Communication::readTimeline(timeline);
+				partial[w]->add(timeline);
+			}
 		}
-		comprStr.flush();
-		int outputBufferLen = comprStr.getOutputLength();
-		char* outputBuffer = (char*)comprStr.getOutputBuffer();
+		catch (...)
+		{
+			fail();
+		}
+	};
+
+	vector<std::thread> workers;
+	try
+	{
+		for (int w = 1; w < numWorkers; w++)
+			workers.push_back(std::thread(work, w));
+	}
+	catch (...)
+	{
+		fail();
+	}
+	work(0);
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
 
-		stream->writeInt(outputBufferLen);
+	if (workerError)
+	{
+		for (int w = 0; w < numWorkers; w++)
+			delete partial[w];
+		std::rethrow_exception(workerError);
+	}
 
-		stream->writeRawData(outputBuffer, outputBufferLen);
-		prog->incrementProgress();
+	for (int w = 1; w < numWorkers; w++)
+	{
+		partial[0]->merge(*partial[w]);
+		delete partial[w];
 	}
-	stream->flush();
+	partial[0]->send(stream);
+	delete partial[0];
 }
 
 void Communication::sendStartFilter(int count, bool excludeMatches)
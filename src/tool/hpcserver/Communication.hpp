@@ -85,9 +85,16 @@ public:
 	static void sendStartGetData(SpaceTimeDataController* contr, int processStart, int processEnd,
 			Time timeStart, Time timeEnd, int verticalResolution, int horizontalResolution);
 	static void sendEndGetData(DataSocketStream* stream, ProgressBar* prog, SpaceTimeDataController* controller);
+	static void sendStartGetSummary(SpaceTimeDataController* contr, int processStart, int processEnd,
+			Time timeStart, Time timeEnd, int verticalResolution, int horizontalResolution);
+	static void sendEndGetSummary(DataSocketStream* stream, SpaceTimeDataController* controller);
 	static void sendStartFilter(int count, bool excludeMatches);
 	static void sendFilter(BinaryRepresentationOfFilter filt);
 
+	// Reads a timeline on a worker thread of sendEndGetData and
+	// sendEndGetSummary; a test may replace it to make the workers fail
+	static void (*readTimeline)(ProcessTimeline* timeline);
+
 	static bool basicInit(int argc, char** argv);
 	static void run();
 	static void closeServer();
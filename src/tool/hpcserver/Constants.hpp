@@ -92,8 +92,10 @@ enum Header {
 	NODB = 0x4E4F4442,
 	EXML = 0x45584D4C,
 	FLTR = 0x464C5452,
+	SUMM = 0x53554D4D,
 	SLAVE_REPLY = 0x534C5250,
-	SLAVE_DONE = 0x534C444E
+	SLAVE_DONE = 0x534C444E,
+	SLAVE_SUMMARY = 0x534C534D
 };
 
 enum ServerNextAction {
@@ -67,11 +67,15 @@
 
 #include "DebugUtils.hpp"
 #include "FilteredBaseData.hpp"
+#include "Server.hpp" // numThreads
 
 namespace TraceviewerServer {
 FilteredBaseData::FilteredBaseData(string filename, int _headerSize) {
 	baseDataFile = new BaseDataFile(filename, _headerSize);
 	headerSize = _headerSize;
+	traceFilename = filename;
+	traceIndex = NULL;
+	tracePyramid = NULL;
 	baseOffsets = baseDataFile->getOffsets();
 	//Filters are default, which is allow everything, so this will initialize the vector
 	filter();
@@ -79,6 +83,8 @@ FilteredBaseData::FilteredBaseData(string filename, int _headerSize) {
 }
 
 FilteredBaseData::~FilteredBaseData() {
+	delete traceIndex;
+	delete tracePyramid;
 	delete baseDataFile;
 }
 
@@ -121,6 +127,37 @@ int FilteredBaseData::getInt(FileOffset position)
 	return baseDataFile->getMasterBuffer()->getInt(position);
 }
 
+void FilteredBaseData::narrowToTime(int pseudoRank, Time time,
+		FileOffset& l_boundOffset, FileOffset& r_boundOffset)
+{
+	if (useTraceIndex) {
+		//Timelines may be read by several threads (cf. numThreads)
+		std::call_once(traceIndexOpened, [this]() {
+			traceIndex = TraceIndex::open(traceFilename, baseDataFile, headerSize);
+		});
+	}
+	if (traceIndex) {
+		assert((unsigned int)pseudoRank < rankMapping.size());
+		traceIndex->narrow(rankMapping[pseudoRank], time, l_boundOffset, r_boundOffset);
+	}
+}
+
+bool FilteredBaseData::sampleFromPyramid(int pseudoRank, Time timeStart,
+		double pixelLength, int numPixels, vector<TimeCPID>& samples)
+{
+	if (!useTracePyramid)
+		return false;
+	std::call_once(tracePyramidOpened, [this]() {
+		tracePyramid = TracePyramid::open(traceFilename, baseDataFile, headerSize,
+				numThreads);
+	});
+	if (!tracePyramid)
+		return false;
+	assert((unsigned int)pseudoRank < rankMapping.size());
+	return tracePyramid->sample(rankMapping[pseudoRank], timeStart, pixelLength,
+			numPixels, samples);
+}
+
 int FilteredBaseData::getNumberOfRanks()
 {
 	return rankMapping.size();
@@ -64,8 +64,12 @@
 #include "BaseDataFile.hpp"
 #include "FilterSet.hpp"
 #include "FileUtils.hpp"//For FileOffset
+#include "TimeCPID.hpp"//For Time
+#include "TraceIndex.hpp"
+#include "TracePyramid.hpp"
 
 #include <vector>
+#include <mutex>
 #include <stdint.h>
 
 using std::vector;
@@ -82,6 +86,13 @@ namespace TraceviewerServer
 		FileOffset getMaxLoc(int pseudoRank);
 		int64_t getLong(FileOffset position);
 		int getInt(FileOffset position);
+		//Narrows the bounds of a search for time in a rank (cf. TraceIndex)
+		void narrowToTime(int pseudoRank, Time time, FileOffset& l_boundOffset,
+				FileOffset& r_boundOffset);
+		//Fills 'samples' for a zoomed-out view from the trace pyramid.
+		//Returns false if the view must be sampled from the trace instead.
+		bool sampleFromPyramid(int pseudoRank, Time timeStart, double pixelLength,
+				int numPixels, vector<TimeCPID>& samples);
 		int getNumberOfRanks();
 		int* getProcessIDs();
 		short* getThreadIDs();
@@ -90,6 +101,14 @@ namespace TraceviewerServer
 		void filter();
 
 		BaseDataFile* baseDataFile;
+		//Built on first use: the instance created for reading the
+		//number of ranks (with a default header size) never needs it.
+		TraceIndex* traceIndex;
+		std::once_flag traceIndexOpened;
+		//Also built on first use (cf. traceIndex)
+		TracePyramid* tracePyramid;
+		std::once_flag tracePyramidOpened;
+		string traceFilename;
 		OffsetPair* baseOffsets;
 		FilterSet currentlyAppliedFilter;
 		//Maps the pseudoranks the program asks for from the unfiltered
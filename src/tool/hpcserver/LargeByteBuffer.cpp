@@ -113,6 +113,11 @@ namespace TraceviewerServer
 		numPages = FullPages + (PartialPageSize == 0 ? 0 : 1);
 		pageManagementList = new LRUList<VersatileMemoryPage>(numPages);
 
+		canEvict = numPages > MaxPages;
+		mappedPages = new std::atomic<char*>[numPages];
+		for (int i = 0; i < numPages; i++)
+			mappedPages[i].store(NULL);
+
 		FileDescriptor fd = open(sPath.c_str(), O_RDONLY);
 
 		FileOffset sizeRemaining = fileSize;
@@ -129,11 +134,28 @@ namespace TraceviewerServer
 
 	}
 
+	char* LargeByteBuffer::getMappedPage(int Page)
+	{
+		char* page = mappedPages[Page].load(std::memory_order_acquire);
+		if (page == NULL)
+		{
+			std::lock_guard<std::mutex> guard(pageLock);
+			page = masterBuffer[Page].get();
+			mappedPages[Page].store(page, std::memory_order_release);
+		}
+		return page;
+	}
+
 	int LargeByteBuffer::getInt(FileOffset pos)
 	{
 		int Page = pos / mmPageSize;
 		int loc = pos % mmPageSize;
-		char* p2D = masterBuffer[Page].get() + loc;
+		if (canEvict)
+		{
+			std::lock_guard<std::mutex> guard(pageLock);
+			return ByteUtilities::readInt(masterBuffer[Page].get() + loc);
+		}
+		char* p2D = getMappedPage(Page) + loc;
 		int val = ByteUtilities::readInt(p2D);
 		return val;
 	}
@@ -141,7 +163,12 @@ namespace TraceviewerServer
 	{
 		int Page = pos / mmPageSize;
 		int loc = pos % mmPageSize;
-		char* p2D = masterBuffer[Page].get() + loc;
+		if (canEvict)
+		{
+			std::lock_guard<std::mutex> guard(pageLock);
+			return ByteUtilities::readLong(masterBuffer[Page].get() + loc);
+		}
+		char* p2D = getMappedPage(Page) + loc;
 		Long val = ByteUtilities::readLong(p2D);
 		return val;
 
@@ -196,6 +223,7 @@ namespace TraceviewerServer
 	{
 		masterBuffer.clear();
 		delete pageManagementList;
+		delete[] mappedPages;
 
 	}
 }
@@ -67,6 +67,8 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
+#include <mutex>
 #include <stdint.h>
 
 namespace TraceviewerServer
@@ -83,10 +85,18 @@ namespace TraceviewerServer
 	private:
 		static uint64_t lcm(uint64_t, uint64_t);
 		static uint64_t getRamSize();
+		char* getMappedPage(int);
 		vector<VersatileMemoryPage> masterBuffer;
 		int numPages;
 		LRUList<VersatileMemoryPage>* pageManagementList;
 
+		//The buffer may be read by several threads. If all pages fit in
+		//memory at once, a page is never unmapped once it is mapped, so only
+		//mapping takes the lock; otherwise every read does.
+		bool canEvict;
+		std::atomic<char*>* mappedPages;
+		std::mutex pageLock;
+
 	};
 
 } /* namespace TraceviewerServer */
@@ -71,6 +71,10 @@
 #include <cstdio>
 #include <sstream>
 
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
 using namespace std;
 typedef int64_t Long;
 namespace TraceviewerServer
@@ -142,7 +146,10 @@ namespace TraceviewerServer
 		//	 no accelator is supported
 		//  for all files:
 		//		int proc-id, int thread-id, long currentOffset
+		//  The offsets are only known once the files are copied (a
+		//  delta-encoded file is expanded), so they are filled in at 4.
 		//-----------------------------------------------------
+		vector<bool> isIndexed(filteredFileNames.size(), false);
 		vector<string>::iterator it2;
 		for (it2 = filteredFileNames.begin(); it2 < filteredFileNames.end(); it2++)
 		{
@@ -176,28 +183,17 @@ namespace TraceviewerServer
 			dos.writeInt(Thread);
 			if (Thread != 0)
 				type |= MULTI_THREADING;
-			dos.writeLong(currentOffset);
-			currentOffset += FileUtils::getFileSize(Filename);
+			dos.writeLong(0);
+			isIndexed[it2 - filteredFileNames.begin()] = true;
 		}
 		//-----------------------------------------------------
 		// 3. Copy all data from the multiple files into one file
 		//-----------------------------------------------------
 		ProgressBar prog("Merging database", filteredFileNames.size());
+		vector<Long> sizes;
 		for (it2 = filteredFileNames.begin(); it2 < filteredFileNames.end(); it2++)
 		{
-			string i = *it2;
-
-			ifstream dis(i.c_str(), ios_base::binary | ios_base::in);
-			char data[PAGE_SIZE_GUESS];
-			dis.read(data, PAGE_SIZE_GUESS);
-			int bytesRead = dis.gcount();
-			while (bytesRead > 0)
-			{
-				dos.write(data, bytesRead);
-				dis.read(data, PAGE_SIZE_GUESS);
-				bytesRead = dis.gcount();
-			}
-			dis.close();
+			sizes.push_back(copyTrace(*it2, &dos));
 			prog.incrementProgress();
 		}
 		insertMarker(&dos);
@@ -206,10 +202,21 @@ namespace TraceviewerServer
 		// 4. FIXME: write the type of the application
 		//  	the type of the application is computed in step 2
 		//		Ideally, this step has to be in the beginning !
+		//  and the offsets of the files, computed in step 3
 		//-----------------------------------------------------
 		//While we don't actually want to do any input operations, adding the input flag prevents the file from being truncated to 0 bytes
 		DataOutputFileStream f(outputFile.c_str(), ios_base::in | ios_base::out | ios_base::binary);
 		f.writeInt(type);
+		Long indexPos = num_metric_header;
+		for (size_t i = 0; i < filteredFileNames.size(); i++)
+		{
+			if (!isIndexed[i])
+				continue;
+			f.seekp(indexPos + 2 * SIZEOF_INT);
+			f.writeLong(currentOffset);
+			indexPos += SIZEOF_LONG + 2 * SIZEOF_INT;
+			currentOffset += sizes[i];
+		}
 		f.close();
 
 		//-----------------------------------------------------
@@ -276,6 +283,57 @@ namespace TraceviewerServer
 		}
 		return false;
 	}
+	//Copies a trace into the merged file and returns the number of bytes
+	//written. A delta-encoded trace is expanded: its header is written with
+	//the delta flag cleared, then each record in the fixed-size format, so
+	//that readers of the merged file can index records.
+	Long MergeDataFiles::copyTrace(string filename, DataOutputFileStream* dos)
+	{
+		FILE* fs = hpcio_fopen_r(filename.c_str());
+		if (!fs)
+			return 0;
+
+		hpctrace_fmt_hdr_t hdr;
+		if (hpctrace_fmt_hdr_fread(&hdr, fs) != HPCFMT_OK
+				|| !hdr.flags.fields.isDeltaEncoded)
+		{
+			rewind(fs);
+			Long size = 0;
+			char data[PAGE_SIZE_GUESS];
+			size_t bytesRead;
+			while ((bytesRead = fread(data, 1, PAGE_SIZE_GUESS, fs)) > 0)
+			{
+				dos->write(data, bytesRead);
+				size += bytesRead;
+			}
+			hpcio_fclose(fs);
+			return size;
+		}
+
+		hpctrace_hdr_flags_t flags = hdr.flags;
+		flags.fields.isDeltaEncoded = false;
+		dos->write(HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen);
+		dos->write(HPCTRACE_FMT_Version, HPCTRACE_FMT_VersionLen);
+		dos->write(HPCTRACE_FMT_Endian, HPCTRACE_FMT_EndianLen);
+		dos->writeLong(flags.bits);
+
+		Long recordSize = SIZE_OF_TRACE_RECORD
+				+ (flags.fields.isDataCentric ? SIZEOF_INT : 0);
+		Long numRecords = 0;
+		hpctrace_fmt_block_t blk = hpctrace_fmt_block_NULL;
+		hpctrace_fmt_datum_t datum;
+		while (hpctrace_fmt_block_datum_fread(&datum, &blk, hdr.flags, fs) == HPCFMT_OK)
+		{
+			dos->writeLong(datum.time);
+			dos->writeInt(datum.cpId);
+			if (flags.fields.isDataCentric)
+				dos->writeInt(datum.metricId);
+			numRecords++;
+		}
+		hpcio_fclose(fs);
+
+		return HPCTRACE_FMT_HeaderLen + numRecords * recordSize;
+	}
 	//From http://stackoverflow.com/questions/236129/splitting-a-string-in-c
 	vector<string> MergeDataFiles::splitString(string toSplit, char delimiter)
 	{
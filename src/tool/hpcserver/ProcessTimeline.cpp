@@ -93,6 +93,16 @@ namespace TraceviewerServer
 		return lineNum;
 	}
 
+	Time ProcessTimeline::getStartingTime()
+	{
+		return startingTime;
+	}
+
+	double ProcessTimeline::getPixelLength()
+	{
+		return pixelLength;
+	}
+
 	ProcessTimeline::~ProcessTimeline()
 	{
 		delete data;
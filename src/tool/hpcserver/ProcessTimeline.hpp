@@ -75,6 +75,8 @@ namespace TraceviewerServer
 		virtual ~ProcessTimeline();
 		int line();
 		void readInData();
+		Time getStartingTime();
+		double getPixelLength();
 		TraceDataByRank* data;
 	private:
 		int lineNumToProcessNum(int line);
@@ -89,6 +89,7 @@ namespace TraceviewerServer
 	bool useCompression = true;
 	int mainPortNumber = DEFAULT_PORT;
 	int xmlPortNumber = 0;
+	int numThreads = 1;
 
 	Server::Server()
 	{
@@ -197,6 +198,15 @@ namespace TraceviewerServer
 					getAndSendData(socketptr);
 #ifdef HPCTOOLKIT_PROFILE
 					hpctoolkit_sampling_stop();
+#endif
+					break;
+				case SUMM:
+#ifdef HPCTOOLKIT_PROFILE
+					hpctoolkit_sampling_start();
+#endif
+					getAndSendSummary(socketptr);
+#ifdef HPCTOOLKIT_PROFILE
+					hpctoolkit_sampling_stop();
 #endif
 					break;
 				case FLTR:
@@ -386,6 +396,35 @@ namespace TraceviewerServer
 
 	}
 
+	// Same request as DATA, but the reply is only the histogram of the
+	// cpIds in each pixel column (see TimelineSummary), computed here
+	// instead of by the client from all the timelines:
+	//   SUMM, int columns, int timelines, int compressed size, compressed data
+	void Server::getAndSendSummary(DataSocketStream* stream)
+	{
+		LOGTIMESTAMPEDMSG("Front end received summary request.")
+		int processStart = stream->readInt();
+		int processEnd = stream->readInt();
+		Time timeStart = stream->readLong();
+		Time timeEnd = stream->readLong();
+		int verticalResolution = stream->readInt();
+		int horizontalResolution = stream->readInt();
+
+		if ((processStart < 0) || (processEnd<0) || (processStart > processEnd)
+				|| (verticalResolution<0) || (horizontalResolution<0)
+				|| (timeEnd < timeStart))
+		{
+			cerr
+					<< "A summary request with invalid parameters was received. The server will now shut down."
+					<< endl;
+			throw(ERROR_INVALID_PARAMETERS);
+		}
+		Communication::sendStartGetSummary(controller, processStart, processEnd, timeStart, timeEnd, verticalResolution, horizontalResolution);
+
+		Communication::sendEndGetSummary(stream, controller);
+		LOGTIMESTAMPEDMSG("Summary sent.")
+	}
+
 	void Server::filter(DataSocketStream* stream)
 	{
 		stream->readByte();//Padding
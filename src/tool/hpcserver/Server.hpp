@@ -70,6 +70,7 @@ namespace TraceviewerServer
 	extern bool useCompression;
 	extern int mainPortNumber;
 	extern int xmlPortNumber;
+	extern int numThreads;
 	class Server
 	{
 
@@ -86,6 +87,7 @@ namespace TraceviewerServer
 		SpaceTimeDataController* parseOpenDB(DataSocketStream*);
 		void filter(DataSocketStream*);
 		void getAndSendData(DataSocketStream*);
+		void getAndSendSummary(DataSocketStream*);
 		void sendXML(DataSocketStream*);
 		void sendDBOpenFailed(DataSocketStream*);
 		void checkProtocolVersions(DataSocketStream* receiver);
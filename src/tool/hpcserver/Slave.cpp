@@ -74,6 +74,7 @@
 #include "Server.hpp"
 #include "FilterSet.hpp"
 #include "DebugUtils.hpp"
+#include "TimelineSummary.hpp"
 
 #ifdef HPCTOOLKIT_PROFILE
  #include "hpctoolkit.h"
@@ -129,6 +130,9 @@ namespace TraceviewerServer
 							MPICommunication::SOCKET_SERVER, 0);
 					break;
 				}
+				case SUMM:
+					getSummary(&Message);
+					break;
 				case FLTR:
 				{
 					FilterSet f(Message.filt.excludeMatches);
@@ -337,6 +341,54 @@ namespace TraceviewerServer
 
 		return LinesSentCount;
 	}
+	//Each slave summarizes every (size-1)th timeline and sends the packed
+	//summary, even if it is empty, so the server knows it is done
+	void Slave::getSummary(MPICommunication::CommandMessage* Message)
+	{
+		MPICommunication::get_data_command gc = Message->gdata;
+		ImageTraceAttributes correspondingAttributes;
+
+		int trueRank = COMM_WORLD.Get_rank();
+		int size = COMM_WORLD.Get_size();
+		int rank = trueRank > MPICommunication::SOCKET_SERVER ? trueRank - 1 : trueRank;
+
+		correspondingAttributes.begProcess = gc.processStart;
+		correspondingAttributes.endProcess = gc.processEnd;
+		correspondingAttributes.numPixelsH = gc.horizontalResolution;
+		correspondingAttributes.numPixelsV = gc.verticalResolution;
+		correspondingAttributes.begTime = gc.timeStart;
+		correspondingAttributes.endTime = gc.timeEnd;
+		correspondingAttributes.lineNum = rank;
+
+		*controller->attributes = correspondingAttributes;
+
+		TimelineSummary summary(gc.horizontalResolution);
+		ProcessTimeline* nextTrace = controller->getNextTrace();
+		while (nextTrace != NULL)
+		{
+			nextTrace->readInData();
+			summary.add(nextTrace);
+			delete nextTrace;
+
+			//Skip to this slave's next line
+			controller->attributes->lineNum += size - 2;
+			nextTrace = controller->getNextTrace();
+		}
+
+		vector<int> packed;
+		summary.pack(packed);
+
+		MPICommunication::ResultMessage msg;
+		msg.tag = SLAVE_SUMMARY;
+		msg.data.rankID = trueRank;
+		msg.data.entries = packed.size();
+		COMM_WORLD.Send(&msg, sizeof(msg), MPI_PACKED, MPICommunication::SOCKET_SERVER, 0);
+		COMM_WORLD.Send(packed.data(), packed.size(), MPI_INT, MPICommunication::SOCKET_SERVER, 0);
+
+		DEBUGCOUT(1) << "Rank " << trueRank << " summarized " << summary.getNumTimelines()
+				<< " trace lines." << endl;
+	}
+
 	void Slave::cleanSent(list<MPICommunication::ResultBufferLocations*>& buffers, bool wait)
 	{
 		MPICommunication::ResultBufferLocations* current;
@@ -78,6 +78,7 @@ namespace TraceviewerServer
 	private:
 		SpaceTimeDataController* controller;
 		int getData(MPICommunication::CommandMessage*);
+		void getSummary(MPICommunication::CommandMessage*);
 		// Removes all sent messages from the queue
 		void cleanSent(list<MPICommunication::ResultBufferLocations*>& buffers, bool wait);
 	};
@@ -126,6 +126,17 @@ namespace TraceviewerServer
 
 	//Don't call if in MPI mode
 	void SpaceTimeDataController::fillTraces()
+	{
+		createTraces();
+
+		for (int i = 0; i < tracesLength; i++)
+		{
+			traces[i]->readInData();
+		}
+	}
+
+	//Don't call if in MPI mode
+	void SpaceTimeDataController::createTraces()
 	{
 		//Traces might be null. resetTraces will fix that.
 		resetTraces();
@@ -135,7 +146,6 @@ namespace TraceviewerServer
 		ProcessTimeline* nextTrace = getNextTrace();
 		while (nextTrace != NULL)
 		{
-			nextTrace->readInData();
 			addNextTrace(nextTrace);
 
 			nextTrace = getNextTrace();
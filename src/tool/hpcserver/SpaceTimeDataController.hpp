@@ -80,6 +80,8 @@ namespace TraceviewerServer
 		ProcessTimeline* getNextTrace();
 		void addNextTrace(ProcessTimeline*);
 		void fillTraces();
+		//Creates the timelines of the current request without reading them
+		void createTraces();
 		ProcessTimeline* fillTrace(bool);
 		void applyFilters(FilterSet filters);
 		//The number of processes in the database, independent of the current display size
@@ -0,0 +1,185 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Per-column histogram of the cpIds shown by a set of timelines
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#include "TimelineSummary.hpp"
+#include "Constants.hpp"
+#include "DataCompressionLayer.hpp"
+#include "TimeCPID.hpp"
+
+#include <algorithm> // min, max
+
+using namespace std;
+
+namespace TraceviewerServer
+{
+	TimelineSummary::TimelineSummary(int numColumns)
+	{
+		columns.resize(max(numColumns, 0));
+		numTimelines = 0;
+	}
+
+	TimelineSummary::~TimelineSummary()
+	{
+	}
+
+	void TimelineSummary::add(ProcessTimeline* timeline)
+	{
+		vector<TimeCPID>& data = *timeline->data->listCPID;
+		Time startingTime = timeline->getStartingTime();
+		double pixelLength = timeline->getPixelLength();
+		int numColumns = columns.size();
+
+		numTimelines++;
+
+		// The column in which each sample starts. Samples before the
+		// image (the one bracketing its beginning) start in column 0.
+		auto columnOf = [&](Time time) -> int {
+			if (time <= startingTime)
+				return 0;
+			if (pixelLength <= 0)
+				return numColumns;
+			double column = (time - startingTime) / pixelLength;
+			return (int) min(column, (double) numColumns);
+		};
+
+		int end = data.empty() ? 0 : columnOf(data[0].timestamp);
+		for (size_t i = 0; i < data.size(); i++)
+		{
+			int begin = end;
+			end = (i + 1 < data.size()) ? columnOf(data[i + 1].timestamp) : numColumns;
+			for (int c = begin; c < end; c++)
+				columns[c][data[i].cpid]++;
+		}
+	}
+
+	void TimelineSummary::merge(const TimelineSummary& other)
+	{
+		size_t numColumns = min(columns.size(), other.columns.size());
+		for (size_t c = 0; c < numColumns; c++)
+		{
+			map<int, int>::const_iterator it;
+			for (it = other.columns[c].begin(); it != other.columns[c].end(); ++it)
+				columns[c][it->first] += it->second;
+		}
+		numTimelines += other.numTimelines;
+	}
+
+	int TimelineSummary::getNumColumns()
+	{
+		return columns.size();
+	}
+
+	int TimelineSummary::getNumTimelines()
+	{
+		return numTimelines;
+	}
+
+	void TimelineSummary::send(DataSocketStream* stream)
+	{
+		DataCompressionLayer comprStr;
+		for (size_t c = 0; c < columns.size(); c++)
+		{
+			comprStr.writeInt(columns[c].size());
+			map<int, int>::iterator it;
+			for (it = columns[c].begin(); it != columns[c].end(); ++it)
+			{
+				comprStr.writeInt(it->first);
+				comprStr.writeInt(it->second);
+			}
+		}
+		comprStr.flush();
+
+		int outputBufferLen = comprStr.getOutputLength();
+		stream->writeInt(SUMM);
+		stream->writeInt(columns.size());
+		stream->writeInt(numTimelines);
+		stream->writeInt(outputBufferLen);
+		stream->writeRawData((char*)comprStr.getOutputBuffer(), outputBufferLen);
+		stream->flush();
+	}
+
+	void TimelineSummary::pack(vector<int>& out)
+	{
+		out.push_back(numTimelines);
+		for (size_t c = 0; c < columns.size(); c++)
+		{
+			out.push_back(columns[c].size());
+			map<int, int>::iterator it;
+			for (it = columns[c].begin(); it != columns[c].end(); ++it)
+			{
+				out.push_back(it->first);
+				out.push_back(it->second);
+			}
+		}
+	}
+
+	void TimelineSummary::unpack(const int* in, int length)
+	{
+		const int* end = in + length;
+		if (in < end)
+			numTimelines += *in++;
+		for (size_t c = 0; c < columns.size() && in < end; c++)
+		{
+			int entries = *in++;
+			for (int i = 0; i < entries && in + 1 < end; i++, in += 2)
+				columns[c][in[0]] += in[1];
+		}
+	}
+
+} /* namespace TraceviewerServer */
@@ -0,0 +1,116 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Per-column histogram of the cpIds shown by a set of timelines
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#ifndef TIMELINESUMMARY_H_
+#define TIMELINESUMMARY_H_
+
+#include <map>
+#include <vector>
+
+#include "DataSocketStream.hpp"
+#include "ProcessTimeline.hpp"
+
+namespace TraceviewerServer
+{
+	/*
+	 * The data behind the viewer's summary view: for every pixel column of
+	 * the image, how many timelines show each cpId in it. A sample covers
+	 * the columns from its own up to (not including) the column of the next
+	 * sample; the last sample of a timeline covers the rest of the image.
+	 * Computing this in the server means only the histogram, and not every
+	 * sample of every timeline, goes over the socket.
+	 *
+	 * Summaries of disjoint sets of timelines can be computed separately
+	 * (per thread or per MPI rank) and merged.
+	 *
+	 * Histogram format (all ints): for each column, the number of distinct
+	 * cpIds, then (cpId, number of timelines) pairs in increasing cpId
+	 * order.
+	 */
+	class TimelineSummary
+	{
+	public:
+		TimelineSummary(int numColumns);
+		virtual ~TimelineSummary();
+
+		// Adds the samples of a timeline whose data has been read in
+		void add(ProcessTimeline* timeline);
+		void merge(const TimelineSummary& other);
+
+		int getNumColumns();
+		// The number of timelines added, including merged ones
+		int getNumTimelines();
+
+		// Sends the reply to a summary request: SUMM, int number of
+		// columns, int number of timelines, int compressed size, and the
+		// compressed histogram
+		void send(DataSocketStream* stream);
+		// The number of timelines followed by the histogram, for sending
+		// between MPI ranks
+		void pack(vector<int>& out);
+		// Merges a packed summary into this one
+		void unpack(const int* in, int length);
+
+	private:
+		vector<map<int, int> > columns;
+		int numTimelines;
+	};
+
+} /* namespace TraceviewerServer */
+#endif /* TIMELINESUMMARY_H_ */
@@ -93,6 +93,7 @@ namespace TraceviewerServer
 
 		// get the number of records data to display
 		 Long numRec = 1 + getNumberOfRecords(startLoc, endLoc);
+		 bool fromPyramid = false;
 
 		// --------------------------------------------------------------------------------------------------
 		// if the data-to-display is fit in the display zone, we don't need to use recursive binary search
@@ -108,6 +109,12 @@ namespace TraceviewerServer
 				i = i + SIZE_OF_TRACE_RECORD;
 			}
 		}
+		else if (data->sampleFromPyramid(rank, timeStart, pixelLength, numPixelsH, *listCPID))
+		{
+			// a zoomed-out view: one sample per change of the dominant
+			// cpId, read from the trace pyramid
+			fromPyramid = true;
+		}
 		else
 		{
 			// the data is too big: try to fit the "big" data into the display
@@ -122,7 +129,10 @@ namespace TraceviewerServer
 		if (endLoc < maxloc)
 		{
 			 TimeCPID dataLast = getData(endLoc);
-			addSample(listCPID->size(), dataLast);
+			// (pyramid samples are at pixel times, not record times)
+			if (!fromPyramid || listCPID->empty()
+					|| dataLast.timestamp > listCPID->back().timestamp)
+				addSample(listCPID->size(), dataLast);
 		}
 
 		// --------------------------------------------------------------------------------------------------
@@ -132,7 +142,9 @@ namespace TraceviewerServer
 		if (startLoc > minloc)
 		{
 			 TimeCPID dataFirst = getData(startLoc - SIZE_OF_TRACE_RECORD);
-			addSample(0, dataFirst);
+			if (!fromPyramid || listCPID->empty()
+					|| dataFirst.timestamp < listCPID->front().timestamp)
+				addSample(0, dataFirst);
 		}
 		postProcess();
 	}
@@ -182,6 +194,9 @@ namespace TraceviewerServer
 	FileOffset TraceDataByRank::findTimeInInterval(Time time, FileOffset l_boundOffset,
 			FileOffset r_boundOffset)
 	{
+		// jump to the block(s) of records containing the target time
+		data->narrowToTime(rank, time, l_boundOffset, r_boundOffset);
+
 		if (l_boundOffset == r_boundOffset)
 			return l_boundOffset;
 
@@ -0,0 +1,294 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Sparse time -> offset index of the merged trace file (sidecar)
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#include "TraceIndex.hpp"
+#include "ByteUtilities.hpp"
+#include "Constants.hpp"
+#include "DataOutputFileStream.hpp"
+#include "DebugUtils.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio> // rename, remove
+#include <cstring> // memcmp
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+namespace TraceviewerServer
+{
+	bool useTraceIndex = true;
+
+	static const char INDEX_TAG[] = "HPCTRIDX";
+	static const int SIZEOF_INDEX_TAG = 8;
+
+	static bool isOlder(string file, string than)
+	{
+		struct stat fileInfo, thanInfo;
+		if (stat(file.c_str(), &fileInfo) != 0 || stat(than.c_str(), &thanInfo) != 0)
+			return true;
+		return fileInfo.st_mtime < thanInfo.st_mtime;
+	}
+
+	TraceIndex::TraceIndex()
+	{
+	}
+
+	TraceIndex::~TraceIndex()
+	{
+	}
+
+	TraceIndex* TraceIndex::open(string traceFile, BaseDataFile* data, int headerSize)
+	{
+		string indexFile = traceFile + ".idx";
+		FileOffset traceSize = data->getMasterBuffer()->size();
+
+		TraceIndex* index = new TraceIndex();
+		if (FileUtils::exists(indexFile) && !isOlder(indexFile, traceFile)
+				&& index->read(indexFile, traceSize, headerSize, data))
+		{
+			DEBUGCOUT(1) << "Read trace index " << indexFile << endl;
+			return index;
+		}
+
+		index->build(data, headerSize);
+		DEBUGCOUT(1) << "Built trace index for " << traceFile << endl;
+
+		// Several processes (hpcserver-mpi) may build the same index; each
+		// writes a private file that is renamed into place atomically.
+		stringstream tmpFile;
+		tmpFile << indexFile << "." << getpid();
+		if (index->write(tmpFile.str(), traceSize, headerSize))
+		{
+			if (rename(tmpFile.str().c_str(), indexFile.c_str()) != 0)
+				remove(tmpFile.str().c_str());
+		}
+		else
+		{
+			// Not fatal: the index is still used from memory
+			remove(tmpFile.str().c_str());
+		}
+		return index;
+	}
+
+	void TraceIndex::build(BaseDataFile* data, int headerSize)
+	{
+		LargeByteBuffer* buffer = data->getMasterBuffer();
+		OffsetPair* offsets = data->getOffsets();
+		int numRanks = data->getNumberOfFiles();
+
+		const FileOffset blockSize = (FileOffset) RECORDS_PER_BLOCK * SIZE_OF_TRACE_RECORD;
+
+		ranks.resize(numRanks);
+		for (int i = 0; i < numRanks; i++)
+		{
+			RankIndex& rank = ranks[i];
+			rank.minloc = offsets[i].start + headerSize;
+			rank.maxloc = offsets[i].end;
+			if (rank.maxloc < rank.minloc)
+				continue;
+
+			// Records are sorted by time, so only the first and last
+			// record of each block is read.
+			for (FileOffset first = rank.minloc; first <= rank.maxloc; first += blockSize)
+			{
+				FileOffset last = min(first + blockSize - SIZE_OF_TRACE_RECORD, rank.maxloc);
+				Block block;
+				block.minTime = buffer->getLong(first);
+				block.maxTime = buffer->getLong(last);
+				rank.blocks.push_back(block);
+			}
+		}
+	}
+
+	bool TraceIndex::read(string filename, FileOffset traceSize, int headerSize,
+			BaseDataFile* data)
+	{
+		ifstream in(filename.c_str(), ios_base::binary | ios_base::in);
+		vector<char> buf((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		in.close();
+
+		FileOffset pos = 0;
+		const FileOffset fixedSize = SIZEOF_INDEX_TAG + SIZEOF_LONG + 3 * SIZEOF_INT;
+		if (buf.size() < fixedSize || memcmp(&buf[0], INDEX_TAG, SIZEOF_INDEX_TAG) != 0)
+			return false;
+		pos += SIZEOF_INDEX_TAG;
+
+		FileOffset size = ByteUtilities::readLong(&buf[pos]);
+		pos += SIZEOF_LONG;
+		int header = ByteUtilities::readInt(&buf[pos]);
+		pos += SIZEOF_INT;
+		int recordsPerBlock = ByteUtilities::readInt(&buf[pos]);
+		pos += SIZEOF_INT;
+		int numRanks = ByteUtilities::readInt(&buf[pos]);
+		pos += SIZEOF_INT;
+		if (size != traceSize || header != headerSize
+				|| recordsPerBlock != RECORDS_PER_BLOCK
+				|| numRanks != data->getNumberOfFiles())
+			return false;
+
+		OffsetPair* offsets = data->getOffsets();
+		ranks.resize(numRanks);
+		for (int i = 0; i < numRanks; i++)
+		{
+			if (buf.size() < pos + 2 * SIZEOF_LONG + SIZEOF_INT)
+				return false;
+			RankIndex& rank = ranks[i];
+			rank.minloc = ByteUtilities::readLong(&buf[pos]);
+			pos += SIZEOF_LONG;
+			rank.maxloc = ByteUtilities::readLong(&buf[pos]);
+			pos += SIZEOF_LONG;
+			int numBlocks = ByteUtilities::readInt(&buf[pos]);
+			pos += SIZEOF_INT;
+			if (rank.minloc != offsets[i].start + headerSize
+					|| rank.maxloc != offsets[i].end || numBlocks < 0
+					|| buf.size() < pos + (FileOffset) numBlocks * 2 * SIZEOF_LONG)
+				return false;
+
+			rank.blocks.resize(numBlocks);
+			for (int b = 0; b < numBlocks; b++)
+			{
+				rank.blocks[b].minTime = ByteUtilities::readLong(&buf[pos]);
+				pos += SIZEOF_LONG;
+				rank.blocks[b].maxTime = ByteUtilities::readLong(&buf[pos]);
+				pos += SIZEOF_LONG;
+			}
+		}
+		return true;
+	}
+
+	bool TraceIndex::write(string filename, FileOffset traceSize, int headerSize)
+	{
+		DataOutputFileStream dos(filename.c_str());
+		if (!dos.good())
+			return false;
+
+		dos.write(INDEX_TAG, SIZEOF_INDEX_TAG);
+		dos.writeLong(traceSize);
+		dos.writeInt(headerSize);
+		dos.writeInt(RECORDS_PER_BLOCK);
+		dos.writeInt(ranks.size());
+		for (size_t i = 0; i < ranks.size(); i++)
+		{
+			RankIndex& rank = ranks[i];
+			dos.writeLong(rank.minloc);
+			dos.writeLong(rank.maxloc);
+			dos.writeInt(rank.blocks.size());
+			for (size_t b = 0; b < rank.blocks.size(); b++)
+			{
+				dos.writeLong(rank.blocks[b].minTime);
+				dos.writeLong(rank.blocks[b].maxTime);
+			}
+		}
+		dos.close();
+		return !dos.fail();
+	}
+
+	bool TraceIndex::beginsAfter(Time time, const Block& block)
+	{
+		return time < block.minTime;
+	}
+
+	void TraceIndex::narrow(int rank, Time time, FileOffset& l_boundOffset,
+			FileOffset& r_boundOffset)
+	{
+		if (rank < 0 || (size_t) rank >= ranks.size())
+			return;
+		RankIndex& index = ranks[rank];
+		if (index.blocks.empty())
+			return;
+
+		const FileOffset blockSize = (FileOffset) RECORDS_PER_BLOCK * SIZE_OF_TRACE_RECORD;
+
+		// b: the last block that begins at or before 'time' (or the first)
+		vector<Block>::iterator it = upper_bound(index.blocks.begin(),
+				index.blocks.end(), time, beginsAfter);
+		size_t b = (it == index.blocks.begin()) ? 0 : (it - index.blocks.begin()) - 1;
+
+		FileOffset first = index.minloc + b * blockSize;
+		FileOffset last = min(first + blockSize - SIZE_OF_TRACE_RECORD, index.maxloc);
+
+		FileOffset l, r;
+		if (time < index.blocks[b].maxTime)
+		{
+			// the bracketing records are in block b
+			l = first;
+			r = last;
+		}
+		else
+		{
+			// the bracketing records are the last of block b and the first
+			// of block b+1
+			l = last;
+			r = min(last + SIZE_OF_TRACE_RECORD, index.maxloc);
+		}
+
+		l = max(l, l_boundOffset);
+		r = min(r, r_boundOffset);
+		if (l <= r)
+		{
+			l_boundOffset = l;
+			r_boundOffset = r;
+		}
+	}
+
+} /* namespace TraceviewerServer */
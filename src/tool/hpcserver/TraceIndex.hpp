@@ -0,0 +1,139 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Sparse time -> offset index of the merged trace file (sidecar)
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#ifndef TRACEINDEX_H_
+#define TRACEINDEX_H_
+
+#include <string>
+#include <vector>
+
+#include "BaseDataFile.hpp"
+#include "TimeCPID.hpp" // Time
+#include "FileUtils.hpp" // FileOffset
+
+namespace TraceviewerServer
+{
+	// Build and use trace indices (default: true)
+	extern bool useTraceIndex;
+
+	/*
+	 * A sparse index over the merged trace file: for every rank, the trace
+	 * records are divided into blocks of RECORDS_PER_BLOCK records, and the
+	 * index holds the first and last time of each block. Looking a time up
+	 * in the index gives the (at most two) blocks that contain the records
+	 * bracketing it, so the search in the trace file itself touches one or
+	 * two pages instead of probing the whole rank.
+	 *
+	 * The index is kept in a sidecar file (the trace file name + ".idx")
+	 * that is built on first use and rebuilt if it is stale. Trace files
+	 * without a sidecar, or in directories that are not writable, work as
+	 * before.
+	 *
+	 * Sidecar format (big endian):
+	 *   char[8] tag ("HPCTRIDX")
+	 *   Long trace file size, int header size, int records per block,
+	 *   int number of ranks
+	 *   for each rank:
+	 *     Long offset of first record, Long offset of last record,
+	 *     int number of blocks, then (Long min time, Long max time) per block
+	 */
+	class TraceIndex
+	{
+	public:
+		// Loads the index of 'traceFile' from its sidecar or builds it from
+		// 'data'. Returns NULL if the index cannot be built.
+		static TraceIndex* open(string traceFile, BaseDataFile* data, int headerSize);
+
+		virtual ~TraceIndex();
+
+		// Narrows [l_boundOffset, r_boundOffset] to the records of 'rank'
+		// that bracket 'time'. Leaves the bounds unchanged if the index
+		// does not apply to them.
+		void narrow(int rank, Time time, FileOffset& l_boundOffset,
+				FileOffset& r_boundOffset);
+
+		static const int RECORDS_PER_BLOCK = 4096;
+
+	private:
+		struct Block
+		{
+			Time minTime;
+			Time maxTime;
+		};
+		struct RankIndex
+		{
+			FileOffset minloc;
+			FileOffset maxloc;
+			vector<Block> blocks;
+		};
+
+		TraceIndex();
+
+		static bool beginsAfter(Time time, const Block& block);
+
+		bool read(string filename, FileOffset traceSize, int headerSize,
+				BaseDataFile* data);
+		void build(BaseDataFile* data, int headerSize);
+		bool write(string filename, FileOffset traceSize, int headerSize);
+
+		vector<RankIndex> ranks;
+	};
+
+} /* namespace TraceviewerServer */
+#endif /* TRACEINDEX_H_ */
@@ -0,0 +1,532 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Multi-resolution summary of the merged trace file (sidecar)
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#include "TracePyramid.hpp"
+#include "ByteUtilities.hpp"
+#include "Constants.hpp"
+#include "DataOutputFileStream.hpp"
+#include "DebugUtils.hpp"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio> // rename, remove
+#include <ctime>
+#include <cstring> // memcmp
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+namespace TraceviewerServer
+{
+	bool useTracePyramid = false;
+
+	static const char PYRAMID_TAG[] = "HPCTRPYR";
+	static const int SIZEOF_PYRAMID_TAG = 8;
+	static const FileOffset SIZEOF_PYRAMID_HEADER =
+			SIZEOF_PYRAMID_TAG + SIZEOF_LONG + 3 * SIZEOF_INT;
+	static const FileOffset SIZEOF_RANK_HEADER = 4 * SIZEOF_LONG + SIZEOF_INT;
+	// Seconds after which the lock of a builder that stopped touching it
+	// is considered stale
+	static const int LOCK_TIMEOUT = 60;
+
+	static bool isOlder(string file, string than)
+	{
+		struct stat fileInfo, thanInfo;
+		if (stat(file.c_str(), &fileInfo) != 0 || stat(than.c_str(), &thanInfo) != 0)
+			return true;
+		return fileInfo.st_mtime < thanInfo.st_mtime;
+	}
+
+	// Waits until 'lockFile' is removed. Returns false if the process
+	// holding it seems to have died, i.e., it has not touched the lock for
+	// LOCK_TIMEOUT seconds.
+	static bool waitForLock(string lockFile)
+	{
+		struct stat info;
+		while (stat(lockFile.c_str(), &info) == 0)
+		{
+			if (time(NULL) - info.st_mtime > LOCK_TIMEOUT)
+				return false;
+			usleep(100000);
+		}
+		return (errno == ENOENT);
+	}
+
+	TracePyramid::TracePyramid()
+	{
+		fd = -1;
+	}
+
+	TracePyramid::~TracePyramid()
+	{
+		if (fd >= 0)
+			close(fd);
+	}
+
+	TracePyramid* TracePyramid::open(string traceFile, BaseDataFile* data,
+			int headerSize, int numThreads)
+	{
+		string pyramidFile = traceFile + ".pyr";
+		FileOffset traceSize = data->getMasterBuffer()->size();
+
+		TracePyramid* pyramid = new TracePyramid();
+		if (FileUtils::exists(pyramidFile) && !isOlder(pyramidFile, traceFile)
+				&& pyramid->read(pyramidFile, traceSize, headerSize, data))
+		{
+			DEBUGCOUT(1) << "Read trace pyramid " << pyramidFile << endl;
+			return pyramid;
+		}
+
+		// Several processes (hpcserver-mpi) may open the same pyramid: the
+		// one that creates the lock file builds it, the others wait for the
+		// lock to go away and read what it built.
+		string lockFile = pyramidFile + ".lock";
+		int lock = ::open(lockFile.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+		if (lock < 0)
+		{
+			if (errno != EEXIST || !waitForLock(lockFile)
+					|| !pyramid->read(pyramidFile, traceSize, headerSize, data))
+			{
+				// Not fatal: views are sampled from the trace
+				delete pyramid;
+				return NULL;
+			}
+			DEBUGCOUT(1) << "Read trace pyramid " << pyramidFile << endl;
+			return pyramid;
+		}
+
+		// The pyramid is written to a private file that is renamed into
+		// place atomically, so that it is never read half written.
+		stringstream tmpFile;
+		tmpFile << pyramidFile << "." << getpid();
+		bool built = pyramid->build(tmpFile.str(), data, headerSize, traceSize,
+				numThreads, lock) && rename(tmpFile.str().c_str(), pyramidFile.c_str()) == 0;
+		if (!built)
+			remove(tmpFile.str().c_str());
+		close(lock);
+		remove(lockFile.c_str());
+		if (!built)
+		{
+			delete pyramid;
+			return NULL;
+		}
+		DEBUGCOUT(1) << "Built trace pyramid for " << traceFile << endl;
+
+		// N.B.: bucket data is read from the sidecar on demand
+		if (!pyramid->read(pyramidFile, traceSize, headerSize, data))
+		{
+			delete pyramid;
+			return NULL;
+		}
+		return pyramid;
+	}
+
+	// Computes the levels of each rank from its first and last record
+	void TracePyramid::layout(BaseDataFile* data, int headerSize)
+	{
+		LargeByteBuffer* buffer = data->getMasterBuffer();
+		OffsetPair* offsets = data->getOffsets();
+		int numRanks = data->getNumberOfFiles();
+
+		// N.B.: a failed read() may have filled in some of the ranks
+		ranks.assign(numRanks, RankPyramid());
+		for (int i = 0; i < numRanks; i++)
+		{
+			RankPyramid& rank = ranks[i];
+			rank.minloc = offsets[i].start + headerSize;
+			rank.maxloc = offsets[i].end;
+			rank.minTime = 0;
+			rank.width = 1;
+			if (rank.maxloc < rank.minloc)
+				continue;
+
+			FileOffset numRecords = (rank.maxloc - rank.minloc) / SIZE_OF_TRACE_RECORD + 1;
+			if (numRecords < (FileOffset) MAX_BUCKETS * MIN_RECORDS_PER_BUCKET)
+				continue;
+
+			rank.minTime = buffer->getLong(rank.minloc);
+			Time maxTime = buffer->getLong(rank.maxloc);
+			if (maxTime < rank.minTime)
+				continue;
+
+			Time span = maxTime - rank.minTime + 1;
+			rank.width = (span + MAX_BUCKETS - 1) / MAX_BUCKETS;
+			int n = (int) ((span + rank.width - 1) / rank.width);
+			rank.numBuckets.push_back(n);
+			while (n > 1)
+			{
+				n = (n + 1) / 2;
+				rank.numBuckets.push_back(n);
+			}
+		}
+	}
+
+	// Assigns the bucket data of each rank a place in the sidecar,
+	// beginning at 'offset'; returns the end of the data
+	FileOffset TracePyramid::layoutData(FileOffset offset)
+	{
+		for (size_t i = 0; i < ranks.size(); i++)
+		{
+			ranks[i].dataOffset = offset;
+			for (size_t l = 0; l < ranks[i].numBuckets.size(); l++)
+				offset += (FileOffset) ranks[i].numBuckets[l] * SIZEOF_INT;
+		}
+		return offset;
+	}
+
+	// Fills 'cpIds' with the levels of 'rank', one after another
+	void TracePyramid::buildRank(BaseDataFile* data, int rankNum, vector<int>& cpIds)
+	{
+		RankPyramid& rank = ranks[rankNum];
+		cpIds.clear();
+		if (rank.numBuckets.empty())
+			return;
+
+		LargeByteBuffer* buffer = data->getMasterBuffer();
+		int n = rank.numBuckets[0];
+		vector<int> dominant(n);
+		vector<Time> covered(n);
+
+		// Level 0: accumulate the time covered by each cpId in the current
+		// bucket. A record covers [its time, the time of the next record);
+		// the last one covers a single tick.
+		unordered_map<int, Time> hist;
+		int b = 0;
+		Time bucketEnd = rank.minTime + rank.width;
+		Time time = buffer->getLong(rank.minloc);
+		int cpId = buffer->getInt(rank.minloc + SIZEOF_LONG);
+
+		auto finishBucket = [&]() {
+			int best = cpId;
+			Time bestTime = 0;
+			bool found = false;
+			for (unordered_map<int, Time>::iterator it = hist.begin(); it != hist.end(); ++it)
+			{
+				// ties go to the smaller cpId so that the result is deterministic
+				if (!found || it->second > bestTime
+						|| (it->second == bestTime && it->first < best))
+				{
+					best = it->first;
+					bestTime = it->second;
+					found = true;
+				}
+			}
+			if (!found && b > 0)
+				best = dominant[b - 1];
+			dominant[b] = best;
+			covered[b] = bestTime;
+			hist.clear();
+		};
+
+		for (FileOffset loc = rank.minloc; loc <= rank.maxloc; loc += SIZE_OF_TRACE_RECORD)
+		{
+			Time next = time + 1;
+			int nextCpId = cpId;
+			if (loc < rank.maxloc)
+			{
+				next = max((Time) buffer->getLong(loc + SIZE_OF_TRACE_RECORD), time);
+				nextCpId = buffer->getInt(loc + SIZE_OF_TRACE_RECORD + SIZEOF_LONG);
+			}
+
+			for (Time t = time; ; )
+			{
+				while (t >= bucketEnd && b < n - 1)
+				{
+					finishBucket();
+					b++;
+					bucketEnd += rank.width;
+				}
+				Time end = min(next, bucketEnd);
+				hist[cpId] += (end > t) ? end - t : 0;
+				t = end;
+				if (t >= next || b == n - 1)
+					break;
+			}
+
+			time = next;
+			cpId = nextCpId;
+		}
+		finishBucket();
+		cpIds.insert(cpIds.end(), dominant.begin(), dominant.end());
+
+		// Levels above: the dominant cpId of the two halves
+		for (size_t l = 1; l < rank.numBuckets.size(); l++)
+		{
+			int m = rank.numBuckets[l];
+			for (int j = 0; j < m; j++)
+			{
+				int left = 2 * j, right = 2 * j + 1;
+				if (right >= n)
+				{
+					dominant[j] = dominant[left];
+					covered[j] = covered[left];
+				}
+				else if (dominant[left] == dominant[right])
+				{
+					dominant[j] = dominant[left];
+					covered[j] = covered[left] + covered[right];
+				}
+				else
+				{
+					int pick = (covered[right] > covered[left]) ? right : left;
+					dominant[j] = dominant[pick];
+					covered[j] = covered[pick];
+				}
+			}
+			n = m;
+			cpIds.insert(cpIds.end(), dominant.begin(), dominant.begin() + n);
+		}
+	}
+
+	// Writes the pyramid to 'filename', touching 'lock' after each batch
+	// of ranks to show that the build is still going on
+	bool TracePyramid::build(string filename, BaseDataFile* data, int headerSize,
+			FileOffset traceSize, int numThreads, int lock)
+	{
+		layout(data, headerSize);
+
+		DataOutputFileStream dos(filename.c_str());
+		if (!dos.good())
+			return false;
+
+		dos.write(PYRAMID_TAG, SIZEOF_PYRAMID_TAG);
+		dos.writeLong(traceSize);
+		dos.writeInt(headerSize);
+		dos.writeInt(MAX_BUCKETS);
+		dos.writeInt(ranks.size());
+		for (size_t i = 0; i < ranks.size(); i++)
+		{
+			RankPyramid& rank = ranks[i];
+			dos.writeLong(rank.minloc);
+			dos.writeLong(rank.maxloc);
+			dos.writeLong(rank.minTime);
+			dos.writeLong(rank.width);
+			dos.writeInt(rank.numBuckets.size());
+			for (size_t l = 0; l < rank.numBuckets.size(); l++)
+				dos.writeInt(rank.numBuckets[l]);
+		}
+
+		// Ranks are summarized in batches (each read once, in parallel)
+		// and written in order, so that only a batch is kept in memory.
+		int numRanks = ranks.size();
+		int batchSize = 16 * max(numThreads, 1);
+		vector<vector<int> > results(batchSize);
+		for (int first = 0; first < numRanks && dos.good(); first += batchSize)
+		{
+			int count = min(batchSize, numRanks - first);
+			std::atomic<int> nextRank(0);
+			auto work = [&]() {
+				for (int i = nextRank++; i < count; i = nextRank++)
+					buildRank(data, first + i, results[i]);
+			};
+
+			if (numThreads > 1)
+			{
+				vector<std::thread> workers;
+				for (int t = 0; t < min(numThreads, count); t++)
+					workers.push_back(std::thread(work));
+				for (size_t t = 0; t < workers.size(); t++)
+					workers[t].join();
+			}
+			else
+			{
+				work();
+			}
+
+			for (int i = 0; i < count; i++)
+			{
+				for (size_t j = 0; j < results[i].size(); j++)
+					dos.writeInt(results[i][j]);
+				vector<int>().swap(results[i]);
+			}
+			futimens(lock, NULL);
+		}
+		dos.close();
+		return !dos.fail();
+	}
+
+	bool TracePyramid::read(string filename, FileOffset traceSize, int headerSize,
+			BaseDataFile* data)
+	{
+		ifstream in(filename.c_str(), ios_base::binary | ios_base::in);
+		char buf[SIZEOF_PYRAMID_HEADER];
+
+		if (!in.read(buf, SIZEOF_PYRAMID_HEADER)
+				|| memcmp(buf, PYRAMID_TAG, SIZEOF_PYRAMID_TAG) != 0)
+			return false;
+		FileOffset pos = SIZEOF_PYRAMID_TAG;
+		FileOffset size = ByteUtilities::readLong(&buf[pos]);
+		pos += SIZEOF_LONG;
+		int header = ByteUtilities::readInt(&buf[pos]);
+		pos += SIZEOF_INT;
+		int maxBuckets = ByteUtilities::readInt(&buf[pos]);
+		pos += SIZEOF_INT;
+		int numRanks = ByteUtilities::readInt(&buf[pos]);
+		if (size != traceSize || header != headerSize
+				|| maxBuckets != MAX_BUCKETS
+				|| numRanks != data->getNumberOfFiles())
+			return false;
+
+		OffsetPair* offsets = data->getOffsets();
+		FileOffset dirSize = SIZEOF_PYRAMID_HEADER;
+		ranks.assign(numRanks, RankPyramid());
+		for (int i = 0; i < numRanks; i++)
+		{
+			char rbuf[SIZEOF_RANK_HEADER];
+			if (!in.read(rbuf, SIZEOF_RANK_HEADER))
+				return false;
+			RankPyramid& rank = ranks[i];
+			rank.minloc = ByteUtilities::readLong(&rbuf[0]);
+			rank.maxloc = ByteUtilities::readLong(&rbuf[SIZEOF_LONG]);
+			rank.minTime = ByteUtilities::readLong(&rbuf[2 * SIZEOF_LONG]);
+			rank.width = ByteUtilities::readLong(&rbuf[3 * SIZEOF_LONG]);
+			int numLevels = ByteUtilities::readInt(&rbuf[4 * SIZEOF_LONG]);
+			if (rank.minloc != offsets[i].start + headerSize
+					|| rank.maxloc != offsets[i].end || rank.width == 0
+					|| numLevels < 0 || numLevels > 32)
+				return false;
+
+			// each level must halve the one below, down to one bucket
+			rank.numBuckets.resize(numLevels);
+			for (int l = 0; l < numLevels; l++)
+			{
+				char lbuf[SIZEOF_INT];
+				if (!in.read(lbuf, SIZEOF_INT))
+					return false;
+				int n = ByteUtilities::readInt(lbuf);
+				if (n < 1 || (l == 0 && n > MAX_BUCKETS)
+						|| (l > 0 && n != (rank.numBuckets[l - 1] + 1) / 2))
+					return false;
+				rank.numBuckets[l] = n;
+			}
+			if (numLevels > 0 && rank.numBuckets[numLevels - 1] != 1)
+				return false;
+			dirSize += SIZEOF_RANK_HEADER + (FileOffset) numLevels * SIZEOF_INT;
+		}
+		in.close();
+
+		struct stat info;
+		FileOffset end = layoutData(dirSize);
+		if (stat(filename.c_str(), &info) != 0 || (FileOffset) info.st_size != end)
+			return false;
+
+		fd = ::open(filename.c_str(), O_RDONLY);
+		return (fd >= 0);
+	}
+
+	bool TracePyramid::sample(int rankNum, Time timeStart, double pixelLength,
+			int numPixels, vector<TimeCPID>& samples)
+	{
+		if (rankNum < 0 || (size_t) rankNum >= ranks.size() || numPixels < 1)
+			return false;
+		RankPyramid& rank = ranks[rankNum];
+		if (rank.numBuckets.empty() || pixelLength < (double) rank.width)
+			return false;
+
+		// the coarsest level whose buckets are no wider than a pixel
+		size_t level = 0;
+		Time width = rank.width;
+		FileOffset offset = rank.dataOffset;
+		while (level + 1 < rank.numBuckets.size() && (double) (2 * width) <= pixelLength)
+		{
+			offset += (FileOffset) rank.numBuckets[level] * SIZEOF_INT;
+			width *= 2;
+			level++;
+		}
+		Time n = rank.numBuckets[level];
+
+		auto bucketOf = [&](Time t) -> Time {
+			return (t <= rank.minTime) ? 0 : min(n - 1, (t - rank.minTime) / width);
+		};
+		Time b0 = bucketOf(timeStart);
+		Time b1 = bucketOf((Time) ((numPixels - 1) * pixelLength + timeStart));
+
+		// one or two buckets per pixel
+		vector<char> buf((b1 - b0 + 1) * SIZEOF_INT);
+		size_t done = 0;
+		while (done < buf.size())
+		{
+			ssize_t ret = pread(fd, &buf[done], buf.size() - done,
+					offset + b0 * SIZEOF_INT + done);
+			if (ret <= 0)
+				return false;
+			done += ret;
+		}
+
+		size_t first = samples.size();
+		for (int p = 0; p < numPixels; p++)
+		{
+			Time t = (Time) (p * pixelLength + timeStart);
+			int cpId = ByteUtilities::readInt(&buf[(bucketOf(t) - b0) * SIZEOF_INT]);
+			if (samples.size() == first || samples.back().cpid != cpId)
+				samples.push_back(TimeCPID(t, cpId));
+		}
+		return true;
+	}
+
+} /* namespace TraceviewerServer */
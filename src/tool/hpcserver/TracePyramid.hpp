@@ -0,0 +1,156 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Multi-resolution summary of the merged trace file (sidecar)
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#ifndef TRACEPYRAMID_H_
+#define TRACEPYRAMID_H_
+
+#include <string>
+#include <vector>
+
+#include "BaseDataFile.hpp"
+#include "TimeCPID.hpp" // Time
+#include "FileUtils.hpp" // FileOffset
+
+namespace TraceviewerServer
+{
+	// Build and use trace pyramids (default: false)
+	extern bool useTracePyramid;
+
+	/*
+	 * A pyramid of summaries of the merged trace file: for every rank with
+	 * enough records, level 0 divides the time from the first to the last
+	 * record into at most MAX_BUCKETS buckets of equal width, and each
+	 * level above halves the number of buckets. Every bucket holds its
+	 * dominant cpId, i.e., the one that covers the most time in it (a
+	 * record covers the time until the next record). Above level 0 the
+	 * dominant cpId of a bucket is chosen from those of its two halves.
+	 *
+	 * A zoomed-out view is then served from the coarsest level whose
+	 * buckets are no wider than a pixel, reading a few buckets per pixel
+	 * instead of searching the trace once per pixel. Finer views use the
+	 * trace itself.
+	 *
+	 * The pyramid is kept in a sidecar file (the trace file name + ".pyr")
+	 * that is built on first use and rebuilt if it is stale. Processes
+	 * opening it at the same time (hpcserver-mpi) build it once: the one
+	 * that creates the lock file (+ ".lock") builds it, and the others
+	 * wait for the lock to be removed before reading it. Bucket data is
+	 * read from the file on demand; if the sidecar cannot be written, the
+	 * pyramid is not used.
+	 *
+	 * Sidecar format (big endian):
+	 *   char[8] tag ("HPCTRPYR")
+	 *   Long trace file size, int header size, int max buckets,
+	 *   int number of ranks
+	 *   for each rank:
+	 *     Long offset of first record, Long offset of last record,
+	 *     Long time of first record, Long level 0 bucket width,
+	 *     int number of levels, then int number of buckets per level
+	 *   for each rank and level: int dominant cpId per bucket
+	 */
+	class TracePyramid
+	{
+	public:
+		// Loads the pyramid of 'traceFile' from its sidecar or builds it
+		// from 'data' with 'numThreads' threads. Returns NULL if the
+		// pyramid cannot be built.
+		static TracePyramid* open(string traceFile, BaseDataFile* data,
+				int headerSize, int numThreads);
+
+		virtual ~TracePyramid();
+
+		// Fills 'samples' with the dominant cpId of 'rank' at each of the
+		// 'numPixels' pixels beginning at 'timeStart', merging repeated
+		// cpIds. Returns false, leaving 'samples' unchanged, if the
+		// pyramid has no level as coarse as 'pixelLength'.
+		bool sample(int rank, Time timeStart, double pixelLength,
+				int numPixels, vector<TimeCPID>& samples);
+
+		static const int MAX_BUCKETS = 2048;
+		// Ranks with fewer records (per level 0 bucket) are not summarized
+		static const int MIN_RECORDS_PER_BUCKET = 4;
+
+	private:
+		struct RankPyramid
+		{
+			FileOffset minloc;
+			FileOffset maxloc;
+			Time minTime;
+			Time width; // of a level 0 bucket
+			vector<int> numBuckets; // per level
+			FileOffset dataOffset; // of level 0 in the sidecar
+		};
+
+		TracePyramid();
+
+		void layout(BaseDataFile* data, int headerSize);
+		FileOffset layoutData(FileOffset offset);
+		void buildRank(BaseDataFile* data, int rank, vector<int>& cpIds);
+		bool build(string filename, BaseDataFile* data, int headerSize,
+				FileOffset traceSize, int numThreads, int lock);
+		bool read(string filename, FileOffset traceSize, int headerSize,
+				BaseDataFile* data);
+
+		vector<RankPyramid> ranks;
+		int fd;
+	};
+
+} /* namespace TraceviewerServer */
+#endif /* TRACEPYRAMID_H_ */
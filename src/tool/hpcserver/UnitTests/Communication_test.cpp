@@ -0,0 +1,181 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+
+#undef NDEBUG
+
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include <stdlib.h> // mkdtemp
+#include <unistd.h> // rmdir
+
+#include "../Communication.hpp"
+#include "../DataSocketStream.hpp"
+#include "../FileData.hpp"
+#include "../ProgressBar.hpp"
+#include "../Server.hpp" // numThreads
+#include "../SpaceTimeDataController.hpp"
+#include "TestTraces.hpp"
+
+using namespace std;
+using namespace TraceviewerServer;
+
+#define HEADER_SIZE 24
+#define NUM_RANKS 16
+#define NUM_RECORDS 20000
+
+// Makes a worker thread fail, as if it ran out of memory
+static void failReadTimeline(ProcessTimeline*)
+{
+	throw std::bad_alloc();
+}
+
+// Sends the timelines of all ranks with 'threads' threads; returns what
+// was sent
+static string getData(SpaceTimeDataController* controller, int threads)
+{
+	numThreads = threads;
+	// N.B.: not deleted: ~DataSocketStream closes a socket
+	CaptureStream* out = new CaptureStream();
+	ProgressBar prog("Timelines", NUM_RANKS);
+	Communication::sendStartGetData(controller, 0, NUM_RANKS, 1000,
+			500L * NUM_RECORDS, NUM_RANKS, 1000);
+	Communication::sendEndGetData(out, &prog, controller);
+	return out->bytes;
+}
+
+// Sends the summary of all ranks made with 'threads' threads; returns
+// what was sent
+static string getSummary(SpaceTimeDataController* controller, int threads)
+{
+	numThreads = threads;
+	// N.B.: not deleted: ~DataSocketStream closes a socket
+	CaptureStream* out = new CaptureStream();
+	Communication::sendStartGetSummary(controller, 0, NUM_RANKS, 1000,
+			500L * NUM_RECORDS, NUM_RANKS, 1000);
+	Communication::sendEndGetSummary(out, controller);
+	return out->bytes;
+}
+
+void threadedTimelinesTest()
+{
+	int numRecords[NUM_RANKS];
+	for (int i = 0; i < NUM_RANKS; i++)
+		numRecords[i] = NUM_RECORDS;
+
+	char dir[] = "/tmp/threadedTimelinesTestXXXXXX";
+	assert(mkdtemp(dir));
+	FileData files;
+	files.fileTrace = string(dir) + "/experiment.mt";
+	writeTestTrace(files.fileTrace, NUM_RANKS, numRecords, HEADER_SIZE, 11);
+
+	SpaceTimeDataController controller(&files);
+	controller.setInfo(1000, 500L * NUM_RECORDS, HEADER_SIZE);
+
+	int savedNumThreads = numThreads;
+	string expected = getData(&controller, 1);
+	assert(getData(&controller, 4) == expected);
+	cout << "Timelines read by 4 threads are the same" << endl;
+
+	// a worker's exception is rethrown here instead of terminating
+	void (*readTimeline)(ProcessTimeline*) = Communication::readTimeline;
+	Communication::readTimeline = failReadTimeline;
+	bool caught = false;
+	try
+	{
+		getData(&controller, 4);
+	}
+	catch (std::bad_alloc&)
+	{
+		caught = true;
+	}
+	Communication::readTimeline = readTimeline;
+	assert(caught);
+	assert(getData(&controller, 4) == expected);
+	cout << "Exception in a timeline worker was passed on" << endl;
+
+	expected = getSummary(&controller, 1);
+	assert(getSummary(&controller, 4) == expected);
+	cout << "Summary made by 4 threads is the same" << endl;
+
+	Communication::readTimeline = failReadTimeline;
+	caught = false;
+	try
+	{
+		getSummary(&controller, 4);
+	}
+	catch (std::bad_alloc&)
+	{
+		caught = true;
+	}
+	Communication::readTimeline = readTimeline;
+	assert(caught);
+	assert(getSummary(&controller, 4) == expected);
+	cout << "Exception in a summary worker was passed on" << endl;
+
+	numThreads = savedNumThreads;
+	remove((files.fileTrace + ".idx").c_str());
+	remove(files.fileTrace.c_str());
+	rmdir(dir);
+}
@@ -61,6 +61,11 @@ extern void filterTest();
 extern void progBarTest();
 extern void compressionTest();
 extern void lruTest();
+extern void traceIndexTest();
+extern void mergeDataFilesTest();
+extern void tracePyramidTest();
+extern void threadedTimelinesTest();
+extern void timelineSummaryTest();
 
 int main(int argc, char** argv)
 {
@@ -68,5 +73,10 @@ int main(int argc, char** argv)
 	compressionTest();
 	progBarTest();
 	filterTest();
+	traceIndexTest();
+	mergeDataFilesTest();
+	tracePyramidTest();
+	threadedTimelinesTest();
+	timelineSummaryTest();
 }
 
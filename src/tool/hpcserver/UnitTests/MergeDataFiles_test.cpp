@@ -0,0 +1,198 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+
+
+#undef NDEBUG
+
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h> // mkdtemp
+#include <unistd.h> // rmdir
+
+#include "../ByteUtilities.hpp"
+#include "../Constants.hpp"
+#include "../FileUtils.hpp"
+#include "../MergeDataFiles.hpp"
+
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+using namespace std;
+using namespace TraceviewerServer;
+
+struct TestTrace
+{
+	string name;
+	bool deltaEncoded;
+	bool dataCentric;
+	vector<hpctrace_fmt_datum_t> records;
+};
+
+// Writes 'numRecords' records with times that mostly increase (by small
+// and large steps, with some going back) and cpIds and metricIds over
+// their whole range, in either encoding
+static void writeTrace(string dir, TestTrace& trace, int numRecords)
+{
+	hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
+	flags.fields.isDeltaEncoded = trace.deltaEncoded;
+	flags.fields.isDataCentric = trace.dataCentric;
+
+	FILE* fs = fopen((dir + "/" + trace.name).c_str(), "w");
+	assert(fs);
+	assert(hpctrace_fmt_hdr_fwrite(flags, fs) == HPCFMT_OK);
+
+	hpctrace_fmt_block_t blk = hpctrace_fmt_block_NULL;
+	uint64_t time = 1500000000000000ULL;
+	for (int i = 0; i < numRecords; i++)
+	{
+		switch (rand() % 8)
+		{
+			case 0: time += (uint64_t) rand() * rand(); break;
+			case 1: time -= rand() % 100; break;
+			default: time += rand() % 1000; break;
+		}
+		hpctrace_fmt_datum_t datum;
+		datum.time = time;
+		datum.cpId = (rand() % 4) ? rand() % 5000 : (uint32_t) rand() * 2;
+		datum.metricId = trace.dataCentric ? rand() % 3 : HPCRUN_FMT_MetricId_NULL;
+		if (i % 1000 == 999)
+			datum.cpId = HPCRUN_FMT_CCTNodeId_NULL;
+		assert(hpctrace_fmt_block_datum_fwrite(&datum, &blk, flags, fs) == HPCFMT_OK);
+		trace.records.push_back(datum);
+	}
+	fclose(fs);
+}
+
+void mergeDataFilesTest()
+{
+	char dir[] = "/tmp/mergeDataFilesTestXXXXXX";
+	assert(mkdtemp(dir));
+	string outputFile = string(dir) + "/experiment.mt";
+
+	// named as by hpcrun: <prog>-<proc>-<thread>-<host>-<pid>-<gen>
+	TestTrace traces[] = {
+		{ "app-000000-000-7f0101-100-0.hpctrace", true, false },
+		{ "app-000000-001-7f0101-100-0.hpctrace", false, false },
+		{ "app-000001-000-7f0101-101-0.hpctrace", true, true },
+		{ "app-000001-001-7f0101-101-0.hpctrace", true, false },
+		{ "app-000002-000-7f0101-102-0.hpctrace", false, true },
+	};
+	const int numRecords[] = { 20000, 3000, 15000, 0, 1 };
+	const int numTraces = sizeof(traces) / sizeof(traces[0]);
+	srand(12);
+	for (int i = 0; i < numTraces; i++)
+		writeTrace(dir, traces[i], numRecords[i]);
+
+	assert(MergeDataFiles::merge(dir, "*.hpctrace", outputFile) == SUCCESS_MERGED);
+
+	ifstream in(outputFile.c_str(), ios_base::binary);
+	string merged((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+	char* buf = &merged[0];
+	assert(ByteUtilities::readInt(buf) == (MULTI_PROCESSES | MULTI_THREADING));
+	assert(ByteUtilities::readInt(buf + 4) == numTraces);
+
+	// every trace in fixed-size records, right after the one before
+	Long offset = 2 * SIZEOF_INT + numTraces * (2 * SIZEOF_INT + SIZEOF_LONG);
+	for (int i = 0; i < numTraces; i++)
+	{
+		char* entry = buf + 2 * SIZEOF_INT + i * (2 * SIZEOF_INT + SIZEOF_LONG);
+		assert(ByteUtilities::readInt(entry) == i / 2);
+		assert(ByteUtilities::readInt(entry + SIZEOF_INT) == i % 2);
+		assert(ByteUtilities::readLong(entry + 2 * SIZEOF_INT) == offset);
+
+		char* p = buf + offset;
+		assert(string(p, HPCTRACE_FMT_MagicLen) == HPCTRACE_FMT_Magic);
+		hpctrace_hdr_flags_t flags;
+		flags.bits = ByteUtilities::readLong(p + HPCTRACE_FMT_HeaderLen - HPCTRACE_FMT_FlagsLen);
+		assert(!flags.fields.isDeltaEncoded);
+		assert(flags.fields.isDataCentric == traces[i].dataCentric);
+		p += HPCTRACE_FMT_HeaderLen;
+
+		vector<hpctrace_fmt_datum_t>& records = traces[i].records;
+		for (size_t r = 0; r < records.size(); r++)
+		{
+			assert((uint64_t) ByteUtilities::readLong(p) == records[r].time);
+			assert((uint32_t) ByteUtilities::readInt(p + SIZEOF_LONG) == records[r].cpId);
+			p += SIZE_OF_TRACE_RECORD;
+			if (flags.fields.isDataCentric)
+			{
+				assert((uint32_t) ByteUtilities::readInt(p) == records[r].metricId);
+				p += SIZEOF_INT;
+			}
+		}
+		offset = p - buf;
+	}
+	assert(offset + SIZEOF_LONG == (Long) merged.size());
+	assert((uint64_t) ByteUtilities::readLong(buf + offset) == 0xFFFFFFFFDEADF00DULL);
+	cout << "Merged traces round trip" << endl;
+
+	// the input files are removed
+	for (int i = 0; i < numTraces; i++)
+		assert(!FileUtils::exists(string(dir) + "/" + traces[i].name));
+	remove(outputFile.c_str());
+	rmdir(dir);
+}
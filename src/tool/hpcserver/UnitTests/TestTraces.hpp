@@ -0,0 +1,160 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+
+#ifndef TESTTRACES_H_
+#define TESTTRACES_H_
+
+#include <cassert>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+
+#include <utime.h>
+#include <sys/stat.h>
+
+#include "../ByteUtilities.hpp"
+#include "../DataOutputFileStream.hpp"
+#include "../DataSocketStream.hpp"
+#include "../Constants.hpp"
+
+namespace TraceviewerServer
+{
+	// Writes a merged trace file (cf. MergeDataFiles) in which rank i has
+	// numRecords[i] records with increasing random times, starting after
+	// 1000, and random cpIds in [0, numCpIds). Ranks are (process i,
+	// thread 0); each has a zero-filled header of headerSize bytes.
+	inline void writeTestTrace(std::string filename, int numRanks,
+			const int* numRecords, int headerSize, unsigned int seed,
+			int numCpIds = 50)
+	{
+		srand(seed);
+		DataOutputFileStream dos(filename.c_str());
+		dos.writeInt(1); // format
+		dos.writeInt(numRanks);
+		Long offset = 2 * SIZEOF_INT + numRanks * (2 * SIZEOF_INT + SIZEOF_LONG);
+		for (int i = 0; i < numRanks; i++)
+		{
+			dos.writeInt(i); // process
+			dos.writeInt(0); // thread
+			dos.writeLong(offset);
+			offset += headerSize + (Long) numRecords[i] * SIZE_OF_TRACE_RECORD;
+		}
+		for (int i = 0; i < numRanks; i++)
+		{
+			for (int h = 0; h < headerSize; h++)
+				dos.put(0);
+			Long time = 1000;
+			for (int k = 0; k < numRecords[i]; k++)
+			{
+				time += 1 + rand() % 1000;
+				dos.writeLong(time);
+				dos.writeInt(rand() % numCpIds);
+			}
+		}
+		dos.writeInt(0x12345678); // end marker
+		dos.close();
+	}
+
+	// Modification time of 'filename'; with setModificationTime, lets tests
+	// age a trace relative to its sidecar files
+	inline time_t modificationTime(std::string filename)
+	{
+		struct stat info;
+		assert(stat(filename.c_str(), &info) == 0);
+		return info.st_mtime;
+	}
+
+	inline void setModificationTime(std::string filename, time_t mtime)
+	{
+		struct utimbuf times;
+		times.actime = mtime;
+		times.modtime = mtime;
+		assert(utime(filename.c_str(), &times) == 0);
+	}
+
+	// Keeps what is sent to the client
+	class CaptureStream : public DataSocketStream
+	{
+	public:
+		std::string bytes;
+
+		void writeInt(int v)
+		{
+			char b[SIZEOF_INT];
+			ByteUtilities::writeInt(b, v);
+			bytes.append(b, SIZEOF_INT);
+		}
+		void writeLong(Long v)
+		{
+			char b[SIZEOF_LONG];
+			ByteUtilities::writeLong(b, v);
+			bytes.append(b, SIZEOF_LONG);
+		}
+		void writeRawData(char* data, int length)
+		{
+			bytes.append(data, length);
+		}
+		void flush()
+		{
+		}
+	};
+
+} /* namespace TraceviewerServer */
+#endif /* TESTTRACES_H_ */
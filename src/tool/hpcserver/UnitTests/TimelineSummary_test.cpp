@@ -0,0 +1,223 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+
+
+#undef NDEBUG
+
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdlib.h> // mkdtemp
+#include <unistd.h> // rmdir
+#include <zlib.h>
+
+#include "../ByteUtilities.hpp"
+#include "../Communication.hpp"
+#include "../Constants.hpp"
+#include "../DataSocketStream.hpp"
+#include "../FileData.hpp"
+#include "../SpaceTimeDataController.hpp"
+#include "../TimelineSummary.hpp"
+#include "TestTraces.hpp"
+
+using namespace std;
+using namespace TraceviewerServer;
+
+#define HEADER_SIZE 24
+#define NUM_RANKS 8
+#define NUM_RECORDS 2000
+#define NUM_COLUMNS 300
+
+static vector<int> packed(TimelineSummary& summary)
+{
+	vector<int> out;
+	summary.pack(out);
+	return out;
+}
+
+// The cpid shown by a timeline in a column is the one of the last sample
+// starting before the column ends; count them without TimelineSummary
+static vector<map<int, int> > bruteForce(ProcessTimeline** traces, int numTraces)
+{
+	vector<map<int, int> > columns(NUM_COLUMNS);
+	for (int i = 0; i < numTraces; i++)
+	{
+		vector<TimeCPID>& data = *traces[i]->data->listCPID;
+		Time start = traces[i]->getStartingTime();
+		double pixelLength = traces[i]->getPixelLength();
+		for (int c = 0; c < NUM_COLUMNS; c++)
+		{
+			int cpid = -1;
+			for (size_t k = 0; k < data.size(); k++)
+			{
+				Time t = data[k].timestamp;
+				if (t > start && (t - start) / pixelLength >= c + 1)
+					break;
+				cpid = data[k].cpid;
+			}
+			if (cpid >= 0)
+				columns[c][cpid]++;
+		}
+	}
+	return columns;
+}
+
+void timelineSummaryTest()
+{
+	int numRecords[NUM_RANKS];
+	for (int i = 0; i < NUM_RANKS; i++)
+		numRecords[i] = NUM_RECORDS;
+
+	char dir[] = "/tmp/timelineSummaryTestXXXXXX";
+	assert(mkdtemp(dir));
+	FileData files;
+	files.fileTrace = string(dir) + "/experiment.mt";
+	writeTestTrace(files.fileTrace, NUM_RANKS, numRecords, HEADER_SIZE, 5);
+
+	// a window starting and ending inside the traces, so that samples
+	// bracket both of its ends
+	SpaceTimeDataController controller(&files);
+	controller.setInfo(1000, 500L * NUM_RECORDS, HEADER_SIZE);
+	Communication::sendStartGetSummary(&controller, 0, NUM_RANKS, 200000, 700000,
+			NUM_RANKS, NUM_COLUMNS);
+	controller.fillTraces();
+	ProcessTimeline** traces = controller.traces;
+	int numTraces = controller.tracesLength;
+	assert(numTraces == NUM_RANKS);
+
+	// add
+	TimelineSummary all(NUM_COLUMNS);
+	for (int i = 0; i < numTraces; i++)
+		all.add(traces[i]);
+	assert(all.getNumColumns() == NUM_COLUMNS);
+	assert(all.getNumTimelines() == numTraces);
+
+	vector<map<int, int> > expected = bruteForce(traces, numTraces);
+	vector<int> allPacked = packed(all);
+	size_t p = 0;
+	assert(allPacked[p++] == numTraces);
+	for (int c = 0; c < NUM_COLUMNS; c++)
+	{
+		int entries = allPacked[p++];
+		assert(entries == (int) expected[c].size());
+		int total = 0;
+		for (int e = 0; e < entries; e++, p += 2)
+		{
+			assert(expected[c][allPacked[p]] == allPacked[p + 1]);
+			total += allPacked[p + 1];
+		}
+		assert(total == numTraces);
+	}
+	assert(p == allPacked.size());
+	cout << "Summary counts match the timelines" << endl;
+
+	// merge
+	TimelineSummary first(NUM_COLUMNS), second(NUM_COLUMNS);
+	for (int i = 0; i < numTraces; i++)
+		(i < numTraces / 3 ? first : second).add(traces[i]);
+	TimelineSummary merged(NUM_COLUMNS);
+	merged.merge(second);
+	merged.merge(first);
+	assert(merged.getNumTimelines() == numTraces);
+	assert(packed(merged) == allPacked);
+	cout << "Merged summaries are the same" << endl;
+
+	// pack and unpack
+	TimelineSummary unpacked(NUM_COLUMNS);
+	unpacked.unpack(allPacked.data(), allPacked.size());
+	assert(packed(unpacked) == allPacked);
+	vector<int> secondPacked = packed(second);
+	first.unpack(secondPacked.data(), secondPacked.size());
+	assert(packed(first) == allPacked);
+	cout << "Unpacked summaries are the same" << endl;
+
+	// send: the header, then the counts compressed
+	// N.B.: not deleted: ~DataSocketStream closes a socket
+	CaptureStream* out = new CaptureStream();
+	all.send(out);
+	char* msg = (char*) out->bytes.data();
+	assert(ByteUtilities::readInt(msg) == SUMM);
+	assert(ByteUtilities::readInt(msg + 4) == NUM_COLUMNS);
+	assert(ByteUtilities::readInt(msg + 8) == numTraces);
+	int compressedSize = ByteUtilities::readInt(msg + 12);
+	assert(out->bytes.size() == 16 + (size_t) compressedSize);
+
+	vector<char> counts((allPacked.size() - 1) * SIZEOF_INT);
+	z_stream z = z_stream();
+	assert(inflateInit2(&z, 32 + MAX_WBITS) == Z_OK);
+	z.next_in = (Bytef*) msg + 16;
+	z.avail_in = compressedSize;
+	z.next_out = (Bytef*) counts.data();
+	z.avail_out = counts.size();
+	assert(inflate(&z, Z_FINISH) == Z_STREAM_END);
+	assert(z.total_out == counts.size());
+	inflateEnd(&z);
+	for (size_t i = 1; i < allPacked.size(); i++)
+		assert(ByteUtilities::readInt(&counts[(i - 1) * SIZEOF_INT]) == allPacked[i]);
+	cout << "Sent summary matches" << endl;
+
+	remove((files.fileTrace + ".idx").c_str());
+	remove(files.fileTrace.c_str());
+	rmdir(dir);
+}
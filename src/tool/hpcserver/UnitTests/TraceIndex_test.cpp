@@ -0,0 +1,183 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+
+#undef NDEBUG
+
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <stdlib.h> // mkdtemp
+#include <unistd.h> // rmdir
+#include <sys/stat.h>
+
+#include "../FilteredBaseData.hpp"
+#include "../TraceDataByRank.hpp"
+#include "../TraceIndex.hpp"
+#include "../Constants.hpp"
+#include "TestTraces.hpp"
+
+using namespace std;
+using namespace TraceviewerServer;
+
+#define HEADER_SIZE 24
+#define NUM_RANKS 5
+
+// Checks that narrowToTime keeps the records bracketing each time within
+// the bounds, and that searches give the same records with and without
+// the index
+static void checkNarrow(string traceFile, const int* numRecords)
+{
+	useTraceIndex = false;
+	FilteredBaseData plain(traceFile, HEADER_SIZE);
+	useTraceIndex = true;
+	FilteredBaseData indexed(traceFile, HEADER_SIZE);
+
+	for (int rank = 0; rank < NUM_RANKS; rank++)
+	{
+		if (numRecords[rank] == 0)
+			continue;
+		FileOffset minLoc = plain.getMinLoc(rank);
+		FileOffset maxLoc = plain.getMaxLoc(rank);
+		Long maxTime = plain.getLong(maxLoc);
+		TraceDataByRank plainRank(&plain, rank, 1000, HEADER_SIZE);
+		TraceDataByRank indexedRank(&indexed, rank, 1000, HEADER_SIZE);
+
+		for (int q = 0; q < 2000; q++)
+		{
+			Time time = rand() % (maxTime + 2000);
+
+			FileOffset l = minLoc, r = maxLoc;
+			indexed.narrowToTime(rank, time, l, r);
+			assert(minLoc <= l && l <= r && r <= maxLoc);
+			assert((l - minLoc) % SIZE_OF_TRACE_RECORD == 0);
+			assert((r - minLoc) % SIZE_OF_TRACE_RECORD == 0);
+			assert(l == minLoc || (Time) indexed.getLong(l) <= time);
+			assert(r == maxLoc || (Time) indexed.getLong(r) >= time);
+
+			// a narrower search interval, as when a timeline is refined
+			l = minLoc;
+			r = maxLoc;
+			if (q % 2)
+			{
+				FileOffset n = (maxLoc - minLoc) / SIZE_OF_TRACE_RECORD + 1;
+				l = minLoc + SIZE_OF_TRACE_RECORD * (rand() % n);
+				r = minLoc + SIZE_OF_TRACE_RECORD * (rand() % n);
+				if (l > r)
+					swap(l, r);
+			}
+			assert(plainRank.findTimeInInterval(time, l, r)
+					== indexedRank.findTimeInInterval(time, l, r));
+		}
+	}
+}
+
+void traceIndexTest()
+{
+	// ranks without records, with less than one block, and with several
+	// blocks (cf. TraceIndex::RECORDS_PER_BLOCK)
+	const int numRecords[NUM_RANKS] = {0, 1, 5000, 100000, 37};
+
+	char dir[] = "/tmp/traceIndexTestXXXXXX";
+	assert(mkdtemp(dir));
+	string traceFile = string(dir) + "/experiment.mt";
+	string indexFile = traceFile + ".idx";
+
+	// built on first use
+	writeTestTrace(traceFile, NUM_RANKS, numRecords, HEADER_SIZE, 7);
+	assert(!FileUtils::exists(indexFile));
+	checkNarrow(traceFile, numRecords);
+	assert(FileUtils::exists(indexFile));
+	cout << "Trace index built" << endl;
+
+	// read back: not rewritten
+	setModificationTime(indexFile, modificationTime(traceFile) + 10);
+	time_t built = modificationTime(indexFile);
+	checkNarrow(traceFile, numRecords);
+	assert(modificationTime(indexFile) == built);
+	cout << "Trace index read" << endl;
+
+	// stale: a trace file of the same size but with other times that is
+	// newer than the index
+	writeTestTrace(traceFile, NUM_RANKS, numRecords, HEADER_SIZE, 8);
+	setModificationTime(traceFile, built + 10);
+	checkNarrow(traceFile, numRecords);
+	assert(modificationTime(indexFile) != built);
+	cout << "Stale trace index rebuilt" << endl;
+
+	// invalid: a truncated index is rebuilt too
+	{
+		FILE* f = fopen(indexFile.c_str(), "r+");
+		assert(f && ftruncate(fileno(f), 20) == 0);
+		fclose(f);
+	}
+	setModificationTime(indexFile, modificationTime(traceFile) + 10);
+	checkNarrow(traceFile, numRecords);
+	struct stat info;
+	assert(stat(indexFile.c_str(), &info) == 0 && info.st_size > 20);
+	cout << "Invalid trace index rebuilt" << endl;
+
+	remove(indexFile.c_str());
+	remove(traceFile.c_str());
+	rmdir(dir);
+	cout << "Trace index tests passed" << endl;
+}
@@ -0,0 +1,333 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+
+
+#undef NDEBUG
+
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h> // mkdtemp
+#include <unistd.h> // rmdir
+
+#include "../BaseDataFile.hpp"
+#include "../Constants.hpp"
+#include "../TracePyramid.hpp"
+#include "TestTraces.hpp"
+
+using namespace std;
+using namespace TraceviewerServer;
+
+#define HEADER_SIZE 24
+#define NUM_RANKS 5
+
+// The levels of a rank, computed from its records as described in
+// TracePyramid.hpp
+struct Levels
+{
+	Time minTime;
+	Time width; // of a level 0 bucket
+	vector<vector<int> > dominant;
+};
+
+static Levels expectedLevels(BaseDataFile& data, int rank)
+{
+	LargeByteBuffer* buffer = data.getMasterBuffer();
+	FileOffset minloc = data.getOffsets()[rank].start + HEADER_SIZE;
+	FileOffset maxloc = data.getOffsets()[rank].end;
+	vector<Time> times;
+	vector<int> cpIds;
+	for (FileOffset loc = minloc; loc <= maxloc; loc += SIZE_OF_TRACE_RECORD)
+	{
+		times.push_back(buffer->getLong(loc));
+		cpIds.push_back(buffer->getInt(loc + SIZEOF_LONG));
+	}
+
+	Levels levels;
+	levels.minTime = times.front();
+	Time span = times.back() - times.front() + 1;
+	levels.width = (span + TracePyramid::MAX_BUCKETS - 1) / TracePyramid::MAX_BUCKETS;
+	int n = (span + levels.width - 1) / levels.width;
+
+	// level 0: the time each cpId covers in each bucket
+	vector<map<int, Time> > hist(n);
+	for (size_t k = 0; k < times.size(); k++)
+	{
+		Time end = (k + 1 < times.size()) ? times[k + 1] : times[k] + 1;
+		for (Time t = times[k]; t < end; t++)
+		{
+			Time b = min((Time) n - 1, (t - levels.minTime) / levels.width);
+			hist[b][cpIds[k]]++;
+		}
+	}
+	vector<int> dominant(n);
+	vector<Time> covered(n);
+	for (int b = 0; b < n; b++)
+	{
+		covered[b] = 0;
+		map<int, Time>::iterator it;
+		for (it = hist[b].begin(); it != hist[b].end(); ++it)
+		{
+			if (it->second > covered[b])
+			{
+				dominant[b] = it->first;
+				covered[b] = it->second;
+			}
+		}
+	}
+	levels.dominant.push_back(dominant);
+
+	// levels above: the one of the two halves that covers more time
+	while (n > 1)
+	{
+		int m = (n + 1) / 2;
+		vector<int> up(m);
+		vector<Time> upCovered(m);
+		for (int j = 0; j < m; j++)
+		{
+			int l = 2 * j, r = 2 * j + 1;
+			if (r >= n || dominant[l] == dominant[r])
+			{
+				up[j] = dominant[l];
+				upCovered[j] = covered[l] + (r < n ? covered[r] : 0);
+			}
+			else
+			{
+				int pick = (covered[r] > covered[l]) ? r : l;
+				up[j] = dominant[pick];
+				upCovered[j] = covered[pick];
+			}
+		}
+		dominant.swap(up);
+		covered.swap(upCovered);
+		n = m;
+		levels.dominant.push_back(dominant);
+	}
+	return levels;
+}
+
+// What TracePyramid::sample should give: the dominant cpId of the bucket
+// holding each pixel's time, at the coarsest level no wider than a pixel
+static vector<TimeCPID> expectedSamples(const Levels& levels, Time timeStart,
+		double pixelLength, int numPixels)
+{
+	size_t level = 0;
+	Time width = levels.width;
+	while (level + 1 < levels.dominant.size() && (double) (2 * width) <= pixelLength)
+	{
+		width *= 2;
+		level++;
+	}
+	const vector<int>& dominant = levels.dominant[level];
+
+	vector<TimeCPID> samples;
+	for (int p = 0; p < numPixels; p++)
+	{
+		Time t = (Time) (p * pixelLength + timeStart);
+		Time b = (t <= levels.minTime) ? 0
+				: min((Time) dominant.size() - 1, (t - levels.minTime) / width);
+		if (samples.empty() || samples.back().cpid != dominant[b])
+			samples.push_back(TimeCPID(t, dominant[b]));
+	}
+	return samples;
+}
+
+static bool sameSamples(const vector<TimeCPID>& a, const vector<TimeCPID>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+		if (a[i].timestamp != b[i].timestamp || a[i].cpid != b[i].cpid)
+			return false;
+	return true;
+}
+
+static void checkPyramid(TracePyramid* pyramid, BaseDataFile& data,
+		const int* numRecords)
+{
+	assert(pyramid);
+	for (int rank = 0; rank < NUM_RANKS; rank++)
+	{
+		vector<TimeCPID> samples;
+		if (numRecords[rank] < TracePyramid::MAX_BUCKETS * TracePyramid::MIN_RECORDS_PER_BUCKET)
+		{
+			assert(!pyramid->sample(rank, 0, 1e9, 100, samples));
+			continue;
+		}
+		Levels levels = expectedLevels(data, rank);
+
+		// finer than level 0: samples are left alone
+		samples.push_back(TimeCPID(1, 2));
+		assert(!pyramid->sample(rank, levels.minTime, levels.width - 0.5, 100, samples));
+		assert(samples.size() == 1);
+		samples.clear();
+
+		// every bucket of every level
+		Time width = levels.width;
+		for (size_t l = 0; l < levels.dominant.size(); l++, width *= 2)
+		{
+			int n = levels.dominant[l].size();
+			samples.clear();
+			assert(pyramid->sample(rank, levels.minTime, width, n, samples));
+			assert(sameSamples(samples, expectedSamples(levels, levels.minTime, width, n)));
+		}
+
+		// views beginning and ending anywhere, also outside the trace
+		Time span = levels.width * levels.dominant[0].size();
+		for (int q = 0; q < 200; q++)
+		{
+			Time timeStart = rand() % (span + span / 4);
+			double pixelLength = levels.width * (1 + rand() % 5000 / 100.0);
+			int numPixels = 1 + rand() % 2000;
+			samples.clear();
+			assert(pyramid->sample(rank, timeStart, pixelLength, numPixels, samples));
+			assert(sameSamples(samples,
+					expectedSamples(levels, timeStart, pixelLength, numPixels)));
+		}
+	}
+}
+
+void tracePyramidTest()
+{
+	// ranks too small to be summarized, with as many records as buckets
+	// at the minimum, and larger ones
+	const int numRecords[NUM_RANKS] = {0, 100, 8192, 50000, 9001};
+
+	char dir[] = "/tmp/tracePyramidTestXXXXXX";
+	assert(mkdtemp(dir));
+	string traceFile = string(dir) + "/experiment.mt";
+	string pyramidFile = traceFile + ".pyr";
+	string lockFile = pyramidFile + ".lock";
+	writeTestTrace(traceFile, NUM_RANKS, numRecords, HEADER_SIZE, 3);
+	BaseDataFile data(traceFile, HEADER_SIZE);
+
+	// built on first use, the same with one or several threads
+	TracePyramid* pyramid = TracePyramid::open(traceFile, &data, HEADER_SIZE, 1);
+	checkPyramid(pyramid, data, numRecords);
+	delete pyramid;
+	string built;
+	{
+		ifstream in(pyramidFile.c_str(), ios_base::binary);
+		built.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	}
+	remove(pyramidFile.c_str());
+	pyramid = TracePyramid::open(traceFile, &data, HEADER_SIZE, 4);
+	checkPyramid(pyramid, data, numRecords);
+	delete pyramid;
+	{
+		ifstream in(pyramidFile.c_str(), ios_base::binary);
+		assert(built == string(istreambuf_iterator<char>(in), istreambuf_iterator<char>()));
+	}
+	assert(!FileUtils::exists(lockFile));
+	cout << "Trace pyramid built" << endl;
+
+	// read back: not rewritten
+	setModificationTime(pyramidFile, modificationTime(traceFile) + 10);
+	time_t written = modificationTime(pyramidFile);
+	pyramid = TracePyramid::open(traceFile, &data, HEADER_SIZE, 1);
+	checkPyramid(pyramid, data, numRecords);
+	delete pyramid;
+	assert(modificationTime(pyramidFile) == written);
+	cout << "Trace pyramid read" << endl;
+
+	// invalid: a sidecar whose directory is read in full before it turns
+	// out to be truncated is rebuilt from scratch
+	assert(truncate(pyramidFile.c_str(), built.size() - 4) == 0);
+	setModificationTime(pyramidFile, modificationTime(traceFile) + 10);
+	pyramid = TracePyramid::open(traceFile, &data, HEADER_SIZE, 1);
+	checkPyramid(pyramid, data, numRecords);
+	delete pyramid;
+	assert(modificationTime(pyramidFile) != written);
+	cout << "Invalid trace pyramid rebuilt" << endl;
+
+	// while another process holds the lock, the pyramid it builds is
+	// waited for and read instead of built again
+	setModificationTime(pyramidFile, modificationTime(traceFile) - 10);
+	written = modificationTime(pyramidFile);
+	int lock = open(lockFile.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+	assert(lock >= 0);
+	TracePyramid* waited = NULL;
+	std::thread waiter([&]() {
+		waited = TracePyramid::open(traceFile, &data, HEADER_SIZE, 1);
+	});
+	usleep(300000);
+	assert(!waited);
+	close(lock);
+	remove(lockFile.c_str());
+	waiter.join();
+	checkPyramid(waited, data, numRecords);
+	delete waited;
+	assert(modificationTime(pyramidFile) == written);
+	cout << "Trace pyramid built by another process read" << endl;
+
+	remove(pyramidFile.c_str());
+	remove(traceFile.c_str());
+	rmdir(dir);
+	cout << "Trace pyramid tests passed" << endl;
+}
@@ -61,6 +61,8 @@
 #include "Communication.hpp"
 #include "Constants.hpp"
 #include "Args.hpp"
+#include "TraceIndex.hpp"
+#include "TracePyramid.hpp"
 #include "DebugUtils.hpp"
 
 using namespace std;
@@ -74,6 +76,9 @@ int main(int argc, char *argv[])
 	TraceviewerServer::useCompression = args.compression;
 	TraceviewerServer::xmlPortNumber = args.xmlPort;
 	TraceviewerServer::mainPortNumber = args.mainPort;
+	TraceviewerServer::useTraceIndex = args.traceIndex;
+	TraceviewerServer::useTracePyramid = args.tracePyramid;
+	TraceviewerServer::numThreads = args.numThreads;
 
 	try
 	{
@@ -104,10 +104,11 @@ main(int argc, char **argv)
   }
 
   // read and dump trace records until EOF 
+  hpctrace_fmt_block_t blk = hpctrace_fmt_block_NULL;
   while ( !feof(infs) ) {
     hpctrace_fmt_datum_t datum;
 
-    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
+    ret = hpctrace_fmt_block_datum_fread(&datum, &blk, hdr.flags, infs);
 
     if (ret == HPCFMT_EOF) {
       break;